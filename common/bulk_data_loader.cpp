@@ -0,0 +1,145 @@
+#include "common/bulk_data_loader.h"
+
+#include <fcntl.h>
+#include <glog/logging.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+namespace slog {
+
+namespace {
+
+const size_t kBatchSize = 1024;
+
+bool ReadVarint(const uint8_t*& pos, const uint8_t* end, uint64_t& value) {
+  value = 0;
+  for (int shift = 0; shift < 64 && pos < end; shift += 7) {
+    auto byte = *pos++;
+    value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+struct Chunk {
+  const uint8_t* begin;
+  const uint8_t* end;
+  uint64_t num_datums;
+};
+
+}  // namespace
+
+BulkDataLoader::BulkDataLoader(uint32_t num_threads)
+    : num_threads_(std::max(num_threads, 1U)), num_chunks_(0), num_datums_(0) {}
+
+bool BulkDataLoader::Load(const std::string& path, const BatchFn& batch_fn, const CountFn& count_fn) {
+  auto start_time = std::chrono::steady_clock::now();
+
+  auto fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    LOG(FATAL) << "Cannot stat \"" << path << "\": " << strerror(errno);
+  }
+  size_t size = st.st_size;
+  if (size == 0) {
+    LOG(FATAL) << "Error while reading data file \"" << path << "\": file is empty";
+  }
+  auto data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (data == MAP_FAILED) {
+    LOG(FATAL) << "Cannot map \"" << path << "\": " << strerror(errno);
+  }
+  close(fd);
+  // Every page will be read exactly once, so start reading ahead right away
+  madvise(data, size, MADV_WILLNEED);
+
+  auto pos = static_cast<const uint8_t*>(data);
+  auto end = pos + size;
+
+  uint64_t num_datums;
+  if (!ReadVarint(pos, end, num_datums)) {
+    LOG(FATAL) << "Error while reading data file \"" << path << "\"";
+  }
+  if (count_fn) {
+    count_fn(num_datums);
+  }
+
+  // Split the file into chunks of about the same size, at datum boundaries
+  std::vector<Chunk> chunks;
+  size_t target_chunk_size = (end - pos) / num_threads_ + 1;
+  Chunk chunk{pos, pos, 0};
+  for (uint64_t i = 0; i < num_datums; i++) {
+    uint64_t datum_size;
+    if (!ReadVarint(pos, end, datum_size) || datum_size > static_cast<uint64_t>(end - pos)) {
+      LOG(FATAL) << "Error while reading data file \"" << path << "\": datum " << i << " is truncated";
+    }
+    pos += datum_size;
+    chunk.num_datums++;
+    if (static_cast<size_t>(pos - chunk.begin) >= target_chunk_size) {
+      chunk.end = pos;
+      chunks.push_back(chunk);
+      chunk = Chunk{pos, pos, 0};
+    }
+  }
+  if (chunk.num_datums > 0) {
+    chunk.end = pos;
+    chunks.push_back(chunk);
+  }
+
+  auto DecodeFn = [&path, &batch_fn](uint32_t chunk_id, const Chunk& chunk) {
+    std::vector<Datum> batch;
+    batch.reserve(kBatchSize);
+    auto pos = chunk.begin;
+    for (uint64_t i = 0; i < chunk.num_datums; i++) {
+      uint64_t datum_size;
+      ReadVarint(pos, chunk.end, datum_size);
+      if (!batch.emplace_back().ParseFromArray(pos, datum_size)) {
+        LOG(FATAL) << "Error while parsing a datum in \"" << path << "\"";
+      }
+      pos += datum_size;
+      if (batch.size() == kBatchSize) {
+        batch_fn(chunk_id, batch);
+        batch.clear();
+      }
+    }
+    if (!batch.empty()) {
+      batch_fn(chunk_id, batch);
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (uint32_t i = 1; i < chunks.size(); i++) {
+    threads.emplace_back(DecodeFn, i, chunks[i]);
+  }
+  if (!chunks.empty()) {
+    DecodeFn(0, chunks[0]);
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  munmap(data, size);
+
+  num_chunks_ = chunks.size();
+  num_datums_ = num_datums;
+
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_time;
+  auto mb = size / 1048576.0;
+  LOG(INFO) << "Loaded " << num_datums << " datums (" << mb << " MB) from \"" << path << "\" in " << elapsed.count()
+            << " s using " << num_chunks_ << " threads. Throughput: " << num_datums / elapsed.count() << " datums/s, "
+            << mb / elapsed.count() << " MB/s";
+
+  return true;
+}
+
+}  // namespace slog
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "proto/offline_data.pb.h"
+
+namespace slog {
+
+/**
+ * Loads a data file generated by tools/gen_data.py, which is laid out as
+ *
+ *    <number of datums (varint)> <size (varint)> <Datum> <size (varint)> <Datum> ...
+ *
+ * The file is memory-mapped and split into contiguous chunks by scanning the size
+ * prefixes, without parsing any datum. Each chunk is then decoded on its own thread.
+ */
+class BulkDataLoader {
+ public:
+  /**
+   * Called with consecutive batches of datums of a chunk, in file order. Different
+   * chunks are processed concurrently so this function must be thread-safe.
+   * The batch can be modified or moved from.
+   */
+  using BatchFn = std::function<void(uint32_t chunk, std::vector<Datum>& batch)>;
+
+  /**
+   * Called with the number of datums in the file before any batch is passed to BatchFn
+   */
+  using CountFn = std::function<void(uint64_t num_datums)>;
+
+  BulkDataLoader(uint32_t num_threads);
+
+  /**
+   * Loads the file at the given path, passing all its datums to batch_fn.
+   * A malformed file is a fatal error.
+   *
+   * @return false if the file cannot be opened, with errno set accordingly
+   */
+  bool Load(const std::string& path, const BatchFn& batch_fn, const CountFn& count_fn = nullptr);
+
+  /**
+   * Number of chunks of the last loaded file. Chunks are numbered from 0 in file order.
+   */
+  uint32_t num_chunks() const { return num_chunks_; }
+
+  uint64_t num_datums() const { return num_datums_; }
+
+ private:
+  uint32_t num_threads_;
+  uint32_t num_chunks_;
+  uint64_t num_datums_;
+};
+
+}  // namespace slog
@@ -0,0 +1,210 @@
+#include "common/compression.h"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace slog {
+
+namespace {
+
+constexpr size_t kMinMatch = 4;
+constexpr size_t kMaxOffset = 65535;
+constexpr int kHashBits = 12;
+// A nibble of a block token saturates at this value, after which the length continues in extra bytes
+constexpr size_t kNibbleMax = 15;
+// Skip faster through data without matches. The step grows by 1 every 2^kSkipShift misses
+constexpr int kSkipShift = 5;
+
+uint32_t Load32(const char* p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+uint32_t Hash(uint32_t v) { return (v * 2654435761U) >> (32 - kHashBits); }
+
+void PutVarint(std::string& out, uint64_t v) {
+  while (v >= 0x80) {
+    out.push_back(static_cast<char>(v | 0x80));
+    v >>= 7;
+  }
+  out.push_back(static_cast<char>(v));
+}
+
+bool GetVarint(std::string_view in, size_t& pos, uint64_t& v) {
+  v = 0;
+  for (int shift = 0; shift < 64 && pos < in.size(); shift += 7) {
+    uint8_t byte = in[pos++];
+    v |= static_cast<uint64_t>(byte & 0x7F) << shift;
+    if (byte < 0x80) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Writes the part of a length that does not fit into a nibble of the token
+void PutExtraLength(std::string& out, size_t len) {
+  if (len < kNibbleMax) {
+    return;
+  }
+  len -= kNibbleMax;
+  while (len >= 255) {
+    out.push_back(static_cast<char>(255));
+    len -= 255;
+  }
+  out.push_back(static_cast<char>(len));
+}
+
+bool GetExtraLength(std::string_view in, size_t& pos, size_t& len) {
+  if (len < kNibbleMax) {
+    return true;
+  }
+  while (pos < in.size()) {
+    uint8_t byte = in[pos++];
+    len += byte;
+    if (byte < 255) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// A match length of 0 means that the block only has literals
+void PutBlock(std::string& out, const char* literals, size_t num_literals, size_t offset, size_t match_len) {
+  auto match_nibble = match_len == 0 ? 0 : std::min(match_len - kMinMatch, kNibbleMax);
+  out.push_back(static_cast<char>(std::min(num_literals, kNibbleMax) << 4 | match_nibble));
+  PutExtraLength(out, num_literals);
+  out.append(literals, num_literals);
+  if (match_len > 0) {
+    out.push_back(static_cast<char>(offset & 0xFF));
+    out.push_back(static_cast<char>(offset >> 8));
+    PutExtraLength(out, match_len - kMinMatch);
+  }
+}
+
+}  // namespace
+
+void CompressValue(std::string_view value, std::string& compressed) {
+  compressed.clear();
+  compressed.reserve(value.size() + value.size() / 255 + 16);
+  PutVarint(compressed, value.size());
+
+  auto data = value.data();
+  auto size = value.size();
+  // Positions are offset by 1 so that 0 marks an empty slot
+  uint32_t table[1 << kHashBits] = {};
+  size_t anchor = 0;
+  size_t pos = 0;
+  size_t misses = 0;
+  while (pos + kMinMatch <= size) {
+    auto seq = Load32(data + pos);
+    auto& slot = table[Hash(seq)];
+    auto candidate = static_cast<size_t>(slot) - 1;
+    slot = pos + 1;
+    if (candidate >= pos || pos - candidate > kMaxOffset || Load32(data + candidate) != seq) {
+      pos += (misses++ >> kSkipShift) + 1;
+      continue;
+    }
+    misses = 0;
+    auto match_len = kMinMatch;
+    while (pos + match_len < size && data[candidate + match_len] == data[pos + match_len]) {
+      match_len++;
+    }
+    PutBlock(compressed, data + anchor, pos - anchor, pos - candidate, match_len);
+    pos += match_len;
+    anchor = pos;
+  }
+  PutBlock(compressed, data + anchor, size - anchor, 0, 0);
+}
+
+bool DecompressValue(std::string_view compressed, std::string& value) {
+  size_t pos = 0;
+  uint64_t size;
+  // Each input byte expands to at most 255 output bytes, which protects against huge sizes in corrupted input
+  if (!GetVarint(compressed, pos, size) || size / 255 > compressed.size()) {
+    return false;
+  }
+  value.resize(size);
+  auto out = value.data();
+  size_t out_pos = 0;
+  for (;;) {
+    if (pos >= compressed.size()) {
+      return false;
+    }
+    uint8_t token = compressed[pos++];
+
+    size_t num_literals = token >> 4;
+    if (!GetExtraLength(compressed, pos, num_literals) || num_literals > compressed.size() - pos ||
+        num_literals > size - out_pos) {
+      return false;
+    }
+    memcpy(out + out_pos, compressed.data() + pos, num_literals);
+    pos += num_literals;
+    out_pos += num_literals;
+    if (pos == compressed.size()) {
+      break;
+    }
+
+    if (compressed.size() - pos < 2) {
+      return false;
+    }
+    size_t offset = static_cast<uint8_t>(compressed[pos]) | static_cast<uint8_t>(compressed[pos + 1]) << 8;
+    pos += 2;
+    size_t match_len = token & kNibbleMax;
+    if (offset == 0 || offset > out_pos || !GetExtraLength(compressed, pos, match_len) ||
+        match_len + kMinMatch > size - out_pos) {
+      return false;
+    }
+    match_len += kMinMatch;
+    auto src = out + out_pos - offset;
+    if (offset >= match_len) {
+      memcpy(out + out_pos, src, match_len);
+    } else {
+      // The match overlaps with itself, repeating the last offset bytes
+      for (size_t i = 0; i < match_len; i++) {
+        out[out_pos + i] = src[i];
+      }
+    }
+    out_pos += match_len;
+  }
+  return out_pos == size;
+}
+
+bool MaybeCompressValue(const std::string& value, uint32_t min_size, std::string& compressed) {
+  if (min_size == 0 || value.size() < min_size) {
+    return false;
+  }
+  CompressValue(value, compressed);
+  return compressed.size() < value.size();
+}
+
+void DecompressInPlace(std::string& value, bool& compressed) {
+  if (!compressed) {
+    return;
+  }
+  std::string decompressed;
+  CHECK(DecompressValue(value, decompressed)) << "Compressed value is corrupted";
+  value = std::move(decompressed);
+  compressed = false;
+}
+
+void DecompressValueEntry(ValueEntry& entry) {
+  if (!entry.compressed()) {
+    return;
+  }
+  std::string value;
+  CHECK(DecompressValue(entry.value(), value)) << "Compressed value is corrupted";
+  entry.set_value(std::move(value));
+  entry.set_compressed(false);
+}
+
+void DecompressValues(Transaction& txn) {
+  for (auto& [_, entry] : *txn.mutable_keys()) {
+    DecompressValueEntry(entry);
+  }
+}
+
+}  // namespace slog
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+#include "common/types.h"
+#include "proto/transaction.pb.h"
+
+namespace slog {
+
+/**
+ * A small LZ77 codec in the spirit of LZ4, tuned for speed rather than ratio. The output
+ * is the varint-encoded size of the input followed by a sequence of blocks, each made of
+ * a run of literal bytes and a back-reference of at least 4 bytes into the last 64KB of
+ * the output. The last block only has literals.
+ */
+void CompressValue(std::string_view value, std::string& compressed);
+
+/**
+ * Returns false if the input is not produced by CompressValue
+ */
+bool DecompressValue(std::string_view compressed, std::string& value);
+
+/**
+ * Compresses a value that has at least min_size bytes. Returns false if the value is too
+ * small or does not get smaller, in which case it should be stored as is. Values are
+ * never compressed if min_size is 0
+ */
+bool MaybeCompressValue(const std::string& value, uint32_t min_size, std::string& compressed);
+
+/**
+ * Decompresses a value in place if it is compressed and clears the flag
+ */
+void DecompressInPlace(std::string& value, bool& compressed);
+
+/**
+ * Decompresses the value of a key of a txn in place if it is compressed
+ */
+void DecompressValueEntry(ValueEntry& entry);
+
+/**
+ * Decompresses the values of all keys of a txn so that it can be returned to the client
+ */
+void DecompressValues(Transaction& txn);
+
+}  // namespace slog
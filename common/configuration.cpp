@@ -10,6 +10,7 @@
 
 #include "common/constants.h"
 #include "common/proto_utils.h"
+#include "common/string_utils.h"
 
 namespace slog {
 
@@ -151,7 +152,7 @@ uint32_t Configuration::partition_of_key(const Key& key) const {
                    : key.begin() + config_.hash_partitioning().partition_key_num_bytes();
     return FNVHash(key.begin(), end) % num_partitions();
   } else {
-    return partition_of_key(std::stoll(key));
+    return partition_of_key(ParseNumericKey(key));
   }
 }
 
@@ -159,14 +160,42 @@ bool Configuration::key_is_in_local_partition(const Key& key) const {
   return partition_of_key(key) == local_partition_;
 }
 
-uint32_t Configuration::partition_of_key(uint32_t key) const { return key % num_partitions(); }
+uint32_t Configuration::partition_of_key(uint64_t key) const { return key % num_partitions(); }
 
-uint32_t Configuration::master_of_key(uint32_t key) const { return (key / num_partitions()) % num_replicas(); }
+uint32_t Configuration::master_of_key(uint64_t key) const { return (key / num_partitions()) % num_replicas(); }
 
 const internal::SimplePartitioning* Configuration::simple_partitioning() const {
   return config_.has_simple_partitioning() ? &config_.simple_partitioning() : nullptr;
 }
 
+const internal::LogStructuredStorage* Configuration::log_structured_storage() const {
+  return config_.has_log_structured_storage() ? &config_.log_structured_storage() : nullptr;
+}
+
+const internal::MultiVersionStorage* Configuration::multi_version_storage() const {
+  return config_.has_multi_version_storage() ? &config_.multi_version_storage() : nullptr;
+}
+
+const internal::WriteAheadLog* Configuration::write_ahead_log() const {
+  return config_.has_write_ahead_log() ? &config_.write_ahead_log() : nullptr;
+}
+
+const internal::ValueCompression* Configuration::value_compression() const {
+  return config_.has_value_compression() ? &config_.value_compression() : nullptr;
+}
+
+const internal::MessageCoalescing* Configuration::message_coalescing() const {
+  return config_.has_message_coalescing() ? &config_.message_coalescing() : nullptr;
+}
+
+const internal::SharedMemoryTransport* Configuration::shared_memory_transport() const {
+  return config_.has_shared_memory_transport() ? &config_.shared_memory_transport() : nullptr;
+}
+
+const internal::BrokerRouting* Configuration::broker_routing() const {
+  return config_.has_broker_routing() ? &config_.broker_routing() : nullptr;
+}
+
 uint32_t Configuration::replication_delay_pct() const { return config_.replication_delay().delay_pct(); }
 
 uint32_t Configuration::replication_delay_amount_ms() const { return config_.replication_delay().delay_amount_ms(); }
@@ -52,9 +52,16 @@ class Configuration {
   uint32_t partition_of_key(const Key& key) const;
   bool key_is_in_local_partition(const Key& key) const;
   // Only work with simple partitioning
-  uint32_t partition_of_key(uint32_t key) const;
-  uint32_t master_of_key(uint32_t key) const;
+  uint32_t partition_of_key(uint64_t key) const;
+  uint32_t master_of_key(uint64_t key) const;
   const internal::SimplePartitioning* simple_partitioning() const;
+  const internal::LogStructuredStorage* log_structured_storage() const;
+  const internal::MultiVersionStorage* multi_version_storage() const;
+  const internal::WriteAheadLog* write_ahead_log() const;
+  const internal::ValueCompression* value_compression() const;
+  const internal::MessageCoalescing* message_coalescing() const;
+  const internal::SharedMemoryTransport* shared_memory_transport() const;
+  const internal::BrokerRouting* broker_routing() const;
 
   uint32_t replication_delay_pct() const;
   uint32_t replication_delay_amount_ms() const;
@@ -16,7 +16,6 @@ const Channel kInterleaverChannel = 5;
 const Channel kSchedulerChannel = 6;
 const Channel kLocalPaxos = 7;
 const Channel kGlobalPaxos = 8;
-const Channel kWorkerChannel = 9;
 // Broker channels range from kBrokerChannel to kMaxChannel - 1
 const Channel kBrokerChannel = 10;
 const Channel kMaxChannel = 15;
@@ -29,10 +28,17 @@ const size_t kLockTableSizeLimit = 1000000;
 
 const int kRecvRetries = 1000;
 
+// Number of values that the queues between the scheduler and the workers hold before overflowing
+const size_t kWorkerQueueCapacity = 4096;
+
 /****************************
  *      Statistic Keys
  ****************************/
 
+/* Broker */
+const char BROKER_SATURATION[] = "broker_saturation";
+const char BROKER_NUM_MESSAGES[] = "broker_num_messages";
+
 /* Server */
 const char TXN_ID_COUNTER[] = "txn_id_counter";
 const char NUM_PENDING_RESPONSES[] = "num_pending_responses";
@@ -67,4 +73,12 @@ const char TXN_ABORTING[] = "aborting";
 const char TXN_NUM_LO[] = "num_lo";
 const char TXN_EXPECTED_NUM_LO[] = "expected_num_lo";
 
+/* Storage */
+const char STORAGE_NUM_KEYS[] = "storage_num_keys";
+const char STORAGE_VALUE_BYTES[] = "storage_value_bytes";
+const char STORAGE_INDEX_BYTES[] = "storage_index_bytes";
+const char STORAGE_NUM_BUCKETS[] = "storage_num_buckets";
+const char STORAGE_MAX_CHAIN_LENGTH[] = "storage_max_chain_length";
+const char STORAGE_SEGMENTS[] = "storage_segments";
+
 }  // namespace slog
\ No newline at end of file
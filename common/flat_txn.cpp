@@ -0,0 +1,116 @@
+#include "common/flat_txn.h"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <numeric>
+
+#include "common/string_utils.h"
+
+namespace slog {
+
+FlatTxn::FlatTxn(const Transaction& txn)
+    : id_(txn.internal().id()),
+      home_(txn.internal().home()),
+      is_remaster_(txn.procedure_case() == Transaction::kRemaster) {
+  keys_.reserve(txn.keys_size());
+  slots_.reserve(txn.keys_size());
+  for (const auto& [key, value] : txn.keys()) {
+    keys_.push_back(key);
+    auto& slot = slots_.emplace_back();
+    slot.type = value.type();
+    slot.metadata = value.metadata();
+    slot.compressed = value.compressed();
+    slot.value = value.value();
+    slot.new_value = value.new_value();
+  }
+  SortKeys();
+
+  for (const auto& key : txn.deleted_keys()) {
+    if (auto i = Find(key); i != kNotFound) {
+      deleted_.push_back(i);
+    }
+  }
+}
+
+size_t FlatTxn::Find(std::string_view key) const {
+  auto it = std::lower_bound(keys_.begin(), keys_.end(), key);
+  if (it == keys_.end() || *it != key) {
+    return kNotFound;
+  }
+  return it - keys_.begin();
+}
+
+void FlatTxn::AddRemoteReads(const google::protobuf::Map<std::string, ValueEntry>& reads) {
+  DCHECK(deleted_.empty()) << "Keys cannot be added after some are deleted";
+  auto num_local_keys = keys_.size();
+  for (const auto& [key, value] : reads) {
+    if (std::binary_search(keys_.begin(), keys_.begin() + num_local_keys, key)) {
+      continue;
+    }
+    keys_.push_back(key);
+    auto& slot = slots_.emplace_back();
+    slot.type = value.type();
+    slot.compressed = value.compressed();
+    slot.value = value.value();
+  }
+  if (keys_.size() > num_local_keys) {
+    SortKeys();
+  }
+}
+
+void FlatTxn::ParseNumericKeys() {
+  has_numeric_keys_ = true;
+  numeric_keys_.clear();
+  numeric_keys_.reserve(keys_.size());
+  for (const auto& key : keys_) {
+    numeric_keys_.push_back(ParseNumericKey(key));
+  }
+}
+
+void FlatTxn::MoveTo(Transaction& txn) {
+  auto& keys = *txn.mutable_keys();
+  for (size_t i = 0; i < keys_.size(); i++) {
+    auto& slot = slots_[i];
+    auto& entry = keys[keys_[i]];
+    entry.set_type(slot.type);
+    entry.set_compressed(slot.compressed);
+    entry.set_value(std::move(slot.value));
+    if (!slot.new_value.empty()) {
+      entry.set_new_value(std::move(slot.new_value));
+    }
+  }
+  txn.mutable_deleted_keys()->Clear();
+  for (auto i : deleted_) {
+    txn.add_deleted_keys(keys_[i]);
+  }
+}
+
+void FlatTxn::SortKeys() {
+  std::vector<size_t> order(keys_.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [this](size_t a, size_t b) { return keys_[a] < keys_[b]; });
+
+  std::vector<Key> keys;
+  std::vector<Slot> slots;
+  keys.reserve(keys_.size());
+  slots.reserve(slots_.size());
+  for (auto i : order) {
+    keys.push_back(std::move(keys_[i]));
+    slots.push_back(std::move(slots_[i]));
+  }
+  keys_.swap(keys);
+  slots_.swap(slots);
+
+  key_ptrs_.clear();
+  key_ptrs_.reserve(keys_.size());
+  for (const auto& key : keys_) {
+    key_ptrs_.push_back(&key);
+  }
+
+  if (has_numeric_keys_) {
+    ParseNumericKeys();
+  }
+}
+
+}  // namespace slog
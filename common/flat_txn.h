@@ -0,0 +1,122 @@
+#pragma once
+
+#include <google/protobuf/map.h>
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "common/types.h"
+#include "proto/transaction.pb.h"
+
+namespace slog {
+
+/**
+ * The read/write set of a txn laid out for the partition-local execution path. A Transaction keeps
+ * its keys in a protobuf map, which is a hash table of individually allocated nodes. Here, the keys
+ * are stored once, sorted, in a single array, and everything else about a key lives in a slot at
+ * the same index of a second array. Looking up a key is a binary search, iterating over the keys
+ * walks two arrays in order, and anything that refers to a key, such as a deleted key, only keeps
+ * its index. All slots are allocated when the txn is flattened so reads and writes fill them in
+ * place.
+ *
+ * A txn is flattened once when it enters the scheduler and its values are moved back into the
+ * Transaction when its result is sent to the server.
+ */
+class FlatTxn {
+ public:
+  static constexpr size_t kNotFound = static_cast<size_t>(-1);
+
+  struct Slot {
+    KeyType type = KeyType::READ;
+    Metadata metadata;
+    bool compressed = false;
+    std::string value;
+    std::string new_value;
+  };
+
+  FlatTxn() = default;
+  explicit FlatTxn(const Transaction& txn);
+  // Moving keeps the key array in place so the key pointers stay valid, which copying would not
+  FlatTxn(FlatTxn&&) = default;
+  FlatTxn& operator=(FlatTxn&&) = default;
+  FlatTxn(const FlatTxn&) = delete;
+  FlatTxn& operator=(const FlatTxn&) = delete;
+
+  TxnId id() const { return id_; }
+  int home() const { return home_; }
+  bool is_remaster() const { return is_remaster_; }
+
+  size_t num_keys() const { return keys_.size(); }
+  const Key& key(size_t i) const { return keys_[i]; }
+
+  /**
+   * Parses all keys as numbers, which all keys are with simple partitioning, so that the lock
+   * managers can lock them as integers. Keys added later by AddRemoteReads are parsed too
+   */
+  void ParseNumericKeys();
+  bool has_numeric_keys() const { return has_numeric_keys_; }
+  uint64_t numeric_key(size_t i) const { return numeric_keys_[i]; }
+
+  /**
+   * The key at index i as the key type K of a lock manager: either Key or uint64_t. The latter
+   * requires ParseNumericKeys to have been called
+   */
+  template <typename K>
+  K key_as(size_t i) const;
+
+  const Slot& slot(size_t i) const { return slots_[i]; }
+  Slot& slot(size_t i) { return slots_[i]; }
+
+  /**
+   * Pointers to the keys in sorted order, in the form that Storage takes them
+   */
+  const std::vector<const Key*>& key_ptrs() const { return key_ptrs_; }
+
+  /**
+   * Returns the index of a key or kNotFound
+   */
+  size_t Find(std::string_view key) const;
+
+  /**
+   * Adds the reads sent by other partitions. Keys that the txn already has are not overwritten.
+   * This must happen before any key is deleted
+   */
+  void AddRemoteReads(const google::protobuf::Map<std::string, ValueEntry>& reads);
+
+  void Delete(size_t i) { deleted_.push_back(i); }
+  const std::vector<size_t>& deleted() const { return deleted_; }
+
+  /**
+   * Writes the values back into the txn that this was flattened from, moving them out of the
+   * slots. Keys added by AddRemoteReads are added to the txn
+   */
+  void MoveTo(Transaction& txn);
+
+ private:
+  void SortKeys();
+
+  TxnId id_ = 0;
+  int home_ = -1;
+  bool is_remaster_ = false;
+  std::vector<Key> keys_;
+  std::vector<Slot> slots_;
+  std::vector<const Key*> key_ptrs_;
+  bool has_numeric_keys_ = false;
+  // Same order as keys_. Empty unless has_numeric_keys_ is set
+  std::vector<uint64_t> numeric_keys_;
+  // Indices of the keys in the order they are deleted
+  std::vector<size_t> deleted_;
+};
+
+template <>
+inline Key FlatTxn::key_as<Key>(size_t i) const {
+  return keys_[i];
+}
+
+template <>
+inline uint64_t FlatTxn::key_as<uint64_t>(size_t i) const {
+  return numeric_keys_[i];
+}
+
+}  // namespace slog
@@ -289,13 +289,25 @@ bool operator==(const ValueEntry& val1, const ValueEntry& val2) {
          val1.metadata() == val2.metadata();
 }
 
+google::protobuf::Arena* NewArena(size_t serialized_size) {
+  // Parsed messages take a few times more memory than their serialized form
+  constexpr size_t kParsedBytesPerSerializedByte = 4;
+  constexpr size_t kMinBlockSize = 256;
+  google::protobuf::ArenaOptions options;
+  options.start_block_size = std::max(kMinBlockSize, serialized_size * kParsedBytesPerSerializedByte);
+  options.max_block_size = std::max(options.max_block_size, options.start_block_size);
+  return new google::protobuf::Arena(options);
+}
+
 vector<Transaction*> Unbatch(internal::Batch* batch) {
   auto transactions = batch->mutable_transactions();
+  // Releasing a message from an arena would otherwise copy it to the heap
+  bool in_arena = batch->GetArena() != nullptr;
 
   vector<Transaction*> buffer(transactions->size());
 
   for (int i = transactions->size() - 1; i >= 0; i--) {
-    auto txn = transactions->ReleaseLast();
+    auto txn = in_arena ? transactions->UnsafeArenaReleaseLast() : transactions->ReleaseLast();
     auto txn_internal = txn->mutable_internal();
 
     // Transfer recorded events from batch to each txn in the batch
@@ -309,4 +321,14 @@ vector<Transaction*> Unbatch(internal::Batch* batch) {
   return buffer;
 }
 
+BatchPtr ReleaseBatchData(EnvelopePtr&& env) {
+  auto forward_batch = env->mutable_request()->mutable_forward_batch();
+  if (env->GetArena() == nullptr) {
+    return BatchPtr(forward_batch->release_batch_data());
+  }
+  BatchPtr batch(forward_batch->unsafe_arena_release_batch_data());
+  env.release();
+  return batch;
+}
+
 }  // namespace slog
\ No newline at end of file
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <google/protobuf/arena.h>
+
+#include <memory>
 #include <optional>
 #include <unordered_map>
 #include <variant>
@@ -18,6 +21,48 @@ using std::unordered_map;
 
 namespace slog {
 
+/**
+ * A message allocated in an arena as the root of a tree of messages owns that arena, so deleting
+ * it frees the arena and every message in it in one step. Other messages are simply deleted.
+ * Pointers with the default deleter convert to pointers with this one.
+ */
+template <typename T>
+struct ArenaOwnerDeleter {
+  ArenaOwnerDeleter() = default;
+  ArenaOwnerDeleter(std::default_delete<T>) {}
+
+  void operator()(T* msg) const {
+    if (auto arena = msg->GetArena(); arena != nullptr) {
+      delete arena;
+    } else {
+      delete msg;
+    }
+  }
+};
+
+/**
+ * For messages that share an arena with others. A message in an arena is left to be
+ * freed with the arena, which must be kept alive through an ArenaPtr
+ */
+template <typename T>
+struct ArenaSharerDeleter {
+  void operator()(T* msg) const {
+    if (msg->GetArena() == nullptr) {
+      delete msg;
+    }
+  }
+};
+
+using EnvelopePtr = std::unique_ptr<internal::Envelope, ArenaOwnerDeleter<internal::Envelope>>;
+using BatchPtr = std::unique_ptr<internal::Batch, ArenaOwnerDeleter<internal::Batch>>;
+using ArenaPtr = std::shared_ptr<google::protobuf::Arena>;
+
+/**
+ * Creates an arena whose first block is large enough to parse a message of the given serialized
+ * size without allocating another block in most cases
+ */
+google::protobuf::Arena* NewArena(size_t serialized_size);
+
 struct KeyEntry {
   KeyEntry(const Key& key, KeyType type = KeyType::READ, std::optional<Metadata> metadata = {})
       : key(key), type(type), metadata(metadata) {}
@@ -101,8 +146,15 @@ bool operator==(google::protobuf::Map<K, V> map1, google::protobuf::Map<K, V> ma
 }
 
 /**
- * Extract txns from a batch
+ * Extract txns from a batch. If the batch is in an arena, so are the txns, and they must not
+ * be freed individually
  */
 vector<Transaction*> Unbatch(internal::Batch* batch);
 
+/**
+ * Moves the batch out of a forward batch request. If the envelope is allocated in an arena, the
+ * batch takes over that arena and the envelope is freed together with it
+ */
+BatchPtr ReleaseBatchData(EnvelopePtr&& env);
+
 }  // namespace slog
\ No newline at end of file
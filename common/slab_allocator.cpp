@@ -0,0 +1,151 @@
+#include "common/slab_allocator.h"
+
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace slog {
+
+namespace {
+
+constexpr size_t kNumSizeClasses = 8;
+// Number of blocks in a slab and in a batch moved between a thread and the global pool
+constexpr size_t kBatchSize = 64;
+
+static_assert(SlabAllocator::kMinBlockSize << (kNumSizeClasses - 1) == SlabAllocator::kMaxBlockSize);
+
+struct FreeBlock {
+  FreeBlock* next;
+};
+
+struct FreeList {
+  FreeBlock* head = nullptr;
+  size_t count = 0;
+
+  void Push(FreeBlock* block) {
+    block->next = head;
+    head = block;
+    count++;
+  }
+
+  FreeBlock* Pop() {
+    auto block = head;
+    head = block->next;
+    count--;
+    return block;
+  }
+
+  // Detaches the first n blocks into a new list
+  FreeList Split(size_t n) {
+    FreeList first{head, n};
+    auto last = head;
+    for (size_t i = 1; i < n; i++) {
+      last = last->next;
+    }
+    head = last->next;
+    count -= n;
+    last->next = nullptr;
+    return first;
+  }
+};
+
+class GlobalPool {
+ public:
+  static GlobalPool& Instance() {
+    // Never destroyed so that blocks can still be freed during static destruction
+    static auto instance = new GlobalPool();
+    return *instance;
+  }
+
+  bool Take(size_t size_class, FreeList& list) {
+    std::lock_guard<std::mutex> guard(mut_);
+    auto& batches = batches_[size_class];
+    if (batches.empty()) {
+      return false;
+    }
+    list = batches.back();
+    batches.pop_back();
+    return true;
+  }
+
+  void Give(size_t size_class, FreeList list) {
+    std::lock_guard<std::mutex> guard(mut_);
+    batches_[size_class].push_back(list);
+  }
+
+ private:
+  std::mutex mut_;
+  std::vector<FreeList> batches_[kNumSizeClasses];
+};
+
+// Set once the cache of the current thread is destroyed. Being trivially
+// destructible, it can still be read after the cache is gone.
+thread_local bool thread_cache_destroyed = false;
+
+struct ThreadCache {
+  ~ThreadCache() {
+    for (size_t i = 0; i < kNumSizeClasses; i++) {
+      if (free_lists[i].count > 0) {
+        GlobalPool::Instance().Give(i, free_lists[i]);
+      }
+    }
+    thread_cache_destroyed = true;
+  }
+
+  FreeList free_lists[kNumSizeClasses];
+};
+
+thread_local ThreadCache thread_cache;
+
+size_t SizeClass(size_t block_size) {
+  size_t size_class = 0;
+  while ((SlabAllocator::kMinBlockSize << size_class) < block_size) {
+    size_class++;
+  }
+  return size_class;
+}
+
+FreeList NewSlab(size_t block_size) {
+  auto slab = new char[block_size * kBatchSize];
+  FreeList list;
+  for (size_t i = kBatchSize; i > 0; i--) {
+    list.Push(reinterpret_cast<FreeBlock*>(slab + (i - 1) * block_size));
+  }
+  return list;
+}
+
+}  // namespace
+
+char* SlabAllocator::Allocate(size_t block_size) {
+  if (block_size > kMaxBlockSize || thread_cache_destroyed) {
+    return new char[block_size];
+  }
+  auto size_class = SizeClass(block_size);
+  auto& free_list = thread_cache.free_lists[size_class];
+  if (free_list.count == 0 && !GlobalPool::Instance().Take(size_class, free_list)) {
+    free_list = NewSlab(block_size);
+  }
+  return reinterpret_cast<char*>(free_list.Pop());
+}
+
+void SlabAllocator::Free(char* block, size_t block_size) {
+  if (block_size > kMaxBlockSize) {
+    delete[] block;
+    return;
+  }
+  auto size_class = SizeClass(block_size);
+  auto free_block = reinterpret_cast<FreeBlock*>(block);
+  if (thread_cache_destroyed) {
+    FreeList list;
+    list.Push(free_block);
+    GlobalPool::Instance().Give(size_class, list);
+    return;
+  }
+  auto& free_list = thread_cache.free_lists[size_class];
+  free_list.Push(free_block);
+  if (free_list.count >= 2 * kBatchSize) {
+    GlobalPool::Instance().Give(size_class, free_list.Split(kBatchSize));
+  }
+}
+
+}  // namespace slog
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace slog {
+
+/**
+ * Allocates memory blocks in a few size classes (powers of 2 from kMinBlockSize
+ * to kMaxBlockSize). Blocks are carved out of large slabs and freed blocks are kept
+ * in per-thread free lists for reuse, so that allocating and freeing a block is
+ * usually just a pointer swap. When a thread accumulates too many free blocks of a
+ * size class, a batch of them is moved to a global pool where other threads can
+ * pick them up. Slabs are never returned to the system.
+ *
+ * Larger blocks are allocated with operator new.
+ */
+class SlabAllocator {
+ public:
+  static constexpr size_t kMinBlockSize = 32;
+  static constexpr size_t kMaxBlockSize = 4096;
+
+  /**
+   * @return the size of the block that would be allocated for the given size
+   */
+  static size_t BlockSize(size_t size) {
+    if (size > kMaxBlockSize) {
+      return size;
+    }
+    size_t block_size = kMinBlockSize;
+    while (block_size < size) {
+      block_size <<= 1;
+    }
+    return block_size;
+  }
+
+  /**
+   * Allocates a block whose size must be a value returned by BlockSize
+   */
+  static char* Allocate(size_t block_size);
+
+  /**
+   * Frees a block allocated with the same block size
+   */
+  static void Free(char* block, size_t block_size);
+};
+
+}  // namespace slog
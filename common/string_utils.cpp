@@ -1,6 +1,8 @@
 #include "common/string_utils.h"
 
 #include <algorithm>
+#include <charconv>
+#include <stdexcept>
 
 namespace slog {
 
@@ -53,4 +55,15 @@ string Trim(string str) {
   return str;
 }
 
+uint64_t ParseNumericKey(const string& key) {
+  uint64_t res;
+  auto end = key.data() + key.size();
+  auto [ptr, ec] = std::from_chars(key.data(), end, res);
+  // Leading zeros are rejected so that each number has exactly one key
+  if (ec != std::errc() || ptr != end || key.empty() || (key.size() > 1 && key[0] == '0')) {
+    throw std::invalid_argument("Not a numeric key: \"" + key + "\"");
+  }
+  return res;
+}
+
 }  // namespace slog
\ No newline at end of file
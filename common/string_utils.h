@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -12,4 +13,10 @@ size_t NextNTokens(std::vector<std::string>& tokens, const std::string& str, con
 
 std::string Trim(std::string str);
 
+/**
+ * Parses a key made of decimal digits only and without leading zeros, as used with
+ * simple partitioning. Throws std::invalid_argument otherwise.
+ */
+uint64_t ParseNumericKey(const std::string& key);
+
 }  // namespace slog
\ No newline at end of file
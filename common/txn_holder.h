@@ -6,52 +6,90 @@
 #include <vector>
 
 #include "common/configuration.h"
+#include "common/flat_txn.h"
 #include "common/proto_utils.h"
 #include "common/types.h"
 #include "proto/transaction.pb.h"
 
 namespace slog {
 
-using EnvelopePtr = std::unique_ptr<internal::Envelope>;
-
+/**
+ * Holds a txn and its lock-only txns. A txn that is allocated in the arena of its batch comes with
+ * a pointer to that arena, which is kept alive for as long as the txn is held.
+ *
+ * Each txn is flattened when it is added. The lock managers and the worker work on the flat txns,
+ * which are moved back into the Transaction only when the result is sent out. With simple
+ * partitioning, the keys are parsed as numbers once here.
+ */
 class TxnHolder {
  public:
-  TxnHolder(const ConfigurationPtr& config, Transaction* txn)
+  TxnHolder(const ConfigurationPtr& config, Transaction* txn, ArenaPtr arena = nullptr)
       : txn_id_(txn->internal().id()),
         main_txn_(txn->internal().home()),
+        numeric_keys_(config->simple_partitioning() != nullptr),
+        arenas_(config->num_replicas()),
         lo_txns_(config->num_replicas()),
+        flat_lo_txns_(config->num_replicas()),
         remaster_result_(std::nullopt),
+        log_position_(0),
+        wal_lsn_(0),
         aborting_(false),
         done_(false),
         num_lo_txns_(0),
         expected_num_lo_txns_(txn->internal().involved_replicas_size()) {
+    arenas_[main_txn_] = std::move(arena);
     lo_txns_[main_txn_].reset(txn);
+    flat_lo_txns_[main_txn_] = FlatTxn(*txn);
+    if (numeric_keys_) {
+      flat_lo_txns_[main_txn_].ParseNumericKeys();
+    }
     ++num_lo_txns_;
   }
 
-  bool AddLockOnlyTxn(Transaction* txn) {
+  bool AddLockOnlyTxn(Transaction* txn, ArenaPtr arena = nullptr) {
     auto home = txn->internal().home();
     if (home >= static_cast<int>(lo_txns_.size()) || lo_txns_[home] != nullptr) {
       return false;
     }
+    arenas_[home] = std::move(arena);
     lo_txns_[home].reset(txn);
+    flat_lo_txns_[home] = FlatTxn(*txn);
+    if (numeric_keys_) {
+      flat_lo_txns_[home].ParseNumericKeys();
+    }
     ++num_lo_txns_;
     return true;
   }
 
-  Transaction* Release() {
+  /**
+   * Gives up the main txn together with its arena, if any. The txn is only valid for as long as
+   * the returned arena is alive
+   */
+  std::pair<Transaction*, ArenaPtr> Release() {
     auto txn = lo_txns_[main_txn_].release();
+    auto arena = std::move(arenas_[main_txn_]);
     lo_txns_.clear();
-    return txn;
+    flat_lo_txns_.clear();
+    arenas_.clear();
+    return {txn, std::move(arena)};
   }
 
   TxnId txn_id() const { return txn_id_; }
   Transaction& txn() const { return *lo_txns_[main_txn_]; }
   Transaction& lock_only_txn(size_t i) const { return *lo_txns_[i]; }
+  FlatTxn& flat_txn() { return flat_lo_txns_[main_txn_]; }
+  const FlatTxn& flat_lock_only_txn(size_t i) const { return flat_lo_txns_[i]; }
 
   void SetRemasterResult(const Key& key, uint32_t counter) { remaster_result_.emplace(key, counter); }
   std::optional<pair<Key, uint32_t>> remaster_result() const { return remaster_result_; }
 
+  void SetLogPosition(LogPosition position) { log_position_ = position; }
+  LogPosition log_position() const { return log_position_; }
+
+  // The writes of the txn survive a crash once the write-ahead log is durable up to this LSN
+  void SetWalLsn(uint64_t lsn) { wal_lsn_ = lsn; }
+  uint64_t wal_lsn() const { return wal_lsn_; }
+
   void SetDone() { done_ = true; }
   bool is_done() const { return done_; }
 
@@ -65,8 +103,15 @@ class TxnHolder {
  private:
   TxnId txn_id_;
   size_t main_txn_;
-  std::vector<std::unique_ptr<Transaction>> lo_txns_;
+  // With simple partitioning, the keys of the flat txns are also parsed as numbers for the lock manager
+  bool numeric_keys_;
+  // Declared before the txns so that they are destroyed after them
+  std::vector<ArenaPtr> arenas_;
+  std::vector<std::unique_ptr<Transaction, ArenaSharerDeleter<Transaction>>> lo_txns_;
+  std::vector<FlatTxn> flat_lo_txns_;
   std::optional<pair<Key, uint32_t>> remaster_result_;
+  LogPosition log_position_;
+  uint64_t wal_lsn_;
   bool aborting_;
   bool done_;
   int num_lo_txns_;
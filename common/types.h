@@ -1,8 +1,13 @@
 #pragma once
 
 #include <chrono>
+#include <cstring>
+#include <ostream>
 #include <string>
+#include <string_view>
+#include <type_traits>
 
+#include "common/slab_allocator.h"
 #include "proto/transaction.pb.h"
 
 using namespace std::chrono;
@@ -13,6 +18,9 @@ using Key = std::string;
 using KeyReplica = std::string;
 using Value = std::string;
 using TxnId = uint64_t;
+// Position of a transaction in the order in which a partition applies the writes of its log. Position 0
+// comes before all transactions
+using LogPosition = uint64_t;
 using BatchId = uint32_t;
 using SlotId = uint32_t;
 using Channel = uint64_t;
@@ -32,46 +40,106 @@ struct Metadata {
   uint32_t counter = 0;
 };
 
+/**
+ * Values of at most kInlineSize bytes are stored inside the record itself. Larger values are
+ * stored in blocks of SlabAllocator. Setting a value that fits into the current buffer reuses it.
+ *
+ * A value can be stored compressed with CompressValue, which is marked by a flag kept in the
+ * highest bit of the size so that the record does not grow.
+ */
 struct Record {
+  static constexpr size_t kInlineSize = 24;
+
   Record(const std::string& v, uint32_t m, uint32_t c = 0) : metadata(m, c) { SetValue(v); }
 
-  Record(const Record& other) {
-    SetValue(other.data_.get(), other.size_);
-    metadata = other.metadata;
-  }
+  Record(const Record& other) : metadata(other.metadata) { SetValue(other.data(), other.size(), other.compressed()); }
+
+  Record(Record&& other) noexcept : metadata(other.metadata) { MoveFrom(other); }
 
   Record& operator=(const Record& other) {
-    Record tmp(other);
-    data_.swap(tmp.data_);
-    std::swap(size_, tmp.size_);
-    std::swap(metadata, tmp.metadata);
+    if (this != &other) {
+      SetValue(other.data(), other.size(), other.compressed());
+      metadata = other.metadata;
+    }
     return *this;
   }
 
-  void SetValue(const std::string& v) { SetValue(v.data(), v.size()); }
-
-  void SetValue(const char* data, size_t size) {
-    size_ = size;
-    data_.reset(new char[size_]);
-    memcpy(data_.get(), data, size_);
+  Record& operator=(Record&& other) noexcept {
+    if (this != &other) {
+      FreeBuffer();
+      MoveFrom(other);
+      metadata = other.metadata;
+    }
+    return *this;
   }
 
-  std::string to_string() const {
-    if (data_ == nullptr) {
-      return "";
+  ~Record() { FreeBuffer(); }
+
+  void SetValue(const std::string& v, bool compressed = false) { SetValue(v.data(), v.size(), compressed); }
+  // Would otherwise take the flag as the size when called with a string literal
+  void SetValue(const char* data, bool compressed) = delete;
+
+  void SetValue(const char* data, size_t size, bool compressed = false) {
+    if (size > capacity_) {
+      FreeBuffer();
+      capacity_ = SlabAllocator::BlockSize(size);
+      heap_ = SlabAllocator::Allocate(capacity_);
     }
-    return std::string(data_.get(), size_);
+    size_ = size | (compressed ? kCompressedFlag : 0);
+    memcpy(this->data(), data, size);
   }
 
+  // Returns the value as stored, which has to be decompressed if compressed() is true
+  std::string to_string() const { return std::string(data(), size()); }
+  std::string_view view() const { return std::string_view(data(), size()); }
+
+  size_t size() const { return size_ & ~kCompressedFlag; }
+
+  bool compressed() const { return size_ & kCompressedFlag; }
+
   Record() = default;
 
   Metadata metadata;
 
  private:
-  std::unique_ptr<char[]> data_;
-  size_t size_ = 0;
+  static constexpr uint32_t kCompressedFlag = 1U << 31;
+
+  bool is_inline() const { return capacity_ == kInlineSize; }
+
+  char* data() { return is_inline() ? inline_ : heap_; }
+  const char* data() const { return is_inline() ? inline_ : heap_; }
+
+  void FreeBuffer() {
+    if (!is_inline()) {
+      SlabAllocator::Free(heap_, capacity_);
+      capacity_ = kInlineSize;
+    }
+  }
+
+  // The buffer must have been freed
+  void MoveFrom(Record& other) {
+    size_ = other.size_;
+    capacity_ = other.capacity_;
+    if (other.is_inline()) {
+      memcpy(inline_, other.inline_, other.size());
+    } else {
+      heap_ = other.heap_;
+      other.capacity_ = kInlineSize;
+    }
+    other.size_ = 0;
+  }
+
+  union {
+    char inline_[kInlineSize];
+    char* heap_;
+  };
+  uint32_t size_ = 0;
+  uint32_t capacity_ = kInlineSize;
 };
 
+// Bytes of a record counted in the stats of a storage
+inline size_t ValueBytes(const Record& record) { return record.size(); }
+
 enum class LockMode { UNLOCKED, READ, WRITE };
 enum class AcquireLocksResult { ACQUIRED, WAITING, ABORT };
 
@@ -85,4 +153,40 @@ inline KeyReplica MakeKeyReplica(Key key, uint32_t master) {
   return new_key;
 }
 
+/**
+ * With simple partitioning, keys are decimal integers and the lock managers lock them as such. A
+ * numeric key and its replica are packed into one struct instead of being concatenated into a string
+ */
+struct NumericKeyReplica {
+  uint64_t key;
+  uint32_t master;
+
+  bool operator==(const NumericKeyReplica& other) const { return key == other.key && master == other.master; }
+};
+
+inline NumericKeyReplica MakeKeyReplica(uint64_t key, uint32_t master) { return {key, master}; }
+
+struct NumericKeyReplicaHash {
+  size_t operator()(const NumericKeyReplica& key_replica) const {
+    return std::hash<uint64_t>{}(key_replica.key * 31 + key_replica.master);
+  }
+};
+
+inline std::ostream& operator<<(std::ostream& os, const NumericKeyReplica& key_replica) {
+  return os << key_replica.key << ":" << key_replica.master;
+}
+
+// Type of the keys that a lock manager templated on the key type K locks, with and without replicas
+template <typename K>
+using KeyReplicaOf = std::conditional_t<std::is_same_v<K, uint64_t>, NumericKeyReplica, KeyReplica>;
+template <typename K>
+using KeyReplicaHashOf = std::conditional_t<std::is_same_v<K, uint64_t>, NumericKeyReplicaHash, std::hash<KeyReplica>>;
+
+// Text form of a locked key in the stats of a lock manager
+inline std::string LockKeyToString(const std::string& key) { return key; }
+inline std::string LockKeyToString(uint64_t key) { return std::to_string(key); }
+inline std::string LockKeyToString(const NumericKeyReplica& key_replica) {
+  return std::to_string(key_replica.key) + ":" + std::to_string(key_replica.master);
+}
+
 }  // namespace slog
\ No newline at end of file
@@ -2,9 +2,12 @@
 
 #include <glog/logging.h>
 
+#include <limits>
+
 #include "common/constants.h"
 #include "common/proto_utils.h"
 #include "common/thread_utils.h"
+#include "connection/shm_ring.h"
 #include "connection/zmq_utils.h"
 #include "proto/internal.pb.h"
 
@@ -20,18 +23,32 @@ namespace slog {
 using internal::Envelope;
 
 namespace {
+
+// Maximum number of messages read from a ring in one loop, so that a busy ring does not starve the others
+const size_t kMaxMessagesPerRing = 100;
+// How often the broker looks for rings whose sender has exited without detaching them
+const std::chrono::seconds kRingLivenessCheckInterval(1);
+
+bool IsLoopbackAddress(const char* address) {
+  string addr(address);
+  return addr.rfind("127.", 0) == 0 || addr == "::1" || addr.rfind("::ffff:127.", 0) == 0;
+}
+
 class BrokerThread : public Module {
  public:
-  BrokerThread(const shared_ptr<zmq::context_t>& context, const string& internal_endpoint,
-               const string& external_endpoint, const vector<pair<Channel, bool>>& channels,
-               std::chrono::milliseconds poll_timeout_ms)
+  BrokerThread(const ConfigurationPtr& config, const shared_ptr<zmq::context_t>& context,
+               const string& internal_endpoint, const string& external_endpoint,
+               const vector<pair<Channel, bool>>& channels, std::chrono::milliseconds poll_timeout_ms,
+               Broker::ThreadStats& stats)
       : Module("Broker"),
+        config_(config),
         external_socket_(*context, ZMQ_PULL),
         internal_socket_(*context, ZMQ_PULL),
         internal_endpoint_(internal_endpoint),
         external_endpoint_(external_endpoint),
         poll_timeout_ms_(poll_timeout_ms),
-        recv_retries_(0) {
+        recv_retries_(0),
+        stats_(stats) {
     // Remove all limits on the message queue
     external_socket_.set(zmq::sockopt::rcvhwm, 0);
 
@@ -55,13 +72,61 @@ class BrokerThread : public Module {
   }
 
   bool Loop() final {
-    if (recv_retries_ <= 0 && !zmq::poll(poll_items_, poll_timeout_ms_)) {
-      return false;
+    // Senders on the same host only wake up the broker through the socket if it is marked as
+    // sleeping in their rings
+    if (recv_retries_ <= 0 && SleepOnRings()) {
+      auto has_event = zmq::poll(poll_items_, poll_timeout_ms_);
+      for (auto& ring : rings_) {
+        ring->Wake();
+      }
+      if (!has_event) {
+        return false;
+      }
     }
 
+    auto start = std::chrono::steady_clock::now();
+    auto num_messages = num_messages_;
+
     if (zmq::message_t msg; external_socket_.recv(msg, zmq::recv_flags::dontwait)) {
       recv_retries_ = kRecvRetries;
-      HandleIncomingMessage(move(msg));
+      if (auto type = wire::ReadType(msg.data<char>(), msg.size());
+          type == wire::Type::RING_ATTACH || type == wire::Type::RING_DETACH) {
+        HandleRingMessage(msg, type.value());
+      } else {
+        HandleIncomingMessage(msg.data<char>(), msg.size());
+      }
+    }
+
+    for (size_t i = 0; i < rings_.size();) {
+      auto handle = [this](const char* data, size_t size) { HandleIncomingMessage(data, size); };
+      if (rings_[i]->Read(handle, kMaxMessagesPerRing) > 0) {
+        recv_retries_ = kRecvRetries;
+      }
+      if (rings_[i]->corrupted()) {
+        LOG(ERROR) << "Dropping corrupted ring " << rings_[i]->name();
+        rings_.erase(rings_.begin() + i);
+      } else {
+        i++;
+      }
+    }
+
+    if (!rings_.empty() && start >= next_liveness_check_) {
+      next_liveness_check_ = start + kRingLivenessCheckInterval;
+      for (size_t i = 0; i < rings_.size();) {
+        if (rings_[i]->ProducerExited()) {
+          LOG(WARNING) << "The sender of ring " << rings_[i]->name() << " has exited";
+          DetachRing(i);
+        } else {
+          i++;
+        }
+      }
+    }
+
+    // Only time spent on messages counts as work, not time spent on checking for messages
+    if (num_messages_ != num_messages) {
+      auto work = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+      stats_.work_ns.store(stats_.work_ns.load(std::memory_order_relaxed) + work.count(), std::memory_order_relaxed);
+      stats_.num_messages.store(num_messages_, std::memory_order_relaxed);
     }
 
     if (auto env = RecvEnvelope(internal_socket_, true /* dont_wait */); env != nullptr) {
@@ -84,7 +149,7 @@ class BrokerThread : public Module {
       auto& entry = redirect_[tag];
       entry.to = channel;
       for (auto& msg : entry.pending_msgs) {
-        ForwardMessage(chan_it->second.socket, chan_it->second.send_raw, move(msg));
+        ForwardMessage(chan_it->second.socket, chan_it->second.send_raw, msg.data(), msg.size());
       }
       entry.pending_msgs.clear();
     }
@@ -97,12 +162,99 @@ class BrokerThread : public Module {
   }
 
  private:
-  void HandleIncomingMessage(zmq::message_t&& msg) {
-    Channel tag_or_chan_id;
-    if (!ParseChannel(tag_or_chan_id, msg)) {
+  /**
+   * Returns true if all rings are empty and marked as sleeping
+   */
+  bool SleepOnRings() {
+    for (size_t i = 0; i < rings_.size(); i++) {
+      if (!rings_[i]->Sleep()) {
+        for (size_t j = 0; j < i; j++) {
+          rings_[j]->Wake();
+        }
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /**
+   * Rings are only attached or detached if the shared memory transport is enabled and the message
+   * comes straight from the socket, from a sender on the same host
+   */
+  void HandleRingMessage(zmq::message_t& msg, wire::Type type) {
+    if (config_->shared_memory_transport() == nullptr) {
+      LOG(ERROR) << "Shared memory transport is disabled. Dropping ring message";
+      return;
+    }
+    if (config_->protocol() != "ipc") {
+      auto peer_address = zmq_msg_gets(msg.handle(), "Peer-Address");
+      if (peer_address == nullptr || !IsLoopbackAddress(peer_address)) {
+        LOG(ERROR) << "Ring message from another host: " << (peer_address == nullptr ? "unknown" : peer_address)
+                   << ". Dropping message";
+        return;
+      }
+    }
+    auto data = msg.data<char>();
+    auto size = msg.size();
+    if (wire::Read<uint32_t>(data, wire::kPayloadSizeOffset) != size - wire::kHeaderSize) {
+      LOG(ERROR) << "Malformed ring message";
+      return;
+    }
+    string name(data + wire::kHeaderSize, size - wire::kHeaderSize);
+    if (type == wire::Type::RING_ATTACH) {
+      if (auto ring = ShmRing::Open(name); ring != nullptr) {
+        rings_.push_back(move(ring));
+      }
+      return;
+    }
+    for (size_t i = 0; i < rings_.size(); i++) {
+      if (rings_[i]->name() == name) {
+        DetachRing(i);
+        return;
+      }
+    }
+    LOG(ERROR) << "Cannot detach unknown ring " << name;
+  }
+
+  /**
+   * Handles the messages left in a ring then drops it. The sender writes nothing to the ring after
+   * detaching it so these are the last messages of the ring
+   */
+  void DetachRing(size_t i) {
+    auto handle = [this](const char* data, size_t size) { HandleIncomingMessage(data, size); };
+    rings_[i]->Read(handle, std::numeric_limits<size_t>::max());
+    rings_.erase(rings_.begin() + i);
+  }
+
+  void HandleIncomingMessage(const char* data, size_t size) {
+    if (size < wire::kVersionOffset) {
       LOG(ERROR) << "Message without channel info";
       return;
     }
+    if (!wire::ReadVersion(data, size).has_value()) {
+      LOG(ERROR) << "Unknown wire format version. Dropping message";
+      return;
+    }
+    switch (wire::ReadType(data, size).value_or(wire::Type::ENVELOPE)) {
+      case wire::Type::COALESCED: {
+        auto unpack = [this](const char* msg_data, size_t msg_size) { HandleIncomingMessage(msg_data, msg_size); };
+        if (!wire::ForEachCoalesced(data, size, unpack)) {
+          LOG(ERROR) << "Malformed coalesced message";
+        }
+        return;
+      }
+      case wire::Type::RING_ATTACH:
+      case wire::Type::RING_DETACH:
+        LOG(ERROR) << "Ring message inside another message. Dropping message";
+        return;
+      case wire::Type::RING_WAKEUP:
+        // Receiving it is enough to wake up the broker
+        return;
+      default:
+        break;
+    }
+    num_messages_++;
+    auto tag_or_chan_id = wire::Read<Channel>(data, wire::kChannelOffset);
 
     auto chan_id = tag_or_chan_id;
 
@@ -112,7 +264,7 @@ class BrokerThread : public Module {
     if (tag_or_chan_id >= kMaxChannel) {
       auto& entry = redirect_[tag_or_chan_id];
       if (!entry.to.has_value()) {
-        entry.pending_msgs.push_back(move(msg));
+        entry.pending_msgs.emplace_back(data, size);
         return;
       }
       chan_id = entry.to.value();
@@ -123,18 +275,17 @@ class BrokerThread : public Module {
       LOG(ERROR) << "Unknown channel: \"" << chan_id << "\". Dropping message";
       return;
     }
-    ForwardMessage(chan_it->second.socket, chan_it->second.send_raw, move(msg));
+    ForwardMessage(chan_it->second.socket, chan_it->second.send_raw, data, size);
   }
 
-  void ForwardMessage(zmq::socket_t& socket, bool send_raw, zmq::message_t&& msg) {
-    MachineId machine_id = -1;
-    ParseMachineId(machine_id, msg);
+  void ForwardMessage(zmq::socket_t& socket, bool send_raw, const char* data, size_t size) {
+    auto machine_id = wire::Read<MachineId>(data, wire::kMachineIdOffset);
 
     auto env = std::make_unique<Envelope>();
     if (send_raw) {
-      env->set_raw(msg.to_string());
+      env->set_raw(data, size);
     } else {
-      if (!DeserializeProto(*env, msg)) {
+      if (!DeserializeProto(*env, data, size)) {
         LOG(ERROR) << "Malformed message";
         return;
       }
@@ -145,6 +296,7 @@ class BrokerThread : public Module {
     SendEnvelope(socket, move(env));
   }
 
+  ConfigurationPtr config_;
   zmq::socket_t external_socket_;
   zmq::socket_t internal_socket_;
   const string internal_endpoint_;
@@ -152,6 +304,11 @@ class BrokerThread : public Module {
   std::chrono::milliseconds poll_timeout_ms_;
   vector<zmq::pollitem_t> poll_items_;
   int recv_retries_;
+  vector<std::unique_ptr<ShmRing>> rings_;
+  std::chrono::steady_clock::time_point next_liveness_check_;
+  Broker::ThreadStats& stats_;
+  // Only written by this thread. Copied to stats_ after each round of messages
+  uint64_t num_messages_ = 0;
 
   struct ChannelEntry {
     ChannelEntry(zmq::socket_t&& socket, bool send_raw) : socket(std::move(socket)), send_raw(send_raw) {}
@@ -162,7 +319,7 @@ class BrokerThread : public Module {
 
   struct RedirectEntry {
     std::optional<Channel> to;
-    vector<zmq::message_t> pending_msgs;
+    vector<string> pending_msgs;
   };
   unordered_map<Channel, RedirectEntry> redirect_;
 };
@@ -176,11 +333,16 @@ shared_ptr<Broker> Broker::New(const ConfigurationPtr& config, std::chrono::mill
 
 Broker::Broker(const ConfigurationPtr& config, const shared_ptr<zmq::context_t>& context,
                std::chrono::milliseconds poll_timeout_ms)
-    : config_(config), context_(context), poll_timeout_ms_(poll_timeout_ms), running_(false) {}
+    : config_(config),
+      context_(context),
+      poll_timeout_ms_(poll_timeout_ms),
+      running_(false),
+      thread_stats_(new ThreadStats[config->broker_ports_size()]) {}
 
 void Broker::AddChannel(Channel chan, bool send_raw) {
   CHECK(!running_) << "Cannot add new channel. The broker has already been running";
-  channels_.emplace_back(chan, send_raw);
+  auto routing = config_->broker_routing();
+  channels_.emplace_back(chan, send_raw || (routing != nullptr && routing->lazy_deserialization()));
 }
 
 void Broker::StartInNewThreads() {
@@ -197,7 +359,8 @@ void Broker::StartInNewThreads() {
     auto external_endpoint = MakeRemoteAddress(config_->protocol(), binding_addr, config_->broker_ports(i));
 
     auto& t = threads_.emplace_back(
-        MakeRunnerFor<BrokerThread>(context_, internal_endpoint, external_endpoint, channels_, poll_timeout_ms_));
+        MakeRunnerFor<BrokerThread>(config_, context_, internal_endpoint, external_endpoint, channels_,
+                                    poll_timeout_ms_, thread_stats_[i]));
 
     std::optional<uint32_t> cpu = {};
     if (i < cpus.size()) {
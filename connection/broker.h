@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <condition_variable>
 #include <thread>
 #include <unordered_map>
@@ -45,6 +46,14 @@ namespace slog {
  * specified in each message. On the other end of each channel is a module which also runs
  * in its own thread.
  *
+ * A message may be a frame of messages coalesced by a Sender, in which case each message
+ * in it is brokered on its own.
+ *
+ * A machine has one broker thread per broker port, each parsing the messages that it receives. If
+ * sharding is enabled in the config, the messages that are not sent via a specific broker are spread
+ * over the broker threads by their sender and channel. If lazy deserialization is enabled, the
+ * broker threads never parse messages and the modules do it on their own threads instead.
+ *
  * A module sends message to another machine via a Sender object. Not showed above: the modules
  * can send message to each other using Sender without going through the Broker.
  */
@@ -58,8 +67,23 @@ class Broker {
   void StartInNewThreads();
   void Stop();
 
+  /**
+   * @param send_raw Whether to hand the messages to the module without parsing them. Always true if
+   * lazy deserialization is enabled in the config
+   */
   void AddChannel(Channel chan, bool send_raw = false);
 
+  struct ThreadStats {
+    // Time spent on handling messages
+    std::atomic<uint64_t> work_ns = 0;
+    std::atomic<uint64_t> num_messages = 0;
+  };
+
+  /**
+   * Stats of the thread of a broker port, which are updated by the thread as it runs
+   */
+  const ThreadStats& thread_stats(size_t broker_id) const { return thread_stats_[broker_id]; }
+
   const ConfigurationPtr& config() const { return config_; }
   const std::shared_ptr<zmq::context_t>& context() const { return context_; }
 
@@ -73,6 +97,8 @@ class Broker {
 
   bool running_;
   std::vector<std::pair<Channel, bool>> channels_;
+  // Declared before the threads so that it outlives them
+  std::unique_ptr<ThreadStats[]> thread_stats_;
   std::vector<std::unique_ptr<slog::ModuleRunner>> threads_;
 };
 
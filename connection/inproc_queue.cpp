@@ -0,0 +1,49 @@
+#include "connection/inproc_queue.h"
+
+#include <glog/logging.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+namespace slog {
+
+InProcQueueBase::InProcQueueBase() : fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)), sleeping_(false) {
+  CHECK_GE(fd_, 0) << "Cannot create eventfd: " << strerror(errno);
+}
+
+InProcQueueBase::~InProcQueueBase() { close(fd_); }
+
+bool InProcQueueBase::Sleep() {
+  sleeping_.store(true, std::memory_order_relaxed);
+  // Pairs with the fence in Notify: either this sees the pushed value or the producer sees that the
+  // consumer is sleeping
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (!empty()) {
+    sleeping_.store(false, std::memory_order_relaxed);
+    return false;
+  }
+  return true;
+}
+
+void InProcQueueBase::Wake() {
+  sleeping_.store(false, std::memory_order_relaxed);
+  // Reset the counter of the eventfd so that it does not stay readable
+  uint64_t count;
+  if (read(fd_, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+    LOG(ERROR) << "Cannot read eventfd: " << strerror(errno);
+  }
+}
+
+void InProcQueueBase::Notify() {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (sleeping_.load(std::memory_order_relaxed) && sleeping_.exchange(false, std::memory_order_relaxed)) {
+    uint64_t one = 1;
+    if (write(fd_, &one, sizeof(one)) < 0) {
+      LOG(ERROR) << "Cannot write eventfd: " << strerror(errno);
+    }
+  }
+}
+
+}  // namespace slog
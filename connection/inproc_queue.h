@@ -0,0 +1,172 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+
+namespace slog {
+
+/**
+ * The part of an InProcQueue that lets its consumer wait for it in a Poller, next to zmq sockets.
+ *
+ * Before blocking, the consumer marks itself as sleeping with Sleep. A producer only writes to the
+ * eventfd if it sees this mark after pushing, so neither side makes a syscall while the consumer
+ * keeps up with the producers.
+ */
+class InProcQueueBase {
+ public:
+  InProcQueueBase();
+  virtual ~InProcQueueBase();
+  InProcQueueBase(const InProcQueueBase&) = delete;
+  InProcQueueBase& operator=(const InProcQueueBase&) = delete;
+
+  // Becomes readable when a producer wakes up the consumer
+  int fd() const { return fd_; }
+
+  /**
+   * Called by the consumer before it waits on fd(). Returns false and stays awake if the queue
+   * is not empty, in which case the consumer must not wait
+   */
+  bool Sleep();
+
+  /**
+   * Called by the consumer after waiting on fd()
+   */
+  void Wake();
+
+ protected:
+  /**
+   * Called by a producer after pushing
+   */
+  void Notify();
+
+  virtual bool empty() const = 0;
+
+ private:
+  int fd_;
+  alignas(64) std::atomic<bool> sleeping_;
+};
+
+/**
+ * A bounded lock-free queue with multiple producers and a single consumer, carrying values that
+ * are trivially copyable such as pointers and ids. Producers claim cells with a CAS on the tail and
+ * publish them with a per-cell sequence number, so that producers do not wait for each other.
+ *
+ * When the ring is full, values are pushed into an overflow list behind a mutex instead of blocking
+ * the producer, since two modules pushing to each other would otherwise deadlock. The values of
+ * a producer are still popped in the order they are pushed.
+ */
+template <typename T>
+class InProcQueue : public InProcQueueBase {
+  static_assert(std::is_trivially_copyable_v<T>, "Values of an InProcQueue must be trivially copyable");
+
+ public:
+  /**
+   * @param capacity Number of values held without overflowing, rounded up to a power of two
+   */
+  explicit InProcQueue(size_t capacity) : capacity_(RoundUp(capacity)), cells_(new Cell[capacity_]) {
+    for (size_t i = 0; i < capacity_; i++) {
+      cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  void Push(T value) {
+    if (overflowing_.load(std::memory_order_acquire) || !PushToRing(value)) {
+      std::lock_guard<std::mutex> lock(overflow_mutex_);
+      overflow_.push_back(value);
+      overflowing_.store(true, std::memory_order_release);
+    }
+    Notify();
+  }
+
+  /**
+   * Must only be called by the consumer. Returns false if the queue is empty
+   */
+  bool Pop(T& value) {
+    if (PopFromRing(value)) {
+      return true;
+    }
+    if (!overflowing_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    std::lock_guard<std::mutex> lock(overflow_mutex_);
+    // A producer may have pushed into the ring right before overflowing, so the ring goes first
+    if (PopFromRing(value)) {
+      return true;
+    }
+    value = overflow_.front();
+    overflow_.pop_front();
+    if (overflow_.empty()) {
+      overflowing_.store(false, std::memory_order_relaxed);
+    }
+    return true;
+  }
+
+  size_t capacity() const { return capacity_; }
+
+ protected:
+  bool empty() const final {
+    auto& cell = cells_[head_ & (capacity_ - 1)];
+    return cell.sequence.load(std::memory_order_acquire) != head_ + 1 &&
+           !overflowing_.load(std::memory_order_acquire);
+  }
+
+ private:
+  static size_t RoundUp(size_t capacity) {
+    size_t rounded = 1;
+    while (rounded < capacity) {
+      rounded <<= 1;
+    }
+    return rounded;
+  }
+
+  bool PushToRing(T value) {
+    auto pos = tail_.load(std::memory_order_relaxed);
+    for (;;) {
+      auto& cell = cells_[pos & (capacity_ - 1)];
+      auto diff = static_cast<int64_t>(cell.sequence.load(std::memory_order_acquire) - pos);
+      if (diff == 0) {
+        if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          cell.value = value;
+          cell.sequence.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        // The cell still holds the value pushed one lap ago
+        return false;
+      } else {
+        pos = tail_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  bool PopFromRing(T& value) {
+    auto& cell = cells_[head_ & (capacity_ - 1)];
+    if (cell.sequence.load(std::memory_order_acquire) != head_ + 1) {
+      return false;
+    }
+    value = cell.value;
+    cell.sequence.store(head_ + capacity_, std::memory_order_release);
+    head_++;
+    return true;
+  }
+
+  struct Cell {
+    std::atomic<uint64_t> sequence;
+    T value;
+  };
+
+  const size_t capacity_;
+  std::unique_ptr<Cell[]> cells_;
+  alignas(64) std::atomic<uint64_t> tail_ = 0;
+  // Only accessed by the consumer
+  alignas(64) uint64_t head_ = 0;
+
+  alignas(64) std::atomic<bool> overflowing_ = false;
+  std::mutex overflow_mutex_;
+  std::deque<T> overflow_;
+};
+
+}  // namespace slog
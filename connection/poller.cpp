@@ -16,9 +16,27 @@ void Poller::PushSocket(zmq::socket_t& socket) {
   });
 }
 
+void Poller::PushQueue(InProcQueueBase& queue) {
+  poll_items_.push_back({nullptr, queue.fd(), ZMQ_POLLIN, 0});
+  queues_.push_back(&queue);
+}
+
+bool Poller::SleepOnQueues() {
+  for (size_t i = 0; i < queues_.size(); i++) {
+    if (!queues_[i]->Sleep()) {
+      for (size_t j = 0; j < i; j++) {
+        queues_[j]->Wake();
+      }
+      return false;
+    }
+  }
+  return true;
+}
+
 bool Poller::NextEvent(bool dont_wait) {
   auto may_has_msg = true;
-  if (!dont_wait) {
+  // Producers of the queues only signal the eventfds if the queues are marked as sleeping
+  if (!dont_wait && SleepOnQueues()) {
     // Compute the time that we need to wait until the next event
     auto shortest_timeout = poll_timeout_;
     auto now = Clock::now();
@@ -42,6 +60,9 @@ bool Poller::NextEvent(bool dont_wait) {
       // No timed event to wait, wait until there is a new message
       rc = zmq::poll(poll_items_, -1);
     }
+    for (auto queue : queues_) {
+      queue->Wake();
+    }
     may_has_msg = rc > 0;
   }
 
@@ -6,6 +6,8 @@
 #include <vector>
 #include <zmq.hpp>
 
+#include "connection/inproc_queue.h"
+
 namespace slog {
 
 class Poller {
@@ -18,6 +20,9 @@ class Poller {
 
   void PushSocket(zmq::socket_t& socket);
 
+  // The queue must outlive the poller
+  void PushQueue(InProcQueueBase& queue);
+
   bool is_socket_ready(size_t i) const;
 
   void AddTimedCallback(std::chrono::microseconds timeout, std::function<void()>&& cb);
@@ -32,8 +37,14 @@ class Poller {
     std::function<void()> callback;
   };
 
+  /**
+   * Returns true if all queues are empty and marked as sleeping
+   */
+  bool SleepOnQueues();
+
   std::optional<std::chrono::microseconds> poll_timeout_;
   std::vector<zmq::pollitem_t> poll_items_;
+  std::vector<InProcQueueBase*> queues_;
   std::list<TimedCallback> timed_callbacks_;
 };
 
@@ -1,18 +1,91 @@
 #include "sender.h"
 
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cstring>
+
 using std::move;
 
 namespace slog {
 
+namespace {
+const size_t kDefaultMaxFrameBytes = 16384;
+const std::chrono::microseconds kDefaultMaxDelay(100);
+const size_t kDefaultRingSize = 4194304;
+// How long a destroyed sender keeps trying to tell a broker that it detaches its ring
+const int kRingDetachLingerMs = 1000;
+// How long a write waits for a broker to make room in its ring before the socket is used instead
+const std::chrono::seconds kRingWriteTimeout(1);
+
+bool IsOnSameHost(const std::string& protocol, const std::string& address) {
+  return protocol == "ipc" || address == "localhost" || address.rfind("127.", 0) == 0;
+}
+}  // namespace
+
 Sender::Sender(const ConfigurationPtr& config, const std::shared_ptr<zmq::context_t>& context)
-    : config_(config), context_(context) {}
+    : config_(config),
+      context_(context),
+      shard_brokers_(config->broker_routing() != nullptr && config->broker_routing()->shard()),
+      coalescing_(false),
+      max_frame_bytes_(kDefaultMaxFrameBytes),
+      max_delay_(kDefaultMaxDelay),
+      ring_size_(0) {
+  if (auto coalescing_config = config_->message_coalescing(); coalescing_config != nullptr) {
+    coalescing_ = true;
+    if (coalescing_config->max_frame_bytes() > 0) {
+      max_frame_bytes_ = coalescing_config->max_frame_bytes();
+    }
+    if (coalescing_config->max_delay() > 0) {
+      max_delay_ = std::chrono::microseconds(coalescing_config->max_delay());
+    }
+  }
+  if (auto shm_config = config_->shared_memory_transport(); shm_config != nullptr) {
+    ring_size_ = shm_config->ring_size_bytes() > 0 ? shm_config->ring_size_bytes() : kDefaultRingSize;
+  }
+}
+
+Sender::~Sender() {
+  for (auto& [machine_id, connections] : machine_id_to_connections_) {
+    for (auto& conn : connections) {
+      if (conn != nullptr && conn->ring != nullptr) {
+        // Sockets do not linger by default, in which case the messages that are not sent yet,
+        // including the ones telling the broker about the ring, would be dropped on closing
+        conn->socket.set(zmq::sockopt::linger, kRingDetachLingerMs);
+        DetachRing(*conn);
+      }
+    }
+  }
+}
 
-void Sender::Send(const internal::Envelope& envelope, MachineId to_machine_id, Channel to_channel, size_t via_broker) {
-  auto& socket = GetRemoteSocket(to_machine_id, via_broker);
-  SendSerializedProto(*socket, envelope, config_->local_machine_id(), to_channel);
+void Sender::Send(const internal::Envelope& envelope, MachineId to_machine_id, Channel to_channel,
+                  std::optional<size_t> via_broker) {
+  auto& conn = GetRemoteConnection(to_machine_id, PickBroker(to_channel, via_broker));
+  if (conn.ring != nullptr) {
+    auto payload_size = envelope.ByteSizeLong();
+    ring_buffer_.resize(wire::kHeaderSize + payload_size);
+    SerializeProtoTo(ring_buffer_.data(), envelope, payload_size);
+    SetAddress(ring_buffer_.data(), config_->local_machine_id(), to_channel);
+    stats_.serialized_bytes += ring_buffer_.size();
+    WriteToRing(conn, ring_buffer_.data(), ring_buffer_.size());
+    return;
+  }
+  if (coalescing_) {
+    auto payload_size = envelope.ByteSizeLong();
+    if (auto data = ReserveInFrame(conn, wire::kHeaderSize + payload_size); data != nullptr) {
+      SerializeProtoTo(data, envelope, payload_size);
+      SetAddress(data, config_->local_machine_id(), to_channel);
+      stats_.serialized_bytes += wire::kHeaderSize + payload_size;
+      return;
+    }
+  }
+  auto serialized = SerializeProto(envelope);
+  stats_.serialized_bytes += serialized.size();
+  SendAddressedBuffer(conn.socket, move(serialized), config_->local_machine_id(), to_channel);
 }
 
-void Sender::Send(EnvelopePtr&& envelope, MachineId to_machine_id, Channel to_channel, size_t via_broker) {
+void Sender::Send(EnvelopePtr&& envelope, MachineId to_machine_id, Channel to_channel,
+                  std::optional<size_t> via_broker) {
   if (to_machine_id == config_->local_machine_id()) {
     Send(move(envelope), to_channel);
   } else {
@@ -35,47 +108,203 @@ void Sender::Send(EnvelopePtr&& envelope, Channel to_channel) {
 }
 
 void Sender::Send(const internal::Envelope& envelope, const std::vector<MachineId>& to_machine_ids, Channel to_channel,
-                  size_t via_broker) {
-  auto serialized = SerializeProto(envelope);
-  for (auto dest : to_machine_ids) {
-    zmq::message_t copied;
-    copied.copy(serialized);
-    auto& socket = GetRemoteSocket(dest, via_broker);
-    SendAddressedBuffer(*socket, move(copied), config_->local_machine_id(), to_channel);
-  }
+                  std::optional<size_t> via_broker) {
+  Multicast(envelope, to_machine_ids, to_channel, via_broker, false /* skip_local */);
 }
 
 void Sender::Send(EnvelopePtr&& envelope, const std::vector<MachineId>& to_machine_ids, Channel to_channel,
-                  size_t via_broker) {
-  auto serialized = SerializeProto(*envelope);
-  bool send_local = false;
+                  std::optional<size_t> via_broker) {
+  Multicast(*envelope, to_machine_ids, to_channel, via_broker, true /* skip_local */);
+  if (std::find(to_machine_ids.begin(), to_machine_ids.end(), config_->local_machine_id()) != to_machine_ids.end()) {
+    Send(std::move(envelope), to_channel);
+  }
+}
+
+void Sender::Multicast(const internal::Envelope& envelope, const std::vector<MachineId>& to_machine_ids,
+                       Channel to_channel, std::optional<size_t> via_broker, bool skip_local) {
+  auto local_machine_id = config_->local_machine_id();
+  auto is_destination = [&](MachineId dest) { return !skip_local || dest != local_machine_id; };
+  auto num_remaining = std::count_if(to_machine_ids.begin(), to_machine_ids.end(), is_destination);
+  if (num_remaining == 0) {
+    return;
+  }
+
+  auto broker_id = PickBroker(to_channel, via_broker);
+
+  // The header is the same for all destinations so it is written before the buffer is shared
+  auto serialized = SerializeProto(envelope);
+  SetAddress(serialized, local_machine_id, to_channel);
+  stats_.serialized_bytes += serialized.size();
+
   for (auto dest : to_machine_ids) {
-    if (dest == config_->local_machine_id()) {
-      send_local = true;
+    if (!is_destination(dest)) {
+      continue;
+    }
+    auto& conn = GetRemoteConnection(dest, broker_id);
+    --num_remaining;
+    if (conn.ring != nullptr) {
+      WriteToRing(conn, serialized.data<char>(), serialized.size());
       continue;
     }
-    zmq::message_t copied;
-    copied.copy(serialized);
-    auto& socket = GetRemoteSocket(dest, via_broker);
-    SendAddressedBuffer(*socket, move(copied), config_->local_machine_id(), to_channel);
+    if (auto data = ReserveInFrame(conn, serialized.size()); data != nullptr) {
+      memcpy(data, serialized.data(), serialized.size());
+      stats_.copied_bytes += serialized.size();
+      continue;
+    }
+    if (num_remaining == 0) {
+      // The last destination takes over the buffer
+      conn.socket.send(serialized, zmq::send_flags::dontwait);
+      break;
+    }
+    // The copy shares the buffer of the original message through a reference count instead of
+    // copying its content. The buffer is freed after it is sent to the last destination
+    zmq::message_t shared;
+    shared.copy(serialized);
+    conn.socket.send(shared, zmq::send_flags::dontwait);
+    stats_.num_shared_sends++;
   }
-  if (send_local) {
-    Send(std::move(envelope), to_channel);
+}
+
+size_t Sender::PickBroker(Channel to_channel, std::optional<size_t> via_broker) const {
+  if (via_broker.has_value()) {
+    return via_broker.value();
+  }
+  // Tags can only be routed by the broker that they are redirected at
+  if (!shard_brokers_ || to_channel >= kMaxChannel) {
+    return 0;
+  }
+  return (config_->local_machine_id() + to_channel) % config_->broker_ports_size();
+}
+
+void Sender::FlushExpired() {
+  if (pending_connections_.empty()) {
+    return;
+  }
+  auto now = Clock::now();
+  size_t num_pending = 0;
+  for (auto conn : pending_connections_) {
+    if (!conn->frame.empty() && conn->deadline <= now) {
+      FlushFrame(*conn);
+    }
+    if (conn->frame.empty()) {
+      conn->pending = false;
+    } else {
+      pending_connections_[num_pending++] = conn;
+    }
   }
+  pending_connections_.resize(num_pending);
 }
 
-Sender::SocketPtr& Sender::GetRemoteSocket(MachineId machine_id, size_t broker_id) {
+void Sender::Flush() {
+  for (auto conn : pending_connections_) {
+    FlushFrame(*conn);
+    conn->pending = false;
+  }
+  pending_connections_.clear();
+}
+
+char* Sender::ReserveInFrame(RemoteConnection& conn, size_t size) {
+  if (!coalescing_ || conn.ring != nullptr) {
+    return nullptr;
+  }
+  if (wire::kHeaderSize + size > max_frame_bytes_) {
+    FlushFrame(conn);
+    return nullptr;
+  }
+  if (conn.frame.size() + size > max_frame_bytes_) {
+    FlushFrame(conn);
+  }
+  if (conn.frame.empty()) {
+    conn.frame.resize(wire::kHeaderSize);
+    conn.deadline = Clock::now() + max_delay_;
+    if (!conn.pending) {
+      conn.pending = true;
+      pending_connections_.push_back(&conn);
+    }
+  }
+  auto offset = conn.frame.size();
+  conn.frame.resize(offset + size);
+  return conn.frame.data() + offset;
+}
+
+void Sender::FlushFrame(RemoteConnection& conn) {
+  if (conn.frame.empty()) {
+    return;
+  }
+  auto data = conn.frame.data();
+  wire::WriteHeader(data, wire::Type::COALESCED, conn.frame.size() - wire::kHeaderSize);
+  // The channel of the frame is not used. Each coalesced message is routed with its own channel
+  SetAddress(data, config_->local_machine_id(), 0);
+  // The frame keeps its capacity for the next messages
+  zmq::message_t msg(conn.frame.data(), conn.frame.size());
+  stats_.copied_bytes += conn.frame.size();
+  conn.socket.send(msg, zmq::send_flags::dontwait);
+  conn.frame.clear();
+}
+
+void Sender::AttachRing(RemoteConnection& conn) {
+  conn.ring = ShmRing::Create(ring_size_);
+  if (conn.ring == nullptr) {
+    LOG(ERROR) << "Falling back to sending through the socket";
+    return;
+  }
+  // Everything written to the ring is read after this message, so the messages stay in order
+  SendRingMessage(conn, wire::Type::RING_ATTACH);
+}
+
+void Sender::DetachRing(RemoteConnection& conn) {
+  // The broker reads what is left in the ring before anything sent through the socket after this
+  // message, so the messages stay in order
+  SendRingMessage(conn, wire::Type::RING_DETACH);
+  conn.ring.reset();
+}
+
+void Sender::SendRingMessage(RemoteConnection& conn, wire::Type type) {
+  const auto& name = conn.ring->name();
+  zmq::message_t msg(wire::kHeaderSize + name.size());
+  wire::WriteHeader(msg.data<char>(), type, name.size());
+  memcpy(msg.data<char>() + wire::kHeaderSize, name.data(), name.size());
+  SendAddressedBuffer(conn.socket, std::move(msg), config_->local_machine_id(), 0);
+}
+
+void Sender::WriteToRing(RemoteConnection& conn, const char* data, size_t size) {
+  stats_.copied_bytes += size;
+  auto wake_up_broker = [this, &conn] {
+    zmq::message_t msg(wire::kHeaderSize);
+    wire::WriteHeader(msg.data<char>(), wire::Type::RING_WAKEUP, 0);
+    SendAddressedBuffer(conn.socket, std::move(msg), config_->local_machine_id(), 0);
+  };
+  if (conn.ring->Write(data, size, kRingWriteTimeout, wake_up_broker)) {
+    return;
+  }
+  // The socket never blocks, unlike a full ring. The broker drops the part of the message that is in
+  // the ring, and everything sent through the socket from now on is read after what is in the ring
+  LOG(ERROR) << "The broker does not read ring " << conn.ring->name() << ". Falling back to sending through the socket";
+  DetachRing(conn);
+  zmq::message_t msg(data, size);
+  stats_.copied_bytes += size;
+  conn.socket.send(msg, zmq::send_flags::dontwait);
+}
+
+Sender::RemoteConnection::RemoteConnection(zmq::context_t& context, const std::string& endpoint)
+    : socket(context, ZMQ_PUSH) {
+  socket.set(zmq::sockopt::sndhwm, 0);
+  socket.connect(endpoint);
+}
+
+Sender::RemoteConnection& Sender::GetRemoteConnection(MachineId machine_id, size_t broker_id) {
   // Lazily establish a new connection when necessary
-  auto ins = machine_id_to_sockets_.try_emplace(machine_id, config_->broker_ports_size());
-  auto& socket = ins.first->second[broker_id];
-  if (socket == nullptr) {
-    socket = std::make_unique<zmq::socket_t>(*context_, ZMQ_PUSH);
-    socket->set(zmq::sockopt::sndhwm, 0);
+  auto ins = machine_id_to_connections_.try_emplace(machine_id, config_->broker_ports_size());
+  auto& conn = ins.first->second[broker_id];
+  if (conn == nullptr) {
     auto endpoint =
         MakeRemoteAddress(config_->protocol(), config_->address(machine_id), config_->broker_ports(broker_id));
-    socket->connect(endpoint);
+    conn = std::make_unique<RemoteConnection>(*context_, endpoint);
+    if (ring_size_ > 0 && IsOnSameHost(config_->protocol(), config_->address(machine_id))) {
+      AttachRing(*conn);
+    }
   }
-  return socket;
+  return *conn;
 }
 
 }  // namespace slog
\ No newline at end of file
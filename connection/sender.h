@@ -1,30 +1,47 @@
 #pragma once
 
+#include <chrono>
+#include <optional>
 #include <unordered_map>
 #include <zmq.hpp>
 
 #include "common/types.h"
 #include "connection/broker.h"
+#include "connection/shm_ring.h"
 #include "connection/zmq_utils.h"
 #include "proto/internal.pb.h"
 
 namespace slog {
 
 /*
- * See Broker class for details about this class
+ * See Broker class for details about this class.
+ *
+ * If message coalescing is enabled in the config, messages sent to another machine are packed into
+ * one frame per broker of that machine and are not sent until the frame is flushed. The owner of the
+ * sender must call FlushExpired regularly and Flush before it waits for anything.
+ *
+ * If the shared memory transport is enabled in the config, messages sent to a broker on the same host
+ * go through a shared memory ring, which is never coalesced.
  */
 class Sender {
  public:
   Sender(const ConfigurationPtr& config, const std::shared_ptr<zmq::context_t>& context);
 
+  /**
+   * Detaches the shared memory rings from the brokers
+   */
+  ~Sender();
+
   /**
    * Send a request or response to a given channel of a given machine
    * @param envelope Request or response to be sent
    * @param to_machine_id Id of the machine that this message is sent to
    * @param to_channel Channel on the machine that this message is sent to
-   * @param via_broker Send to the channel via this broker on the remote machine
+   * @param via_broker Send to the channel via this broker on the remote machine. If not set, the
+   * broker is picked by the routing policy in the config
    */
-  void Send(const internal::Envelope& envelope, MachineId to_machine_id, Channel to_channel, size_t via_broker = 0);
+  void Send(const internal::Envelope& envelope, MachineId to_machine_id, Channel to_channel,
+            std::optional<size_t> via_broker = {});
 
   /**
    * Send a request or response to a given channel of a given machine. Use local send
@@ -32,9 +49,11 @@ class Sender {
    * @param envelope Request or response to be sent
    * @param to_machine_id Id of the machine that this message is sent to
    * @param to_channel Channel on the machine that this message is sent to
-   * @param via_broker Send to the channel via this broker on the remote machine
+   * @param via_broker Send to the channel via this broker on the remote machine. If not set, the
+   * broker is picked by the routing policy in the config
    */
-  void Send(EnvelopePtr&& envelope, MachineId to_machine_id, Channel to_channel, size_t via_broker = 0);
+  void Send(EnvelopePtr&& envelope, MachineId to_machine_id, Channel to_channel,
+            std::optional<size_t> via_broker = {});
 
   /**
    * Send a request or response to the same machine given a channel
@@ -49,10 +68,11 @@ class Sender {
    * @param request_or_response Request or response to be sent
    * @param to_machine_ids Ids of the machines that this message is sent to
    * @param to_channel Channel on the machine that this message is sent to
-   * @param via_broker Send to the channel via this broker on the remote machine
+   * @param via_broker Send to the channel via this broker on the remote machine. If not set, the
+   * broker is picked by the routing policy in the config
    */
   void Send(const internal::Envelope& envelope, const std::vector<MachineId>& to_machine_ids, Channel to_channel,
-            size_t via_broker = 0);
+            std::optional<size_t> via_broker = {});
 
   /**
    * Send a request or response to a given channel of a list of machines.
@@ -61,22 +81,103 @@ class Sender {
    * @param request_or_response Request or response to be sent
    * @param to_machine_ids Ids of the machines that this message is sent to
    * @param to_channel Channel on the machine that this message is sent to
-   * @param via_broker Send to the channel via this broker on the remote machine
+   * @param via_broker Send to the channel via this broker on the remote machine. If not set, the
+   * broker is picked by the routing policy in the config
    */
   void Send(EnvelopePtr&& envelope, const std::vector<MachineId>& to_machine_ids, Channel to_channel,
-            size_t via_broker = 0);
+            std::optional<size_t> via_broker = {});
+
+  /**
+   * Sends the frames of coalesced messages that have waited for the maximum delay
+   */
+  void FlushExpired();
+
+  /**
+   * Sends all frames of coalesced messages
+   */
+  void Flush();
+
+  struct Stats {
+    // Bytes written by serializing envelopes, headers included
+    uint64_t serialized_bytes = 0;
+    // Bytes of serialized messages copied into frames or shared memory rings, and of frames copied into messages
+    uint64_t copied_bytes = 0;
+    // Number of times a serialized buffer was sent to one more destination without being copied
+    uint64_t num_shared_sends = 0;
+  };
+
+  /**
+   * Counts the work done to send messages to other machines. Messages to the local machine are never serialized
+   */
+  const Stats& stats() const { return stats_; }
 
  private:
-  using SocketPtr = std::unique_ptr<zmq::socket_t>;
-  SocketPtr& GetRemoteSocket(MachineId machine_id, size_t broker_id);
+  using Clock = std::chrono::steady_clock;
+
+  struct RemoteConnection {
+    RemoteConnection(zmq::context_t& context, const std::string& endpoint);
+    zmq::socket_t socket;
+    // Replaces the socket for messages if the broker is on the same host. The socket is still used
+    // to tell the broker about the ring and to wake it up
+    std::unique_ptr<ShmRing> ring;
+    // The frame being filled: a header followed by the coalesced messages. Empty if there is no message
+    std::string frame;
+    Clock::time_point deadline;
+    // Whether this connection is in pending_connections_
+    bool pending = false;
+  };
+  using ConnectionPtr = std::unique_ptr<RemoteConnection>;
+  RemoteConnection& GetRemoteConnection(MachineId machine_id, size_t broker_id);
+
+  /**
+   * Returns where to write a message of the given size in the frame of a connection or nullptr if the
+   * message must be sent on its own, which is the case if coalescing is disabled or the message is
+   * larger than a frame. In the latter case, the frame is flushed so the messages stay in order
+   */
+  char* ReserveInFrame(RemoteConnection& conn, size_t size);
+  void FlushFrame(RemoteConnection& conn);
+
+  void AttachRing(RemoteConnection& conn);
+  void DetachRing(RemoteConnection& conn);
+  void SendRingMessage(RemoteConnection& conn, wire::Type type);
+  void WriteToRing(RemoteConnection& conn, const char* data, size_t size);
+
+  /**
+   * Serializes the envelope once and sends the same buffer to all destinations, except the
+   * local machine if skip_local is true. Nothing is serialized if there is no destination
+   */
+  void Multicast(const internal::Envelope& envelope, const std::vector<MachineId>& to_machine_ids,
+                 Channel to_channel, std::optional<size_t> via_broker, bool skip_local);
+
+  /**
+   * Messages to a channel that are not sent via a specific broker go through the first broker, or
+   * through a broker picked by the local machine and the channel if sharding is enabled
+   */
+  size_t PickBroker(Channel to_channel, std::optional<size_t> via_broker) const;
 
   ConfigurationPtr config_;
   // Keep a pointer to context here to make sure that the below sockets
   // are destroyed before the context is
   std::shared_ptr<zmq::context_t> context_;
 
-  std::unordered_map<MachineId, std::vector<SocketPtr>> machine_id_to_sockets_;
+  std::unordered_map<MachineId, std::vector<ConnectionPtr>> machine_id_to_connections_;
   std::unordered_map<Channel, zmq::socket_t> local_channel_to_socket_;
+
+  // Whether the messages that are not sent via a specific broker are spread over the brokers
+  bool shard_brokers_;
+
+  bool coalescing_;
+  size_t max_frame_bytes_;
+  std::chrono::microseconds max_delay_;
+  // Connections that have had a non-empty frame since the last time they were flushed
+  std::vector<RemoteConnection*> pending_connections_;
+
+  // Size of the shared memory rings or 0 if the shared memory transport is disabled
+  size_t ring_size_;
+  // Serialized messages are written here before they are copied into a ring
+  std::string ring_buffer_;
+
+  Stats stats_;
 };
 
 }  // namespace slog
\ No newline at end of file
@@ -0,0 +1,205 @@
+#include "connection/shm_ring.h"
+
+#include <fcntl.h>
+#include <glog/logging.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <optional>
+#include <thread>
+
+namespace slog {
+
+namespace {
+
+const size_t kMinCapacity = 4096;
+const size_t kMaxCapacity = size_t(1) << 31;
+
+// Every ring is named after this prefix, and only such names are opened, so that a ring name coming
+// from another process cannot make Open map and remove any other shared memory segment
+const std::string kNamePrefix = "/slog_ring_";
+
+std::atomic<uint64_t> num_created_rings = 0;
+
+}  // namespace
+
+std::unique_ptr<ShmRing> ShmRing::Create(size_t capacity) {
+  capacity = std::clamp(capacity, kMinCapacity, kMaxCapacity);
+  // Round up to a power of two so that positions can be masked into indices
+  size_t rounded = kMinCapacity;
+  while (rounded < capacity) {
+    rounded <<= 1;
+  }
+
+  auto name = kNamePrefix + std::to_string(getpid()) + "_" + std::to_string(num_created_rings++);
+  int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, S_IRUSR | S_IWUSR);
+  if (fd < 0) {
+    LOG(ERROR) << "Cannot create shared memory segment " << name << ": " << strerror(errno);
+    return nullptr;
+  }
+  auto mapped_size = sizeof(Control) + rounded;
+  if (ftruncate(fd, mapped_size) < 0) {
+    LOG(ERROR) << "Cannot resize shared memory segment " << name << ": " << strerror(errno);
+    close(fd);
+    shm_unlink(name.c_str());
+    return nullptr;
+  }
+  auto mem = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mem == MAP_FAILED) {
+    LOG(ERROR) << "Cannot map shared memory segment " << name << ": " << strerror(errno);
+    shm_unlink(name.c_str());
+    return nullptr;
+  }
+
+  auto control = new (mem) Control();
+  control->capacity = rounded;
+  control->producer_pid = getpid();
+  control->head.store(0, std::memory_order_relaxed);
+  control->tail.store(0, std::memory_order_relaxed);
+  control->sleeping.store(false, std::memory_order_release);
+
+  return std::unique_ptr<ShmRing>(new ShmRing(name, mem, mapped_size, true /* owner */));
+}
+
+std::unique_ptr<ShmRing> ShmRing::Open(const std::string& name) {
+  if (name.rfind(kNamePrefix, 0) != 0 || name.find('/', 1) != std::string::npos) {
+    LOG(ERROR) << "Invalid ring name " << name;
+    return nullptr;
+  }
+  int fd = shm_open(name.c_str(), O_RDWR, 0);
+  if (fd < 0) {
+    LOG(ERROR) << "Cannot open shared memory segment " << name << ": " << strerror(errno);
+    return nullptr;
+  }
+  struct stat st;
+  if (fstat(fd, &st) < 0 || static_cast<size_t>(st.st_size) < sizeof(Control) + kMinCapacity) {
+    LOG(ERROR) << "Invalid shared memory segment " << name;
+    close(fd);
+    return nullptr;
+  }
+  auto mem = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mem == MAP_FAILED) {
+    LOG(ERROR) << "Cannot map shared memory segment " << name << ": " << strerror(errno);
+    return nullptr;
+  }
+  // The capacity is taken from the size of the segment, which the producer cannot change once it is
+  // mapped. Positions are masked into indices and records are aligned to 8 bytes, so that the size
+  // word of a record is always in the ring
+  auto ring = std::unique_ptr<ShmRing>(new ShmRing(name, mem, st.st_size, false /* owner */));
+  if (ring->capacity_ != ring->control_->capacity || (ring->capacity_ & (ring->capacity_ - 1)) != 0 ||
+      ring->head_ % 8 != 0) {
+    LOG(ERROR) << "Invalid shared memory segment " << name;
+    return nullptr;
+  }
+  // The segment stays alive as long as it is mapped. Removing its name here makes sure that it does
+  // not outlive both sides
+  shm_unlink(name.c_str());
+
+  return ring;
+}
+
+ShmRing::ShmRing(const std::string& name, void* mem, size_t mapped_size, bool owner)
+    : name_(name),
+      mem_(mem),
+      mapped_size_(mapped_size),
+      owner_(owner),
+      control_(static_cast<Control*>(mem)),
+      data_(static_cast<char*>(mem) + sizeof(Control)),
+      capacity_(mapped_size - sizeof(Control)),
+      // A record of this size always fits in an empty ring, wherever the ring starts
+      max_chunk_(capacity_ / 2 - sizeof(uint32_t)) {
+  head_ = control_->head.load(std::memory_order_acquire);
+  tail_ = control_->tail.load(std::memory_order_acquire);
+  cached_head_ = head_;
+  cached_tail_ = tail_;
+}
+
+ShmRing::~ShmRing() {
+  // If the consumer has not read everything, it may not have opened the ring yet. The name is left
+  // for it to open the ring and remove the name. Otherwise, removing the name fails if the consumer
+  // has already removed it
+  if (owner_ && control_->head.load(std::memory_order_acquire) == tail_) {
+    shm_unlink(name_.c_str());
+  }
+  munmap(mem_, mapped_size_);
+}
+
+bool ShmRing::Write(const char* data, size_t size, std::chrono::microseconds timeout,
+                    const std::function<void()>& wake_up_consumer) {
+  // Only set once the ring is found to be full, so that a write that does not wait never reads the clock
+  std::optional<std::chrono::steady_clock::time_point> deadline;
+  do {
+    auto chunk = std::min(size, max_chunk_);
+    auto record_size = RecordSize(chunk);
+    auto index = tail_ & (capacity_ - 1);
+    size_t skip = capacity_ - index < record_size ? capacity_ - index : 0;
+
+    while (tail_ + skip + record_size - cached_head_ > capacity_) {
+      cached_head_ = control_->head.load(std::memory_order_acquire);
+      if (tail_ + skip + record_size - cached_head_ > capacity_) {
+        // The consumer may have gone to sleep before the previous chunks of this message were written
+        if (TakeSleepingMark()) {
+          wake_up_consumer();
+        }
+        auto now = std::chrono::steady_clock::now();
+        if (!deadline.has_value()) {
+          deadline = now + timeout;
+        } else if (now >= deadline.value()) {
+          if (owner_) {
+            shm_unlink(name_.c_str());
+          }
+          return false;
+        }
+        std::this_thread::yield();
+      }
+    }
+
+    if (skip > 0) {
+      memcpy(data_ + index, &kWrapMarker, sizeof(kWrapMarker));
+      tail_ += skip;
+      index = 0;
+    }
+    uint32_t word = chunk | (chunk < size ? kPartialFlag : 0);
+    memcpy(data_ + index, &word, sizeof(word));
+    memcpy(data_ + index + sizeof(word), data, chunk);
+    tail_ += record_size;
+    control_->tail.store(tail_, std::memory_order_release);
+
+    data += chunk;
+    size -= chunk;
+  } while (size > 0);
+
+  if (TakeSleepingMark()) {
+    wake_up_consumer();
+  }
+  return true;
+}
+
+bool ShmRing::TakeSleepingMark() {
+  // Pairs with the fence in Sleep: either the consumer sees the new tail before sleeping or this
+  // sees that it is sleeping
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  return control_->sleeping.load(std::memory_order_relaxed) &&
+         control_->sleeping.exchange(false, std::memory_order_relaxed);
+}
+
+bool ShmRing::Sleep() {
+  control_->sleeping.store(true, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (control_->tail.load(std::memory_order_relaxed) != head_) {
+    control_->sleeping.store(false, std::memory_order_relaxed);
+    return false;
+  }
+  return true;
+}
+
+void ShmRing::Wake() { control_->sleeping.store(false, std::memory_order_relaxed); }
+
+bool ShmRing::ProducerExited() const { return kill(control_->producer_pid, 0) < 0 && errno == ESRCH; }
+
+}  // namespace slog
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace slog {
+
+/**
+ * A single-producer single-consumer queue of messages in a POSIX shared memory segment, used to pass
+ * messages to a broker on the same host. Writing and reading a message only touches the shared memory.
+ *
+ * Each message is stored as a record: a 4-byte size followed by the message, padded to 8 bytes. A
+ * message larger than half of the ring is split into several records, all but the last of which are
+ * flagged as partial, and is put back together by the consumer. A record never wraps around the end
+ * of the ring: if it does not fit before the end, a wrap marker is written and it starts over at the
+ * beginning.
+ *
+ * The consumer marks itself as sleeping before it waits on something else than the ring. A producer
+ * that sees the mark after writing a message, or while waiting for room, has to wake the consumer up
+ * by other means.
+ */
+class ShmRing {
+ public:
+  /**
+   * Creates a ring with a unique name and a capacity of at least the given number of bytes. Returns
+   * nullptr if the shared memory segment cannot be created. The name is removed when the ring is
+   * destroyed, unless there are messages left in it for the consumer to open the ring and read them
+   */
+  static std::unique_ptr<ShmRing> Create(size_t capacity);
+
+  /**
+   * Maps a ring created by another thread or process and removes its name. Returns nullptr if it
+   * does not exist or if the name is not one that Create gives to a ring
+   */
+  static std::unique_ptr<ShmRing> Open(const std::string& name);
+
+  ~ShmRing();
+  ShmRing(const ShmRing&) = delete;
+  ShmRing& operator=(const ShmRing&) = delete;
+
+  const std::string& name() const { return name_; }
+  size_t capacity() const { return capacity_; }
+
+  /**
+   * Producer: appends a message, spinning for up to the given time while the ring is full. Calls
+   * wake_up_consumer each time it finds the consumer sleeping. Returns false if the consumer did not
+   * make room in time. The message may then be partly written, so the ring is given up: its name is
+   * removed and it must not be written to again
+   */
+  bool Write(const char* data, size_t size, std::chrono::microseconds timeout,
+             const std::function<void()>& wake_up_consumer);
+
+  /**
+   * Consumer: calls fn(data, size) on each message in the ring, up to max_messages messages. The data
+   * is only valid during the call. Returns the number of messages read. Stops at a record that does
+   * not fit in the ring, after which the ring is corrupted
+   */
+  template <typename Fn>
+  size_t Read(Fn&& fn, size_t max_messages);
+
+  /**
+   * Consumer: returns true if a record that does not fit in the ring was found, which a producer that
+   * is not a ShmRing may have written. Nothing more can be read and the ring must be dropped
+   */
+  bool corrupted() const { return corrupted_; }
+
+  /**
+   * Consumer: marks the consumer as sleeping. Returns false without marking it if the ring is not empty
+   */
+  bool Sleep();
+
+  /**
+   * Consumer: removes the sleeping mark
+   */
+  void Wake();
+
+  /**
+   * Consumer: returns true if the process that created the ring has exited, in which case nothing
+   * more will be written to the ring
+   */
+  bool ProducerExited() const;
+
+ private:
+  struct Control {
+    uint64_t capacity;
+    pid_t producer_pid;
+    // Position of the next record to read. Only written by the consumer
+    alignas(64) std::atomic<uint64_t> head;
+    // Position after the last published record. Only written by the producer
+    alignas(64) std::atomic<uint64_t> tail;
+    alignas(64) std::atomic<bool> sleeping;
+  };
+  static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<bool>::is_always_lock_free,
+                "Atomics in shared memory must be lock-free");
+
+  static constexpr uint32_t kWrapMarker = 0xFFFFFFFF;
+  static constexpr uint32_t kPartialFlag = 0x80000000;
+
+  static size_t RecordSize(size_t size) { return (sizeof(uint32_t) + size + 7) & ~static_cast<size_t>(7); }
+
+  ShmRing(const std::string& name, void* mem, size_t mapped_size, bool owner);
+
+  /**
+   * Producer: returns true if the consumer is sleeping and removes the mark
+   */
+  bool TakeSleepingMark();
+
+  const std::string name_;
+  void* const mem_;
+  const size_t mapped_size_;
+  const bool owner_;
+  Control* const control_;
+  char* const data_;
+  const size_t capacity_;
+  const size_t max_chunk_;
+
+  // Local copies of the positions, to avoid touching the cache line of the other side when possible
+  uint64_t head_ = 0;
+  uint64_t tail_ = 0;
+  uint64_t cached_head_ = 0;
+  uint64_t cached_tail_ = 0;
+
+  // Chunks of a split message received so far
+  std::string partial_;
+  bool corrupted_ = false;
+};
+
+template <typename Fn>
+size_t ShmRing::Read(Fn&& fn, size_t max_messages) {
+  size_t num_messages = 0;
+  while (num_messages < max_messages && !corrupted_) {
+    if (head_ == cached_tail_) {
+      cached_tail_ = control_->tail.load(std::memory_order_acquire);
+      if (head_ == cached_tail_) {
+        break;
+      }
+    }
+    auto index = head_ & (capacity_ - 1);
+    uint32_t word;
+    memcpy(&word, data_ + index, sizeof(word));
+    if (word == kWrapMarker) {
+      head_ += capacity_ - index;
+    } else {
+      size_t size = word & ~kPartialFlag;
+      // The size comes from shared memory so it is checked before the message is touched
+      if (size > max_chunk_ || index + RecordSize(size) > capacity_) {
+        corrupted_ = true;
+        break;
+      }
+      const char* msg = data_ + index + sizeof(word);
+      if (word & kPartialFlag) {
+        partial_.append(msg, size);
+      } else if (!partial_.empty()) {
+        partial_.append(msg, size);
+        fn(partial_.data(), partial_.size());
+        partial_.clear();
+        num_messages++;
+      } else {
+        fn(msg, size);
+        num_messages++;
+      }
+      head_ += RecordSize(size);
+    }
+    // Released record by record so that a producer waiting to write a large message makes progress
+    control_->head.store(head_, std::memory_order_release);
+  }
+  return num_messages;
+}
+
+}  // namespace slog
@@ -2,16 +2,19 @@
 
 #include <google/protobuf/any.pb.h>
 
+#include <cstring>
+#include <optional>
 #include <sstream>
+#include <type_traits>
 #include <zmq.hpp>
 
+#include "common/proto_utils.h"
 #include "common/types.h"
+#include "proto/api.pb.h"
 #include "proto/internal.pb.h"
 
 namespace slog {
 
-using EnvelopePtr = std::unique_ptr<internal::Envelope>;
-
 inline std::string MakeInProcChannelAddress(Channel chan) { return "inproc://channel_" + std::to_string(chan); }
 
 inline std::string MakeRemoteAddress(const std::string& protocol, const std::string& addr, uint32_t port) {
@@ -42,96 +45,286 @@ inline EnvelopePtr RecvEnvelope(zmq::socket_t& socket, bool dont_wait = false) {
   return EnvelopePtr(*(msg.data<internal::Envelope*>()));
 }
 
-inline zmq::message_t SerializeProto(const google::protobuf::Message& proto) {
-  google::protobuf::Any any;
-  any.PackFrom(proto);
+/**
+ * Format of the messages exchanged between machines and with clients:
+ *
+ *   <sender machine id> <receiver channel> <version> <type> <reserved> <payload size> <payload>
+ *
+ * The payload is the serialized message. The sender machine id and receiver channel are at the same
+ * offsets in all versions so that the broker can route a message without knowing its version.
+ *
+ * In version 0, the header only had the sender machine id and receiver channel and the payload was a
+ * google::protobuf::Any wrapping the message, which costs a second serialization pass, a type URL in
+ * every message and a type name comparison on receiving. Version 0 messages can still be received.
+ * The server answers a client in the version of its request so that older clients keep working.
+ *
+ * A sender may coalesce messages to the same broker of a machine into one message of type COALESCED,
+ * whose payload is the concatenation of complete version 1 messages, headers included.
+ *
+ * A sender on the same host as a broker may instead pass its messages through a shared memory ring
+ * (see ShmRing). It tells the broker the name of the ring in a RING_ATTACH message, wakes up the
+ * broker if needed with an empty RING_WAKEUP message and stops using the ring with a RING_DETACH
+ * message carrying its name, all sent through the socket. The broker only takes RING_ATTACH and
+ * RING_DETACH messages straight from its socket, from the same host, and only if the shared memory
+ * transport is enabled.
+ */
+namespace wire {
+
+constexpr uint8_t kLegacyVersion = 0;
+constexpr uint8_t kVersion = 1;
+
+constexpr size_t kMachineIdOffset = 0;
+constexpr size_t kChannelOffset = kMachineIdOffset + sizeof(MachineId);
+constexpr size_t kVersionOffset = kChannelOffset + sizeof(Channel);
+constexpr size_t kTypeOffset = kVersionOffset + 1;
+constexpr size_t kPayloadSizeOffset = kTypeOffset + 3;
+constexpr size_t kHeaderSize = kPayloadSizeOffset + sizeof(uint32_t);
+constexpr size_t kLegacyHeaderSize = kVersionOffset;
+
+// A version 0 payload starts with the tag of the type URL field of Any
+constexpr uint8_t kLegacyPayloadTag = 0x0A;
+
+enum class Type : uint8_t {
+  ENVELOPE = 1,
+  INTERNAL_REQUEST,
+  INTERNAL_RESPONSE,
+  API_REQUEST,
+  API_RESPONSE,
+  COALESCED,
+  RING_ATTACH,
+  RING_WAKEUP,
+  RING_DETACH
+};
+
+template <typename T>
+struct TypeOf;
+template <>
+struct TypeOf<internal::Envelope> : std::integral_constant<Type, Type::ENVELOPE> {};
+template <>
+struct TypeOf<internal::Request> : std::integral_constant<Type, Type::INTERNAL_REQUEST> {};
+template <>
+struct TypeOf<internal::Response> : std::integral_constant<Type, Type::INTERNAL_RESPONSE> {};
+template <>
+struct TypeOf<api::Request> : std::integral_constant<Type, Type::API_REQUEST> {};
+template <>
+struct TypeOf<api::Response> : std::integral_constant<Type, Type::API_RESPONSE> {};
+
+template <typename T>
+inline T Read(const char* data, size_t offset) {
+  T value;
+  memcpy(&value, data + offset, sizeof(T));
+  return value;
+}
 
-  auto header_sz = sizeof(MachineId) + sizeof(Channel);
-  zmq::message_t msg(header_sz + any.ByteSizeLong());
-  any.SerializeToArray(msg.data<char>() + header_sz, any.ByteSizeLong());
+template <typename T>
+inline void Write(char* data, size_t offset, T value) {
+  memcpy(data + offset, &value, sizeof(T));
+}
 
+/**
+ * Returns the version of a message or std::nullopt if it is too short or has an unknown version
+ */
+inline std::optional<uint8_t> ReadVersion(const char* data, size_t size) {
+  if (size < kLegacyHeaderSize) {
+    return std::nullopt;
+  }
+  if (size == kLegacyHeaderSize) {
+    // An empty Any
+    return kLegacyVersion;
+  }
+  auto version = Read<uint8_t>(data, kVersionOffset);
+  if (version == kLegacyPayloadTag) {
+    return kLegacyVersion;
+  }
+  if (version != kVersion) {
+    return std::nullopt;
+  }
+  return version;
+}
+
+/**
+ * Writes a version 1 header, except for the sender machine id and receiver channel
+ */
+inline void WriteHeader(char* data, Type type, uint32_t payload_size) {
+  Write<uint8_t>(data, kVersionOffset, kVersion);
+  Write<Type>(data, kTypeOffset, type);
+  Write<uint16_t>(data, kTypeOffset + 1, 0);
+  Write<uint32_t>(data, kPayloadSizeOffset, payload_size);
+}
+
+/**
+ * Returns the type of a version 1 message or std::nullopt if it is not one
+ */
+inline std::optional<Type> ReadType(const char* data, size_t size) {
+  if (size < kHeaderSize || Read<uint8_t>(data, kVersionOffset) != kVersion) {
+    return std::nullopt;
+  }
+  return Read<Type>(data, kTypeOffset);
+}
+
+inline bool IsCoalesced(const char* data, size_t size) { return ReadType(data, size) == Type::COALESCED; }
+
+/**
+ * Calls fn(data, size) on each message of a COALESCED message. Returns false if the message is
+ * malformed, in which case fn is only called on the messages before the malformed part
+ */
+template <typename Fn>
+inline bool ForEachCoalesced(const char* data, size_t size, Fn&& fn) {
+  if (!IsCoalesced(data, size) || Read<uint32_t>(data, kPayloadSizeOffset) != size - kHeaderSize) {
+    return false;
+  }
+  for (size_t offset = kHeaderSize; offset < size;) {
+    auto remaining = size - offset;
+    if (remaining < kHeaderSize || Read<uint8_t>(data + offset, kVersionOffset) != kVersion ||
+        Read<Type>(data + offset, kTypeOffset) == Type::COALESCED) {
+      return false;
+    }
+    auto msg_size = kHeaderSize + Read<uint32_t>(data + offset, kPayloadSizeOffset);
+    if (msg_size > remaining) {
+      return false;
+    }
+    fn(data + offset, msg_size);
+    offset += msg_size;
+  }
+  return true;
+}
+
+}  // namespace wire
+
+/**
+ * Serializes a message in version 1 of the wire format into a buffer of wire::kHeaderSize + payload_size
+ * bytes, where payload_size is what ByteSizeLong last returned for the message
+ */
+template <typename T>
+inline void SerializeProtoTo(char* data, const T& proto, size_t payload_size) {
+  wire::WriteHeader(data, wire::TypeOf<T>::value, payload_size);
+  proto.SerializeWithCachedSizesToArray(reinterpret_cast<uint8_t*>(data) + wire::kHeaderSize);
+}
+
+/**
+ * Serializes a message in the given version of the wire format, leaving the sender machine id and
+ * receiver channel to be filled in with SetAddress
+ */
+template <typename T>
+inline zmq::message_t SerializeProto(const T& proto, uint8_t version = wire::kVersion) {
+  if (version == wire::kLegacyVersion) {
+    google::protobuf::Any any;
+    any.PackFrom(proto);
+    zmq::message_t msg(wire::kLegacyHeaderSize + any.ByteSizeLong());
+    any.SerializeWithCachedSizesToArray(msg.data<uint8_t>() + wire::kLegacyHeaderSize);
+    return msg;
+  }
+
+  auto payload_size = proto.ByteSizeLong();
+  zmq::message_t msg(wire::kHeaderSize + payload_size);
+  SerializeProtoTo(msg.data<char>(), proto, payload_size);
   return msg;
 }
 
-inline void SendAddressedBuffer(zmq::socket_t& socket, zmq::message_t&& msg, MachineId from_machine_id = -1,
-                                Channel to_chan = 0) {
-  auto machine_id_data = msg.data<MachineId>();
-  *machine_id_data = from_machine_id;
+/**
+ * Fills in the header of a buffer made by SerializeProto. The content of a message cannot be modified
+ * once it is shared with zmq::message_t::copy, so this must happen before the buffer is shared
+ */
+inline void SetAddress(char* data, MachineId from_machine_id, Channel to_chan) {
+  wire::Write<MachineId>(data, wire::kMachineIdOffset, from_machine_id);
+  wire::Write<Channel>(data, wire::kChannelOffset, to_chan);
+}
 
-  auto channel_data = reinterpret_cast<Channel*>(machine_id_data + 1);
-  *channel_data = to_chan;
+inline void SetAddress(zmq::message_t& msg, MachineId from_machine_id, Channel to_chan) {
+  SetAddress(msg.data<char>(), from_machine_id, to_chan);
+}
 
+inline void SendAddressedBuffer(zmq::socket_t& socket, zmq::message_t&& msg, MachineId from_machine_id = -1,
+                                Channel to_chan = 0) {
+  SetAddress(msg, from_machine_id, to_chan);
   socket.send(msg, zmq::send_flags::dontwait);
 }
 
 /**
- * Serializes and send proto message. The sent buffer contains
- * <sender machine id> <receiver channel> <proto>
+ * Serializes and send proto message. See the wire namespace for the format of the sent buffer
  */
-inline void SendSerializedProto(zmq::socket_t& socket, const google::protobuf::Message& proto,
-                                MachineId from_machine_id = -1, Channel to_chan = 0) {
-  SendAddressedBuffer(socket, SerializeProto(proto), from_machine_id, to_chan);
+template <typename T>
+inline void SendSerializedProto(zmq::socket_t& socket, const T& proto, MachineId from_machine_id = -1,
+                                Channel to_chan = 0, uint8_t version = wire::kVersion) {
+  SendAddressedBuffer(socket, SerializeProto(proto, version), from_machine_id, to_chan);
 }
 
-inline void SendSerializedProtoWithEmptyDelim(zmq::socket_t& socket, const google::protobuf::Message& proto) {
+template <typename T>
+inline void SendSerializedProtoWithEmptyDelim(zmq::socket_t& socket, const T& proto, uint8_t version = wire::kVersion) {
   socket.send(zmq::message_t{}, zmq::send_flags::sndmore);
-  SendSerializedProto(socket, proto);
+  SendSerializedProto(socket, proto, -1, 0, version);
 }
 
 inline bool ParseMachineId(MachineId& id, const zmq::message_t& msg) {
-  if (msg.size() < sizeof(MachineId)) {
+  if (msg.size() < wire::kChannelOffset) {
     return false;
   }
-  id = *msg.data<MachineId>();
+  id = wire::Read<MachineId>(msg.data<char>(), wire::kMachineIdOffset);
   return true;
 }
 
 inline bool ParseChannel(Channel& chan, const zmq::message_t& msg) {
-  if (msg.size() < sizeof(MachineId) + sizeof(Channel)) {
+  if (msg.size() < wire::kVersionOffset) {
     return false;
   }
-  auto chan_data = reinterpret_cast<const Channel*>(msg.data<MachineId>() + 1);
-  chan = *chan_data;
+  chan = wire::Read<Channel>(msg.data<char>(), wire::kChannelOffset);
   return true;
 }
 
+/**
+ * Parses a message of any known version of the wire format. The version of the message is returned
+ * in version if it is not null
+ */
 template <typename T>
-inline bool DeserializeProto(T& out, const char* data, size_t size) {
-  google::protobuf::Any any;
-  auto header_sz = sizeof(MachineId) + sizeof(Channel);
-  if (size < header_sz) {
+inline bool DeserializeProto(T& out, const char* data, size_t size, uint8_t* version = nullptr) {
+  auto msg_version = wire::ReadVersion(data, size);
+  if (!msg_version.has_value()) {
+    return false;
+  }
+  if (version != nullptr) {
+    *version = msg_version.value();
+  }
+
+  if (msg_version == wire::kLegacyVersion) {
+    google::protobuf::Any any;
+    if (!any.ParseFromArray(data + wire::kLegacyHeaderSize, size - wire::kLegacyHeaderSize)) {
+      return false;
+    }
+    return any.UnpackTo(&out);
+  }
+
+  if (size < wire::kHeaderSize || wire::Read<wire::Type>(data, wire::kTypeOffset) != wire::TypeOf<T>::value) {
     return false;
   }
-  // Skip the machineid and channel part
-  auto proto_data = data + header_sz;
-  auto proto_size = size - header_sz;
-  if (!any.ParseFromArray(proto_data, proto_size)) {
+  auto payload_size = wire::Read<uint32_t>(data, wire::kPayloadSizeOffset);
+  if (payload_size != size - wire::kHeaderSize) {
     return false;
   }
-  return any.UnpackTo(&out);
+  return out.ParseFromArray(data + wire::kHeaderSize, payload_size);
 }
 
 template <typename T>
-inline bool DeserializeProto(T& out, const zmq::message_t& msg) {
-  return DeserializeProto(out, msg.data<char>(), msg.size());
+inline bool DeserializeProto(T& out, const zmq::message_t& msg, uint8_t* version = nullptr) {
+  return DeserializeProto(out, msg.data<char>(), msg.size(), version);
 }
 
 template <typename T>
-inline bool RecvDeserializedProto(zmq::socket_t& socket, T& out, bool dont_wait = false) {
+inline bool RecvDeserializedProto(zmq::socket_t& socket, T& out, bool dont_wait = false, uint8_t* version = nullptr) {
   zmq::message_t msg;
   auto flag = dont_wait ? zmq::recv_flags::dontwait : zmq::recv_flags::none;
   if (!socket.recv(msg, flag)) {
     return false;
   }
-  return DeserializeProto(out, msg);
+  return DeserializeProto(out, msg, version);
 }
 
 template <typename T>
-inline bool RecvDeserializedProtoWithEmptyDelim(zmq::socket_t& socket, T& out, bool dont_wait = false) {
+inline bool RecvDeserializedProtoWithEmptyDelim(zmq::socket_t& socket, T& out, bool dont_wait = false,
+                                                uint8_t* version = nullptr) {
   if (zmq::message_t empty; !socket.recv(empty) || !empty.more()) {
     return false;
   }
-  return RecvDeserializedProto(socket, out, dont_wait);
+  return RecvDeserializedProto(socket, out, dont_wait, version);
 }
 
 }  // namespace slog
\ No newline at end of file
@@ -3,14 +3,13 @@
 #include <queue>
 #include <unordered_map>
 
+#include "common/proto_utils.h"
 #include "common/types.h"
 #include "data_structure/async_log.h"
 #include "proto/internal.pb.h"
 
 namespace slog {
 
-using BatchPtr = std::unique_ptr<internal::Batch>;
-
 class BatchLog {
  public:
   BatchLog();
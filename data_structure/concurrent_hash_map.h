@@ -2,8 +2,8 @@
  * concurrent_hash_map.h
  *
  * This implementation borrows from folly::ConcurrentHashMap the idea of sharding key space
- * into different segments. However, each segment here is only coarsely guarded with a read-write
- * latch as opposed to a more granular approach in the highly-optimized folly::ConcurrentHashMap.
+ * into different segments. Writers of a segment are serialized with a mutex while readers
+ * do not take any lock (see SegmentT).
  *
  * This map should be used in conjuction with shared_ptr because its destructor is not
  * thread-safe. With shared_ptr, the last thread that releases the pointer will be the only
@@ -12,211 +12,541 @@
 #pragma once
 
 #include <atomic>
+#include <algorithm>
+#include <deque>
+#include <limits>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
 
-#include "data_structure/rwlatch.h"
+#include "data_structure/epoch_manager.h"
 
 namespace slog {
 
 namespace concurrent_hash_map {
 
+/**
+ * Number of bytes of a value counted in SegmentStats::value_bytes. A value type can provide a
+ * non-template overload of ValueBytes in its own namespace to be found by argument-dependent lookup
+ */
+template <typename ValueType>
+size_t ValueBytes(const ValueType&) {
+  return 0;
+}
+
+/**
+ * Memory usage and shape of one or more segments
+ */
+struct SegmentStats {
+  size_t num_keys = 0;
+  size_t num_buckets = 0;
+  // Sum of ValueBytes() over all values
+  size_t value_bytes = 0;
+  // Memory taken by the bucket arrays and the nodes, excluding any memory owned by the keys and values
+  size_t index_bytes = 0;
+  // The fields below are only computed when chain lengths are requested
+  size_t num_empty_buckets = 0;
+  size_t max_chain_length = 0;
+};
+
+/**
+ * A node is immutable once it is linked into a segment, except for its next pointer.
+ * Updating a key links a new node in place of the old one.
+ */
 template <typename KeyType, typename ValueType>
 struct NodeT {
-  NodeT() = default;
-
-  NodeT(const NodeT& other) {
-    next = other.next;
-    key = other.key;
-    value = other.value;
-  }
+  NodeT(const KeyType& key, const ValueType& value, NodeT* next) : next(next), key(key), value(value) {}
 
-  NodeT* next{nullptr};
-  KeyType key;
-  ValueType value;
+  std::atomic<NodeT*> next;
+  const KeyType key;
+  const ValueType value;
 };
 
+/**
+ * Readers of a segment never take a lock. Writers are serialized by a mutex and
+ * make the version counter odd while modifying the segment. A reader retries if
+ * the version changed while it was looking up a key (seqlock). Unlinked nodes and
+ * replaced bucket arrays are only freed when no reader can still be accessing them.
+ *
+ * When the segment grows, nodes are not moved to the larger bucket array all at once.
+ * Instead, both arrays are kept and each write operation migrates a bounded number of
+ * buckets from the old array to the new one. Meanwhile, a key is looked up in both.
+ */
 template <typename KeyType, typename ValueType, typename HashFn = std::hash<KeyType>, uint8_t ShardBits = 8>
 class SegmentT {
   using Node = NodeT<KeyType, ValueType>;
 
   static constexpr float kLoadFactor = 1.05;
+  // Number of unlinked objects accumulated before advancing the global epoch
+  static constexpr size_t kRetireBatchSize = 64;
+  // Number of old buckets migrated by each write operation during a rehash
+  static constexpr size_t kMigrationBatchSize = 8;
 
  public:
   /**
    * initial_bucket_count must be a power of 2
    */
   SegmentT(size_t initial_bucket_count = 8)
-      : load_factor_max_size_(static_cast<size_t>(kLoadFactor * initial_bucket_count)), size_(0) {
-    buckets_.reset(Buckets::CreateBuckets(initial_bucket_count));
+      : version_(0),
+        load_factor_max_size_(static_cast<size_t>(kLoadFactor * initial_bucket_count)),
+        size_(0),
+        value_bytes_(0),
+        num_migrated_(0) {
+    buckets_.store(Buckets::CreateBuckets(initial_bucket_count));
+    old_buckets_.store(nullptr);
+  }
+
+  ~SegmentT() {
+    for (auto buckets : {buckets_.load(), old_buckets_.load()}) {
+      if (buckets == nullptr) {
+        continue;
+      }
+      for (size_t i = 0; i < buckets->count; i++) {
+        auto node = buckets->bucket_roots[i].load();
+        while (node) {
+          auto next = node->next.load();
+          delete node;
+          node = next;
+        }
+      }
+      delete buckets;
+    }
+    FreeRetired(pending_);
+    for (auto& retired : retired_) {
+      FreeRetired(retired);
+    }
   }
 
   bool Get(ValueType& res, const KeyType& key) const {
+    return Visit(key, [&res](const ValueType& value) { res = value; });
+  }
+
+  /**
+   * Calls fn(value) on the value of the key in place. fn is called again if a writer modified
+   * the segment in the meantime, so it must only read from the value
+   */
+  template <typename Fn>
+  bool Visit(const KeyType& key, Fn&& fn) const {
     auto h = HashFn{}(key);
-    bool found = false;
 
-    rw_latch_.RLock();
+    EpochManager::Guard guard;
 
-    auto idx = GetIndex(buckets_->count, h);
-    auto node = buckets_->bucket_roots[idx];
-    while (node) {
-      if (key == node->key) {
-        break;
+    for (;;) {
+      auto version = version_.load(std::memory_order_acquire);
+      if (version & 1) {
+        // A writer is modifying this segment
+        std::this_thread::yield();
+        continue;
+      }
+
+      bool found = false;
+      bool changed = false;
+      // The key is in the old buckets if its bucket there has not been migrated yet
+      for (auto buckets : {buckets_.load(std::memory_order_acquire), old_buckets_.load(std::memory_order_acquire)}) {
+        if (buckets == nullptr || found || changed) {
+          break;
+        }
+        auto node = buckets->bucket_roots[GetIndex(buckets->count, h)].load(std::memory_order_acquire);
+        while (node) {
+          if (key == node->key) {
+            // A node is never modified once it is published, so its value can be read in place
+            fn(node->value);
+            found = true;
+            break;
+          }
+          node = node->next.load(std::memory_order_acquire);
+          // Stop early instead of following links that are being rearranged
+          if (version_.load(std::memory_order_acquire) != version) {
+            changed = true;
+            break;
+          }
+        }
+      }
+
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (!changed && version_.load(std::memory_order_relaxed) == version) {
+        return found;
       }
-      node = node->next;
     }
-    if (node) {
-      res = node->value;
-      found = true;
+  }
+
+  bool InsertOrUpdate(const KeyType& key, const ValueType& value) {
+    std::lock_guard<std::mutex> guard(write_mut_);
+    return InsertOrUpdateLocked(key, value);
+  }
+
+  void InsertOrUpdateBatch(const std::vector<const std::pair<KeyType, ValueType>*>& entries) {
+    std::lock_guard<std::mutex> guard(write_mut_);
+    for (auto entry : entries) {
+      InsertOrUpdateLocked(entry->first, entry->second);
+    }
+  }
+
+  /**
+   * Calls fn(i, value, exists) for each pair (i, key) of entries and stores the modified value
+   */
+  template <typename Fn>
+  void ReadModifyWriteBatch(const std::vector<std::pair<size_t, const KeyType*>>& entries, Fn&& fn) {
+    std::lock_guard<std::mutex> guard(write_mut_);
+    for (auto [i, key] : entries) {
+      auto h = HashFn{}(*key);
+      MigrateSome();
+      // The link found here is used for the write as well, so each key is looked up only once
+      auto link = FindLink(*key, h);
+      ValueType value = link != nullptr ? link->load(std::memory_order_relaxed)->value : ValueType();
+      fn(i, value, link != nullptr);
+      InsertOrUpdateAt(link, *key, value, h);
     }
+  }
 
-    rw_latch_.RUnlock();
+  /**
+   * Calls fn(i, value) for each pair (i, key) of entries whose key exists. The modified value is
+   * stored if fn returns true, otherwise the key is erased. Keys that do not exist are skipped
+   */
+  template <typename Fn>
+  void UpdateOrEraseBatch(const std::vector<std::pair<size_t, const KeyType*>>& entries, Fn&& fn) {
+    std::lock_guard<std::mutex> guard(write_mut_);
+    for (auto [i, key] : entries) {
+      auto h = HashFn{}(*key);
+      MigrateSome();
+      auto link = FindLink(*key, h);
+      if (link == nullptr) {
+        continue;
+      }
+      ValueType value = link->load(std::memory_order_relaxed)->value;
+      if (fn(i, value)) {
+        InsertOrUpdateAt(link, *key, value, h);
+      } else {
+        EraseAt(link);
+      }
+    }
+  }
 
-    return found;
+  /**
+   * Brings the bucket of the given hash into the cache. Must be called while holding an EpochManager::Guard
+   */
+  void Prefetch(size_t hash) const {
+    auto buckets = buckets_.load(std::memory_order_acquire);
+    __builtin_prefetch(&buckets->bucket_roots[GetIndex(buckets->count, hash)]);
   }
 
-  bool InsertOrUpdate(const KeyType& key, const ValueType& value) {
+  bool Erase(const KeyType& key) {
     auto h = HashFn{}(key);
 
-    rw_latch_.WLock();
-
-    auto idx = GetIndex(buckets_->count, h);
-    Node* prev = nullptr;
-    bool key_exists = false;
-    auto node = buckets_->bucket_roots[idx];
-    while (node) {
-      if (key == node->key) {
-        key_exists = true;
-        // If key already exists, replace the corresponding
-        // node with a new node containing the new value
-        auto new_node = new Node();
-        new_node->key = key;
-        new_node->value = value;
-        new_node->next = node->next;
-        if (prev) {
-          prev->next = new_node;
-        } else {
-          buckets_->bucket_roots[idx] = new_node;
+    std::lock_guard<std::mutex> guard(write_mut_);
+
+    MigrateSome();
+
+    auto link = FindLink(key, h);
+    if (link == nullptr) {
+      return false;
+    }
+
+    EraseAt(link);
+    return true;
+  }
+
+  /**
+   * Grows the bucket array so that it can hold the given number of keys
+   * without rehashing. This rehashes the whole segment at once.
+   */
+  void Reserve(size_t num_keys) {
+    std::lock_guard<std::mutex> guard(write_mut_);
+
+    FinishMigration();
+
+    auto bucket_count = buckets_.load(std::memory_order_relaxed)->count;
+    auto new_bucket_count = bucket_count;
+    while (static_cast<size_t>(kLoadFactor * new_bucket_count) <= num_keys) {
+      new_bucket_count <<= 1;
+    }
+    if (new_bucket_count > bucket_count) {
+      StartMigration(new_bucket_count);
+      FinishMigration();
+    }
+  }
+
+  /**
+   * The counters are maintained by the writers so they are cheap to get. Computing the chain
+   * lengths walks all buckets while blocking the writers of the segment
+   */
+  SegmentStats Stats(bool chain_lengths) const {
+    std::lock_guard<std::mutex> guard(write_mut_);
+
+    SegmentStats stats;
+    stats.num_keys = size_;
+    stats.num_buckets = buckets_.load(std::memory_order_relaxed)->count;
+    stats.value_bytes = value_bytes_;
+    stats.index_bytes = sizeof(*this) + size_ * sizeof(Node);
+    for (auto buckets : {buckets_.load(std::memory_order_relaxed), old_buckets_.load(std::memory_order_relaxed)}) {
+      if (buckets == nullptr) {
+        continue;
+      }
+      stats.index_bytes += sizeof(Buckets) + buckets->count * sizeof(std::atomic<Node*>);
+    }
+    if (!chain_lengths) {
+      return stats;
+    }
+
+    // While a rehash is in progress, the chains of both bucket arrays are counted
+    for (auto buckets : {buckets_.load(std::memory_order_relaxed), old_buckets_.load(std::memory_order_relaxed)}) {
+      if (buckets == nullptr) {
+        continue;
+      }
+      for (size_t idx = buckets == old_buckets_.load(std::memory_order_relaxed) ? num_migrated_ : 0;
+           idx < buckets->count; idx++) {
+        size_t length = 0;
+        for (auto node = buckets->bucket_roots[idx].load(std::memory_order_relaxed); node;
+             node = node->next.load(std::memory_order_relaxed)) {
+          length++;
         }
-        delete node;
+        if (length == 0 && buckets == buckets_.load(std::memory_order_relaxed)) {
+          stats.num_empty_buckets++;
+        }
+        stats.max_chain_length = std::max(stats.max_chain_length, length);
+      }
+    }
+    return stats;
+  }
 
-        break;
+  template <typename Fn>
+  void ForEach(Fn&& fn) const {
+    std::lock_guard<std::mutex> guard(write_mut_);
+
+    for (auto buckets : {buckets_.load(std::memory_order_relaxed), old_buckets_.load(std::memory_order_relaxed)}) {
+      if (buckets == nullptr) {
+        continue;
+      }
+      for (size_t idx = 0; idx < buckets->count; idx++) {
+        for (auto node = buckets->bucket_roots[idx].load(std::memory_order_relaxed); node;
+             node = node->next.load(std::memory_order_relaxed)) {
+          fn(node->key, node->value);
+        }
       }
-      prev = node;
-      node = node->next;
     }
+  }
+
+ private:
+  struct Buckets {
+    static Buckets* CreateBuckets(size_t num_buckets) {
+      auto buckets = new Buckets();
+      buckets->count = num_buckets;
+      buckets->bucket_roots = std::make_unique<std::atomic<Node*>[]>(num_buckets);
+      for (size_t i = 0; i < num_buckets; i++) {
+        buckets->bucket_roots[i].store(nullptr, std::memory_order_relaxed);
+      }
+      return buckets;
+    }
+
+    size_t count;
+    std::unique_ptr<std::atomic<Node*>[]> bucket_roots;
+  };
 
-    if (!key_exists) {
-      // If key does not exist, at new node to the bucket
-      auto new_node = new Node();
-      new_node->key = key;
-      new_node->value = value;
-      new_node->next = buckets_->bucket_roots[idx];
-      buckets_->bucket_roots[idx] = new_node;
+  struct Retired {
+    std::vector<Node*> nodes;
+    std::vector<Buckets*> buckets;
+    uint64_t epoch = 0;
+  };
+
+  // Must hold lock
+  bool InsertOrUpdateLocked(const KeyType& key, const ValueType& value) {
+    auto h = HashFn{}(key);
+
+    MigrateSome();
+
+    return InsertOrUpdateAt(FindLink(key, h), key, value, h);
+  }
+
+  // Must hold lock. link must be the result of FindLink(key, h) with no migration step in between
+  bool InsertOrUpdateAt(std::atomic<Node*>* link, const KeyType& key, const ValueType& value, size_t h) {
+    if (link != nullptr) {
+      // If key already exists, replace the corresponding
+      // node with a new node containing the new value
+      auto node = link->load(std::memory_order_relaxed);
+      auto new_node = new Node(key, value, node->next.load(std::memory_order_relaxed));
+      BeginWrite();
+      link->store(new_node, std::memory_order_release);
+      EndWrite();
+
+      value_bytes_ += ValueBytes(value) - ValueBytes(node->value);
+      Retire(node);
+      return true;
     }
 
+    // If key does not exist, at new node to the bucket
+    auto buckets = buckets_.load(std::memory_order_relaxed);
+    auto root = &buckets->bucket_roots[GetIndex(buckets->count, h)];
+    auto new_node = new Node(key, value, root->load(std::memory_order_relaxed));
+    BeginWrite();
+    root->store(new_node, std::memory_order_release);
+    EndWrite();
+
     size_++;
+    value_bytes_ += ValueBytes(value);
     if (size_ >= load_factor_max_size_) {
-      Rehash();
+      // Inserts outpacing the migration would only happen with a tiny batch size
+      FinishMigration();
+      StartMigration(buckets_.load(std::memory_order_relaxed)->count << 1);
     }
 
-    rw_latch_.WUnlock();
-
-    return key_exists;
+    return false;
   }
 
-  bool Erase(const KeyType& key) {
-    auto h = HashFn{}(key);
+  // Must hold lock. link must be the result of FindLink with no migration step in between
+  void EraseAt(std::atomic<Node*>* link) {
+    auto node = link->load(std::memory_order_relaxed);
+    BeginWrite();
+    link->store(node->next.load(std::memory_order_relaxed), std::memory_order_release);
+    EndWrite();
 
-    rw_latch_.WLock();
-
-    bool key_exists = false;
-    auto idx = GetIndex(buckets_->count, h);
-    Node* prev = nullptr;
-    auto node = buckets_->bucket_roots[idx];
-    while (node) {
-      if (key == node->key) {
-        key_exists = true;
-        if (prev) {
-          prev->next = node->next;
-        } else {
-          buckets_->bucket_roots[idx] = node->next;
-        }
-        delete node;
+    size_--;
+    value_bytes_ -= ValueBytes(node->value);
+    Retire(node);
+  }
+
+  // Must hold lock. Returns the link pointing to the node of the given key or nullptr if not found
+  std::atomic<Node*>* FindLink(const KeyType& key, size_t hash) {
+    for (auto buckets : {buckets_.load(std::memory_order_relaxed), old_buckets_.load(std::memory_order_relaxed)}) {
+      if (buckets == nullptr) {
         break;
       }
-      prev = node;
-      node = node->next;
+      auto link = &buckets->bucket_roots[GetIndex(buckets->count, hash)];
+      for (auto node = link->load(std::memory_order_relaxed); node; node = link->load(std::memory_order_relaxed)) {
+        if (key == node->key) {
+          return link;
+        }
+        link = &node->next;
+      }
     }
-
-    rw_latch_.WUnlock();
-
-    return key_exists;
+    return nullptr;
   }
 
- private:
   // Must hold lock
   static uint64_t GetIndex(size_t nbuckets, size_t hash) { return (hash >> ShardBits) & (nbuckets - 1); }
 
   // Must hold lock
-  void Rehash() {
-    auto new_bucket_count = buckets_->count << 1;
+  void BeginWrite() {
+    version_.store(version_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+  }
+
+  // Must hold lock
+  void EndWrite() { version_.store(version_.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+  // Must hold lock and no migration must be in progress. Installs an empty
+  // bucket array with the given size in front of the current one
+  void StartMigration(size_t new_bucket_count) {
     auto new_buckets = Buckets::CreateBuckets(new_bucket_count);
 
-    for (size_t idx = 0; idx < buckets_->count; idx++) {
-      auto node = buckets_->bucket_roots[idx];
-      if (node == nullptr) {
-        continue;
-      }
+    BeginWrite();
+    old_buckets_.store(buckets_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    buckets_.store(new_buckets, std::memory_order_release);
+    EndWrite();
+
+    num_migrated_ = 0;
+    load_factor_max_size_ = static_cast<size_t>(kLoadFactor * new_bucket_count);
+  }
+
+  // Must hold lock. Moves the nodes of at most max_buckets old buckets to the new bucket array
+  void Migrate(size_t max_buckets) {
+    auto old_buckets = old_buckets_.load(std::memory_order_relaxed);
+    if (old_buckets == nullptr) {
+      return;
+    }
+    auto buckets = buckets_.load(std::memory_order_relaxed);
+    auto end = num_migrated_ + std::min(old_buckets->count - num_migrated_, max_buckets);
 
+    BeginWrite();
+    for (; num_migrated_ < end; num_migrated_++) {
+      auto& old_root = old_buckets->bucket_roots[num_migrated_];
+      auto node = old_root.load(std::memory_order_relaxed);
       while (node) {
-        auto next_node = node->next;
+        auto next_node = node->next.load(std::memory_order_relaxed);
 
-        auto idx = GetIndex(new_bucket_count, HashFn{}(node->key));
-        node->next = new_buckets->bucket_roots[idx];
-        new_buckets->bucket_roots[idx] = node;
+        auto& new_root = buckets->bucket_roots[GetIndex(buckets->count, HashFn{}(node->key))];
+        node->next.store(new_root.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        new_root.store(node, std::memory_order_relaxed);
 
         node = next_node;
       }
-      buckets_->bucket_roots[idx] = nullptr;
+      old_root.store(nullptr, std::memory_order_relaxed);
+    }
+    if (num_migrated_ == old_buckets->count) {
+      old_buckets_.store(nullptr, std::memory_order_relaxed);
+    }
+    EndWrite();
+
+    if (old_buckets_.load(std::memory_order_relaxed) == nullptr) {
+      pending_.buckets.push_back(old_buckets);
+      ReclaimRetired();
     }
-    buckets_.reset(new_buckets);
-    load_factor_max_size_ = static_cast<size_t>(kLoadFactor * buckets_->count);
   }
 
-  struct Buckets {
-    static Buckets* CreateBuckets(size_t num_buckets) {
-      auto buckets = new Buckets();
-      buckets->count = num_buckets;
-      buckets->bucket_roots = std::make_unique<Node*[]>(num_buckets);
-      return buckets;
+  // Must hold lock
+  void MigrateSome() { Migrate(kMigrationBatchSize); }
+
+  // Must hold lock
+  void FinishMigration() { Migrate(std::numeric_limits<size_t>::max()); }
+
+  // Must hold lock
+  void Retire(Node* node) {
+    pending_.nodes.push_back(node);
+    if (pending_.nodes.size() >= kRetireBatchSize) {
+      ReclaimRetired();
     }
+  }
 
-    ~Buckets() {
-      for (size_t i = 0; i < count; i++) {
-        auto node = bucket_roots[i];
-        while (node) {
-          auto next = node->next;
-          delete node;
-          node = next;
-        }
-      }
+  // Must hold lock
+  void ReclaimRetired() {
+    auto& epoch_manager = EpochManager::Instance();
+    pending_.epoch = epoch_manager.Advance();
+    retired_.push_back(std::move(pending_));
+    pending_ = Retired();
+    while (!retired_.empty() && epoch_manager.IsSafeToFree(retired_.front().epoch)) {
+      FreeRetired(retired_.front());
+      retired_.pop_front();
     }
+  }
 
-    size_t count;
-    std::unique_ptr<Node*[]> bucket_roots;
-  };
+  static void FreeRetired(Retired& retired) {
+    for (auto node : retired.nodes) {
+      delete node;
+    }
+    for (auto buckets : retired.buckets) {
+      delete buckets;
+    }
+  }
+
+  std::atomic<uint64_t> version_;
+  std::atomic<Buckets*> buckets_;
+  // Buckets being migrated to buckets_ or nullptr if no rehash is in progress
+  std::atomic<Buckets*> old_buckets_;
 
-  mutable bustub::ReaderWriterLatch rw_latch_;
-  std::unique_ptr<Buckets> buckets_;
+  mutable std::mutex write_mut_;
   size_t load_factor_max_size_;
   size_t size_;
+  size_t value_bytes_;
+  // Number of old buckets that have been migrated
+  size_t num_migrated_;
+  // Objects unlinked since the last time the global epoch was advanced
+  Retired pending_;
+  // Objects waiting for readers to move past their retire epochs, in increasing order of epoch
+  std::deque<Retired> retired_;
 };
 
 }  // namespace concurrent_hash_map
 
-template <typename KeyType, typename ValueType, typename HashFn = std::hash<KeyType>, uint8_t ShardBits = 8>
+/**
+ * SegmentImpl selects the layout of a segment. The default is SegmentT, which chains
+ * separately allocated nodes. See open_addressing_segment.h for an alternative.
+ */
+template <typename KeyType, typename ValueType, typename HashFn = std::hash<KeyType>, uint8_t ShardBits = 8,
+          template <typename, typename, typename, uint8_t> class SegmentImpl = concurrent_hash_map::SegmentT>
 class ConcurrentHashMap {
-  using Segment = concurrent_hash_map::SegmentT<KeyType, ValueType, HashFn, ShardBits>;
+  using Segment = SegmentImpl<KeyType, ValueType, HashFn, ShardBits>;
 
  public:
   ConcurrentHashMap() {
@@ -239,17 +569,177 @@ class ConcurrentHashMap {
     return EnsureSegment(idx)->Get(res, key);
   }
 
+  /**
+   * Calls fn(value) on the value of the key without copying it. Returns false if the key
+   * does not exist. fn may be called more than once so it must only read from the value
+   */
+  template <typename Fn>
+  bool Visit(const KeyType& key, Fn&& fn) const {
+    auto idx = PickSegment(key);
+    return EnsureSegment(idx)->Visit(key, std::forward<Fn>(fn));
+  }
+
   bool InsertOrUpdate(const KeyType& key, const ValueType& value) {
     auto idx = PickSegment(key);
     return EnsureSegment(idx)->InsertOrUpdate(key, value);
   }
 
+  /**
+   * Looks up many keys at once. The buckets of all keys are prefetched before any of them is read
+   */
+  void MultiGet(const std::vector<const KeyType*>& keys, std::vector<std::optional<ValueType>>& results) const {
+    results.clear();
+    results.resize(keys.size());
+    MultiVisit(keys, [&results](size_t i, const ValueType& value) { results[i] = value; });
+  }
+
+  /**
+   * Like MultiGet but calls fn(index of the key, value) in place for each key that exists instead of
+   * copying the values. fn may be called more than once for the same key so it must only read from the value
+   */
+  template <typename Fn>
+  void MultiVisit(const std::vector<const KeyType*>& keys, Fn&& fn) const {
+    EpochManager::Guard guard;
+
+    for (auto key : keys) {
+      auto h = HashFn{}(*key);
+      EnsureSegment(h & (NumShards - 1))->Prefetch(h);
+    }
+
+    for (size_t i = 0; i < keys.size(); i++) {
+      Visit(*keys[i], [&fn, i](const ValueType& value) { fn(i, value); });
+    }
+  }
+
+  /**
+   * For each key, calls fn(index of the key, value, whether the key exists) with the value of the
+   * key, or a default-constructed value if it does not exist, and stores the modified value.
+   * Each segment is write-locked only once.
+   */
+  template <typename Fn>
+  void ReadModifyWrite(const std::vector<const KeyType*>& keys, Fn&& fn) {
+    auto entries_per_segment = GroupBySegment(keys);
+    for (uint64_t i = 0; i < NumShards; i++) {
+      if (!entries_per_segment[i].empty()) {
+        EnsureSegment(i)->ReadModifyWriteBatch(entries_per_segment[i], fn);
+      }
+    }
+  }
+
+  /**
+   * For each key that exists, calls fn(index of the key, value) and stores the modified value if fn
+   * returns true or erases the key otherwise. Keys that do not exist are not inserted.
+   * Each segment is write-locked only once.
+   */
+  template <typename Fn>
+  void UpdateOrErase(const std::vector<const KeyType*>& keys, Fn&& fn) {
+    auto entries_per_segment = GroupBySegment(keys);
+    for (uint64_t i = 0; i < NumShards; i++) {
+      if (!entries_per_segment[i].empty()) {
+        EnsureSegment(i)->UpdateOrEraseBatch(entries_per_segment[i], fn);
+      }
+    }
+  }
+
+  /**
+   * Inserts or updates many entries while write-locking each segment only once
+   */
+  void InsertOrUpdateBatch(const std::vector<std::pair<KeyType, ValueType>>& entries) {
+    std::vector<std::vector<const std::pair<KeyType, ValueType>*>> entries_per_segment(NumShards);
+    for (const auto& entry : entries) {
+      entries_per_segment[PickSegment(entry.first)].push_back(&entry);
+    }
+    for (uint64_t i = 0; i < NumShards; i++) {
+      if (!entries_per_segment[i].empty()) {
+        EnsureSegment(i)->InsertOrUpdateBatch(entries_per_segment[i]);
+      }
+    }
+  }
+
   bool Erase(const KeyType& key) {
     auto idx = PickSegment(key);
     return EnsureSegment(idx)->Erase(key);
   }
 
+  /**
+   * Presizes all segments for the given total number of keys, assuming that keys
+   * are spread evenly across segments, so that inserting them does not rehash
+   */
+  void Reserve(size_t num_keys) {
+    auto num_keys_per_segment = (num_keys + NumShards - 1) / NumShards;
+    for (uint64_t i = 0; i < NumShards; i++) {
+      EnsureSegment(i)->Reserve(num_keys_per_segment);
+    }
+  }
+
+  /**
+   * Returns the stats summed over all segments. The maximum chain length is the maximum over all
+   * segments. If per_segment is not null, it receives the stats of each segment that has been
+   * created, including their chain lengths
+   */
+  concurrent_hash_map::SegmentStats Stats(std::vector<concurrent_hash_map::SegmentStats>* per_segment = nullptr) const {
+    concurrent_hash_map::SegmentStats total;
+    if (per_segment != nullptr) {
+      per_segment->clear();
+    }
+    for (uint64_t i = 0; i < NumShards; i++) {
+      auto segment = segments_[i].load();
+      if (segment == nullptr) {
+        continue;
+      }
+      auto stats = segment->Stats(per_segment != nullptr);
+      total.num_keys += stats.num_keys;
+      total.num_buckets += stats.num_buckets;
+      total.value_bytes += stats.value_bytes;
+      total.index_bytes += stats.index_bytes;
+      total.num_empty_buckets += stats.num_empty_buckets;
+      total.max_chain_length = std::max(total.max_chain_length, stats.max_chain_length);
+      if (per_segment != nullptr) {
+        per_segment->push_back(stats);
+      }
+    }
+    total.index_bytes += sizeof(*this);
+    return total;
+  }
+
+  /**
+   * Calls fn(key, value) on every entry. Writers of each segment are blocked while it
+   * is being visited so entries modified concurrently may or may not be visited.
+   */
+  template <typename Fn>
+  void ForEach(Fn&& fn) const {
+    for (uint64_t i = 0; i < NumShards; i++) {
+      auto segment = segments_[i].load();
+      if (segment) {
+        segment->ForEach(fn);
+      }
+    }
+  }
+
+  /**
+   * Like ForEach but only visits the entries of one segment, so that a pass over all
+   * entries can be split into num_segments() steps
+   */
+  template <typename Fn>
+  void ForEachInSegment(uint64_t idx, Fn&& fn) const {
+    auto segment = segments_[idx].load();
+    if (segment) {
+      segment->ForEach(fn);
+    }
+  }
+
+  static constexpr uint64_t num_segments() { return NumShards; }
+
  private:
+  std::vector<std::vector<std::pair<size_t, const KeyType*>>> GroupBySegment(
+      const std::vector<const KeyType*>& keys) const {
+    std::vector<std::vector<std::pair<size_t, const KeyType*>>> entries_per_segment(NumShards);
+    for (size_t i = 0; i < keys.size(); i++) {
+      entries_per_segment[PickSegment(*keys[i])].emplace_back(i, keys[i]);
+    }
+    return entries_per_segment;
+  }
+
   uint64_t PickSegment(const KeyType& key) const {
     auto h = HashFn{}(key);
     return h & (NumShards - 1);
@@ -0,0 +1,199 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <new>
+
+namespace slog {
+
+/**
+ * An ordered set of keys. Readers never take a lock while writers are serialized by a mutex.
+ *
+ * Nodes are never unlinked until the list is destroyed. Erasing a key only marks its node
+ * as absent so that readers can traverse the list without any memory reclamation, and a
+ * key that is inserted again reuses its node. This suits sets whose keys rarely go away,
+ * such as the keys of a storage.
+ */
+template <typename KeyType, typename Compare = std::less<KeyType>>
+class ConcurrentSkipList {
+  static constexpr int kMaxHeight = 24;
+  // Each level has 1 / kBranching of the nodes of the level below
+  static constexpr uint32_t kBranching = 4;
+
+  // The links of a node are allocated right after it so that following a link does not incur another cache miss
+  struct Node {
+    static Node* New(const KeyType& key, int height) {
+      auto mem = ::operator new(sizeof(Node) + (height - 1) * sizeof(std::atomic<Node*>));
+      auto node = new (mem) Node(key);
+      for (int i = 0; i < height; i++) {
+        new (&node->next[i]) std::atomic<Node*>(nullptr);
+      }
+      return node;
+    }
+
+    static void Delete(Node* node) {
+      node->~Node();
+      ::operator delete(node);
+    }
+
+    const KeyType key;
+    std::atomic<bool> present;
+    // Has as many elements as the height of the node
+    std::atomic<Node*> next[1];
+
+   private:
+    explicit Node(const KeyType& key) : key(key), present(true) {}
+  };
+
+ public:
+  ConcurrentSkipList()
+      : head_(Node::New(KeyType(), kMaxHeight)),
+        height_(1),
+        size_(0),
+        memory_bytes_(sizeof(*this) + NodeBytes(kMaxHeight)),
+        random_state_(0x2545F491) {}
+
+  ~ConcurrentSkipList() {
+    auto node = head_;
+    while (node) {
+      auto next = node->next[0].load();
+      Node::Delete(node);
+      node = next;
+    }
+  }
+
+  ConcurrentSkipList(const ConcurrentSkipList&) = delete;
+  ConcurrentSkipList& operator=(const ConcurrentSkipList&) = delete;
+
+  /**
+   * Returns true if the key was not in the set
+   */
+  bool Insert(const KeyType& key) {
+    std::lock_guard<std::mutex> guard(write_mut_);
+
+    Node* prev[kMaxHeight];
+    auto node = FindGreaterOrEqual(key, prev);
+    if (node != nullptr && !Compare{}(key, node->key)) {
+      if (node->present.load(std::memory_order_relaxed)) {
+        return false;
+      }
+      node->present.store(true, std::memory_order_release);
+      size_++;
+      return true;
+    }
+
+    auto height = RandomHeight();
+    auto cur_height = height_.load(std::memory_order_relaxed);
+    for (int i = cur_height; i < height; i++) {
+      prev[i] = head_;
+    }
+
+    node = Node::New(key, height);
+    memory_bytes_ += NodeBytes(height);
+    // Linking from the bottom up means that a node reachable from a level is reachable from all levels below
+    for (int i = 0; i < height; i++) {
+      node->next[i].store(prev[i]->next[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+      prev[i]->next[i].store(node, std::memory_order_release);
+    }
+    if (height > cur_height) {
+      height_.store(height, std::memory_order_release);
+    }
+    size_++;
+    return true;
+  }
+
+  /**
+   * Returns true if the key was in the set
+   */
+  bool Erase(const KeyType& key) {
+    std::lock_guard<std::mutex> guard(write_mut_);
+
+    auto node = FindGreaterOrEqual(key, nullptr);
+    if (node == nullptr || Compare{}(key, node->key) || !node->present.load(std::memory_order_relaxed)) {
+      return false;
+    }
+    node->present.store(false, std::memory_order_release);
+    size_--;
+    return true;
+  }
+
+  bool Contains(const KeyType& key) const {
+    auto node = FindGreaterOrEqual(key, nullptr);
+    return node != nullptr && !Compare{}(key, node->key) && node->present.load(std::memory_order_acquire);
+  }
+
+  /**
+   * Calls fn(key) for each key in [start, end) in order until fn returns false. Keys
+   * inserted or erased during the scan may or may not be seen.
+   */
+  template <typename Fn>
+  void Scan(const KeyType& start, const KeyType& end, Fn&& fn) const {
+    for (auto node = FindGreaterOrEqual(start, nullptr); node != nullptr && Compare{}(node->key, end);
+         node = node->next[0].load(std::memory_order_acquire)) {
+      if (node->present.load(std::memory_order_acquire) && !fn(node->key)) {
+        break;
+      }
+    }
+  }
+
+  size_t size() const {
+    std::lock_guard<std::mutex> guard(write_mut_);
+    return size_;
+  }
+
+  // Memory taken by the list and its nodes, including the nodes of erased keys but excluding any
+  // memory owned by the keys
+  size_t memory_bytes() const {
+    std::lock_guard<std::mutex> guard(write_mut_);
+    return memory_bytes_;
+  }
+
+ private:
+  static size_t NodeBytes(int height) { return sizeof(Node) + (height - 1) * sizeof(std::atomic<Node*>); }
+
+  // Returns the first node whose key is not less than the given key. If prev is not null, it
+  // is filled with the last node before that at each level. Must hold the lock if prev is not null
+  Node* FindGreaterOrEqual(const KeyType& key, Node** prev) const {
+    auto node = head_;
+    for (int level = height_.load(std::memory_order_acquire) - 1;; level--) {
+      auto next = node->next[level].load(std::memory_order_acquire);
+      while (next != nullptr && Compare{}(next->key, key)) {
+        node = next;
+        next = node->next[level].load(std::memory_order_acquire);
+      }
+      if (prev != nullptr) {
+        prev[level] = node;
+      }
+      if (level == 0) {
+        return next;
+      }
+    }
+  }
+
+  // Must hold lock
+  int RandomHeight() {
+    int height = 1;
+    while (height < kMaxHeight && NextRandom() % kBranching == 0) {
+      height++;
+    }
+    return height;
+  }
+
+  // Must hold lock
+  uint32_t NextRandom() {
+    random_state_ ^= random_state_ << 13;
+    random_state_ ^= random_state_ >> 17;
+    random_state_ ^= random_state_ << 5;
+    return random_state_;
+  }
+
+  Node* const head_;
+  std::atomic<int> height_;
+  size_t size_;
+  size_t memory_bytes_;
+  uint32_t random_state_;
+  mutable std::mutex write_mut_;
+};
+
+}  // namespace slog
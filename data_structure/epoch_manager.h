@@ -0,0 +1,131 @@
+/**
+ * epoch_manager.h
+ *
+ * Epoch-based reclamation for data structures whose readers do not take any lock.
+ *
+ * A reader pins the current global epoch for the duration of its access. A writer
+ * that unlinks an object from a data structure advances the global epoch and
+ * remembers the new epoch as the retire epoch of the object. The object can be
+ * freed once every pinned epoch is at least its retire epoch, because readers that
+ * pinned such epochs started after the object had become unreachable.
+ */
+#pragma once
+
+#include <glog/logging.h>
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+
+namespace slog {
+
+class EpochManager {
+  struct Slot;
+  struct ThreadSlot;
+
+ public:
+  static constexpr uint64_t kNotPinned = std::numeric_limits<uint64_t>::max();
+
+  static EpochManager& Instance() {
+    static EpochManager instance;
+    return instance;
+  }
+
+  /**
+   * Pins the current epoch for the calling thread until destruction. Guards can be nested.
+   */
+  class Guard {
+   public:
+    Guard() : slot_(EpochManager::Instance().ThisThreadSlot()) {
+      if (slot_.depth++ == 0) {
+        EpochManager::Instance().Pin(*slot_.slot);
+      }
+    }
+
+    ~Guard() {
+      if (--slot_.depth == 0) {
+        slot_.slot->epoch.store(kNotPinned, std::memory_order_release);
+      }
+    }
+
+    Guard(const Guard&) = delete;
+    Guard& operator=(const Guard&) = delete;
+
+   private:
+    ThreadSlot& slot_;
+  };
+
+  /**
+   * Advances the global epoch. Must be called after the object to be retired
+   * has been unlinked.
+   *
+   * @return The retire epoch of the object
+   */
+  uint64_t Advance() { return global_epoch_.fetch_add(1, std::memory_order_seq_cst) + 1; }
+
+  /**
+   * @return true if an object retired at the given epoch can no longer be accessed by any reader
+   */
+  bool IsSafeToFree(uint64_t retire_epoch) const {
+    auto num_slots = num_slots_.load(std::memory_order_seq_cst);
+    for (size_t i = 0; i < num_slots; i++) {
+      if (slots_[i].epoch.load(std::memory_order_seq_cst) < retire_epoch) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+ private:
+  static constexpr size_t kMaxThreads = 1024;
+
+  struct alignas(64) Slot {
+    std::atomic<uint64_t> epoch{kNotPinned};
+    std::atomic<bool> in_use{false};
+  };
+
+  struct ThreadSlot {
+    ThreadSlot(Slot* slot) : slot(slot), depth(0) {}
+    ~ThreadSlot() { slot->in_use.store(false, std::memory_order_release); }
+    Slot* slot;
+    int depth;
+  };
+
+  EpochManager() = default;
+
+  ThreadSlot& ThisThreadSlot() {
+    thread_local ThreadSlot thread_slot(AcquireSlot());
+    return thread_slot;
+  }
+
+  Slot* AcquireSlot() {
+    for (size_t i = 0; i < kMaxThreads; i++) {
+      bool in_use = false;
+      if (!slots_[i].in_use.load(std::memory_order_relaxed) && slots_[i].in_use.compare_exchange_strong(in_use, true)) {
+        // Only the slots below this mark need to be checked for pinned epochs
+        auto num_slots = num_slots_.load();
+        while (num_slots < i + 1 && !num_slots_.compare_exchange_weak(num_slots, i + 1)) {
+        }
+        return &slots_[i];
+      }
+    }
+    LOG(FATAL) << "Too many threads are accessing epoch-protected data structures";
+    return nullptr;
+  }
+
+  void Pin(Slot& slot) {
+    // Publish the pinned epoch and make sure that the global epoch had not moved on in the
+    // meantime, so that no writer could have missed this pin when checking IsSafeToFree
+    uint64_t epoch;
+    do {
+      epoch = global_epoch_.load(std::memory_order_seq_cst);
+      slot.epoch.store(epoch, std::memory_order_seq_cst);
+    } while (global_epoch_.load(std::memory_order_seq_cst) != epoch);
+  }
+
+  alignas(64) std::atomic<uint64_t> global_epoch_{1};
+  std::atomic<size_t> num_slots_{0};
+  Slot slots_[kMaxThreads];
+};
+
+}  // namespace slog
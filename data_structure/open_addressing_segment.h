@@ -0,0 +1,444 @@
+/**
+ * open_addressing_segment.h
+ *
+ * An alternative segment layout for ConcurrentHashMap. Instead of chaining separately
+ * allocated nodes, keys and values are stored inline in a flat slot array and found
+ * by open addressing, in the style of Abseil's SwissTable:
+ *
+ *  - Slots are probed in groups of 16. Each slot has a control byte holding either
+ *    a 7-bit fingerprint of the hash of its key or a marker for an empty or deleted slot.
+ *  - A lookup compares the fingerprint against the 16 control bytes of a group at once
+ *    (with SSE2 if available) and only compares the keys of matching slots.
+ *  - Updating an existing key assigns the new value in place, without any allocation.
+ *
+ * To use it:
+ *
+ *    ConcurrentHashMap<K, V, std::hash<K>, 8, concurrent_hash_map::OpenAddressingSegmentT>
+ *
+ * Writers are serialized with a latch. If both the key and the value types are trivially
+ * copyable, readers do not take any lock and instead validate their reads against a
+ * version counter like the chained segment. Otherwise, copying a value could observe it
+ * half-assigned, so readers share the latch with each other instead. The latch is a
+ * std::shared_mutex by default and can be replaced by any latch of rwlatch.h:
+ *
+ *    ConcurrentHashMap<K, V, std::hash<K>, 8, concurrent_hash_map::WithLatch<SpinRWLatch>::OpenAddressingSegmentT>
+ */
+#pragma once
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <atomic>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "data_structure/epoch_manager.h"
+#include "data_structure/rwlatch.h"
+
+// Optimistic readers may read slots while they are being modified but discard what they
+// read if the segment version has changed in the meantime
+#if defined(__has_feature)
+#if __has_feature(thread_sanitizer)
+#define SLOG_OPTIMISTIC_READ __attribute__((no_sanitize("thread")))
+#endif
+#elif defined(__SANITIZE_THREAD__)
+#define SLOG_OPTIMISTIC_READ __attribute__((no_sanitize("thread")))
+#endif
+#ifndef SLOG_OPTIMISTIC_READ
+#define SLOG_OPTIMISTIC_READ
+#endif
+
+namespace slog {
+
+namespace concurrent_hash_map {
+
+template <typename KeyType, typename ValueType, typename HashFn, uint8_t ShardBits, typename Latch>
+class BasicOpenAddressingSegment {
+  static constexpr bool kOptimisticReads =
+      std::is_trivially_copyable_v<KeyType> && std::is_trivially_copyable_v<ValueType>;
+
+  static constexpr size_t kGroupSize = 16;
+  static constexpr uint8_t kEmpty = 0x80;
+  static constexpr uint8_t kDeleted = 0xFE;
+  // A slot is full iff the highest bit of its control byte is 0
+  static constexpr uint8_t kFingerprintMask = 0x7F;
+
+  struct Slot {
+    Slot(const KeyType& key, const ValueType& value) : key(key), value(value) {}
+    KeyType key;
+    ValueType value;
+  };
+
+  struct Table {
+    Table(size_t num_groups) : num_groups(num_groups) {
+      auto capacity = num_groups * kGroupSize;
+      ctrl = static_cast<uint8_t*>(::operator new(capacity, std::align_val_t(kGroupSize)));
+      memset(ctrl, kEmpty, capacity);
+      slots = static_cast<Slot*>(::operator new(capacity * sizeof(Slot), std::align_val_t(alignof(Slot))));
+    }
+
+    ~Table() {
+      for (size_t i = 0; i < capacity(); i++) {
+        if (IsFull(ctrl[i])) {
+          slots[i].~Slot();
+        }
+      }
+      ::operator delete(slots, std::align_val_t(alignof(Slot)));
+      ::operator delete(ctrl, std::align_val_t(kGroupSize));
+    }
+
+    size_t capacity() const { return num_groups * kGroupSize; }
+
+    const size_t num_groups;
+    uint8_t* ctrl;
+    Slot* slots;
+  };
+
+ public:
+  /**
+   * initial_bucket_count is rounded up to a power-of-2 multiple of the group size
+   */
+  BasicOpenAddressingSegment(size_t initial_bucket_count = kGroupSize) : version_(0), size_(0), num_deleted_(0) {
+    size_t num_groups = 1;
+    while (num_groups * kGroupSize < initial_bucket_count) {
+      num_groups <<= 1;
+    }
+    table_.store(new Table(num_groups));
+  }
+
+  ~BasicOpenAddressingSegment() {
+    delete table_.load();
+    for (auto& retired : retired_) {
+      delete retired.second;
+    }
+  }
+
+  bool Get(ValueType& res, const KeyType& key) const {
+    return Visit(key, [&res](const ValueType& value) { res = value; });
+  }
+
+  template <typename Fn>
+  SLOG_OPTIMISTIC_READ bool Visit(const KeyType& key, Fn&& fn) const {
+    auto h = Mix(HashFn{}(key));
+
+    if constexpr (kOptimisticReads) {
+      EpochManager::Guard guard;
+      for (;;) {
+        auto version = version_.load(std::memory_order_acquire);
+        if (version & 1) {
+          // A writer is modifying this segment
+          std::this_thread::yield();
+          continue;
+        }
+
+        auto table = table_.load(std::memory_order_acquire);
+        auto i = Find(*table, key, h);
+        if (i != kNotFound) {
+          fn(table->slots[i].value);
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (version_.load(std::memory_order_relaxed) == version) {
+          return i != kNotFound;
+        }
+      }
+    } else {
+      std::shared_lock<Latch> lock(mut_);
+      auto table = table_.load(std::memory_order_relaxed);
+      auto i = Find(*table, key, h);
+      if (i == kNotFound) {
+        return false;
+      }
+      fn(table->slots[i].value);
+      return true;
+    }
+  }
+
+  bool InsertOrUpdate(const KeyType& key, const ValueType& value) {
+    std::unique_lock<Latch> lock(mut_);
+    return InsertOrUpdateLocked(key, value);
+  }
+
+  void InsertOrUpdateBatch(const std::vector<const std::pair<KeyType, ValueType>*>& entries) {
+    std::unique_lock<Latch> lock(mut_);
+    for (auto entry : entries) {
+      InsertOrUpdateLocked(entry->first, entry->second);
+    }
+  }
+
+  template <typename Fn>
+  void ReadModifyWriteBatch(const std::vector<std::pair<size_t, const KeyType*>>& entries, Fn&& fn) {
+    std::unique_lock<Latch> lock(mut_);
+    for (auto [i, key] : entries) {
+      auto h = Mix(HashFn{}(*key));
+      auto table = table_.load(std::memory_order_relaxed);
+      // The slot found here is used for the write as well, so each key is looked up only once
+      auto slot = Find(*table, *key, h);
+      ValueType value = slot != kNotFound ? table->slots[slot].value : ValueType();
+      fn(i, value, slot != kNotFound);
+      InsertOrUpdateAt(slot, *key, value, h);
+    }
+  }
+
+  template <typename Fn>
+  void UpdateOrEraseBatch(const std::vector<std::pair<size_t, const KeyType*>>& entries, Fn&& fn) {
+    std::unique_lock<Latch> lock(mut_);
+    for (auto [i, key] : entries) {
+      auto h = Mix(HashFn{}(*key));
+      auto table = table_.load(std::memory_order_relaxed);
+      auto slot = Find(*table, *key, h);
+      if (slot == kNotFound) {
+        continue;
+      }
+      ValueType value = table->slots[slot].value;
+      if (fn(i, value)) {
+        InsertOrUpdateAt(slot, *key, value, h);
+      } else {
+        EraseAt(slot);
+      }
+    }
+  }
+
+  void Prefetch(size_t hash) const {
+    // Without optimistic reads, tables are freed right after being replaced
+    if constexpr (kOptimisticReads) {
+      auto table = table_.load(std::memory_order_acquire);
+      __builtin_prefetch(table->ctrl + FirstGroup(*table, Mix(hash)) * kGroupSize);
+    }
+  }
+
+  bool Erase(const KeyType& key) {
+    auto h = Mix(HashFn{}(key));
+
+    std::unique_lock<Latch> lock(mut_);
+
+    auto table = table_.load(std::memory_order_relaxed);
+    auto i = Find(*table, key, h);
+    if (i == kNotFound) {
+      return false;
+    }
+
+    EraseAt(i);
+    return true;
+  }
+
+  void Reserve(size_t num_keys) {
+    std::unique_lock<Latch> lock(mut_);
+
+    auto table = table_.load(std::memory_order_relaxed);
+    auto num_groups = table->num_groups;
+    while (num_keys * 8 > num_groups * kGroupSize * 7) {
+      num_groups <<= 1;
+    }
+    if (num_groups > table->num_groups) {
+      Resize(num_groups);
+    }
+  }
+
+  template <typename Fn>
+  void ForEach(Fn&& fn) const {
+    std::shared_lock<Latch> lock(mut_);
+
+    auto table = table_.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < table->capacity(); i++) {
+      if (IsFull(table->ctrl[i])) {
+        fn(table->slots[i].key, table->slots[i].value);
+      }
+    }
+  }
+
+ private:
+  static constexpr size_t kNotFound = static_cast<size_t>(-1);
+
+  static bool IsFull(uint8_t ctrl) { return (ctrl & kEmpty) == 0; }
+
+  // The lower bits of the hash were used to pick this segment and std::hash of an
+  // integer is the identity, so mix all bits before using them
+  static uint64_t Mix(uint64_t hash) {
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    return hash;
+  }
+
+  static uint8_t Fingerprint(uint64_t h) { return h & kFingerprintMask; }
+
+  static size_t FirstGroup(const Table& table, uint64_t h) { return (h >> 7) & (table.num_groups - 1); }
+
+  // Returns a bitmask of the slots in the group whose control byte equals the given byte
+  SLOG_OPTIMISTIC_READ static uint32_t MatchGroup(const uint8_t* group, uint8_t byte) {
+#ifdef __SSE2__
+    auto ctrl = _mm_load_si128(reinterpret_cast<const __m128i*>(group));
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(byte)));
+#else
+    uint32_t mask = 0;
+    for (size_t i = 0; i < kGroupSize; i++) {
+      if (group[i] == byte) {
+        mask |= 1 << i;
+      }
+    }
+    return mask;
+#endif
+  }
+
+  SLOG_OPTIMISTIC_READ static size_t Find(const Table& table, const KeyType& key, uint64_t h) {
+    auto fingerprint = Fingerprint(h);
+    auto g = FirstGroup(table, h);
+    // Bounded so that an optimistic reader seeing a table in the middle of a
+    // modification cannot loop forever
+    for (size_t probes = 0; probes < table.num_groups; probes++) {
+      auto group = table.ctrl + g * kGroupSize;
+      for (auto match = MatchGroup(group, fingerprint); match; match &= match - 1) {
+        auto i = g * kGroupSize + __builtin_ctz(match);
+        if (table.slots[i].key == key) {
+          return i;
+        }
+      }
+      // The key would have been placed in this group if it had an empty slot
+      if (MatchGroup(group, kEmpty)) {
+        return kNotFound;
+      }
+      g = (g + 1) & (table.num_groups - 1);
+    }
+    return kNotFound;
+  }
+
+  // Returns the first empty or deleted slot in the probe sequence. The table must not be full
+  static size_t FindFree(const Table& table, uint64_t h) {
+    for (auto g = FirstGroup(table, h);; g = (g + 1) & (table.num_groups - 1)) {
+      auto group = table.ctrl + g * kGroupSize;
+      auto free = MatchGroup(group, kEmpty) | MatchGroup(group, kDeleted);
+      if (free) {
+        return g * kGroupSize + __builtin_ctz(free);
+      }
+    }
+  }
+
+  // Must hold lock
+  bool InsertOrUpdateLocked(const KeyType& key, const ValueType& value) {
+    auto h = Mix(HashFn{}(key));
+    auto table = table_.load(std::memory_order_relaxed);
+    return InsertOrUpdateAt(Find(*table, key, h), key, value, h);
+  }
+
+  // Must hold lock. i must be the result of Find(*table_, key, h)
+  bool InsertOrUpdateAt(size_t i, const KeyType& key, const ValueType& value, uint64_t h) {
+    auto table = table_.load(std::memory_order_relaxed);
+    if (i != kNotFound) {
+      BeginWrite();
+      table->slots[i].value = value;
+      EndWrite();
+      return true;
+    }
+
+    // Keep the load factor, including deleted slots, at most 7/8
+    if ((size_ + num_deleted_ + 1) * 8 > table->capacity() * 7) {
+      // Grow the table if it is at least half full with live keys, otherwise only get rid of the deleted slots
+      auto num_groups = table->num_groups;
+      if ((size_ + 1) * 2 > table->capacity()) {
+        num_groups <<= 1;
+      }
+      Resize(num_groups);
+      table = table_.load(std::memory_order_relaxed);
+    }
+
+    i = FindFree(*table, h);
+    BeginWrite();
+    if (table->ctrl[i] == kDeleted) {
+      num_deleted_--;
+    }
+    new (&table->slots[i]) Slot(key, value);
+    table->ctrl[i] = Fingerprint(h);
+    EndWrite();
+
+    size_++;
+    return false;
+  }
+
+  // Must hold lock. i must be the result of Find(*table_, key, h)
+  void EraseAt(size_t i) {
+    auto table = table_.load(std::memory_order_relaxed);
+    BeginWrite();
+    table->ctrl[i] = kDeleted;
+    table->slots[i].~Slot();
+    EndWrite();
+
+    size_--;
+    num_deleted_++;
+  }
+
+  // Must hold lock
+  void BeginWrite() {
+    if constexpr (kOptimisticReads) {
+      version_.store(version_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+    }
+  }
+
+  // Must hold lock
+  void EndWrite() {
+    if constexpr (kOptimisticReads) {
+      version_.store(version_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+  }
+
+  // Must hold lock. Moves all keys to a new table with the given number of groups
+  void Resize(size_t num_groups) {
+    auto table = table_.load(std::memory_order_relaxed);
+    auto new_table = new Table(num_groups);
+    for (size_t i = 0; i < table->capacity(); i++) {
+      if (IsFull(table->ctrl[i])) {
+        auto& slot = table->slots[i];
+        auto h = Mix(HashFn{}(slot.key));
+        auto j = FindFree(*new_table, h);
+        new (&new_table->slots[j]) Slot(std::move(slot));
+        new_table->ctrl[j] = Fingerprint(h);
+      }
+    }
+    num_deleted_ = 0;
+
+    // The new table is completely filled before being published so readers
+    // never observe it half-built
+    table_.store(new_table, std::memory_order_release);
+
+    if constexpr (kOptimisticReads) {
+      auto& epoch_manager = EpochManager::Instance();
+      retired_.emplace_back(epoch_manager.Advance(), table);
+      while (!retired_.empty() && epoch_manager.IsSafeToFree(retired_.front().first)) {
+        delete retired_.front().second;
+        retired_.pop_front();
+      }
+    } else {
+      delete table;
+    }
+  }
+
+  std::atomic<uint64_t> version_;
+  std::atomic<Table*> table_;
+
+  mutable Latch mut_;
+  size_t size_;
+  size_t num_deleted_;
+  // Replaced tables waiting for optimistic readers to move past their retire epochs
+  std::deque<std::pair<uint64_t, Table*>> retired_;
+};
+
+template <typename KeyType, typename ValueType, typename HashFn = std::hash<KeyType>, uint8_t ShardBits = 8>
+using OpenAddressingSegmentT = BasicOpenAddressingSegment<KeyType, ValueType, HashFn, ShardBits, SharedMutexLatch>;
+
+template <typename Latch>
+struct WithLatch {
+  template <typename KeyType, typename ValueType, typename HashFn = std::hash<KeyType>, uint8_t ShardBits = 8>
+  using OpenAddressingSegmentT = BasicOpenAddressingSegment<KeyType, ValueType, HashFn, ShardBits, Latch>;
+};
+
+}  // namespace concurrent_hash_map
+
+}  // namespace slog
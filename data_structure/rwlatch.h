@@ -1,101 +1,187 @@
-// Originally from CMU's BusTub project:
-// https://github.com/cmu-db/bustub/edit/master/src/include/common/rwlatch.h
-//
-// Slightly modified to work with this project.
-//===----------------------------------------------------------------------===//
-//
-//                         BusTub
-//
-// rwmutex.h
-//
-// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
-//
-//===----------------------------------------------------------------------===//
-
+/**
+ * rwlatch.h
+ *
+ * Reader-writer latches for data structures whose readers need to exclude writers. All
+ * latches have the interface of std::shared_mutex so they can be used with std::shared_lock
+ * and std::unique_lock and can be plugged in wherever a std::shared_mutex is expected:
+ *
+ *  - SharedMutexLatch: std::shared_mutex. Waiters block in the kernel, so it behaves well
+ *    when there are more threads than cores, but every read still writes a shared cache line.
+ *  - SpinRWLatch: a single atomic word. Uncontended reads and writes are one compare-and-swap.
+ *    Waiters spin, then yield. Waiting writers block new readers so they are not starved.
+ *  - DistributedRWLatch: each reader only increments a counter on its own cache line, so
+ *    readers on different cores never contend with each other. In exchange, a writer has to
+ *    check the counters of all readers, which makes writes slower and the latch much larger.
+ *
+ * See test/microbenchmark/rwlatch_microbenchmark.cpp to compare them on a given workload.
+ */
 #pragma once
 
-#include <climits>
-#include <condition_variable>  // NOLINT
-#include <mutex>               // NOLINT
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <shared_mutex>
+#include <thread>
 
-// Macros to disable copying and moving
-#define DISALLOW_COPY(cname)                             \
-  cname(const cname &) = delete;            /* NOLINT */ \
-  cname &operator=(const cname &) = delete; /* NOLINT */
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
-namespace bustub {
+namespace slog {
 
-/**
- * Reader-Writer latch backed by std::mutex.
- */
-class ReaderWriterLatch {
-  using mutex_t = std::mutex;
-  using cond_t = std::condition_variable;
-  static const uint32_t MAX_READERS = UINT_MAX;
+using SharedMutexLatch = std::shared_mutex;
+
+namespace rwlatch {
 
+// Number of busy-wait iterations before a waiter starts yielding its core
+constexpr int kSpinsBeforeYield = 64;
+
+class Backoff {
  public:
-  ReaderWriterLatch() = default;
-  ~ReaderWriterLatch() { std::lock_guard<mutex_t> guard(mutex_); }
-
-  DISALLOW_COPY(ReaderWriterLatch);
-
-  /**
-   * Acquire a write latch.
-   */
-  void WLock() {
-    std::unique_lock<mutex_t> latch(mutex_);
-    while (writer_entered_) {
-      reader_.wait(latch);
+  void Wait() {
+    if (spins_ < kSpinsBeforeYield) {
+      spins_++;
+#ifdef __SSE2__
+      _mm_pause();
+#endif
+    } else {
+      std::this_thread::yield();
     }
-    writer_entered_ = true;
-    while (reader_count_ > 0) {
-      writer_.wait(latch);
+  }
+
+ private:
+  int spins_ = 0;
+};
+
+}  // namespace rwlatch
+
+class SpinRWLatch {
+ public:
+  SpinRWLatch() = default;
+  SpinRWLatch(const SpinRWLatch&) = delete;
+  SpinRWLatch& operator=(const SpinRWLatch&) = delete;
+
+  void lock() {
+    rwlatch::Backoff backoff;
+    for (;;) {
+      auto state = state_.load(std::memory_order_relaxed);
+      // Acquiring the latch also clears the pending bit. Other waiting writers set it again
+      if ((state & ~kPending) == 0 && state_.compare_exchange_weak(state, kWriter, std::memory_order_acquire)) {
+        return;
+      }
+      if (!(state & kPending)) {
+        state_.fetch_or(kPending, std::memory_order_relaxed);
+      }
+      backoff.Wait();
     }
   }
 
-  /**
-   * Release a write latch.
-   */
-  void WUnlock() {
-    std::lock_guard<mutex_t> guard(mutex_);
-    writer_entered_ = false;
-    reader_.notify_all();
+  bool try_lock() {
+    uint32_t state = 0;
+    return state_.compare_exchange_strong(state, kWriter, std::memory_order_acquire);
   }
 
-  /**
-   * Acquire a read latch.
-   */
-  void RLock() {
-    std::unique_lock<mutex_t> latch(mutex_);
-    while (writer_entered_ || reader_count_ == MAX_READERS) {
-      reader_.wait(latch);
+  void unlock() { state_.fetch_and(~kWriter, std::memory_order_release); }
+
+  void lock_shared() {
+    rwlatch::Backoff backoff;
+    while (!try_lock_shared()) {
+      backoff.Wait();
     }
-    reader_count_++;
   }
 
-  /**
-   * Release a read latch.
-   */
-  void RUnlock() {
-    std::lock_guard<mutex_t> guard(mutex_);
-    reader_count_--;
-    if (writer_entered_) {
-      if (reader_count_ == 0) {
-        writer_.notify_one();
+  bool try_lock_shared() {
+    auto state = state_.load(std::memory_order_relaxed);
+    return !(state & (kWriter | kPending)) &&
+           state_.compare_exchange_weak(state, state + kReader, std::memory_order_acquire);
+  }
+
+  void unlock_shared() { state_.fetch_sub(kReader, std::memory_order_release); }
+
+ private:
+  static constexpr uint32_t kWriter = 1;
+  static constexpr uint32_t kPending = 2;
+  // The number of readers is kept in the remaining bits
+  static constexpr uint32_t kReader = 4;
+
+  std::atomic<uint32_t> state_{0};
+};
+
+/**
+ * Each thread is assigned one of NumSlots reader counters in a round-robin fashion when it first
+ * takes any DistributedRWLatch. Threads keep their slot even when they migrate to another core,
+ * so that a latch is always released on the slot where it was acquired. Readers only share
+ * a cache line when there are more than NumSlots threads.
+ */
+template <size_t NumSlots = 16>
+class DistributedRWLatch {
+ public:
+  DistributedRWLatch() = default;
+  DistributedRWLatch(const DistributedRWLatch&) = delete;
+  DistributedRWLatch& operator=(const DistributedRWLatch&) = delete;
+
+  void lock() {
+    rwlatch::Backoff backoff;
+    while (writer_.exchange(true, std::memory_order_seq_cst)) {
+      backoff.Wait();
+    }
+    // New readers now see the writer flag and back off. Wait for the current ones to leave
+    for (auto& slot : slots_) {
+      while (slot.readers.load(std::memory_order_seq_cst) != 0) {
+        backoff.Wait();
       }
-    } else {
-      if (reader_count_ == MAX_READERS - 1) {
-        reader_.notify_one();
+    }
+  }
+
+  bool try_lock() {
+    if (writer_.exchange(true, std::memory_order_seq_cst)) {
+      return false;
+    }
+    for (auto& slot : slots_) {
+      if (slot.readers.load(std::memory_order_seq_cst) != 0) {
+        writer_.store(false, std::memory_order_release);
+        return false;
       }
     }
+    return true;
   }
 
+  void unlock() { writer_.store(false, std::memory_order_release); }
+
+  void lock_shared() {
+    rwlatch::Backoff backoff;
+    while (!try_lock_shared()) {
+      backoff.Wait();
+    }
+  }
+
+  bool try_lock_shared() {
+    auto& readers = slots_[ThisThreadSlot()].readers;
+    // The increment must be visible before the writer flag is read, and the writer sets its flag
+    // before reading the counters, so at least one of them sees the other
+    readers.fetch_add(1, std::memory_order_seq_cst);
+    if (!writer_.load(std::memory_order_seq_cst)) {
+      return true;
+    }
+    readers.fetch_sub(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  void unlock_shared() { slots_[ThisThreadSlot()].readers.fetch_sub(1, std::memory_order_release); }
+
  private:
-  mutex_t mutex_;
-  cond_t writer_;
-  cond_t reader_;
-  uint32_t reader_count_{0};
-  bool writer_entered_{false};
+  struct alignas(64) Slot {
+    std::atomic<uint32_t> readers{0};
+  };
+
+  static size_t ThisThreadSlot() {
+    static std::atomic<size_t> next_slot{0};
+    thread_local size_t slot = next_slot.fetch_add(1, std::memory_order_relaxed) % NumSlots;
+    return slot;
+  }
+
+  alignas(64) std::atomic<bool> writer_{false};
+  Slot slots_[NumSlots];
 };
 
-}  // namespace bustub
+}  // namespace slog
@@ -23,6 +23,7 @@ NetworkedModule::NetworkedModule(const std::string& name, const std::shared_ptr<
     : Module(name),
       context_(broker->context()),
       channel_(chopt.channel),
+      parse_into_arena_(chopt.parse_into_arena),
       pull_socket_(*context_, ZMQ_PULL),
       sender_(broker->config(), broker->context()),
       poller_(poll_timeout),
@@ -50,6 +51,8 @@ void NetworkedModule::AddCustomSocket(zmq::socket_t&& new_socket) {
   poller_.PushSocket(sock);
 }
 
+void NetworkedModule::AddCustomQueue(InProcQueueBase& queue) { poller_.PushQueue(queue); }
+
 zmq::socket_t& NetworkedModule::GetCustomSocket(size_t i) { return custom_sockets_[i]; }
 
 const std::shared_ptr<zmq::context_t> NetworkedModule::context() const { return context_; }
@@ -63,6 +66,13 @@ void NetworkedModule::SetUp() {
 }
 
 bool NetworkedModule::Loop() {
+  // Coalesced messages must not wait for the poller, which blocks when there is nothing to do
+  if (recv_retries_ > 0) {
+    sender_.FlushExpired();
+  } else {
+    sender_.Flush();
+  }
+
   if (!poller_.NextEvent(recv_retries_ > 0)) {
     return false;
   }
@@ -78,8 +88,9 @@ bool NetworkedModule::Loop() {
 #endif
     EnvelopePtr env;
     if (wrapped_env->type_case() == Envelope::TypeCase::kRaw) {
-      env.reset(new Envelope());
-      if (DeserializeProto(*env, wrapped_env->raw().data(), wrapped_env->raw().size())) {
+      const auto& raw = wrapped_env->raw();
+      env.reset(google::protobuf::Arena::CreateMessage<Envelope>(parse_into_arena_ ? NewArena(raw.size()) : nullptr));
+      if (DeserializeProto(*env, raw.data(), raw.size())) {
         env->set_from(wrapped_env->from());
       }
     } else {
@@ -113,23 +124,25 @@ bool NetworkedModule::Loop() {
   return false;
 }
 
-void NetworkedModule::Send(const Envelope& env, MachineId to_machine_id, Channel to_channel, size_t via_broker) {
+void NetworkedModule::Send(const Envelope& env, MachineId to_machine_id, Channel to_channel,
+                           std::optional<size_t> via_broker) {
   sender_.Send(env, to_machine_id, to_channel, via_broker);
 }
 
-void NetworkedModule::Send(EnvelopePtr&& env, MachineId to_machine_id, Channel to_channel, size_t via_broker) {
+void NetworkedModule::Send(EnvelopePtr&& env, MachineId to_machine_id, Channel to_channel,
+                           std::optional<size_t> via_broker) {
   sender_.Send(move(env), to_machine_id, to_channel, via_broker);
 }
 
 void NetworkedModule::Send(EnvelopePtr&& env, Channel to_channel) { sender_.Send(move(env), to_channel); }
 
 void NetworkedModule::Send(const Envelope& env, const std::vector<MachineId>& to_machine_ids, Channel to_channel,
-                           size_t via_broker) {
+                           std::optional<size_t> via_broker) {
   sender_.Send(env, to_machine_ids, to_channel, via_broker);
 }
 
 void NetworkedModule::Send(EnvelopePtr&& env, const std::vector<MachineId>& to_machine_ids, Channel to_channel,
-                           size_t via_broker) {
+                           std::optional<size_t> via_broker) {
   sender_.Send(move(env), to_machine_ids, to_channel, via_broker);
 }
 
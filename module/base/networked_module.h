@@ -7,6 +7,7 @@
 #include "common/constants.h"
 #include "common/types.h"
 #include "connection/broker.h"
+#include "connection/inproc_queue.h"
 #include "connection/poller.h"
 #include "connection/sender.h"
 #include "connection/zmq_utils.h"
@@ -16,9 +17,12 @@
 namespace slog {
 
 struct ChannelOption {
-  ChannelOption(Channel channel, bool recv_raw = true) : channel(channel), recv_raw(recv_raw) {}
+  ChannelOption(Channel channel, bool recv_raw = true, bool parse_into_arena = false)
+      : channel(channel), recv_raw(recv_raw), parse_into_arena(parse_into_arena) {}
   Channel channel;
   bool recv_raw;
+  // Each raw message is parsed into its own arena, which is owned by the received envelope
+  bool parse_into_arena;
 };
 
 /**
@@ -42,14 +46,20 @@ class NetworkedModule : public Module {
 
   void AddCustomSocket(zmq::socket_t&& new_socket);
   zmq::socket_t& GetCustomSocket(size_t i);
+  // The module is woken up when something is pushed into this queue, which must outlive the module.
+  // Its values are popped in OnCustomSocket
+  void AddCustomQueue(InProcQueueBase& queue);
 
   inline static EnvelopePtr NewEnvelope() { return std::make_unique<internal::Envelope>(); }
-  void Send(const internal::Envelope& env, MachineId to_machine_id, Channel to_channel, size_t via_broker = 0);
-  void Send(EnvelopePtr&& env, MachineId to_machine_id, Channel to_channel, size_t via_broker = 0);
+  void Send(const internal::Envelope& env, MachineId to_machine_id, Channel to_channel,
+            std::optional<size_t> via_broker = {});
+  void Send(EnvelopePtr&& env, MachineId to_machine_id, Channel to_channel,
+            std::optional<size_t> via_broker = {});
   void Send(EnvelopePtr&& env, Channel to_channel);
   void Send(const internal::Envelope& env, const std::vector<MachineId>& to_machine_ids, Channel to_channel,
-            size_t via_broker = 0);
-  void Send(EnvelopePtr&& env, const std::vector<MachineId>& to_machine_ids, Channel to_channel, size_t via_broker = 0);
+            std::optional<size_t> via_broker = {});
+  void Send(EnvelopePtr&& env, const std::vector<MachineId>& to_machine_ids, Channel to_channel,
+            std::optional<size_t> via_broker = {});
 
   void NewTimedCallback(microseconds timeout, std::function<void()>&& cb);
   void ClearTimedCallbacks();
@@ -64,6 +74,7 @@ class NetworkedModule : public Module {
 
   std::shared_ptr<zmq::context_t> context_;
   Channel channel_;
+  bool parse_into_arena_;
   zmq::socket_t pull_socket_;
   std::vector<zmq::socket_t> custom_sockets_;
   Sender sender_;
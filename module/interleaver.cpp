@@ -55,7 +55,9 @@ void LocalLog::UpdateReadyBatches() {
 
 Interleaver::Interleaver(const ConfigurationPtr& config, const shared_ptr<Broker>& broker,
                          std::chrono::milliseconds poll_timeout)
-    : NetworkedModule("Interleaver", broker, kInterleaverChannel, poll_timeout), config_(config) {}
+    : NetworkedModule("Interleaver", broker, ChannelOption(kInterleaverChannel, true, true /* parse_into_arena */),
+                      poll_timeout),
+      config_(config) {}
 
 void Interleaver::OnInternalRequestReceived(EnvelopePtr&& env) {
   auto request = env->mutable_request();
@@ -67,22 +69,23 @@ void Interleaver::OnInternalRequestReceived(EnvelopePtr&& env) {
 
   } else if (request->type_case() == Request::kForwardBatch) {
     auto forward_batch = request->mutable_forward_batch();
-    auto [from_replica, from_partition] = config_->UnpackMachineId(env->from());
+    auto from = env->from();
+    auto [from_replica, from_partition] = config_->UnpackMachineId(from);
 
     switch (forward_batch->part_case()) {
       case internal::ForwardBatch::kBatchData: {
-        auto batch = BatchPtr{forward_batch->release_batch_data()};
+        // Batches generated by the same machine need to follow the order
+        // of creation. This field is used to keep track of that order
+        auto same_origin_position = forward_batch->same_origin_position();
+        auto batch = ReleaseBatchData(move(env));
 
         TRACE(batch.get(), TransactionEvent::ENTER_INTERLEAVER_IN_BATCH);
 
-        VLOG(1) << "Received data for batch " << batch->id() << " from [" << env->from()
+        VLOG(1) << "Received data for batch " << batch->id() << " from [" << from
                 << "]. Number of txns: " << batch->transactions_size();
 
         if (from_replica == config_->local_replica()) {
-          local_log_.AddBatchId(from_partition /* queue_id */,
-                                // Batches generated by the same machine need to follow the order
-                                // of creation. This field is used to keep track of that order
-                                forward_batch->same_origin_position(), batch->id());
+          local_log_.AddBatchId(from_partition /* queue_id */, same_origin_position, batch->id());
         }
 
         single_home_logs_[from_replica].AddBatch(move(batch));
@@ -140,15 +143,13 @@ void Interleaver::AdvanceLogs() {
 void Interleaver::EmitBatch(BatchPtr&& batch) {
   VLOG(1) << "Processing batch " << batch->id() << " from global log";
 
-  auto transactions = Unbatch(batch.get());
-  for (auto txn : transactions) {
-    TRACE(txn->mutable_internal(), TransactionEvent::EXIT_INTERLEAVER);
+  TRACE(batch.get(), TransactionEvent::EXIT_INTERLEAVER);
 
-    auto env = NewEnvelope();
-    auto forward_txn = env->mutable_request()->mutable_forward_txn();
-    forward_txn->set_allocated_txn(txn);
-    Send(move(env), kSchedulerChannel);
-  }
+  // The whole batch goes to the scheduler so that its txns can stay in the arena of the batch, if any.
+  // The envelope is put in the same arena and takes it over from the batch
+  EnvelopePtr env(google::protobuf::Arena::CreateMessage<Envelope>(batch->GetArena()));
+  env->mutable_request()->mutable_forward_batch()->set_allocated_batch_data(batch.release());
+  Send(move(env), kSchedulerChannel);
 }
 
 }  // namespace slog
\ No newline at end of file
@@ -18,16 +18,31 @@ using internal::Request;
 using internal::Response;
 
 Scheduler::Scheduler(const ConfigurationPtr& config, const shared_ptr<Broker>& broker,
-                     const shared_ptr<Storage<Key, Record>>& storage, std::chrono::milliseconds poll_timeout)
-    : NetworkedModule("Scheduler", broker, {kSchedulerChannel, false /* recv_raw */}, poll_timeout), config_(config) {
+                     const shared_ptr<Storage<Key, Record>>& storage, const shared_ptr<WriteAheadLog>& wal,
+                     std::chrono::milliseconds poll_timeout)
+    : NetworkedModule("Scheduler", broker, {kSchedulerChannel, false /* recv_raw */}, poll_timeout),
+      config_(config),
+      storage_(storage),
+      wal_(wal),
+      last_log_position_(0),
+      stable_position_recheck_scheduled_(false),
+      stable_log_position_(0),
+      next_worker_(0),
+      done_queue_(make_shared<Worker::DoneQueue>(kWorkerQueueCapacity)) {
   for (size_t i = 0; i < config->num_workers(); i++) {
-    workers_.push_back(MakeRunnerFor<Worker>(config, broker, Worker::MakeChannel(i), storage, poll_timeout));
+    auto& txn_queue = worker_queues_.emplace_back(make_shared<Worker::TxnQueue>(kWorkerQueueCapacity));
+    workers_.push_back(MakeRunnerFor<Worker>(config, broker, Worker::MakeChannel(i), storage, wal, txn_queue,
+                                             done_queue_, poll_timeout));
   }
 
 #if defined(REMASTER_PROTOCOL_SIMPLE) || defined(REMASTER_PROTOCOL_PER_KEY)
   remaster_manager_.SetStorage(storage);
 #endif /* defined(REMASTER_PROTOCOL_SIMPLE) || \
           defined(REMASTER_PROTOCOL_PER_KEY) */
+
+  if (config->simple_partitioning() != nullptr) {
+    lock_manager_.emplace<LockManager<uint64_t>>();
+  }
 }
 
 void Scheduler::Initialize() {
@@ -41,18 +56,16 @@ void Scheduler::Initialize() {
     worker->StartInNewThread(cpu);
   }
 
-  zmq::socket_t worker_socket(*context(), ZMQ_DEALER);
-  worker_socket.set(zmq::sockopt::rcvhwm, 0);
-  worker_socket.set(zmq::sockopt::sndhwm, 0);
-  worker_socket.bind(MakeInProcChannelAddress(kWorkerChannel));
-
-  AddCustomSocket(move(worker_socket));
+  AddCustomQueue(*done_queue_);
 }
 
 void Scheduler::OnInternalRequestReceived(EnvelopePtr&& env) {
   switch (env->request().type_case()) {
     case Request::kForwardTxn:
-      ProcessTransaction(move(env));
+      ProcessTransaction(env->mutable_request()->mutable_forward_txn()->release_txn());
+      break;
+    case Request::kForwardBatch:
+      ProcessBatch(move(env));
       break;
     case Request::kStats:
       ProcessStatsRequest(env->request().stats());
@@ -65,15 +78,14 @@ void Scheduler::OnInternalRequestReceived(EnvelopePtr&& env) {
 
 // Handle responses from the workers
 bool Scheduler::OnCustomSocket() {
-  auto& worker_socket = GetCustomSocket(0);
   auto max_txns = config_->scheduler_max_txns();
 
   do {
-    zmq::message_t msg;
-    while (worker_socket.recv(msg, zmq::recv_flags::dontwait)) {
-      auto txn_id = *msg.data<TxnId>();
+    TxnId txn_id;
+    while (done_queue_->Pop(txn_id)) {
       // Release locks held by this txn then dispatch the txns that become ready thanks to this release.
-      auto unblocked_txns = lock_manager_.ReleaseLocks(txn_id);
+      auto unblocked_txns =
+          std::visit([txn_id](auto& lock_manager) { return lock_manager.ReleaseLocks(txn_id); }, lock_manager_);
       for (auto unblocked_txn : unblocked_txns) {
         Dispatch(unblocked_txn);
       }
@@ -84,6 +96,12 @@ bool Scheduler::OnCustomSocket() {
       DCHECK(it != active_txns_.end());
       auto& txn_holder = it->second;
 
+      if (wal_ != nullptr && txn_holder.wal_lsn() > wal_->durable_lsn()) {
+        non_durable_log_positions_.emplace(txn_holder.wal_lsn(), txn_holder.log_position());
+      } else {
+        executing_log_positions_.erase(txn_holder.log_position());
+      }
+
 #if defined(REMASTER_PROTOCOL_SIMPLE) || defined(REMASTER_PROTOCOL_PER_KEY)
       auto remaster_result = txn_holder.remaster_result();
       // If a remaster transaction, trigger any unblocked txns
@@ -99,15 +117,31 @@ bool Scheduler::OnCustomSocket() {
         active_txns_.erase(it);
       }
     }
+    UpdateStablePosition();
   } while (max_txns > 0 && active_txns_.size() >= max_txns);
 
   return true;
 }
 
-void Scheduler::ProcessTransaction(EnvelopePtr&& env) {
-  auto txn = env->mutable_request()->mutable_forward_txn()->release_txn();
+void Scheduler::ProcessBatch(EnvelopePtr&& env) {
+  auto batch = env->mutable_request()->mutable_forward_batch()->mutable_batch_data();
+  auto transactions = Unbatch(batch);
+
+  // The txns of a batch in an arena take over the arena from the envelope and free it when the last
+  // of them is done
+  ArenaPtr arena;
+  if (env->GetArena() != nullptr) {
+    arena.reset(env.release()->GetArena());
+  }
+
+  for (auto txn : transactions) {
+    ProcessTransaction(txn, arena);
+  }
+}
+
+void Scheduler::ProcessTransaction(Transaction* txn, const ArenaPtr& arena) {
   auto txn_id = txn->internal().id();
-  auto ins = active_txns_.try_emplace(txn_id, config_, txn);
+  auto ins = active_txns_.try_emplace(txn_id, config_, txn, arena);
 
   if (ins.second) {
     TRACE(txn->mutable_internal(), TransactionEvent::ENTER_SCHEDULER);
@@ -115,7 +149,7 @@ void Scheduler::ProcessTransaction(EnvelopePtr&& env) {
     VLOG(2) << "Accepted " << ENUM_NAME(txn->internal().type(), TransactionType) << " transaction (" << txn_id << ", "
             << txn->internal().home() << ")";
   } else {
-    if (!ins.first->second.AddLockOnlyTxn(txn)) {
+    if (!ins.first->second.AddLockOnlyTxn(txn, arena)) {
       LOG(ERROR) << "Already received txn: (" << txn_id << ", " << txn->internal().home() << ")";
       return;
     }
@@ -134,7 +168,7 @@ void Scheduler::ProcessTransaction(EnvelopePtr&& env) {
 #if defined(REMASTER_PROTOCOL_SIMPLE) || defined(REMASTER_PROTOCOL_PER_KEY)
   SendToRemasterManager(*txn);
 #else
-  SendToLockManager(*txn);
+  SendToLockManager(ins.first->second.flat_lock_only_txn(txn->internal().home()));
 #endif
 }
 
@@ -142,7 +176,7 @@ void Scheduler::ProcessTransaction(EnvelopePtr&& env) {
 void Scheduler::SendToRemasterManager(const Transaction& txn) {
   switch (remaster_manager_.VerifyMaster(txn)) {
     case VerifyMasterResult::VALID: {
-      SendToLockManager(txn);
+      SendToLockManager(FlatLockOnlyTxn(txn));
       break;
     }
     case VerifyMasterResult::ABORT: {
@@ -162,7 +196,7 @@ void Scheduler::SendToRemasterManager(const Transaction& txn) {
 
 void Scheduler::ProcessRemasterResult(RemasterOccurredResult result) {
   for (auto unblocked_lo : result.unblocked) {
-    SendToLockManager(*unblocked_lo);
+    SendToLockManager(FlatLockOnlyTxn(*unblocked_lo));
   }
   // Check for duplicates
   // TODO: remove this set and check
@@ -175,39 +209,79 @@ void Scheduler::ProcessRemasterResult(RemasterOccurredResult result) {
     TriggerPreDispatchAbort(txn_id);
   }
 }
+
+const FlatTxn& Scheduler::FlatLockOnlyTxn(const Transaction& txn) const {
+  return active_txns_.at(txn.internal().id()).flat_lock_only_txn(txn.internal().home());
+}
 #endif /* defined(REMASTER_PROTOCOL_SIMPLE) || \
           defined(REMASTER_PROTOCOL_PER_KEY) */
 
-void Scheduler::SendToLockManager(const Transaction& txn) {
-  auto txn_id = txn.internal().id();
+void Scheduler::SendToLockManager(const FlatTxn& txn) {
+  auto txn_id = txn.id();
 
   VLOG(2) << "Trying to acquires locks of txn " << txn_id;
 
-  switch (lock_manager_.AcquireLocks(txn)) {
+  switch (std::visit([&txn](auto& lock_manager) { return lock_manager.AcquireLocks(txn); }, lock_manager_)) {
     case AcquireLocksResult::ACQUIRED:
       Dispatch(txn_id);
       break;
     case AcquireLocksResult::ABORT:
       TriggerPreDispatchAbort(txn_id);
       break;
-    case AcquireLocksResult::WAITING:
+    case AcquireLocksResult::WAITING: {
       VLOG(2) << "Txn " << txn_id << " cannot be dispatched yet";
+      // Give the storage a head start on reading the keys while the txn waits for its locks
+      storage_->Prefetch(txn.key_ptrs());
       break;
+    }
     default:
       LOG(ERROR) << "Unknown lock result type";
       break;
   }
 }
 
+void Scheduler::UpdateStablePosition() {
+  if (wal_ != nullptr) {
+    auto durable_lsn = wal_->durable_lsn();
+    auto it = non_durable_log_positions_.begin();
+    for (; it != non_durable_log_positions_.end() && it->first <= durable_lsn; it++) {
+      executing_log_positions_.erase(it->second);
+    }
+    non_durable_log_positions_.erase(non_durable_log_positions_.begin(), it);
+
+    // Without this, the stable position would not move until the next txn is done
+    if (!non_durable_log_positions_.empty() && !stable_position_recheck_scheduled_) {
+      stable_position_recheck_scheduled_ = true;
+      NewTimedCallback(wal_->group_commit_interval(), [this]() {
+        stable_position_recheck_scheduled_ = false;
+        UpdateStablePosition();
+      });
+    }
+  }
+
+  // All txns before the oldest txn that is executing or waiting for durability have been applied to
+  // the storage and are durable
+  auto stable_log_position =
+      executing_log_positions_.empty() ? last_log_position_ : *executing_log_positions_.begin() - 1;
+  if (stable_log_position != stable_log_position_) {
+    stable_log_position_ = stable_log_position;
+    storage_->SetStablePosition(stable_log_position);
+  }
+}
+
 void Scheduler::Dispatch(TxnId txn_id) {
   auto it = active_txns_.find(txn_id);
   auto& txn_holder = it->second;
 
   TRACE(txn_holder.txn().mutable_internal(), TransactionEvent::DISPATCHED);
 
-  zmq::message_t msg(sizeof(TxnHolder*));
-  *msg.data<TxnHolder*>() = &txn_holder;
-  GetCustomSocket(0).send(msg, zmq::send_flags::none);
+  // A txn is only dispatched after the txns it conflicts with are done, so the storage receives
+  // the writes to any key in the order of their log positions
+  txn_holder.SetLogPosition(++last_log_position_);
+  executing_log_positions_.insert(last_log_position_);
+
+  worker_queues_[next_worker_]->Push(&txn_holder);
+  next_worker_ = (next_worker_ + 1) % worker_queues_.size();
 
   VLOG(2) << "Dispatched txn " << txn_id;
 }
@@ -243,7 +317,8 @@ void Scheduler::TriggerPreDispatchAbort(TxnId txn_id) {
 
   // Release locks held by this txn. Enqueue the txns that
   // become ready thanks to this release.
-  auto unblocked_txns = lock_manager_.ReleaseLocks(txn_id);
+  auto unblocked_txns =
+      std::visit([txn_id](auto& lock_manager) { return lock_manager.ReleaseLocks(txn_id); }, lock_manager_);
   for (auto unblocked_txn : unblocked_txns) {
     Dispatch(unblocked_txn);
   }
@@ -280,6 +355,12 @@ void Scheduler::ProcessStatsRequest(const internal::StatsRequest& stats_request)
   stats.SetObject();
   auto& alloc = stats.GetAllocator();
 
+  if (stats_request.module() == ModuleId::STORAGE) {
+    AddStorageStats(stats, level);
+    SendStats(stats_request.id(), stats);
+    return;
+  }
+
   // Add stats for current transactions in the system
   stats.AddMember(StringRef(NUM_ALL_TXNS), active_txns_.size(), alloc);
   if (level == 0) {
@@ -304,15 +385,63 @@ void Scheduler::ProcessStatsRequest(const internal::StatsRequest& stats_request)
   }
 
   // Add stats from the lock manager
-  lock_manager_.GetStats(stats, level);
+  std::visit([&](const auto& lock_manager) { lock_manager.GetStats(stats, level); }, lock_manager_);
+
+  SendStats(stats_request.id(), stats);
+}
+
+/**
+ * {
+ *    storage_num_keys: <number of keys>,
+ *    storage_value_bytes: <total size of the values>,
+ *    storage_index_bytes: <memory used by the index structures>,
+ *    storage_num_buckets: <number of buckets of the main table>,
+ *    storage_max_chain_length: <longest bucket chain of the main table>,
+ *    storage_segments (lvl >= 1): [
+ *      [<num keys>, <num buckets>, <num empty buckets>, <max chain length>],
+ *      ...
+ *    ]
+ * }
+ *
+ * The object is empty if the storage does not keep stats
+ */
+void Scheduler::AddStorageStats(rapidjson::Document& stats, int level) const {
+  using rapidjson::StringRef;
+
+  StorageStats storage_stats;
+  if (!storage_->GetStats(storage_stats, level >= 1)) {
+    return;
+  }
+
+  auto& alloc = stats.GetAllocator();
+  stats.AddMember(StringRef(STORAGE_NUM_KEYS), storage_stats.num_keys, alloc)
+      .AddMember(StringRef(STORAGE_VALUE_BYTES), storage_stats.value_bytes, alloc)
+      .AddMember(StringRef(STORAGE_INDEX_BYTES), storage_stats.index_bytes, alloc)
+      .AddMember(StringRef(STORAGE_NUM_BUCKETS), storage_stats.table.num_buckets, alloc)
+      .AddMember(StringRef(STORAGE_MAX_CHAIN_LENGTH), storage_stats.table.max_chain_length, alloc);
+
+  if (level >= 1) {
+    rapidjson::Value segments(rapidjson::kArrayType);
+    for (const auto& segment : storage_stats.segments) {
+      rapidjson::Value entry(rapidjson::kArrayType);
+      entry.PushBack(segment.num_keys, alloc)
+          .PushBack(segment.num_buckets, alloc)
+          .PushBack(segment.num_empty_buckets, alloc)
+          .PushBack(segment.max_chain_length, alloc);
+      segments.PushBack(entry, alloc);
+    }
+    stats.AddMember(StringRef(STORAGE_SEGMENTS), segments, alloc);
+  }
+}
 
+void Scheduler::SendStats(uint32_t id, const rapidjson::Document& stats) {
   // Write JSON object to a buffer and send back to the server
   rapidjson::StringBuffer buf;
   rapidjson::Writer<rapidjson::StringBuffer> writer(buf);
   stats.Accept(writer);
 
   auto env = NewEnvelope();
-  env->mutable_response()->mutable_stats()->set_id(stats_request.id());
+  env->mutable_response()->mutable_stats()->set_id(id);
   env->mutable_response()->mutable_stats()->set_stats_json(buf.GetString());
   Send(move(env), kServerChannel);
 }
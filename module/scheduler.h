@@ -2,8 +2,11 @@
 
 #include <glog/logging.h>
 
+#include <map>
+#include <set>
 #include <unordered_map>
 #include <unordered_set>
+#include <variant>
 #include <vector>
 
 #include "common/configuration.h"
@@ -42,7 +45,7 @@ namespace slog {
 class Scheduler : public NetworkedModule {
  public:
   Scheduler(const ConfigurationPtr& config, const std::shared_ptr<Broker>& broker,
-            const std::shared_ptr<Storage<Key, Record>>& storage,
+            const std::shared_ptr<Storage<Key, Record>>& storage, const std::shared_ptr<WriteAheadLog>& wal,
             std::chrono::milliseconds poll_timeout = kModuleTimeout);
 
  protected:
@@ -54,18 +57,23 @@ class Scheduler : public NetworkedModule {
   bool OnCustomSocket() final;
 
  private:
-  void ProcessTransaction(EnvelopePtr&& env);
+  void ProcessBatch(EnvelopePtr&& env);
+  void ProcessTransaction(Transaction* txn, const ArenaPtr& arena = nullptr);
   void ProcessStatsRequest(const internal::StatsRequest& stats_request);
+  void AddStorageStats(rapidjson::Document& stats, int level) const;
+  void SendStats(uint32_t id, const rapidjson::Document& stats);
 
 #if defined(REMASTER_PROTOCOL_SIMPLE) || defined(REMASTER_PROTOCOL_PER_KEY)
   // Send single-home and lock-only transactions for counter checking
   void SendToRemasterManager(const Transaction& txn);
   // Send transactions to lock manager or abort them
   void ProcessRemasterResult(RemasterOccurredResult result);
+  // The remaster managers work on Transactions but the lock manager takes their flattened form
+  const FlatTxn& FlatLockOnlyTxn(const Transaction& txn) const;
 #endif
 
   // Send all transactions for locks
-  void SendToLockManager(const Transaction& txn);
+  void SendToLockManager(const FlatTxn& txn);
 
   // Send txn to worker
   void Dispatch(TxnId txn_id);
@@ -84,7 +92,25 @@ class Scheduler : public NetworkedModule {
 
   void MaybeCleanUpTxn(TxnId txn_id);
 
+  /**
+   * Publishes to the storage the last log position up to which all txns have been applied and
+   * their writes are durable. Rechecks later if some done txns are still waiting for durability
+   */
+  void UpdateStablePosition();
+
   ConfigurationPtr config_;
+  std::shared_ptr<Storage<Key, Record>> storage_;
+  std::shared_ptr<WriteAheadLog> wal_;
+
+  // Log position given to the last dispatched txn
+  LogPosition last_log_position_;
+  // Log positions of the dispatched txns that are not done yet or whose writes are not durable yet
+  std::set<LogPosition> executing_log_positions_;
+  // Log positions of the done txns whose writes are not durable yet, keyed by the LSN that has to be durable
+  std::multimap<uint64_t, LogPosition> non_durable_log_positions_;
+  bool stable_position_recheck_scheduled_;
+  // Last position up to which all txns were reported to be applied to the storage and durable
+  LogPosition stable_log_position_;
 
 #if defined(REMASTER_PROTOCOL_SIMPLE)
   SimpleRemasterManager remaster_manager_;
@@ -94,15 +120,25 @@ class Scheduler : public NetworkedModule {
 
 #if defined(REMASTER_PROTOCOL_SIMPLE) || defined(REMASTER_PROTOCOL_PER_KEY) || \
     (defined(LOCK_MANAGER_OLD) && !defined(REMASTER_PROTOCOL_COUNTERLESS))
-  OldLockManager lock_manager_;
+  template <typename K>
+  using LockManager = OldLockManager<K>;
 #elif defined(LOCK_MANAGER_DDR)
-  DDRLockManager lock_manager_;
+  template <typename K>
+  using LockManager = DDRLockManager<K>;
 #else
-  RMALockManager lock_manager_;
+  template <typename K>
+  using LockManager = RMALockManager<K>;
 #endif
+  // With simple partitioning, the keys are locked as the integers parsed by the txn holders
+  std::variant<LockManager<Key>, LockManager<uint64_t>> lock_manager_;
 
   std::unordered_map<TxnId, TxnHolder> active_txns_;
 
+  // Txns are dispatched to the workers in a round-robin manner
+  std::vector<std::shared_ptr<Worker::TxnQueue>> worker_queues_;
+  size_t next_worker_;
+  std::shared_ptr<Worker::DoneQueue> done_queue_;
+
   // This must be defined at the end so that the workers exit before any resources
   // in the scheduler is destroyed
   std::vector<std::unique_ptr<ModuleRunner>> workers_;
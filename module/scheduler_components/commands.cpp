@@ -6,6 +6,7 @@
 #include <string>
 #include <thread>
 
+#include "common/compression.h"
 #include "common/proto_utils.h"
 #include "common/string_utils.h"
 
@@ -19,45 +20,50 @@ namespace {
 const string SPACE(" \t\n\v\f\r");
 }  // namespace
 
-const std::unordered_map<string, size_t> KeyValueCommands::COMMAND_NUM_ARGS = {{"GET", 1},  {"SET", 2}, {"DEL", 1},
-                                                                               {"COPY", 2}, {"EQ", 2},  {"SLEEP", 1}};
+const std::unordered_map<string, size_t> KeyValueCommands::COMMAND_NUM_ARGS = {
+    {"GET", 1}, {"SET", 2}, {"DEL", 1}, {"COPY", 2}, {"EQ", 2}, {"SLEEP", 1}, {"SCAN", 2}};
 
-void KeyValueCommands::Execute(Transaction& txn) {
+void KeyValueCommands::Execute(Transaction& txn, FlatTxn& flat_txn) {
   Reset();
-  auto& keys = *txn.mutable_keys();
 
   // If a command will write to a key but that key is
   // not in the write set, that command will be ignored.
+  // GET and SCAN have nothing to do here since their keys are
+  // among the keys of the txn, which are read before execution.
   while (NextCommand(txn.code())) {
     if (cmd_ == "SET") {
-      auto it = keys.find(args_[0]);
-      if (it == keys.end() || it->second.type() != KeyType::WRITE) {
+      auto i = flat_txn.Find(args_[0]);
+      if (i == FlatTxn::kNotFound || flat_txn.slot(i).type != KeyType::WRITE) {
         continue;
       }
-      it->second.set_new_value(move(args_[1]));
+      flat_txn.slot(i).new_value = move(args_[1]);
     } else if (cmd_ == "DEL") {
-      if (!keys.contains(args_[0]) || keys.at(args_[0]).type() != KeyType::WRITE) {
+      auto i = flat_txn.Find(args_[0]);
+      if (i == FlatTxn::kNotFound || flat_txn.slot(i).type != KeyType::WRITE) {
         continue;
       }
-      txn.mutable_deleted_keys()->Add(move(args_[0]));
+      flat_txn.Delete(i);
     } else if (cmd_ == "COPY") {
-      auto src_it = keys.find(args_[0]);
-      auto dst_it = keys.find(args_[1]);
-      if (src_it == keys.end()) {
+      auto src = flat_txn.Find(args_[0]);
+      auto dst = flat_txn.Find(args_[1]);
+      if (src == FlatTxn::kNotFound) {
         continue;
       }
-      if (dst_it == keys.end() || dst_it->second.type() != KeyType::WRITE) {
+      if (dst == FlatTxn::kNotFound || flat_txn.slot(dst).type != KeyType::WRITE) {
         continue;
       }
-      dst_it->second.set_new_value(src_it->second.value());
+      auto& src_slot = flat_txn.slot(src);
+      DecompressInPlace(src_slot.value, src_slot.compressed);
+      flat_txn.slot(dst).new_value = src_slot.value;
     } else if (cmd_ == "EQ") {
-      auto it = keys.find(args_[0]);
-      if (it == keys.end()) {
+      auto i = flat_txn.Find(args_[0]);
+      if (i == FlatTxn::kNotFound) {
         continue;
       }
-      if (it->second.value() != args_[1]) {
-        Abort() << "Key = " << args_[0] << ". Expected value = " << args_[1]
-                << ". Actual value = " << it->second.value();
+      auto& slot = flat_txn.slot(i);
+      DecompressInPlace(slot.value, slot.compressed);
+      if (slot.value != args_[1]) {
+        Abort() << "Key = " << args_[0] << ". Expected value = " << args_[1] << ". Actual value = " << slot.value;
       }
     } else if (cmd_ == "SLEEP") {
       std::this_thread::sleep_for(std::chrono::seconds(std::stoi(args_[0])));
@@ -72,6 +78,92 @@ void KeyValueCommands::Execute(Transaction& txn) {
   }
 }
 
+bool KeyValueCommands::ReadRanges(const Transaction& txn, const FlatTxn& flat_txn,
+                                  const Storage<Key, Record>& storage, std::vector<std::optional<Record>>& records,
+                                  std::vector<bool>& scanned) {
+  // Only saves parsing the code of the many txns without a scan. The commands are parsed below
+  if (txn.code().find("SCAN") == string::npos || !flat_txn.has_numeric_keys()) {
+    return false;
+  }
+
+  Reset();
+  bool any_scanned = false;
+  vector<std::pair<Key, Record>> range;
+  while (NextCommand(txn.code())) {
+    if (cmd_ != "SCAN") {
+      continue;
+    }
+    if (!storage.Scan(args_[0], args_[1], range)) {
+      // The storage does not keep its keys ordered so the keys are read one by one
+      return false;
+    }
+    if (!any_scanned) {
+      records.assign(flat_txn.num_keys(), std::nullopt);
+      scanned.assign(flat_txn.num_keys(), false);
+      any_scanned = true;
+    }
+    for (auto& [key, record] : range) {
+      auto i = flat_txn.Find(key);
+      if (i != FlatTxn::kNotFound) {
+        records[i] = move(record);
+      }
+    }
+    // The keys of the range that do not exist are not looked up either
+    auto start = ParseNumericKey(args_[0]);
+    auto end = ParseNumericKey(args_[1]);
+    for (size_t i = 0; i < flat_txn.num_keys(); i++) {
+      if (flat_txn.numeric_key(i) >= start && flat_txn.numeric_key(i) < end) {
+        scanned[i] = true;
+      }
+    }
+  }
+  return any_scanned;
+}
+
+bool KeyValueCommands::DeclareScannedKeys(Transaction& txn, bool integer_keys) {
+  Reset();
+  auto& keys = *txn.mutable_keys();
+  uint64_t num_scanned_keys = 0;
+  // NextCommand aborts the txn on an invalid command so it is rejected before being ordered
+  while (NextCommand(txn.code())) {
+    if (cmd_ != "SCAN") {
+      continue;
+    }
+    if (!integer_keys) {
+      Abort() << "SCAN requires integer keys so that the keys of its range can be declared";
+      break;
+    }
+    uint64_t start, end;
+    try {
+      start = ParseNumericKey(args_[0]);
+      end = ParseNumericKey(args_[1]);
+    } catch (std::invalid_argument&) {
+      Abort() << "Scan range must be integers: [" << args_[0] << ", " << args_[1] << ")";
+      break;
+    }
+    if (start > end) {
+      Abort() << "Invalid scan range: [" << start << ", " << end << ")";
+      break;
+    }
+    if (end - start > kMaxScanKeys - num_scanned_keys) {
+      Abort() << "Too many keys to scan. At most " << kMaxScanKeys << " keys can be scanned by a txn";
+      break;
+    }
+    num_scanned_keys += end - start;
+    for (auto key = start; key < end; key++) {
+      // Does not change the type of a key that is also written
+      keys[std::to_string(key)];
+    }
+  }
+
+  if (aborted_) {
+    txn.set_status(TransactionStatus::ABORTED);
+    txn.set_abort_reason(abort_reason_.str());
+    return false;
+  }
+  return true;
+}
+
 void KeyValueCommands::Reset() {
   pos_ = 0;
   aborted_ = false;
@@ -106,6 +198,6 @@ bool KeyValueCommands::NextCommand(const string& code) {
   return true;
 }
 
-void TPCCCommands::Execute(Transaction& /*txn*/) {}
+void TPCCCommands::Execute(Transaction& /*txn*/, FlatTxn& /*flat_txn*/) {}
 
 }  // namespace slog
\ No newline at end of file
@@ -1,23 +1,82 @@
 #pragma once
 
+#include <optional>
 #include <sstream>
 #include <unordered_map>
 #include <vector>
 
+#include "common/flat_txn.h"
 #include "common/types.h"
 #include "proto/transaction.pb.h"
+#include "storage/storage.h"
 
 namespace slog {
 
 class Commands {
  public:
   virtual ~Commands() = default;
-  virtual void Execute(Transaction& txn) = 0;
+
+  /**
+   * Runs the code of a txn against its flattened keys. The outcome is set on the txn and the
+   * writes are left in the slots of the flat txn
+   */
+  virtual void Execute(Transaction& txn, FlatTxn& flat_txn) = 0;
+
+  /**
+   * Runs the code of a txn that has not been flattened and moves the writes back into it
+   */
+  void Execute(Transaction& txn) {
+    FlatTxn flat_txn(txn);
+    Execute(txn, flat_txn);
+    flat_txn.MoveTo(txn);
+  }
+
+  /**
+   * Reads the keys that the code of a txn reads by range from the ordered index of the storage.
+   * records[i] receives the record of the key at index i of the flat txn, if it exists, and
+   * scanned[i] is set if that key is only read by range so that it does not have to be looked
+   * up again. Returns false, without touching records, if no key is read this way
+   */
+  virtual bool ReadRanges(const Transaction& /* txn */, const FlatTxn& /* flat_txn */,
+                          const Storage<Key, Record>& /* storage */, std::vector<std::optional<Record>>& /* records */,
+                          std::vector<bool>& /* scanned */) {
+    return false;
+  }
 };
 
+/**
+ * Commands:
+ *    GET key
+ *    SET key value
+ *    DEL key
+ *    COPY src dst
+ *    EQ key value
+ *    SLEEP seconds
+ *    SCAN start end
+ *
+ * SCAN reads all keys in [start, end). Like for GET, these keys must be among the keys of the
+ * txn so that the lock footprint of a scan is known before the txn is ordered, which is why
+ * scans require integer keys. The keys of the ranges are read through the ordered index of
+ * the storage if it has one, so that only the keys that exist are looked up.
+ */
 class KeyValueCommands : public Commands {
  public:
-  void Execute(Transaction& txn) final;
+  // Maximum number of keys in the ranges of all SCAN commands of a txn
+  static constexpr uint64_t kMaxScanKeys = 100000;
+
+  using Commands::Execute;
+  void Execute(Transaction& txn, FlatTxn& flat_txn) final;
+
+  bool ReadRanges(const Transaction& txn, const FlatTxn& flat_txn, const Storage<Key, Record>& storage,
+                  std::vector<std::optional<Record>>& records, std::vector<bool>& scanned) final;
+
+  /**
+   * Adds every key in the ranges of the SCAN commands of the txn to its keys as a READ key.
+   * integer_keys tells whether all keys are integers, without which the keys of a range cannot
+   * be enumerated. Returns false and aborts the txn if its code is not valid, if it scans without
+   * integer keys or if a range is not valid.
+   */
+  bool DeclareScannedKeys(Transaction& txn, bool integer_keys);
 
  private:
   static const std::unordered_map<std::string, size_t> COMMAND_NUM_ARGS;
@@ -35,7 +94,8 @@ class KeyValueCommands : public Commands {
 
 class TPCCCommands : public Commands {
  public:
-  void Execute(Transaction& txn) final;
+  using Commands::Execute;
+  void Execute(Transaction& txn, FlatTxn& flat_txn) final;
 };
 
 }  // namespace slog
\ No newline at end of file
@@ -26,28 +26,30 @@ vector<TxnId> LockQueueTail::AcquireWriteLock(TxnId txn_id) {
   return deps;
 }
 
-AcquireLocksResult DDRLockManager::AcquireLocks(const Transaction& txn) {
-  auto txn_id = txn.internal().id();
-  auto home = txn.internal().home();
-  auto is_remaster = txn.procedure_case() == Transaction::kRemaster;
+template <typename K>
+AcquireLocksResult DDRLockManager<K>::AcquireLocks(const FlatTxn& txn) {
+  auto txn_id = txn.id();
+  auto home = txn.home();
+  auto is_remaster = txn.is_remaster();
 
   // A remaster txn only has one key K but it acquires locks on (K, RO) and (K, RN)
   // where RO and RN are the old and new region respectively.
-  auto num_required_locks = is_remaster ? 2 : txn.keys_size();
+  auto num_required_locks = is_remaster ? 2 : txn.num_keys();
   auto ins = txn_info_.try_emplace(txn_id, num_required_locks);
 
   int num_relevant_locks = 0;
   vector<TxnId> blocking_txns;
-  for (const auto& [key, value] : txn.keys()) {
-    if (!is_remaster && static_cast<int>(value.metadata().master()) != home) {
+  for (size_t i = 0; i < txn.num_keys(); i++) {
+    const auto& slot = txn.slot(i);
+    if (!is_remaster && static_cast<int>(slot.metadata.master) != home) {
       continue;
     }
     ++num_relevant_locks;
 
-    auto key_replica = MakeKeyReplica(key, home);
+    auto key_replica = MakeKeyReplica(txn.key_as<K>(i), home);
     auto& lock_queue_tail = lock_table_[key_replica];
 
-    switch (value.type()) {
+    switch (slot.type) {
       case KeyType::READ: {
         auto b_txn = lock_queue_tail.AcquireReadLock(txn_id);
         if (b_txn.has_value()) {
@@ -99,7 +101,8 @@ AcquireLocksResult DDRLockManager::AcquireLocks(const Transaction& txn) {
   return AcquireLocksResult::WAITING;
 }
 
-vector<TxnId> DDRLockManager::ReleaseLocks(TxnId txn_id) {
+template <typename K>
+vector<TxnId> DDRLockManager<K>::ReleaseLocks(TxnId txn_id) {
   vector<TxnId> result;
   auto txn_info_it = txn_info_.find(txn_id);
   if (txn_info_it == txn_info_.end()) {
@@ -146,7 +149,8 @@ vector<TxnId> DDRLockManager::ReleaseLocks(TxnId txn_id) {
  *    ],
  * }
  */
-void DDRLockManager::GetStats(rapidjson::Document& stats, uint32_t level) const {
+template <typename K>
+void DDRLockManager<K>::GetStats(rapidjson::Document& stats, uint32_t level) const {
   using rapidjson::StringRef;
 
   auto& alloc = stats.GetAllocator();
@@ -169,7 +173,7 @@ void DDRLockManager::GetStats(rapidjson::Document& stats, uint32_t level) const
     rapidjson::Value lock_table(rapidjson::kArrayType);
     for (const auto& [key, lock_state] : lock_table_) {
       rapidjson::Value entry(rapidjson::kArrayType);
-      rapidjson::Value key_json(key.c_str(), alloc);
+      rapidjson::Value key_json(LockKeyToString(key).c_str(), alloc);
       entry.PushBack(key_json, alloc)
           .PushBack(lock_state.write_lock_requester().value_or(0), alloc)
           .PushBack(ToJsonArray(lock_state.read_lock_requesters(), alloc), alloc);
@@ -179,4 +183,7 @@ void DDRLockManager::GetStats(rapidjson::Document& stats, uint32_t level) const
   }
 }
 
+template class DDRLockManager<Key>;
+template class DDRLockManager<uint64_t>;
+
 }  // namespace slog
\ No newline at end of file
@@ -67,7 +67,11 @@ class LockQueueTail {
  * transactions hold separate locks for the same key, then one has an
  * incorrect master and will be aborted. Remaster transactions request the
  * locks for both <key, old replica> and <key, new replica>.
+ *
+ * K is the type of the keys: Key, or uint64_t for the parsed keys of simple
+ * partitioning.
  */
+template <typename K = Key>
 class DDRLockManager {
  public:
   /**
@@ -79,7 +83,7 @@ class DDRLockManager {
    * @return    true if all locks are acquired, false if not and
    *            the transaction is queued up.
    */
-  AcquireLocksResult AcquireLocks(const Transaction& txn);
+  AcquireLocksResult AcquireLocks(const FlatTxn& txn);
 
   /**
    * Releases all locks that a transaction is holding or waiting for.
@@ -108,7 +112,7 @@ class DDRLockManager {
     bool is_ready() const { return waiting_for_cnt == 0 && unarrived_lock_requests == 0; }
   };
   unordered_map<TxnId, TxnInfo> txn_info_;
-  unordered_map<KeyReplica, LockQueueTail> lock_table_;
+  unordered_map<KeyReplicaOf<K>, LockQueueTail, KeyReplicaHashOf<K>> lock_table_;
 };
 
 }  // namespace slog
\ No newline at end of file
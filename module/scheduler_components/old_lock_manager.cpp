@@ -101,18 +101,21 @@ unordered_set<TxnId> OldLockState::Release(TxnId txn_id) {
   return holders_;
 }
 
-AcquireLocksResult OldLockManager::AcquireLocks(const Transaction& txn) {
-  auto txn_id = txn.internal().id();
+template <typename K>
+AcquireLocksResult OldLockManager<K>::AcquireLocks(const FlatTxn& txn) {
+  auto txn_id = txn.id();
 
-  auto ins = txn_info_.try_emplace(txn_id, txn.keys_size());
+  auto ins = txn_info_.try_emplace(txn_id, txn.num_keys());
   auto& txn_info = ins.first->second;
 
-  for (const auto& [key, value] : txn.keys()) {
+  for (size_t i = 0; i < txn.num_keys(); i++) {
+    const auto& slot = txn.slot(i);
     // Skip keys that does not belong to the assigned home
-    if (static_cast<int>(value.metadata().master()) != txn.internal().home()) {
+    if (static_cast<int>(slot.metadata.master) != txn.home()) {
       continue;
     }
 
+    auto key = txn.key_as<K>(i);
     txn_info.keys.push_back(key);
 
     auto& lock_state = lock_table_[key];
@@ -120,7 +123,7 @@ AcquireLocksResult OldLockManager::AcquireLocks(const Transaction& txn) {
     DCHECK(!lock_state.Contains(txn_id)) << "Txn requested lock twice: " << txn_id << ", " << key;
 
     auto before_mode = lock_state.mode;
-    switch (value.type()) {
+    switch (slot.type) {
       case KeyType::READ:
         if (lock_state.AcquireReadLock(txn_id)) {
           txn_info.num_waiting_for--;
@@ -146,7 +149,8 @@ AcquireLocksResult OldLockManager::AcquireLocks(const Transaction& txn) {
   return AcquireLocksResult::WAITING;
 }
 
-vector<TxnId> OldLockManager::ReleaseLocks(TxnId txn_id) {
+template <typename K>
+vector<TxnId> OldLockManager<K>::ReleaseLocks(TxnId txn_id) {
   vector<TxnId> result;
   auto info_it = txn_info_.find(txn_id);
   if (info_it == txn_info_.end()) {
@@ -211,7 +215,8 @@ vector<TxnId> OldLockManager::ReleaseLocks(TxnId txn_id) {
  *    ],
  * }
  */
-void OldLockManager::GetStats(rapidjson::Document& stats, uint32_t level) const {
+template <typename K>
+void OldLockManager<K>::GetStats(rapidjson::Document& stats, uint32_t level) const {
   using rapidjson::StringRef;
 
   auto& alloc = stats.GetAllocator();
@@ -235,7 +240,7 @@ void OldLockManager::GetStats(rapidjson::Document& stats, uint32_t level) const
         continue;
       }
       rapidjson::Value entry(rapidjson::kArrayType);
-      rapidjson::Value key_json(key.c_str(), alloc);
+      rapidjson::Value key_json(LockKeyToString(key).c_str(), alloc);
       entry.PushBack(key_json, alloc)
           .PushBack(static_cast<uint32_t>(lock_state.mode), alloc)
           .PushBack(ToJsonArray(lock_state.GetHolders(), alloc), alloc)
@@ -248,4 +253,7 @@ void OldLockManager::GetStats(rapidjson::Document& stats, uint32_t level) const
   }
 }
 
+template class OldLockManager<Key>;
+template class OldLockManager<uint64_t>;
+
 }  // namespace slog
\ No newline at end of file
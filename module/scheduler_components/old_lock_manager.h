@@ -55,7 +55,11 @@ class OldLockState {
  * This is a deterministic lock manager which grants locks for transactions
  * in the order that they request. If transaction X, appears before
  * transaction Y in the log, X always gets all locks before Y.
+ *
+ * K is the type of the keys: Key, or uint64_t for the parsed keys of simple
+ * partitioning.
  */
+template <typename K = Key>
 class OldLockManager {
  public:
   /**
@@ -67,7 +71,7 @@ class OldLockManager {
    * @return    true if all locks are acquired, false if not and
    *            the transaction is queued up.
    */
-  AcquireLocksResult AcquireLocks(const Transaction& txn);
+  AcquireLocksResult AcquireLocks(const FlatTxn& txn);
 
   /**
    * Releases all locks that a transaction is holding or waiting for.
@@ -93,10 +97,10 @@ class OldLockManager {
     bool is_ready() const { return num_waiting_for == 0; }
 
     int num_waiting_for;
-    std::vector<Key> keys;
+    std::vector<K> keys;
   };
   unordered_map<TxnId, TxnInfo> txn_info_;
-  unordered_map<Key, OldLockState> lock_table_;
+  unordered_map<K, OldLockState> lock_table_;
   uint32_t num_locked_keys_ = 0;
 };
 
@@ -101,25 +101,27 @@ unordered_set<TxnId> LockState::Release(TxnId txn_id) {
   return holders_;
 }
 
-AcquireLocksResult RMALockManager::AcquireLocks(const Transaction& txn) {
-  auto txn_id = txn.internal().id();
-  auto home = txn.internal().home();
-  auto is_remaster = txn.procedure_case() == Transaction::kRemaster;
+template <typename K>
+AcquireLocksResult RMALockManager<K>::AcquireLocks(const FlatTxn& txn) {
+  auto txn_id = txn.id();
+  auto home = txn.home();
+  auto is_remaster = txn.is_remaster();
 
   // A remaster txn only has one key K but it acquires locks on (K, RO) and (K, RN)
   // where RO and RN are the old and new region respectively.
-  auto num_required_locks = is_remaster ? 2 : txn.keys_size();
+  auto num_required_locks = is_remaster ? 2 : txn.num_keys();
   auto ins = txn_info_.try_emplace(txn_id, num_required_locks);
   auto& txn_info = ins.first->second;
 
-  for (const auto& [key, value] : txn.keys()) {
+  for (size_t i = 0; i < txn.num_keys(); i++) {
+    const auto& slot = txn.slot(i);
     // Skip keys that does not belong to the assigned home. Remaster txn is an exception where
     // it is allowed that the metadata on the txn does not match its assigned home
-    if (!is_remaster && static_cast<int>(value.metadata().master()) != home) {
+    if (!is_remaster && static_cast<int>(slot.metadata.master) != home) {
       continue;
     }
 
-    auto key_replica = MakeKeyReplica(key, home);
+    auto key_replica = MakeKeyReplica(txn.key_as<K>(i), home);
     txn_info.keys.push_back(key_replica);
 
     auto& lock_state = lock_table_[key_replica];
@@ -127,7 +129,7 @@ AcquireLocksResult RMALockManager::AcquireLocks(const Transaction& txn) {
     DCHECK(!lock_state.Contains(txn_id)) << "Txn requested lock twice: " << txn_id << ", " << key_replica;
 
     auto before_mode = lock_state.mode;
-    switch (value.type()) {
+    switch (slot.type) {
       case KeyType::READ:
         if (lock_state.AcquireReadLock(txn_id)) {
           txn_info.num_waiting_for--;
@@ -152,7 +154,8 @@ AcquireLocksResult RMALockManager::AcquireLocks(const Transaction& txn) {
   return AcquireLocksResult::WAITING;
 }
 
-vector<TxnId> RMALockManager::ReleaseLocks(TxnId txn_id) {
+template <typename K>
+vector<TxnId> RMALockManager<K>::ReleaseLocks(TxnId txn_id) {
   vector<TxnId> result;
   auto info_it = txn_info_.find(txn_id);
   if (info_it == txn_info_.end()) {
@@ -218,7 +221,8 @@ vector<TxnId> RMALockManager::ReleaseLocks(TxnId txn_id) {
  *    ],
  * }
  */
-void RMALockManager::GetStats(rapidjson::Document& stats, uint32_t level) const {
+template <typename K>
+void RMALockManager<K>::GetStats(rapidjson::Document& stats, uint32_t level) const {
   using rapidjson::StringRef;
 
   auto& alloc = stats.GetAllocator();
@@ -242,7 +246,7 @@ void RMALockManager::GetStats(rapidjson::Document& stats, uint32_t level) const
         continue;
       }
       rapidjson::Value entry(rapidjson::kArrayType);
-      rapidjson::Value key_json(key.c_str(), alloc);
+      rapidjson::Value key_json(LockKeyToString(key).c_str(), alloc);
       entry.PushBack(key_json, alloc)
           .PushBack(static_cast<uint32_t>(lock_state.mode), alloc)
           .PushBack(ToJsonArray(lock_state.GetHolders(), alloc), alloc)
@@ -255,4 +259,7 @@ void RMALockManager::GetStats(rapidjson::Document& stats, uint32_t level) const
   }
 }
 
+template class RMALockManager<Key>;
+template class RMALockManager<uint64_t>;
+
 }  // namespace slog
\ No newline at end of file
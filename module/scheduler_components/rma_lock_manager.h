@@ -66,7 +66,11 @@ class LockState {
  * transactions hold separate locks for the same key, then one has an
  * incorrect master and will be aborted. Remaster transactions request the
  * locks for both <key, old replica> and <key, new replica>.
+ *
+ * K is the type of the keys: Key, or uint64_t for the parsed keys of simple
+ * partitioning, which are locked without building a string per key.
  */
+template <typename K = Key>
 class RMALockManager {
  public:
   /**
@@ -78,7 +82,7 @@ class RMALockManager {
    * @return    true if all locks are acquired, false if not and
    *            the transaction is queued up.
    */
-  AcquireLocksResult AcquireLocks(const Transaction& txn);
+  AcquireLocksResult AcquireLocks(const FlatTxn& txn);
 
   /**
    * Releases all locks that a transaction is holding or waiting for.
@@ -103,10 +107,10 @@ class RMALockManager {
     bool is_ready() const { return num_waiting_for == 0; }
 
     int num_waiting_for;
-    std::vector<Key> keys;
+    std::vector<KeyReplicaOf<K>> keys;
   };
   unordered_map<TxnId, TxnInfo> txn_info_;
-  unordered_map<KeyReplica, LockState> lock_table_;
+  unordered_map<KeyReplicaOf<K>, LockState, KeyReplicaHashOf<K>> lock_table_;
   uint32_t num_locked_keys_ = 0;
 };
 
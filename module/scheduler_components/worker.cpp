@@ -8,6 +8,7 @@
 
 #include <thread>
 
+#include "common/compression.h"
 #include "common/monitor.h"
 #include "common/proto_utils.h"
 #include "module/scheduler.h"
@@ -18,23 +19,35 @@ using internal::Envelope;
 using internal::Request;
 using internal::Response;
 
+namespace {
+
+// How often to check again for durability after the first group commit interval has passed
+const auto kWalRecheckInterval = 100us;
+
+}  // namespace
+
 Worker::Worker(const ConfigurationPtr& config, const std::shared_ptr<Broker>& broker, Channel channel,
-               const shared_ptr<Storage<Key, Record>>& storage, std::chrono::milliseconds poll_timeout)
+               const shared_ptr<Storage<Key, Record>>& storage, const shared_ptr<WriteAheadLog>& wal,
+               const shared_ptr<TxnQueue>& txn_queue, const shared_ptr<DoneQueue>& done_queue,
+               std::chrono::milliseconds poll_timeout)
     : NetworkedModule("Worker-" + std::to_string(channel), broker, channel, poll_timeout),
       config_(config),
       storage_(storage),
+      wal_(wal),
+      txn_queue_(txn_queue),
+      done_queue_(done_queue),
       // TODO: change this dynamically based on selected experiment
-      commands_(new KeyValueCommands()) {}
-
-void Worker::Initialize() {
-  zmq::socket_t sched_socket(*context(), ZMQ_DEALER);
-  sched_socket.set(zmq::sockopt::rcvhwm, 0);
-  sched_socket.set(zmq::sockopt::sndhwm, 0);
-  sched_socket.connect(MakeInProcChannelAddress(kWorkerChannel));
-
-  AddCustomSocket(std::move(sched_socket));
+      commands_(new KeyValueCommands()),
+      compression_min_size_(0),
+      compressed_remote_reads_(false) {
+  if (auto compression = config_->value_compression(); compression != nullptr) {
+    compression_min_size_ = compression->min_size_bytes();
+    compressed_remote_reads_ = compression->compressed_remote_reads();
+  }
 }
 
+void Worker::Initialize() { AddCustomQueue(*txn_queue_); }
+
 void Worker::OnInternalRequestReceived(EnvelopePtr&& env) {
   if (env->request().type_case() != Request::kRemoteReadResult) {
     LOG(FATAL) << "Invalid request for worker";
@@ -60,9 +73,7 @@ void Worker::OnInternalRequestReceived(EnvelopePtr&& env) {
       txn.set_abort_reason(read_result.abort_reason());
     } else {
       // Apply remote reads.
-      for (const auto& kv : read_result.reads()) {
-        txn.mutable_keys()->insert(kv);
-      }
+      state.txn_holder->flat_txn().AddRemoteReads(read_result.reads());
     }
   }
 
@@ -82,14 +93,11 @@ void Worker::OnInternalRequestReceived(EnvelopePtr&& env) {
 }
 
 bool Worker::OnCustomSocket() {
-  auto& sched_socket = GetCustomSocket(0);
-
-  zmq::message_t msg;
-  if (!sched_socket.recv(msg, zmq::recv_flags::dontwait)) {
+  TxnHolder* txn_holder;
+  if (!txn_queue_->Pop(txn_holder)) {
     return false;
   }
 
-  auto txn_holder = *msg.data<TxnHolder*>();
   auto& txn = txn_holder->txn();
   auto txn_id = txn.internal().id();
 
@@ -149,6 +157,7 @@ void Worker::ReadLocalStorage(TxnId txn_id) {
   auto& state = TxnState(txn_id);
   auto txn_holder = state.txn_holder;
   auto& txn = txn_holder->txn();
+  auto& flat_txn = txn_holder->flat_txn();
 
   if (txn.status() != TransactionStatus::ABORTED) {
 #if defined(REMASTER_PROTOCOL_SIMPLE) || defined(REMASTER_PROTOCOL_PER_KEY)
@@ -173,20 +182,46 @@ void Worker::ReadLocalStorage(TxnId txn_id) {
 
     // We don't need to check if keys are in partition here since the assumption is that
     // the out-of-partition keys have already been removed
-    for (auto& [key, value] : *(txn.mutable_keys())) {
-      Record record;
-      if (storage_->Read(key, record)) {
+    std::vector<std::optional<Record>> records;
+    std::vector<bool> scanned;
+    if (commands_->ReadRanges(txn, flat_txn, *storage_, records, scanned)) {
+      // Only the keys that are not read by range are looked up one by one
+      std::vector<const Key*> keys;
+      std::vector<size_t> indices;
+      for (size_t i = 0; i < flat_txn.num_keys(); i++) {
+        if (!scanned[i]) {
+          keys.push_back(flat_txn.key_ptrs()[i]);
+          indices.push_back(i);
+        }
+      }
+      std::vector<std::optional<Record>> point_records;
+      storage_->MultiRead(keys, point_records);
+      for (size_t j = 0; j < indices.size(); j++) {
+        records[indices[j]] = std::move(point_records[j]);
+      }
+    } else {
+      storage_->MultiRead(flat_txn.key_ptrs(), records);
+    }
+
+    for (size_t i = 0; i < flat_txn.num_keys(); i++) {
+      const auto& record = records[i];
+      auto& slot = flat_txn.slot(i);
+      if (record.has_value()) {
         // Check whether the store master metadata matches with the information
         // stored in the transaction
-        if (value.metadata().master() != record.metadata.master) {
+        if (slot.metadata.master != record->metadata.master) {
           txn.set_status(TransactionStatus::ABORTED);
           txn.set_abort_reason("Outdated master");
           break;
         }
-        value.set_value(record.to_string());
-      } else if (txn.procedure_case() == Transaction::kRemaster) {
+        slot.value.assign(record->view());
+        slot.compressed = record->compressed();
+        if (!compressed_remote_reads_) {
+          DecompressInPlace(slot.value, slot.compressed);
+        }
+      } else if (flat_txn.is_remaster()) {
         txn.set_status(TransactionStatus::ABORTED);
-        txn.set_abort_reason("Remaster non-existent key " + key);
+        txn.set_abort_reason("Remaster non-existent key " + flat_txn.key(i));
         break;
       }
     }
@@ -221,7 +256,7 @@ void Worker::Execute(TxnId txn_id) {
         break;
       }
       // Execute the transaction code
-      commands_->Execute(txn);
+      commands_->Execute(txn, state.txn_holder->flat_txn());
       break;
     }
     case Transaction::kRemaster:
@@ -236,6 +271,7 @@ void Worker::Execute(TxnId txn_id) {
 void Worker::Commit(TxnId txn_id) {
   auto& state = TxnState(txn_id);
   auto& txn = state.txn_holder->txn();
+  auto& flat_txn = state.txn_holder->flat_txn();
   switch (txn.procedure_case()) {
     case Transaction::kCode: {
       // Apply all writes to local storage if the transaction is not aborted
@@ -243,36 +279,97 @@ void Worker::Commit(TxnId txn_id) {
         VLOG(3) << "Txn " << txn_id << " aborted with reason: " << txn.abort_reason();
         break;
       }
-      for (const auto& [key, value] : txn.keys()) {
-        if (value.type() == KeyType::READ) {
-          continue;
+      WriteAheadLogRecord log_record;
+      std::vector<const Key*> keys;
+      std::vector<const FlatTxn::Slot*> values;
+      for (size_t i = 0; i < flat_txn.num_keys(); i++) {
+        const auto& key = flat_txn.key(i);
+        const auto& slot = flat_txn.slot(i);
+        if (slot.type != KeyType::READ && KeyIsInLocalPartition(flat_txn, i)) {
+          keys.push_back(&key);
+          values.push_back(&slot);
         }
-        if (config_->key_is_in_local_partition(key)) {
-          Record record;
-          if (!storage_->Read(key, record)) {
-            record.metadata = value.metadata();
+      }
+      // Values are compressed before the storage segments are locked
+      std::vector<std::string> compressed(keys.size());
+      std::vector<bool> is_compressed(keys.size());
+      for (size_t i = 0; i < keys.size(); i++) {
+        is_compressed[i] = MaybeCompressValue(values[i]->new_value, compression_min_size_, compressed[i]);
+      }
+      auto stored_value = [&](size_t i) -> const std::string& {
+        return is_compressed[i] ? compressed[i] : values[i]->new_value;
+      };
+      // Storage segments are locked while records are modified so the log record is built afterwards
+      std::vector<Metadata> metadata(keys.size());
+      auto log_position = state.txn_holder->log_position();
+      storage_->ReadModifyWriteAt(
+          keys,
+          [&](size_t i, Record& record, bool exists) {
+            if (!exists) {
+              record.metadata = values[i]->metadata;
+            }
+            record.SetValue(stored_value(i), is_compressed[i]);
+            metadata[i] = record.metadata;
+          },
+          log_position);
+      if (wal_ != nullptr) {
+        for (size_t i = 0; i < keys.size(); i++) {
+          auto datum = log_record.add_writes();
+          datum->set_key(*keys[i]);
+          datum->set_record(stored_value(i));
+          datum->set_master(metadata[i].master);
+          datum->set_counter(metadata[i].counter);
+          datum->set_compressed(is_compressed[i]);
+        }
+      }
+      for (auto i : flat_txn.deleted()) {
+        const auto& key = flat_txn.key(i);
+        if (KeyIsInLocalPartition(flat_txn, i)) {
+          storage_->DeleteAt(key, log_position);
+          if (wal_ != nullptr) {
+            log_record.add_deleted_keys(key);
           }
-          record.SetValue(value.new_value());
-          storage_->Write(key, record);
         }
       }
-      for (const auto& key : txn.deleted_keys()) {
-        if (config_->key_is_in_local_partition(key)) {
-          storage_->Delete(key);
+      if (wal_ != nullptr) {
+        // A read-only txn may have read the writes of a txn that is not durable yet, so
+        // it has to wait for everything that has been logged so far
+        if (log_record.writes().empty() && log_record.deleted_keys().empty()) {
+          state.wal_lsn = wal_->last_lsn();
+        } else {
+          state.wal_lsn = wal_->Append(log_record);
         }
       }
       VLOG(3) << "Committed txn " << txn_id;
       break;
     }
     case Transaction::kRemaster: {
-      auto key_it = txn.keys().begin();
-      const auto& key = key_it->first;
-      if (config_->key_is_in_local_partition(key)) {
-        Record record;
-        storage_->Read(key, record);
-        auto new_counter = key_it->second.metadata().counter() + 1;
-        record.metadata = Metadata(txn.remaster().new_master(), new_counter);
-        storage_->Write(key, record);
+      const auto& key = flat_txn.key(0);
+      if (KeyIsInLocalPartition(flat_txn, 0)) {
+        auto new_counter = flat_txn.slot(0).metadata.counter + 1;
+        Metadata new_metadata(txn.remaster().new_master(), new_counter);
+        string value;
+        bool compressed = false;
+        storage_->ReadModifyWriteAt(
+            {&key},
+            [&](size_t, Record& record, bool) {
+              record.metadata = new_metadata;
+              if (wal_ != nullptr) {
+                value = record.to_string();
+                compressed = record.compressed();
+              }
+            },
+            state.txn_holder->log_position());
+        if (wal_ != nullptr) {
+          WriteAheadLogRecord log_record;
+          auto datum = log_record.add_writes();
+          datum->set_key(key);
+          datum->set_record(value);
+          datum->set_master(new_metadata.master);
+          datum->set_counter(new_metadata.counter);
+          datum->set_compressed(compressed);
+          state.wal_lsn = wal_->Append(log_record);
+        }
 
         state.txn_holder->SetRemasterResult(key, new_counter);
       }
@@ -292,10 +389,11 @@ void Worker::Finish(TxnId txn_id) {
   // send the transaction to the server.
   SendToCoordinatingServer(txn_id);
 
-  // Notify the scheduler that we're done
-  zmq::message_t msg(sizeof(TxnId));
-  *msg.data<TxnId>() = txn_id;
-  GetCustomSocket(0).send(msg, zmq::send_flags::none);
+  // Notify the scheduler that we're done. The scheduler does not publish the log position of the
+  // txn to snapshot reads until its writes are durable
+  auto& state = TxnState(txn_id);
+  state.txn_holder->SetWalLsn(state.wal_lsn);
+  done_queue_->Push(txn_id);
 
   // Remove the redirection at broker for this txn
   auto redirect_env = NewEnvelope();
@@ -330,11 +428,14 @@ void Worker::NotifyOtherPartitions(TxnId txn_id) {
   rrr->set_will_abort(aborted);
   rrr->set_abort_reason(txn.abort_reason());
   if (!aborted) {
+    const auto& flat_txn = txn_holder->flat_txn();
     auto reads_to_be_sent = rrr->mutable_reads();
-    for (const auto& [key, value] : txn.keys()) {
-      auto& read = (*reads_to_be_sent)[key];
-      read.set_value(value.value());
-      read.set_type(value.type());
+    for (size_t i = 0; i < flat_txn.num_keys(); i++) {
+      const auto& slot = flat_txn.slot(i);
+      auto& read = (*reads_to_be_sent)[flat_txn.key(i)];
+      read.set_value(slot.value);
+      read.set_type(slot.type);
+      read.set_compressed(slot.compressed);
     }
   }
 
@@ -349,30 +450,68 @@ void Worker::NotifyOtherPartitions(TxnId txn_id) {
   Send(env, destinations, txn_id, config_->broker_ports_size() - 1);
 }
 
+bool Worker::KeyIsInLocalPartition(const FlatTxn& flat_txn, size_t i) const {
+  if (flat_txn.has_numeric_keys()) {
+    return config_->partition_of_key(flat_txn.numeric_key(i)) == config_->local_partition();
+  }
+  return config_->key_is_in_local_partition(flat_txn.key(i));
+}
+
 void Worker::SendToCoordinatingServer(TxnId txn_id) {
   auto& state = TxnState(txn_id);
-  auto txn_holder = state.txn_holder;
-
-  // Send the txn back to the coordinating server
-  Envelope env;
-  auto completed_sub_txn = env.mutable_request()->mutable_completed_subtxn();
-  completed_sub_txn->set_partition(config_->local_partition());
-
-  auto txn = txn_holder->Release();
+  if (!config_->return_dummy_txn()) {
+    state.txn_holder->flat_txn().MoveTo(state.txn_holder->txn());
+  }
+  auto [txn, arena] = state.txn_holder->Release();
   if (config_->return_dummy_txn()) {
     txn->mutable_keys()->clear();
     txn->mutable_code()->clear();
     txn->mutable_remaster()->Clear();
   }
+
+  // Send the txn back to the coordinating server. The envelope is allocated in the arena of
+  // the txn, if any, so that the txn can be attached to it without being copied
+  CompletedSubTxn sub_txn{std::move(arena), nullptr};
+  sub_txn.env.reset(google::protobuf::Arena::CreateMessage<Envelope>(sub_txn.arena.get()));
+  auto completed_sub_txn = sub_txn.env->mutable_request()->mutable_completed_subtxn();
+  completed_sub_txn->set_partition(config_->local_partition());
   completed_sub_txn->set_allocated_txn(txn);
-  Send(env, txn->internal().coordinating_server(), kServerChannel);
 
-  if (!config_->do_not_clean_up_txn()) {
+  if (wal_ != nullptr && state.wal_lsn > wal_->durable_lsn()) {
+    // Hold the result back until the writes of the txn are durable. Only the first
+    // pending sub-txn schedules a check since the check reschedules itself
+    if (non_durable_sub_txns_.empty()) {
+      NewTimedCallback(wal_->group_commit_interval(), [this]() { SendDurableSubTxns(); });
+    }
+    non_durable_sub_txns_.emplace_back(state.wal_lsn, std::move(sub_txn));
+    return;
+  }
+
+  SendCompletedSubTxn(sub_txn);
+}
+
+void Worker::SendCompletedSubTxn(CompletedSubTxn& sub_txn) {
+  auto completed_sub_txn = sub_txn.env->mutable_request()->mutable_completed_subtxn();
+  Send(*sub_txn.env, completed_sub_txn->txn().internal().coordinating_server(), kServerChannel);
+
+  // A txn in an arena is freed together with the arena
+  if (sub_txn.arena == nullptr && !config_->do_not_clean_up_txn()) {
     // This is an intentional memory leak
     completed_sub_txn->release_txn();
   }
 }
 
+void Worker::SendDurableSubTxns() {
+  auto durable_lsn = wal_->durable_lsn();
+  while (!non_durable_sub_txns_.empty() && non_durable_sub_txns_.front().first <= durable_lsn) {
+    SendCompletedSubTxn(non_durable_sub_txns_.front().second);
+    non_durable_sub_txns_.pop_front();
+  }
+  if (!non_durable_sub_txns_.empty()) {
+    NewTimedCallback(kWalRecheckInterval, [this]() { SendDurableSubTxns(); });
+  }
+}
+
 TransactionState& Worker::TxnState(TxnId txn_id) {
   auto state_it = txn_states_.find(txn_id);
   DCHECK(state_it != txn_states_.end());
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <deque>
 #include <functional>
 #include <optional>
 #include <unordered_map>
@@ -9,11 +10,13 @@
 #include "common/configuration.h"
 #include "common/txn_holder.h"
 #include "common/types.h"
+#include "connection/inproc_queue.h"
 #include "module/base/networked_module.h"
 #include "module/scheduler_components/commands.h"
 #include "proto/internal.pb.h"
 #include "proto/transaction.pb.h"
 #include "storage/storage.h"
+#include "storage/write_ahead_log.h"
 
 namespace slog {
 
@@ -21,10 +24,12 @@ struct TransactionState {
   enum class Phase { READ_LOCAL_STORAGE, WAIT_REMOTE_READ, EXECUTE, COMMIT, FINISH };
 
   TransactionState(TxnHolder* txn_holder)
-      : txn_holder(txn_holder), remote_reads_waiting_on(0), phase(Phase::READ_LOCAL_STORAGE) {}
+      : txn_holder(txn_holder), remote_reads_waiting_on(0), phase(Phase::READ_LOCAL_STORAGE), wal_lsn(0) {}
   TxnHolder* txn_holder;
   uint32_t remote_reads_waiting_on;
   Phase phase;
+  // The result of the transaction is not returned until the write-ahead log is durable up to this LSN
+  uint64_t wal_lsn;
 };
 
 /**
@@ -35,8 +40,16 @@ struct TransactionState {
  */
 class Worker : public NetworkedModule {
  public:
+  using TxnQueue = InProcQueue<TxnHolder*>;
+  using DoneQueue = InProcQueue<TxnId>;
+
+  /**
+   * @param txn_queue Txns dispatched to this worker by the scheduler
+   * @param done_queue Ids of the txns that this worker is done with, shared by all workers of the scheduler
+   */
   Worker(const ConfigurationPtr& config, const std::shared_ptr<Broker>& broker, Channel channel,
-         const std::shared_ptr<Storage<Key, Record>>& storage,
+         const std::shared_ptr<Storage<Key, Record>>& storage, const std::shared_ptr<WriteAheadLog>& wal,
+         const std::shared_ptr<TxnQueue>& txn_queue, const std::shared_ptr<DoneQueue>& done_queue,
          std::chrono::milliseconds poll_timeout_ms = kModuleTimeout);
 
   static Channel MakeChannel(int worker_num) { return kMaxChannel + worker_num; }
@@ -72,7 +85,7 @@ class Worker : public NetworkedModule {
   void Execute(TxnId txn_id);
 
   /**
-   * Applies the writes to local storage
+   * Applies the writes to local storage and appends them to the write-ahead log
    */
   void Commit(TxnId txn_id);
 
@@ -85,14 +98,41 @@ class Worker : public NetworkedModule {
 
   void SendToCoordinatingServer(TxnId txn_id);
 
+  // Uses the key parsed by the txn holder instead of parsing it again with simple partitioning
+  bool KeyIsInLocalPartition(const FlatTxn& flat_txn, size_t i) const;
+
+  struct CompletedSubTxn {
+    // Set if the txn is in the arena of its batch. Declared first so that it outlives the envelope
+    ArenaPtr arena;
+    std::unique_ptr<internal::Envelope, ArenaSharerDeleter<internal::Envelope>> env;
+  };
+
+  void SendCompletedSubTxn(CompletedSubTxn& sub_txn);
+
+  /**
+   * Sends the completed sub-txns whose writes have become durable. This
+   * keeps rescheduling itself until there is no more pending sub-txn.
+   */
+  void SendDurableSubTxns();
+
   // Precondition: txn_id must exists in txn states table
   TransactionState& TxnState(TxnId txn_id);
 
   ConfigurationPtr config_;
   std::shared_ptr<Storage<Key, Record>> storage_;
+  std::shared_ptr<WriteAheadLog> wal_;
+  std::shared_ptr<TxnQueue> txn_queue_;
+  std::shared_ptr<DoneQueue> done_queue_;
   std::unique_ptr<Commands> commands_;
+  // Written values of at least this size are compressed. Disabled if 0
+  uint32_t compression_min_size_;
+  // Whether values read from storage stay compressed in the txn until a command reads them
+  bool compressed_remote_reads_;
 
   std::unordered_map<TxnId, TransactionState> txn_states_;
+
+  // Completed sub-txns waiting for the write-ahead log to become durable, in increasing order of LSN
+  std::deque<std::pair<uint64_t, CompletedSubTxn>> non_durable_sub_txns_;
 };
 
 }  // namespace slog
\ No newline at end of file
@@ -1,8 +1,10 @@
 #include "module/server.h"
 
+#include "common/compression.h"
 #include "common/constants.h"
 #include "common/json_utils.h"
 #include "common/monitor.h"
+#include "common/string_utils.h"
 #include "connection/zmq_utils.h"
 #include "proto/internal.pb.h"
 
@@ -10,18 +12,43 @@ using std::move;
 
 namespace slog {
 
-void ValidateTransaction(Transaction* txn) {
+void ValidateTransaction(const ConfigurationPtr& config, Transaction* txn) {
   txn->set_status(TransactionStatus::ABORTED);
   if (txn->keys().empty()) {
     txn->set_abort_reason("Txn accesses no key");
     return;
   }
+  // Checked here so that the txn is not dropped by the forwarder or fails deeper in the system
+  if (config->simple_partitioning() != nullptr) {
+    for (const auto& [key, value] : txn->keys()) {
+      try {
+        ParseNumericKey(key);
+      } catch (std::invalid_argument&) {
+        txn->set_abort_reason("Key " + key + " is not a decimal integer without leading zeros");
+        return;
+      }
+    }
+  }
+  if (txn->read_only()) {
+    for (const auto& [key, value] : txn->keys()) {
+      if (value.type() != KeyType::READ) {
+        txn->set_abort_reason("Read-only txn writes key " + key);
+        return;
+      }
+    }
+  }
   txn->set_status(TransactionStatus::NOT_STARTED);
 }
 
 Server::Server(const ConfigurationPtr& config, const std::shared_ptr<Broker>& broker,
-               std::chrono::milliseconds poll_timeout)
-    : NetworkedModule("Server", broker, kServerChannel, poll_timeout), config_(config), txn_id_counter_(0) {}
+               const std::shared_ptr<MultiVersionStorage>& storage, std::chrono::milliseconds poll_timeout)
+    : NetworkedModule("Server", broker, kServerChannel, poll_timeout),
+      config_(config),
+      broker_(broker),
+      last_broker_stats_time_(std::chrono::steady_clock::now()),
+      last_broker_work_ns_(config->broker_ports_size(), 0),
+      storage_(storage),
+      txn_id_counter_(0) {}
 
 /***********************************************
                 Custom socket
@@ -55,14 +82,15 @@ bool Server::OnCustomSocket() {
     return false;
   }
   api::Request request;
-  if (!RecvDeserializedProtoWithEmptyDelim(socket, request)) {
+  uint8_t wire_version;
+  if (!RecvDeserializedProtoWithEmptyDelim(socket, request, false /* dont_wait */, &wire_version)) {
     LOG(ERROR) << "Invalid message from client: Body is not a proto";
     return false;
   }
 
   // While this is called txn id, we use it for any kind of request
   auto txn_id = NextTxnId();
-  auto res = pending_responses_.try_emplace(txn_id, move(identity), request.stream_id());
+  auto res = pending_responses_.try_emplace(txn_id, move(identity), request.stream_id(), wire_version);
   DCHECK(res.second) << "Duplicate transaction id: " << txn_id;
 
   switch (request.type_case()) {
@@ -75,12 +103,24 @@ bool Server::OnCustomSocket() {
       txn_internal->set_id(txn_id);
       txn_internal->set_coordinating_server(config_->local_machine_id());
 
-      ValidateTransaction(txn);
+      // The keys in the ranges of scans are declared here so that they are locked like the other keys
+      if (txn->procedure_case() == Transaction::kCode &&
+          !commands_.DeclareScannedKeys(*txn, config_->simple_partitioning() != nullptr)) {
+        SendTxnToClient(txn);
+        break;
+      }
+
+      ValidateTransaction(config_, txn);
       if (txn->status() == TransactionStatus::ABORTED) {
         SendTxnToClient(txn);
         break;
       }
 
+      if (txn->read_only() && ExecuteReadOnlyTxn(txn)) {
+        SendTxnToClient(txn);
+        break;
+      }
+
       TRACE(txn_internal, TransactionEvent::EXIT_SERVER_TO_FORWARDER);
 
       // Send to forwarder
@@ -93,12 +133,16 @@ bool Server::OnCustomSocket() {
       auto env = NewEnvelope();
       env->mutable_request()->mutable_stats()->set_id(txn_id);
       env->mutable_request()->mutable_stats()->set_level(request.stats().level());
+      env->mutable_request()->mutable_stats()->set_module(request.stats().module());
 
       // Send to appropriate module based on provided information
       switch (request.stats().module()) {
         case ModuleId::SERVER:
           ProcessStatsRequest(env->request().stats());
           break;
+        case ModuleId::BROKER:
+          ProcessBrokerStatsRequest(env->request().stats());
+          break;
         case ModuleId::FORWARDER:
           Send(move(env), kForwarderChannel);
           break;
@@ -109,6 +153,7 @@ bool Server::OnCustomSocket() {
           Send(move(env), kSequencerChannel);
           break;
         case ModuleId::SCHEDULER:
+        case ModuleId::STORAGE:
           Send(move(env), kSchedulerChannel);
           break;
         default:
@@ -138,6 +183,53 @@ void Server::OnInternalRequestReceived(EnvelopePtr&& env) {
   ProcessCompletedSubtxn(move(env));
 }
 
+bool Server::ExecuteReadOnlyTxn(Transaction* txn) {
+  if (storage_ == nullptr || txn->procedure_case() != Transaction::kCode) {
+    return false;
+  }
+  std::vector<const Key*> keys;
+  std::vector<ValueEntry*> values;
+  keys.reserve(txn->keys_size());
+  values.reserve(txn->keys_size());
+  for (auto& [key, value] : *txn->mutable_keys()) {
+    if (!config_->key_is_in_local_partition(key)) {
+      return false;
+    }
+    keys.push_back(&key);
+    values.push_back(&value);
+  }
+
+  std::optional<LogPosition> requested_position;
+  if (txn->has_snapshot_position()) {
+    requested_position = txn->snapshot_position();
+  }
+  auto position = storage_->AcquireSnapshot(requested_position);
+  if (!position.has_value()) {
+    txn->set_status(TransactionStatus::ABORTED);
+    txn->set_abort_reason(requested_position.has_value()
+                              ? "Snapshot at log position " + std::to_string(*requested_position) + " is not available"
+                              : "No snapshot is available");
+    return true;
+  }
+  std::vector<std::optional<Record>> records;
+  storage_->MultiReadAt(keys, *position, records);
+  storage_->ReleaseSnapshot(*position);
+
+  for (size_t i = 0; i < values.size(); i++) {
+    if (records[i].has_value()) {
+      values[i]->set_value(records[i]->to_string());
+      values[i]->set_compressed(records[i]->compressed());
+    }
+  }
+  txn->set_snapshot_position(*position);
+
+  commands_.Execute(*txn);
+
+  VLOG(3) << "Executed read-only txn " << txn->internal().id() << " at log position " << *position;
+
+  return true;
+}
+
 void Server::ProcessCompletedSubtxn(EnvelopePtr&& env) {
   auto completed_subtxn = env->mutable_request()->mutable_completed_subtxn();
   auto txn_internal = completed_subtxn->mutable_txn()->mutable_internal();
@@ -182,12 +274,43 @@ void Server::ProcessStatsRequest(const internal::StatsRequest& stats_request) {
                     alloc);
   }
 
+  SendStats(stats_request.id(), stats);
+}
+
+void Server::ProcessBrokerStatsRequest(const internal::StatsRequest& stats_request) {
+  using rapidjson::StringRef;
+
+  rapidjson::Document stats;
+  stats.SetObject();
+  auto& alloc = stats.GetAllocator();
+
+  auto now = std::chrono::steady_clock::now();
+  auto elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now - last_broker_stats_time_).count();
+  last_broker_stats_time_ = now;
+
+  rapidjson::Value saturation(rapidjson::kArrayType);
+  rapidjson::Value num_messages(rapidjson::kArrayType);
+  for (size_t i = 0; i < last_broker_work_ns_.size(); i++) {
+    const auto& thread_stats = broker_->thread_stats(i);
+    auto work_ns = thread_stats.work_ns.load(std::memory_order_relaxed);
+    saturation.PushBack(elapsed_ns > 0 ? static_cast<double>(work_ns - last_broker_work_ns_[i]) / elapsed_ns : 0.0,
+                        alloc);
+    num_messages.PushBack(thread_stats.num_messages.load(std::memory_order_relaxed), alloc);
+    last_broker_work_ns_[i] = work_ns;
+  }
+  stats.AddMember(StringRef(BROKER_SATURATION), move(saturation), alloc);
+  stats.AddMember(StringRef(BROKER_NUM_MESSAGES), move(num_messages), alloc);
+
+  SendStats(stats_request.id(), stats);
+}
+
+void Server::SendStats(uint32_t id, const rapidjson::Document& stats) {
   rapidjson::StringBuffer buf;
   rapidjson::Writer<rapidjson::StringBuffer> writer(buf);
   stats.Accept(writer);
 
   auto env = NewEnvelope();
-  env->mutable_response()->mutable_stats()->set_id(stats_request.id());
+  env->mutable_response()->mutable_stats()->set_id(id);
   env->mutable_response()->mutable_stats()->set_stats_json(buf.GetString());
   OnInternalResponseReceived(move(env));
 }
@@ -214,6 +337,9 @@ void Server::OnInternalResponseReceived(EnvelopePtr&& env) {
 void Server::SendTxnToClient(Transaction* txn) {
   TRACE(txn->mutable_internal(), TransactionEvent::EXIT_SERVER_TO_CLIENT);
 
+  // Values that no command has read are still compressed
+  DecompressValues(*txn);
+
   api::Response response;
   auto txn_response = response.mutable_txn();
   txn_response->set_allocated_txn(txn);
@@ -232,7 +358,7 @@ void Server::SendResponseToClient(TxnId txn_id, api::Response&& res) {
   // Send identity to the socket to select the client to response to
   socket.send(it->second.identity, zmq::send_flags::sndmore);
   // Send the actual message
-  SendSerializedProtoWithEmptyDelim(socket, res);
+  SendSerializedProtoWithEmptyDelim(socket, res, it->second.wire_version);
 
   pending_responses_.erase(txn_id);
 }
@@ -14,19 +14,29 @@
 #include "common/types.h"
 #include "connection/broker.h"
 #include "module/base/networked_module.h"
+#include "module/scheduler_components/commands.h"
 #include "proto/api.pb.h"
+#include "rapidjson/document.h"
 #include "storage/lookup_master_index.h"
+#include "storage/multi_version_storage.h"
 
 namespace slog {
 
 struct PendingResponse {
   zmq::message_t identity;
   uint32_t stream_id;
+  // The response is sent in the wire format version of the request
+  uint8_t wire_version;
 
-  explicit PendingResponse(zmq::message_t&& identity, uint32_t stream_id)
-      : identity(std::move(identity)), stream_id(stream_id) {}
+  explicit PendingResponse(zmq::message_t&& identity, uint32_t stream_id, uint8_t wire_version)
+      : identity(std::move(identity)), stream_id(stream_id), wire_version(wire_version) {}
 };
 
+/**
+ * Aborts the txn with a reason if it cannot be executed. Otherwise, sets its status to NOT_STARTED
+ */
+void ValidateTransaction(const ConfigurationPtr& config, Transaction* txn);
+
 class CompletedTransaction {
  public:
   explicit CompletedTransaction(const ConfigurationPtr& config, size_t involved_partitions)
@@ -77,10 +87,13 @@ class CompletedTransaction {
  * OUTPUT: For external TransactionRequest, it forwards the txn internally
  *         to appropriate modules and waits for internal responses before
  *         responding back to the client with an external TransactionResponse.
+ *         A read-only txn on the local partition is answered right away from
+ *         a snapshot of the storage if it is multi-versioned.
  */
 class Server : public NetworkedModule {
  public:
   Server(const ConfigurationPtr& config, const std::shared_ptr<Broker>& broker,
+         const std::shared_ptr<MultiVersionStorage>& storage,
          std::chrono::milliseconds poll_timeout = kModuleTimeout);
 
  protected:
@@ -100,8 +113,20 @@ class Server : public NetworkedModule {
   bool OnCustomSocket() final;
 
  private:
+  /**
+   * Executes a read-only txn on a snapshot of the local storage. Returns false
+   * if the txn cannot be answered locally and has to go through the log.
+   */
+  bool ExecuteReadOnlyTxn(Transaction* txn);
+
   void ProcessCompletedSubtxn(EnvelopePtr&& req);
   void ProcessStatsRequest(const internal::StatsRequest& stats_request);
+  /**
+   * The saturation of a broker thread is the fraction of time it spent on handling messages since
+   * the previous stats request for the brokers
+   */
+  void ProcessBrokerStatsRequest(const internal::StatsRequest& stats_request);
+  void SendStats(uint32_t id, const rapidjson::Document& stats);
 
   void SendTxnToClient(Transaction* txn);
   void SendResponseToClient(TxnId txn_id, api::Response&& res);
@@ -109,6 +134,12 @@ class Server : public NetworkedModule {
   TxnId NextTxnId();
 
   ConfigurationPtr config_;
+  std::shared_ptr<Broker> broker_;
+  std::chrono::steady_clock::time_point last_broker_stats_time_;
+  std::vector<uint64_t> last_broker_work_ns_;
+  // Null if the storage does not keep multiple versions
+  std::shared_ptr<MultiVersionStorage> storage_;
+  KeyValueCommands commands_;
 
   TxnId txn_id_counter_;
   std::unordered_map<TxnId, PendingResponse> pending_responses_;
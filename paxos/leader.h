@@ -4,6 +4,7 @@
 #include <unordered_set>
 #include <vector>
 
+#include "common/proto_utils.h"
 #include "common/types.h"
 #include "proto/internal.pb.h"
 
@@ -15,8 +16,6 @@ using std::vector;
 
 namespace slog {
 
-using EnvelopePtr = unique_ptr<internal::Envelope>;
-
 class SimulatedMultiPaxos;
 
 struct PaxosInstance {
@@ -140,6 +140,19 @@ void PrintServerStats(const rapidjson::Document& stats, uint32_t level) {
   cout << endl;
 }
 
+void PrintBrokerStats(const rapidjson::Document& stats, uint32_t) {
+  const auto& saturation = stats[BROKER_SATURATION].GetArray();
+  const auto& num_messages = stats[BROKER_NUM_MESSAGES].GetArray();
+  cout << "Saturation is the fraction of time spent on messages since the previous stats request\n";
+  cout << setw(8) << "Broker" << setw(12) << "Saturation" << setw(12) << "Messages"
+       << "\n";
+  cout << fixed << setprecision(3);
+  for (size_t i = 0; i < saturation.Size(); i++) {
+    cout << setw(8) << i << setw(12) << saturation[i].GetDouble() << setw(12) << num_messages[i].GetUint64() << "\n";
+  }
+  cout << endl;
+}
+
 void PrintForwarderStats(const rapidjson::Document& stats, uint32_t) {
   const auto& batch_duration_ms_pctls = stats[FORW_BATCH_DURATION_MS_PCTLS].GetArray();
   const auto& batch_size_pctls = stats[FORW_BATCH_SIZE_PCTLS].GetArray();
@@ -300,12 +313,45 @@ void PrintSchedulerStats(const rapidjson::Document& stats, uint32_t level) {
   cout << endl;
 }
 
+void PrintStorageStats(const rapidjson::Document& stats, uint32_t level) {
+  if (!stats.HasMember(STORAGE_NUM_KEYS)) {
+    cout << "The storage does not keep stats" << endl;
+    return;
+  }
+  auto num_keys = stats[STORAGE_NUM_KEYS].GetUint64();
+  auto num_buckets = stats[STORAGE_NUM_BUCKETS].GetUint64();
+  cout << "Number of keys: " << num_keys << "\n";
+  cout << "Value bytes: " << stats[STORAGE_VALUE_BYTES].GetUint64() << "\n";
+  cout << "Index bytes: " << stats[STORAGE_INDEX_BYTES].GetUint64() << "\n";
+  cout << "Buckets: " << num_buckets << "\n";
+  cout << "Load factor: " << (num_buckets == 0 ? 0.0 : static_cast<double>(num_keys) / num_buckets) << "\n";
+  cout << "Max chain length: " << stats[STORAGE_MAX_CHAIN_LENGTH].GetUint64() << "\n";
+
+  if (level >= 1) {
+    cout << "\n\nSEGMENTS\n\n";
+    cout << setw(10) << "Segment" << setw(12) << "Keys" << setw(12) << "Buckets" << setw(14) << "Load factor"
+         << setw(10) << "Empty" << setw(12) << "Max chain"
+         << "\n";
+    int i = 0;
+    TRUNCATED_FOR_EACH(it, stats[STORAGE_SEGMENTS].GetArray()) {
+      const auto& entry = it.GetArray();
+      auto segment_buckets = entry[1].GetUint64();
+      auto load_factor = segment_buckets == 0 ? 0.0 : static_cast<double>(entry[0].GetUint64()) / segment_buckets;
+      cout << setw(10) << i++ << setw(12) << entry[0].GetUint64() << setw(12) << segment_buckets << setw(14)
+           << load_factor << setw(10) << entry[2].GetUint64() << setw(12) << entry[3].GetUint64() << "\n";
+    }
+  }
+  cout << endl;
+}
+
 const unordered_map<string, StatsModule> STATS_MODULES = {
+    {"broker", {ModuleId::BROKER, PrintBrokerStats}},
     {"server", {ModuleId::SERVER, PrintServerStats}},
     {"forwarder", {ModuleId::FORWARDER, PrintForwarderStats}},
     {"mhorderer", {ModuleId::MHORDERER, PrintMHOrdererStats}},
     {"sequencer", {ModuleId::SEQUENCER, PrintSequencerStats}},
-    {"scheduler", {ModuleId::SCHEDULER, PrintSchedulerStats}}};
+    {"scheduler", {ModuleId::SCHEDULER, PrintSchedulerStats}},
+    {"storage", {ModuleId::STORAGE, PrintStorageStats}}};
 
 void ExecuteStats(const char* module, uint32_t level) {
   auto stats_module_it = STATS_MODULES.find(string(module));
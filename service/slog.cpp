@@ -1,12 +1,12 @@
-#include <fcntl.h>
-
+#include <filesystem>
 #include <memory>
 #include <vector>
 
 #include "common/configuration.h"
 #include "common/constants.h"
 #include "common/monitor.h"
-#include "common/offline_data_reader.h"
+#include "common/bulk_data_loader.h"
+#include "common/compression.h"
 #include "common/types.h"
 #include "connection/broker.h"
 #include "module/consensus.h"
@@ -20,22 +20,43 @@
 #include "proto/internal.pb.h"
 #include "proto/offline_data.pb.h"
 #include "service/service_utils.h"
+#include "storage/log_structured_storage.h"
 #include "storage/mem_only_storage.h"
+#include "storage/multi_version_storage.h"
+#include "storage/numeric_key_storage.h"
+#include "storage/snapshot_storage.h"
+#include "storage/write_ahead_log.h"
 
 DEFINE_string(config, "slog.conf", "Path to the configuration file");
 DEFINE_string(address, "", "Address of the local machine");
 DEFINE_string(data_dir, "", "Directory containing intial data");
-DEFINE_uint32(data_threads, 3, "Number of threads used to generate initial data");
+DEFINE_uint32(data_threads, 3, "Number of threads used to generate or load initial data");
+DEFINE_string(snapshot, "",
+              "Path to a snapshot of the initial data of the local partition. If the file exists, the storage "
+              "is mapped from it instead of loading the initial data. Otherwise, it is created after the initial "
+              "data is loaded");
 
 using slog::Broker;
 using slog::ConfigurationPtr;
 using slog::Key;
+using slog::LogStructuredStorage;
+using slog::LookupMasterIndex;
 using slog::MakeRunnerFor;
 using slog::Metadata;
 using slog::Record;
+using slog::SnapshotStorage;
+using slog::SnapshotWriter;
+using slog::Storage;
+using slog::WriteAheadLog;
 
 using std::make_shared;
 
+// Returns the minimum size of the values that are stored compressed, or 0 if values are not compressed
+uint32_t CompressionMinSize(const ConfigurationPtr& config) {
+  auto compression = config->value_compression();
+  return compression != nullptr ? compression->min_size_bytes() : 0;
+}
+
 void LoadData(slog::Storage<Key, Record>& storage, const ConfigurationPtr& config, const string& data_dir) {
   if (data_dir.empty()) {
     LOG(INFO) << "No initial data directory specified. Starting with an empty storage.";
@@ -44,35 +65,49 @@ void LoadData(slog::Storage<Key, Record>& storage, const ConfigurationPtr& confi
 
   auto data_file = data_dir + "/" + std::to_string(config->local_partition()) + ".dat";
 
-  auto fd = open(data_file.c_str(), O_RDONLY);
-  if (fd < 0) {
-    LOG(ERROR) << "Error while loading \"" << data_file << "\": " << strerror(errno)
-               << ". Starting with an empty storage.";
-    return;
-  }
-
-  slog::OfflineDataReader reader(fd);
-  LOG(INFO) << "Loading " << reader.GetNumDatums() << " datums...";
-
-  VLOG(1) << "First 10 datums are: ";
-  int c = 10;
-  while (reader.HasNextDatum()) {
-    auto datum = reader.GetNextDatum();
-    if (c > 0) {
-      VLOG(1) << datum.key() << " " << datum.record() << " " << datum.master();
-      c--;
+  slog::BulkDataLoader loader(FLAGS_data_threads);
+  auto compression_min_size = CompressionMinSize(config);
+  // Only accessed by the thread loading the first chunk
+  bool first_batch = true;
+  auto WriteBatchFn = [&](uint32_t chunk, std::vector<slog::Datum>& batch) {
+    if (chunk == 0 && first_batch) {
+      VLOG(1) << "First 10 datums are: ";
+      for (size_t i = 0; i < std::min<size_t>(10, batch.size()); i++) {
+        VLOG(1) << batch[i].key() << " " << batch[i].record() << " " << batch[i].master();
+      }
+      first_batch = false;
     }
 
-    CHECK(config->key_is_in_local_partition(datum.key()))
-        << "Key " << datum.key() << " does not belong to partition " << config->local_partition();
+    std::vector<std::pair<Key, Record>> records;
+    records.reserve(batch.size());
+    std::string compressed;
+    for (auto& datum : batch) {
+      CHECK(config->key_is_in_local_partition(datum.key()))
+          << "Key " << datum.key() << " does not belong to partition " << config->local_partition();
+
+      CHECK_LT(datum.master(), config->num_replicas()) << "Master number exceeds number of replicas";
+
+      Record record;
+      if (slog::MaybeCompressValue(datum.record(), compression_min_size, compressed)) {
+        record.SetValue(compressed, true /* compressed */);
+      } else {
+        record.SetValue(datum.record());
+      }
+      record.metadata = Metadata(datum.master());
+      records.emplace_back(std::move(*datum.mutable_key()), std::move(record));
+    }
+    // Write to storage
+    storage.WriteBatch(records);
+  };
+  // Presize the storage so that it does not rehash while loading
+  auto ReserveFn = [&storage](uint64_t num_datums) { storage.Reserve(num_datums); };
 
-    CHECK_LT(datum.master(), config->num_replicas()) << "Master number exceeds number of replicas";
+  bool ok = loader.Load(data_file, WriteBatchFn, ReserveFn);
 
-    // Write to storage
-    Record record(datum.record(), datum.master());
-    storage.Write(datum.key(), record);
+  if (!ok) {
+    LOG(ERROR) << "Error while loading \"" << data_file << "\": " << strerror(errno)
+               << ". Starting with an empty storage.";
   }
-  close(fd);
 }
 
 void GenerateData(slog::Storage<Key, Record>& storage, const ConfigurationPtr& config) {
@@ -83,10 +118,18 @@ void GenerateData(slog::Storage<Key, Record>& storage, const ConfigurationPtr& c
 
   // Create a value of specified size by repeating the character 'a'
   string value(simple_partitioning->record_size_bytes(), 'a');
+  string compressed;
+  bool is_compressed = slog::MaybeCompressValue(value, CompressionMinSize(config), compressed);
+  if (is_compressed) {
+    LOG(INFO) << "Generated records are compressed to " << compressed.size() << " bytes";
+    value = std::move(compressed);
+  }
 
   LOG(INFO) << "Generating ~" << num_records / num_partitions << " records using " << FLAGS_data_threads << " threads. "
             << "Record size = " << simple_partitioning->record_size_bytes() << " bytes";
 
+  storage.Reserve(num_records / num_partitions + 1);
+
   std::atomic<uint64_t> counter = 0;
   size_t num_done = 0;
   auto GenerateFn = [&](uint64_t from_key, uint64_t to_key) {
@@ -94,7 +137,9 @@ void GenerateData(slog::Storage<Key, Record>& storage, const ConfigurationPtr& c
     uint64_t end_key = std::min(to_key, num_records);
     for (uint64_t key = start_key; key < end_key; key += num_partitions) {
       int master = config->master_of_key(key);
-      Record record(value, master);
+      Record record;
+      record.SetValue(value, is_compressed);
+      record.metadata = Metadata(master);
       storage.Write(std::to_string(key), record);
       counter++;
     }
@@ -114,6 +159,52 @@ void GenerateData(slog::Storage<Key, Record>& storage, const ConfigurationPtr& c
   }
 }
 
+std::shared_ptr<LogStructuredStorage> MakeLogStructuredStorage(const slog::internal::LogStructuredStorage& lss_config) {
+  LogStructuredStorage::Options options;
+  options.directory = lss_config.directory();
+  if (lss_config.segment_size_bytes() > 0) {
+    options.segment_size_bytes = lss_config.segment_size_bytes();
+  }
+  if (lss_config.memory_budget_bytes() > 0) {
+    options.memory_budget_bytes = lss_config.memory_budget_bytes();
+  }
+  if (lss_config.compaction_garbage_pct() > 0) {
+    options.compaction_garbage_pct = lss_config.compaction_garbage_pct();
+  }
+  if (lss_config.compaction_interval() > 0) {
+    options.compaction_interval = std::chrono::milliseconds(lss_config.compaction_interval());
+  }
+  if (lss_config.prefetch_threads() > 0) {
+    options.prefetch_threads = lss_config.prefetch_threads();
+  }
+  LOG(INFO) << "Using log-structured storage at \"" << options.directory
+            << "\". Memory budget = " << options.memory_budget_bytes << " bytes";
+  return make_shared<LogStructuredStorage>(options);
+}
+
+std::shared_ptr<WriteAheadLog> MakeWriteAheadLog(const slog::internal::WriteAheadLog& wal_config,
+                                                 const std::shared_ptr<LogStructuredStorage>& lss) {
+  std::chrono::microseconds group_commit_interval(1000);
+  if (wal_config.group_commit_interval() > 0) {
+    group_commit_interval = std::chrono::microseconds(wal_config.group_commit_interval());
+  }
+  size_t segment_size_bytes = 64 * 1024 * 1024;
+  if (wal_config.segment_size_bytes() > 0) {
+    segment_size_bytes = wal_config.segment_size_bytes();
+  }
+  // Only the log-structured storage keeps the writes across restarts, so the log
+  // can be truncated once they are synced
+  WriteAheadLog::CheckpointFn checkpoint;
+  if (lss != nullptr) {
+    checkpoint = [lss] { lss->Sync(); };
+  } else {
+    LOG(WARNING) << "The write-ahead log cannot be truncated without the log-structured storage";
+  }
+  LOG(INFO) << "Using write-ahead log at \"" << wal_config.directory()
+            << "\". Group commit interval = " << group_commit_interval.count() << " us";
+  return make_shared<WriteAheadLog>(wal_config.directory(), group_commit_interval, segment_size_bytes, checkpoint);
+}
+
 int main(int argc, char* argv[]) {
   slog::InitializeService(&argc, &argv);
 
@@ -149,23 +240,86 @@ int main(int argc, char* argv[]) {
   auto broker = Broker::New(config);
 
   // Create and initialize storage layer
-  auto storage = make_shared<slog::MemOnlyStorage<Key, Record, Metadata>>();
-  // If simple partitioning is used, generate the data;
+  std::shared_ptr<Storage<Key, Record>> storage;
+  std::shared_ptr<LookupMasterIndex<Key, Metadata>> lookup_master_index;
+  std::shared_ptr<slog::MemOnlyStorage<Key, Record, Metadata>> mem_only_storage;
+  std::shared_ptr<slog::NumericKeyStorage<Record, Metadata>> numeric_key_storage;
+  std::shared_ptr<slog::MultiVersionStorage> multi_version_storage;
+  std::shared_ptr<LogStructuredStorage> lss;
+  std::shared_ptr<SnapshotStorage> snapshot_storage;
+  bool has_recovered_data = false;
+  if (auto lss_config = config->log_structured_storage(); lss_config != nullptr) {
+    lss = MakeLogStructuredStorage(*lss_config);
+    has_recovered_data = lss->num_keys() > 0;
+    storage = lss;
+    lookup_master_index = lss;
+  } else if (auto mvs_config = config->multi_version_storage(); mvs_config != nullptr) {
+    LOG(INFO) << "Using multi-version storage with snapshot retention of " << mvs_config->snapshot_retention()
+              << " log positions";
+    multi_version_storage = make_shared<slog::MultiVersionStorage>(mvs_config->snapshot_retention());
+    storage = multi_version_storage;
+    lookup_master_index = multi_version_storage;
+  } else if (!FLAGS_snapshot.empty() && std::filesystem::exists(FLAGS_snapshot)) {
+    snapshot_storage = make_shared<SnapshotStorage>(FLAGS_snapshot);
+    has_recovered_data = true;
+    storage = snapshot_storage;
+    lookup_master_index = snapshot_storage;
+  } else if (config->simple_partitioning()) {
+    // All keys are integers so they are stored as such
+    numeric_key_storage =
+        make_shared<slog::NumericKeyStorage<Record, Metadata>>(config->simple_partitioning()->ordered_keys());
+    storage = numeric_key_storage;
+    lookup_master_index = numeric_key_storage;
+  } else {
+    mem_only_storage = make_shared<slog::MemOnlyStorage<Key, Record, Metadata>>();
+    storage = mem_only_storage;
+    lookup_master_index = mem_only_storage;
+  }
+  // If the storage already has data from a previous run, use it as is.
+  // Otherwise, if simple partitioning is used, generate the data;
   // otherwise, load data from an external file
-  if (config->simple_partitioning()) {
-    GenerateData(*storage, config);
+  if (has_recovered_data) {
+    LOG(INFO) << "Storage has recovered data from a previous run. Skipping initial data";
   } else {
-    LoadData(*storage, config, FLAGS_data_dir);
+    if (config->simple_partitioning()) {
+      GenerateData(*storage, config);
+    } else {
+      LoadData(*storage, config, FLAGS_data_dir);
+    }
+    // Save the initial data so that the next run can map it instead
+    if ((mem_only_storage != nullptr || numeric_key_storage != nullptr) && !FLAGS_snapshot.empty()) {
+      SnapshotWriter writer(FLAGS_snapshot);
+      auto AddToSnapshot = [&writer](const Key& key, const Record& record) { writer.Add(key, record); };
+      if (mem_only_storage != nullptr) {
+        mem_only_storage->ForEach(AddToSnapshot);
+      } else {
+        numeric_key_storage->ForEach(AddToSnapshot);
+      }
+      writer.Finish();
+    }
+  }
+  // Re-apply the writes committed in previous runs on top of the initial data
+  std::shared_ptr<WriteAheadLog> wal;
+  if (auto wal_config = config->write_ahead_log(); wal_config != nullptr) {
+    wal = MakeWriteAheadLog(*wal_config, lss);
+    uint64_t storage_lsn = 0;
+    if (snapshot_storage != nullptr) {
+      storage_lsn = snapshot_storage->lsn();
+    } else if (lss != nullptr && has_recovered_data) {
+      // The log is only truncated once the log-structured storage has the writes of the deleted segments
+      storage_lsn = wal->first_lsn() - 1;
+    }
+    wal->Replay(*storage, storage_lsn);
   }
 
   vector<pair<unique_ptr<slog::ModuleRunner>, slog::ModuleId>> modules;
-  modules.emplace_back(MakeRunnerFor<slog::Server>(config, broker), slog::ModuleId::SERVER);
+  modules.emplace_back(MakeRunnerFor<slog::Server>(config, broker, multi_version_storage), slog::ModuleId::SERVER);
   modules.emplace_back(MakeRunnerFor<slog::MultiHomeOrderer>(config, broker), slog::ModuleId::MHORDERER);
   modules.emplace_back(MakeRunnerFor<slog::LocalPaxos>(config, broker), slog::ModuleId::LOCALPAXOS);
-  modules.emplace_back(MakeRunnerFor<slog::Forwarder>(config, broker, storage), slog::ModuleId::FORWARDER);
+  modules.emplace_back(MakeRunnerFor<slog::Forwarder>(config, broker, lookup_master_index), slog::ModuleId::FORWARDER);
   modules.emplace_back(MakeRunnerFor<slog::Sequencer>(config, broker), slog::ModuleId::SEQUENCER);
   modules.emplace_back(MakeRunnerFor<slog::Interleaver>(config, broker), slog::ModuleId::INTERLEAVER);
-  modules.emplace_back(MakeRunnerFor<slog::Scheduler>(config, broker, storage), slog::ModuleId::SCHEDULER);
+  modules.emplace_back(MakeRunnerFor<slog::Scheduler>(config, broker, storage, wal), slog::ModuleId::SCHEDULER);
 
   // One region is selected to globally order the multihome batches
   if (config->leader_replica_for_multi_home_ordering() == config->local_replica()) {
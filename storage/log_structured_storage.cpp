@@ -0,0 +1,676 @@
+#include "storage/log_structured_storage.h"
+
+#include <fcntl.h>
+#include <glog/logging.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+namespace slog {
+
+namespace {
+
+const char kSegmentExtension[] = ".seg";
+const uint32_t kTombstone = 1;
+const uint32_t kCompressed = 2;
+// The buffered part of the active segment is written to its file once it reaches this size
+const size_t kWriteBufferSize = 1024 * 1024;
+
+/**
+ * Each entry in a segment file is laid out as <header> <key> <value>
+ */
+struct EntryHeader {
+  // Checksum of everything following this field in the entry
+  uint32_t checksum;
+  uint32_t key_size;
+  uint32_t value_size;
+  uint32_t master;
+  uint32_t counter;
+  uint32_t flags;
+};
+
+size_t EntrySize(size_t key_size, size_t value_size) { return sizeof(EntryHeader) + key_size + value_size; }
+
+uint32_t FNVHash(uint32_t hash, const char* data, size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    hash ^= static_cast<uint8_t>(data[i]);
+    hash *= 0x01000193;
+  }
+  return hash;
+}
+
+uint32_t Checksum(const EntryHeader& header, const char* key, const char* value) {
+  uint32_t hash = 0x811c9dc5;
+  auto fields = reinterpret_cast<const char*>(&header) + sizeof(header.checksum);
+  hash = FNVHash(hash, fields, sizeof(EntryHeader) - sizeof(header.checksum));
+  hash = FNVHash(hash, key, header.key_size);
+  return FNVHash(hash, value, header.value_size);
+}
+
+// The key filters use about 10 bits per key and 7 probes, which gives a false positive rate of about 1%
+const size_t kFilterBitsPerKey = 10;
+const size_t kFilterProbes = 7;
+
+std::vector<uint64_t> BuildKeyFilter(const std::vector<size_t>& hashes) {
+  std::vector<uint64_t> filter((hashes.size() * kFilterBitsPerKey + 63) / 64 + 1, 0);
+  auto num_bits = filter.size() * 64;
+  for (auto hash : hashes) {
+    // Double hashing derives all probes from one hash
+    auto delta = (hash >> 17) | (hash << 47) | 1;
+    for (size_t i = 0; i < kFilterProbes; i++, hash += delta) {
+      auto bit = hash % num_bits;
+      filter[bit / 64] |= 1ULL << (bit % 64);
+    }
+  }
+  return filter;
+}
+
+bool KeyFilterMayContain(const std::vector<uint64_t>& filter, size_t hash) {
+  auto num_bits = filter.size() * 64;
+  auto delta = (hash >> 17) | (hash << 47) | 1;
+  for (size_t i = 0; i < kFilterProbes; i++, hash += delta) {
+    auto bit = hash % num_bits;
+    if (!(filter[bit / 64] & (1ULL << (bit % 64)))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::string SegmentPath(const std::string& directory, uint32_t id) {
+  return directory + "/" + std::to_string(id) + kSegmentExtension;
+}
+
+bool ReadFully(int fd, char* buf, size_t size, uint64_t offset) {
+  while (size > 0) {
+    auto n = pread(fd, buf, size, offset);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    buf += n;
+    size -= n;
+    offset += n;
+  }
+  return true;
+}
+
+void WriteFully(int fd, const char* buf, size_t size, uint64_t offset) {
+  while (size > 0) {
+    auto n = pwrite(fd, buf, size, offset);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0) {
+      LOG(FATAL) << "Error while writing to segment file: " << strerror(errno);
+    }
+    buf += n;
+    size -= n;
+    offset += n;
+  }
+}
+
+void SyncDirectory(const std::string& directory) {
+  auto fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+  if (fd < 0 || fsync(fd) < 0) {
+    LOG(FATAL) << "Cannot sync directory \"" << directory << "\": " << strerror(errno);
+  }
+  close(fd);
+}
+
+}  // namespace
+
+/**
+ * ValueCache
+ */
+
+LogStructuredStorage::ValueCache::ValueCache(size_t capacity_bytes)
+    : shard_capacity_bytes_(capacity_bytes / kNumShards) {}
+
+bool LogStructuredStorage::ValueCache::Get(uint64_t location, std::string& value) {
+  auto& shard = shards_[location % kNumShards];
+  std::lock_guard<std::mutex> guard(shard.mut);
+  auto it = shard.entries.find(location);
+  if (it == shard.entries.end()) {
+    return false;
+  }
+  shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+  value = it->second->second;
+  return true;
+}
+
+bool LogStructuredStorage::ValueCache::Contains(uint64_t location) {
+  auto& shard = shards_[location % kNumShards];
+  std::lock_guard<std::mutex> guard(shard.mut);
+  return shard.entries.count(location) > 0;
+}
+
+void LogStructuredStorage::ValueCache::Put(uint64_t location, const std::string& value) {
+  if (value.size() > shard_capacity_bytes_) {
+    return;
+  }
+  auto& shard = shards_[location % kNumShards];
+  std::lock_guard<std::mutex> guard(shard.mut);
+  if (shard.entries.count(location) > 0) {
+    return;
+  }
+  shard.lru.emplace_front(location, value);
+  shard.entries.emplace(location, shard.lru.begin());
+  shard.size_bytes += value.size();
+  while (shard.size_bytes > shard_capacity_bytes_) {
+    auto& victim = shard.lru.back();
+    shard.size_bytes -= victim.second.size();
+    shard.entries.erase(victim.first);
+    shard.lru.pop_back();
+  }
+}
+
+/**
+ * LogStructuredStorage
+ */
+
+LogStructuredStorage::Segment::~Segment() { close(fd); }
+
+LogStructuredStorage::LogStructuredStorage(const Options& options)
+    : options_(options),
+      cache_(options.memory_budget_bytes),
+      num_keys_(0),
+      stopping_(false),
+      stopping_prefetch_(false),
+      num_prefetched_(0) {
+  CHECK(!options_.directory.empty()) << "Directory of the log-structured storage is not set";
+  Recover();
+  background_thread_ = std::thread(&LogStructuredStorage::BackgroundLoop, this);
+  for (uint32_t i = 0; i < options_.prefetch_threads; i++) {
+    prefetch_threads_.emplace_back(&LogStructuredStorage::PrefetchLoop, this);
+  }
+}
+
+LogStructuredStorage::~LogStructuredStorage() {
+  {
+    std::lock_guard<std::mutex> guard(prefetch_mut_);
+    stopping_prefetch_ = true;
+  }
+  prefetch_cv_.notify_all();
+  for (auto& t : prefetch_threads_) {
+    t.join();
+  }
+  {
+    std::lock_guard<std::mutex> guard(background_mut_);
+    stopping_ = true;
+  }
+  background_cv_.notify_one();
+  background_thread_.join();
+  Flush();
+}
+
+bool LogStructuredStorage::Read(const Key& key, Record& result) const {
+  for (;;) {
+    Location loc;
+    if (!index_.Get(loc, key)) {
+      return false;
+    }
+    std::string value;
+    auto cache_key = CacheKey(loc);
+    if (!cache_.Get(cache_key, value)) {
+      // The segment may have been compacted since the index was looked up,
+      // in which case the index already points to the new location
+      if (!ReadValue(loc, value)) {
+        continue;
+      }
+      cache_.Put(cache_key, value);
+    }
+    result.SetValue(value, loc.compressed);
+    result.metadata = loc.metadata;
+    return true;
+  }
+}
+
+void LogStructuredStorage::Write(const Key& key, const Record& record) {
+  auto value = record.to_string();
+
+  std::lock_guard<std::mutex> guard(write_mut_);
+  auto loc = Append(key, value, record.metadata, record.compressed() ? kCompressed : 0);
+  Location old_loc;
+  if (index_.Get(old_loc, key)) {
+    MarkDead(old_loc.segment, EntrySize(key.size(), old_loc.value_size));
+  } else {
+    num_keys_++;
+  }
+  index_.InsertOrUpdate(key, loc);
+  cache_.Put(CacheKey(loc), value);
+}
+
+bool LogStructuredStorage::Delete(const Key& key) {
+  std::lock_guard<std::mutex> guard(write_mut_);
+  Location old_loc;
+  if (!index_.Get(old_loc, key)) {
+    return false;
+  }
+  Append(key, "", old_loc.metadata, kTombstone);
+  MarkDead(old_loc.segment, EntrySize(key.size(), old_loc.value_size));
+  index_.Erase(key);
+  num_keys_--;
+  return true;
+}
+
+bool LogStructuredStorage::GetMasterMetadata(const Key& key, Metadata& metadata) const {
+  Location loc;
+  if (!index_.Get(loc, key)) {
+    return false;
+  }
+  metadata = loc.metadata;
+  return true;
+}
+
+void LogStructuredStorage::Prefetch(const std::vector<const Key*>& keys) const {
+  if (prefetch_threads_.empty()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> guard(prefetch_mut_);
+    for (auto key : keys) {
+      if (pending_prefetches_.size() >= options_.max_pending_prefetches) {
+        break;
+      }
+      pending_prefetches_.push_back(*key);
+    }
+  }
+  prefetch_cv_.notify_all();
+}
+
+void LogStructuredStorage::Flush() {
+  std::lock_guard<std::mutex> guard(write_mut_);
+  FlushLocked();
+}
+
+void LogStructuredStorage::Sync() {
+  std::vector<SegmentPtr> unsynced;
+  SegmentPtr active_segment;
+  {
+    std::lock_guard<std::mutex> guard(write_mut_);
+    FlushLocked();
+    active_segment = active_segment_;
+    std::shared_lock<std::shared_mutex> lock(segments_mut_);
+    for (const auto& [id, segment] : segments_) {
+      if (!segment->synced) {
+        unsynced.push_back(segment);
+      }
+    }
+  }
+  for (const auto& segment : unsynced) {
+    if (fdatasync(segment->fd) < 0) {
+      LOG(FATAL) << "Cannot sync segment \"" << segment->path << "\": " << strerror(errno);
+    }
+    // More entries may be appended to the active segment after this
+    if (segment != active_segment) {
+      segment->synced = true;
+    }
+  }
+  // Makes the new segment files durable too
+  SyncDirectory(options_.directory);
+}
+
+bool LogStructuredStorage::GetStats(StorageStats& stats, bool per_segment) const {
+  stats.table = index_.Stats(per_segment ? &stats.segments : nullptr);
+  stats.num_keys = stats.table.num_keys;
+  stats.value_bytes = stats.table.value_bytes;
+  stats.index_bytes = stats.table.index_bytes;
+  return true;
+}
+
+size_t LogStructuredStorage::num_segments() const {
+  std::shared_lock<std::shared_mutex> lock(segments_mut_);
+  return segments_.size();
+}
+
+void LogStructuredStorage::Compact() {
+  std::lock_guard<std::mutex> guard(compaction_mut_);
+
+  std::vector<SegmentPtr> candidates;
+  {
+    std::shared_lock<std::shared_mutex> lock(segments_mut_);
+    // The last segment is the active one and is never compacted
+    for (auto it = segments_.begin(); it != segments_.end() && std::next(it) != segments_.end(); it++) {
+      auto& segment = it->second;
+      auto size = segment->size.load();
+      auto garbage = size - segment->live_bytes.load();
+      if (garbage * 100 >= size * options_.compaction_garbage_pct) {
+        candidates.push_back(segment);
+      }
+    }
+  }
+
+  for (auto& segment : candidates) {
+    CompactSegment(segment);
+  }
+}
+
+void LogStructuredStorage::CompactSegment(const SegmentPtr& segment) {
+  std::string data(segment->size.load(), '\0');
+  if (!ReadFully(segment->fd, data.data(), data.size(), 0)) {
+    LOG(ERROR) << "Cannot read segment \"" << segment->path << "\" for compaction: " << strerror(errno);
+    return;
+  }
+
+  size_t num_moved = 0;
+  size_t pos = 0;
+  while (pos < data.size()) {
+    EntryHeader header;
+    memcpy(&header, data.data() + pos, sizeof(header));
+    auto key_data = data.data() + pos + sizeof(header);
+    auto value_data = key_data + header.key_size;
+    auto value_offset = pos + sizeof(header) + header.key_size;
+    pos += EntrySize(header.key_size, header.value_size);
+
+    Key key(key_data, header.key_size);
+
+    std::lock_guard<std::mutex> guard(write_mut_);
+    Location loc;
+    bool in_index = index_.Get(loc, key);
+    if (header.flags & kTombstone) {
+      // A tombstone must be kept as long as there is an older segment that
+      // may contain a version of the deleted key
+      if (in_index || !OlderSegmentMayContain(key, segment->id)) {
+        continue;
+      }
+      Append(key, "", Metadata(header.master, header.counter), kTombstone);
+    } else {
+      // Only move the entry if it is still the latest version of the key
+      if (!in_index || loc.segment != segment->id || loc.value_offset != value_offset) {
+        continue;
+      }
+      index_.InsertOrUpdate(key, Append(key, std::string(value_data, header.value_size), loc.metadata, header.flags));
+    }
+    num_moved++;
+  }
+
+  // The moved entries must be durable before their old versions are gone
+  Sync();
+  {
+    std::unique_lock<std::shared_mutex> lock(segments_mut_);
+    segments_.erase(segment->id);
+  }
+  // Readers that are still holding a pointer to this segment can continue
+  // to read from it until the file descriptor is closed
+  unlink(segment->path.c_str());
+  SyncDirectory(options_.directory);
+
+  VLOG(1) << "Compacted segment \"" << segment->path << "\". Moved " << num_moved << " entries";
+}
+
+bool LogStructuredStorage::OlderSegmentMayContain(const Key& key, uint32_t segment_id) const {
+  auto hash = std::hash<Key>{}(key);
+  std::shared_lock<std::shared_mutex> lock(segments_mut_);
+  for (auto it = segments_.begin(); it != segments_.end() && it->first < segment_id; it++) {
+    if (KeyFilterMayContain(it->second->key_filter, hash)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void LogStructuredStorage::Recover() {
+  fs::create_directories(options_.directory);
+
+  std::vector<uint32_t> ids;
+  for (const auto& entry : fs::directory_iterator(options_.directory)) {
+    const auto& path = entry.path();
+    if (path.extension() != kSegmentExtension) {
+      continue;
+    }
+    ids.push_back(std::stoul(path.stem().string()));
+  }
+  std::sort(ids.begin(), ids.end());
+
+  for (size_t i = 0; i < ids.size(); i++) {
+    auto path = SegmentPath(options_.directory, ids[i]);
+    auto fd = open(path.c_str(), O_RDWR);
+    if (fd < 0) {
+      LOG(FATAL) << "Cannot open segment \"" << path << "\": " << strerror(errno);
+    }
+    auto segment = std::make_shared<Segment>(ids[i], path, fd);
+    segments_.emplace(ids[i], segment);
+    RecoverSegment(segment, i == ids.size() - 1);
+  }
+
+  if (!ids.empty()) {
+    LOG(INFO) << "Recovered " << num_keys_ << " keys from " << ids.size() << " segments in \"" << options_.directory
+              << "\"";
+  }
+
+  std::lock_guard<std::mutex> guard(write_mut_);
+  StartNewSegment();
+}
+
+void LogStructuredStorage::RecoverSegment(const SegmentPtr& segment, bool is_last) {
+  std::string data(lseek(segment->fd, 0, SEEK_END), '\0');
+  if (!ReadFully(segment->fd, data.data(), data.size(), 0)) {
+    LOG(FATAL) << "Cannot read segment \"" << segment->path << "\": " << strerror(errno);
+  }
+
+  std::vector<size_t> key_hashes;
+  size_t pos = 0;
+  while (pos < data.size()) {
+    EntryHeader header;
+    const char* key_data = nullptr;
+    bool valid = pos + sizeof(header) <= data.size();
+    if (valid) {
+      memcpy(&header, data.data() + pos, sizeof(header));
+      key_data = data.data() + pos + sizeof(header);
+      valid = pos + EntrySize(header.key_size, header.value_size) <= data.size() &&
+              header.checksum == Checksum(header, key_data, key_data + header.key_size);
+    }
+    if (!valid) {
+      // Only the tail of the last segment may be incomplete, due to a crash in the middle of a write
+      CHECK(is_last) << "Segment \"" << segment->path << "\" is corrupted at offset " << pos;
+      LOG(WARNING) << "Truncating incomplete entry at the end of \"" << segment->path << "\"";
+      if (ftruncate(segment->fd, pos) < 0) {
+        LOG(FATAL) << "Cannot truncate segment \"" << segment->path << "\": " << strerror(errno);
+      }
+      break;
+    }
+
+    Key key(key_data, header.key_size);
+    key_hashes.push_back(std::hash<Key>{}(key));
+    auto entry_size = EntrySize(header.key_size, header.value_size);
+    Location old_loc;
+    bool existed = index_.Get(old_loc, key);
+    if (existed) {
+      MarkDead(old_loc.segment, EntrySize(key.size(), old_loc.value_size));
+    }
+    if (header.flags & kTombstone) {
+      if (existed) {
+        index_.Erase(key);
+        num_keys_--;
+      }
+    } else {
+      Location loc{.segment = segment->id,
+                   .value_size = header.value_size,
+                   .compressed = (header.flags & kCompressed) != 0,
+                   .value_offset = pos + sizeof(header) + header.key_size,
+                   .metadata = Metadata(header.master, header.counter)};
+      index_.InsertOrUpdate(key, loc);
+      segment->live_bytes += entry_size;
+      if (!existed) {
+        num_keys_++;
+      }
+    }
+    pos += entry_size;
+  }
+  segment->size = pos;
+  segment->flushed_size = pos;
+  segment->key_filter = BuildKeyFilter(key_hashes);
+}
+
+LogStructuredStorage::Location LogStructuredStorage::Append(const Key& key, const std::string& value,
+                                                            const Metadata& metadata, uint32_t flags) {
+  auto entry_size = EntrySize(key.size(), value.size());
+  if (active_segment_->size > 0 && active_segment_->size + entry_size > options_.segment_size_bytes) {
+    StartNewSegment();
+  }
+
+  EntryHeader header{.checksum = 0,
+                     .key_size = static_cast<uint32_t>(key.size()),
+                     .value_size = static_cast<uint32_t>(value.size()),
+                     .master = metadata.master,
+                     .counter = metadata.counter,
+                     .flags = flags};
+  header.checksum = Checksum(header, key.data(), value.data());
+
+  uint64_t offset = active_segment_->size;
+  write_buffer_.append(reinterpret_cast<const char*>(&header), sizeof(header));
+  write_buffer_.append(key);
+  write_buffer_.append(value);
+  active_segment_->size += entry_size;
+  active_key_hashes_.push_back(std::hash<Key>{}(key));
+  if (!(flags & kTombstone)) {
+    active_segment_->live_bytes += entry_size;
+  }
+
+  Location loc{.segment = active_segment_->id,
+               .value_size = header.value_size,
+               .compressed = (flags & kCompressed) != 0,
+               .value_offset = offset + sizeof(header) + key.size(),
+               .metadata = metadata};
+
+  if (write_buffer_.size() >= kWriteBufferSize) {
+    FlushLocked();
+  }
+
+  return loc;
+}
+
+void LogStructuredStorage::StartNewSegment() {
+  uint32_t id = 0;
+  if (active_segment_ != nullptr) {
+    FlushLocked();
+    active_segment_->key_filter = BuildKeyFilter(active_key_hashes_);
+    active_key_hashes_.clear();
+    id = active_segment_->id + 1;
+  } else {
+    std::shared_lock<std::shared_mutex> lock(segments_mut_);
+    if (!segments_.empty()) {
+      id = segments_.rbegin()->first + 1;
+    }
+  }
+
+  auto path = SegmentPath(options_.directory, id);
+  auto fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    LOG(FATAL) << "Cannot create segment \"" << path << "\": " << strerror(errno);
+  }
+  active_segment_ = std::make_shared<Segment>(id, path, fd);
+
+  std::unique_lock<std::shared_mutex> lock(segments_mut_);
+  segments_.emplace(id, active_segment_);
+}
+
+void LogStructuredStorage::FlushLocked() {
+  if (write_buffer_.empty()) {
+    return;
+  }
+  WriteFully(active_segment_->fd, write_buffer_.data(), write_buffer_.size(), active_segment_->flushed_size);
+  active_segment_->flushed_size += write_buffer_.size();
+  write_buffer_.clear();
+}
+
+void LogStructuredStorage::MarkDead(uint32_t segment_id, uint64_t bytes) {
+  if (auto segment = GetSegment(segment_id); segment != nullptr) {
+    segment->live_bytes -= bytes;
+  }
+}
+
+bool LogStructuredStorage::ReadValue(const Location& loc, std::string& value) const {
+  auto segment = GetSegment(loc.segment);
+  if (segment == nullptr) {
+    return false;
+  }
+
+  if (loc.value_offset + loc.value_size > segment->flushed_size) {
+    std::lock_guard<std::mutex> guard(write_mut_);
+    // The whole buffer is written at once so an entry is either entirely
+    // in the file or entirely in the buffer
+    auto flushed_size = segment->flushed_size.load();
+    if (loc.value_offset >= flushed_size) {
+      value.assign(write_buffer_.data() + (loc.value_offset - flushed_size), loc.value_size);
+      return true;
+    }
+  }
+
+  value.resize(loc.value_size);
+  if (!ReadFully(segment->fd, value.data(), loc.value_size, loc.value_offset)) {
+    LOG(FATAL) << "Cannot read from segment \"" << segment->path << "\": " << strerror(errno);
+  }
+  return true;
+}
+
+LogStructuredStorage::SegmentPtr LogStructuredStorage::GetSegment(uint32_t id) const {
+  std::shared_lock<std::shared_mutex> lock(segments_mut_);
+  auto it = segments_.find(id);
+  if (it == segments_.end()) {
+    return nullptr;
+  }
+  return it->second;
+}
+
+void LogStructuredStorage::PrefetchLoop() {
+  std::unique_lock<std::mutex> lock(prefetch_mut_);
+  for (;;) {
+    prefetch_cv_.wait(lock, [this] { return stopping_prefetch_ || !pending_prefetches_.empty(); });
+    if (stopping_prefetch_) {
+      break;
+    }
+    auto key = std::move(pending_prefetches_.front());
+    pending_prefetches_.pop_front();
+    lock.unlock();
+
+    LoadIntoCache(key);
+
+    lock.lock();
+  }
+}
+
+void LogStructuredStorage::LoadIntoCache(const Key& key) {
+  Location loc;
+  if (!index_.Get(loc, key)) {
+    return;
+  }
+  auto cache_key = CacheKey(loc);
+  if (cache_.Contains(cache_key)) {
+    return;
+  }
+  // Values that are still in the write buffer are cheap to read so they are skipped. A
+  // value that has been compacted away since the index was looked up is skipped too
+  auto segment = GetSegment(loc.segment);
+  if (segment == nullptr || loc.value_offset + loc.value_size > segment->flushed_size) {
+    return;
+  }
+  std::string value;
+  if (ReadValue(loc, value)) {
+    cache_.Put(cache_key, value);
+    num_prefetched_++;
+  }
+}
+
+void LogStructuredStorage::BackgroundLoop() {
+  std::unique_lock<std::mutex> lock(background_mut_);
+  while (!stopping_) {
+    background_cv_.wait_for(lock, options_.compaction_interval);
+    if (stopping_) {
+      break;
+    }
+    lock.unlock();
+    Flush();
+    Compact();
+    lock.lock();
+  }
+}
+
+}  // namespace slog
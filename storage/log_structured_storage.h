@@ -0,0 +1,215 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "common/types.h"
+#include "data_structure/concurrent_hash_map.h"
+#include "storage/lookup_master_index.h"
+#include "storage/storage.h"
+
+namespace slog {
+
+/**
+ * A storage that appends every write to a log made of fixed-size segment files on local disk.
+ *
+ * An in-memory index maps each key to the location of its latest version in the log together
+ * with its master metadata, so looking up the master of a key never touches the disk. Recently
+ * read or written values are kept in a cache whose size is bounded by a memory budget. Values
+ * that are not in the cache are read from the segment files.
+ *
+ * Values can be prefetched into the cache by a pool of background threads so that a read
+ * that is known in advance does not have to wait for the disk. Prefetch requests are
+ * dropped when too many of them are pending since they are only hints.
+ *
+ * Overwrites and deletes leave garbage in older segments. A background thread periodically
+ * compacts the sealed segments whose garbage exceeds a threshold by moving their live entries
+ * to the end of the log and then deleting the segment files. A tombstone is dropped by the
+ * compaction once no older segment may hold a version of its key, which is checked against a
+ * Bloom filter of the keys of each sealed segment.
+ *
+ * On construction, the index is rebuilt by replaying all segments found in the directory.
+ * Writes are only flushed to the OS, not fsync'ed, so this storage survives a process crash
+ * but not a machine crash, except for the writes that precede a call to Sync(). Compaction
+ * syncs the entries that it moves before it deletes a segment so that they stay durable.
+ */
+class LogStructuredStorage : public Storage<Key, Record>, public LookupMasterIndex<Key, Metadata> {
+ public:
+  struct Options {
+    std::string directory;
+    size_t segment_size_bytes = 64 * 1024 * 1024;
+    size_t memory_budget_bytes = 1024 * 1024 * 1024;
+    uint32_t compaction_garbage_pct = 50;
+    std::chrono::milliseconds compaction_interval = 1000ms;
+    uint32_t prefetch_threads = 2;
+    size_t max_pending_prefetches = 100000;
+  };
+
+  LogStructuredStorage(const Options& options);
+  ~LogStructuredStorage();
+
+  bool Read(const Key& key, Record& result) const final;
+
+  void Write(const Key& key, const Record& record) final;
+
+  bool Delete(const Key& key) final;
+
+  bool GetMasterMetadata(const Key& key, Metadata& metadata) const final;
+
+  void Prefetch(const std::vector<const Key*>& keys) const final;
+
+  // The value bytes are those of the latest versions in the segment files. Cached values are not counted
+  bool GetStats(StorageStats& stats, bool per_segment) const final;
+
+  /**
+   * Writes the buffered part of the active segment to its file
+   */
+  void Flush();
+
+  /**
+   * Makes all writes so far durable by flushing the active segment and syncing all segment
+   * files that have not been synced since they were sealed
+   */
+  void Sync();
+
+  /**
+   * Compacts all sealed segments having enough garbage. This is periodically
+   * called by the background thread but can also be called directly.
+   */
+  void Compact();
+
+  size_t num_keys() const { return num_keys_; }
+  // Number of values that were read from disk by the prefetch threads
+  size_t num_prefetched() const { return num_prefetched_; }
+  size_t num_segments() const;
+
+ private:
+  struct Location {
+    uint32_t segment;
+    uint32_t value_size : 31;
+    uint32_t compressed : 1;
+    uint64_t value_offset;
+    Metadata metadata;
+
+    // Found by argument-dependent lookup when the index is counted in the stats
+    friend size_t ValueBytes(const Location& loc) { return loc.value_size; }
+  };
+
+  struct Segment {
+    Segment(uint32_t id, const std::string& path, int fd) : id(id), path(path), fd(fd) {}
+    ~Segment();
+
+    const uint32_t id;
+    const std::string path;
+    const int fd;
+    // Number of bytes appended to this segment, including the buffered ones
+    std::atomic<uint64_t> size = 0;
+    // Number of bytes that have been written to the file
+    std::atomic<uint64_t> flushed_size = 0;
+    // Number of bytes of entries that are still referenced by the index
+    std::atomic<uint64_t> live_bytes = 0;
+    // Set once the segment is sealed and synced
+    std::atomic<bool> synced = false;
+    // Bloom filter of the keys of all entries in this segment, including the dead ones and the
+    // tombstones. Built once the segment is sealed and guarded by write_mut_
+    std::vector<uint64_t> key_filter;
+  };
+  using SegmentPtr = std::shared_ptr<Segment>;
+
+  /**
+   * A sharded LRU cache of values, indexed by their location in the log. Since
+   * a location is never reused for a different value, a cached value never
+   * becomes stale; it is simply not looked up anymore after the key is overwritten.
+   */
+  class ValueCache {
+   public:
+    ValueCache(size_t capacity_bytes);
+    bool Get(uint64_t location, std::string& value);
+    // Same as Get but neither copies the value nor makes it more recently used
+    bool Contains(uint64_t location);
+    void Put(uint64_t location, const std::string& value);
+
+   private:
+    static constexpr size_t kNumShards = 16;
+    struct Shard {
+      std::mutex mut;
+      std::list<std::pair<uint64_t, std::string>> lru;
+      std::unordered_map<uint64_t, std::list<std::pair<uint64_t, std::string>>::iterator> entries;
+      size_t size_bytes = 0;
+    };
+    size_t shard_capacity_bytes_;
+    Shard shards_[kNumShards];
+  };
+
+  static uint64_t CacheKey(const Location& loc) {
+    return (static_cast<uint64_t>(loc.segment) << 40) | loc.value_offset;
+  }
+
+  void Recover();
+  void RecoverSegment(const SegmentPtr& segment, bool is_last);
+
+  // Must hold write_mut_
+  Location Append(const Key& key, const std::string& value, const Metadata& metadata, uint32_t flags);
+  // Must hold write_mut_
+  void StartNewSegment();
+  // Must hold write_mut_
+  void FlushLocked();
+  // Must hold write_mut_
+  void MarkDead(uint32_t segment, uint64_t bytes);
+
+  // Returns false if the segment of the given location no longer exists
+  bool ReadValue(const Location& loc, std::string& value) const;
+  void CompactSegment(const SegmentPtr& segment);
+  // Must hold write_mut_
+  bool OlderSegmentMayContain(const Key& key, uint32_t segment_id) const;
+
+  SegmentPtr GetSegment(uint32_t id) const;
+
+  void BackgroundLoop();
+  void PrefetchLoop();
+  // Reads the value of the key into the cache if it is only on disk
+  void LoadIntoCache(const Key& key);
+
+  const Options options_;
+
+  ConcurrentHashMap<Key, Location> index_;
+  mutable ValueCache cache_;
+  std::atomic<size_t> num_keys_;
+
+  mutable std::shared_mutex segments_mut_;
+  std::map<uint32_t, SegmentPtr> segments_;
+
+  // Serializes all appends to the log and the index updates following them
+  mutable std::mutex write_mut_;
+  SegmentPtr active_segment_;
+  std::string write_buffer_;
+  // Hashes of the keys appended to the active segment, from which its key filter is built
+  std::vector<size_t> active_key_hashes_;
+
+  // Prevents compacting the same segment twice
+  std::mutex compaction_mut_;
+
+  std::mutex background_mut_;
+  std::condition_variable background_cv_;
+  bool stopping_;
+  std::thread background_thread_;
+
+  mutable std::mutex prefetch_mut_;
+  mutable std::condition_variable prefetch_cv_;
+  mutable std::deque<Key> pending_prefetches_;
+  bool stopping_prefetch_;
+  std::atomic<size_t> num_prefetched_;
+  std::vector<std::thread> prefetch_threads_;
+};
+
+}  // namespace slog
@@ -1,41 +1,134 @@
 #pragma once
 
+#include <memory>
+
 #include "data_structure/concurrent_hash_map.h"
+#include "data_structure/concurrent_skip_list.h"
 
 #include "storage/storage.h"
 #include "storage/lookup_master_index.h"
 
 namespace slog {
 
-template<typename K, typename R, typename M>
+template<typename K, typename R, typename M, typename HashFn = std::hash<K>>
 class MemOnlyStorage : 
     public Storage<K, R>,
     public LookupMasterIndex<K, M> {
 public:
+  /**
+   * If ordered is true, the keys are also kept in an ordered index so that
+   * they can be scanned by range. This makes inserting new keys slower.
+   */
+  explicit MemOnlyStorage(bool ordered = false) {
+    if (ordered) {
+      index_ = std::make_unique<ConcurrentSkipList<K>>();
+    }
+  }
 
   bool Read(const K& key, R& result) const final {
     return table_.Get(result, key);
   }
 
   void Write(const K& key, const R& record) final {
-    table_.InsertOrUpdate(key, record);
+    bool existed = table_.InsertOrUpdate(key, record);
+    if (!existed && index_ != nullptr) {
+      index_->Insert(key);
+    }
   }
 
   bool Delete(const K& key) final {
+    if (index_ != nullptr) {
+      index_->Erase(key);
+    }
     return table_.Erase(key);
   }
 
-  bool GetMasterMetadata(const K& key, M& metadata) const final {
-    R rec;
-    if (!table_.Get(rec, key)) {
+  void WriteBatch(const std::vector<std::pair<K, R>>& records) final {
+    table_.InsertOrUpdateBatch(records);
+    if (index_ != nullptr) {
+      for (const auto& entry : records) {
+        index_->Insert(entry.first);
+      }
+    }
+  }
+
+  void MultiRead(const std::vector<const K*>& keys, std::vector<std::optional<R>>& records) const final {
+    table_.MultiGet(keys, records);
+  }
+
+  void ReadModifyWrite(const std::vector<const K*>& keys, const typename Storage<K, R>::ModifyFn& modify_fn) final {
+    std::vector<const K*> new_keys;
+    table_.ReadModifyWrite(keys, [&](size_t i, R& record, bool exists) {
+      modify_fn(i, record, exists);
+      if (!exists) {
+        new_keys.push_back(keys[i]);
+      }
+    });
+    if (index_ != nullptr) {
+      for (auto key : new_keys) {
+        index_->Insert(*key);
+      }
+    }
+  }
+
+  bool Scan(const K& start, const K& end, std::vector<std::pair<K, R>>& records) const final {
+    if (index_ == nullptr) {
       return false;
     }
-    metadata = rec.metadata;
+    std::vector<K> keys;
+    index_->Scan(start, end, [&keys](const K& key) {
+      keys.push_back(key);
+      return true;
+    });
+    // Looking up the keys together lets the lookups overlap
+    std::vector<const K*> key_ptrs;
+    key_ptrs.reserve(keys.size());
+    for (const auto& key : keys) {
+      key_ptrs.push_back(&key);
+    }
+    std::vector<std::optional<R>> results;
+    table_.MultiGet(key_ptrs, results);
+
+    records.clear();
+    records.reserve(keys.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+      // The key may have been deleted after it was found in the index
+      if (results[i].has_value()) {
+        records.emplace_back(std::move(keys[i]), std::move(*results[i]));
+      }
+    }
+    return true;
+  }
+
+  void Reserve(size_t num_keys) final {
+    table_.Reserve(num_keys);
+  }
+
+  bool GetStats(StorageStats& stats, bool per_segment) const final {
+    stats.table = table_.Stats(per_segment ? &stats.segments : nullptr);
+    stats.num_keys = stats.table.num_keys;
+    stats.value_bytes = stats.table.value_bytes;
+    stats.index_bytes = stats.table.index_bytes;
+    if (index_ != nullptr) {
+      stats.index_bytes += index_->memory_bytes();
+    }
     return true;
   }
 
+  bool GetMasterMetadata(const K& key, M& metadata) const final {
+    // Only the metadata is copied out of the record, not its value
+    return table_.Visit(key, [&metadata](const R& record) { metadata = record.metadata; });
+  }
+
+  template<typename Fn>
+  void ForEach(Fn&& fn) const {
+    table_.ForEach(fn);
+  }
+
 private:
-  ConcurrentHashMap<K, R> table_;
+  ConcurrentHashMap<K, R, HashFn> table_;
+  // Null if the keys are not ordered
+  std::unique_ptr<ConcurrentSkipList<K>> index_;
 };
 
 } // namespace slog
\ No newline at end of file
@@ -0,0 +1,235 @@
+#include "storage/multi_version_storage.h"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+
+namespace slog {
+
+namespace {
+
+// A full pass over the keys takes this many advances of the gc horizon
+constexpr uint64_t kSweepsPerPass = 16;
+
+}  // namespace
+
+MultiVersionStorage::MultiVersionStorage(LogPosition snapshot_retention)
+    : snapshot_retention_(snapshot_retention), stable_position_(0), gc_horizon_(0), next_sweep_segment_(0) {}
+
+bool MultiVersionStorage::Read(const Key& key, Record& result) const {
+  // Only the newest version is copied out of the chain
+  bool found = false;
+  versions_.Visit(key, [&](const VersionChain& chain) {
+    found = !chain.empty() && chain.front().record.has_value();
+    if (found) {
+      result = *chain.front().record;
+    }
+  });
+  return found;
+}
+
+void MultiVersionStorage::Write(const Key& key, const Record& record) {
+  versions_.InsertOrUpdate(key, {Version{0, record}});
+}
+
+bool MultiVersionStorage::Delete(const Key& key) { return versions_.Erase(key); }
+
+void MultiVersionStorage::WriteBatch(const std::vector<std::pair<Key, Record>>& records) {
+  std::vector<std::pair<Key, VersionChain>> chains;
+  chains.reserve(records.size());
+  for (const auto& [key, record] : records) {
+    chains.emplace_back(key, VersionChain{Version{0, record}});
+  }
+  versions_.InsertOrUpdateBatch(chains);
+}
+
+void MultiVersionStorage::MultiRead(const std::vector<const Key*>& keys,
+                                    std::vector<std::optional<Record>>& records) const {
+  records.clear();
+  records.resize(keys.size());
+  versions_.MultiVisit(keys, [&records](size_t i, const VersionChain& chain) {
+    records[i] = chain.empty() ? std::nullopt : chain.front().record;
+  });
+}
+
+void MultiVersionStorage::ReadModifyWrite(const std::vector<const Key*>& keys, const ModifyFn& modify_fn) {
+  versions_.ReadModifyWrite(keys, [&modify_fn](size_t i, VersionChain& chain, bool) {
+    Record record;
+    bool exists = !chain.empty() && chain.front().record.has_value();
+    if (exists) {
+      record = std::move(*chain.front().record);
+    }
+    modify_fn(i, record, exists);
+    chain = {Version{0, std::move(record)}};
+  });
+}
+
+void MultiVersionStorage::ReadModifyWriteAt(const std::vector<const Key*>& keys, const ModifyFn& modify_fn,
+                                            LogPosition position) {
+  // A stale horizon only makes the garbage collection less aggressive since it never decreases
+  auto gc_horizon = gc_horizon_.load(std::memory_order_acquire);
+  versions_.ReadModifyWrite(keys, [&](size_t i, VersionChain& chain, bool) {
+    Record record;
+    bool exists = !chain.empty() && chain.front().record.has_value();
+    if (exists) {
+      record = *chain.front().record;
+    }
+    modify_fn(i, record, exists);
+    AddVersion(chain, position, std::move(record), gc_horizon);
+  });
+}
+
+bool MultiVersionStorage::DeleteAt(const Key& key, LogPosition position) {
+  auto gc_horizon = gc_horizon_.load(std::memory_order_acquire);
+  bool existed = false;
+  // A key that does not exist already reads the same as a deleted key so it is not inserted
+  versions_.UpdateOrErase(std::vector<const Key*>{&key}, [&](size_t, VersionChain& chain) {
+    existed = !chain.empty() && chain.front().record.has_value();
+    if (existed) {
+      AddVersion(chain, position, std::nullopt, gc_horizon);
+    }
+    return !chain.empty();
+  });
+  return existed;
+}
+
+void MultiVersionStorage::SetStablePosition(LogPosition position) {
+  stable_position_.store(position, std::memory_order_release);
+  bool advanced;
+  {
+    std::lock_guard<std::mutex> guard(snapshots_mut_);
+    advanced = UpdateGcHorizon();
+  }
+  if (advanced) {
+    Sweep();
+  }
+}
+
+void MultiVersionStorage::Reserve(size_t num_keys) { versions_.Reserve(num_keys); }
+
+bool MultiVersionStorage::GetMasterMetadata(const Key& key, Metadata& metadata) const {
+  bool found = false;
+  versions_.Visit(key, [&](const VersionChain& chain) {
+    found = !chain.empty() && chain.front().record.has_value();
+    if (found) {
+      metadata = chain.front().record->metadata;
+    }
+  });
+  return found;
+}
+
+bool MultiVersionStorage::GetStats(StorageStats& stats, bool per_segment) const {
+  stats.table = versions_.Stats(per_segment ? &stats.segments : nullptr);
+  stats.num_keys = stats.table.num_keys;
+  stats.value_bytes = stats.table.value_bytes;
+  stats.index_bytes = stats.table.index_bytes;
+  return true;
+}
+
+std::optional<LogPosition> MultiVersionStorage::AcquireSnapshot(std::optional<LogPosition> position) {
+  std::lock_guard<std::mutex> guard(snapshots_mut_);
+  auto stable_position = stable_position_.load(std::memory_order_acquire);
+  auto snapshot_position = position.value_or(stable_position);
+  if (snapshot_position > stable_position || snapshot_position < gc_horizon_.load(std::memory_order_relaxed)) {
+    return std::nullopt;
+  }
+  snapshots_.insert(snapshot_position);
+  return snapshot_position;
+}
+
+void MultiVersionStorage::ReleaseSnapshot(LogPosition position) {
+  bool advanced;
+  {
+    std::lock_guard<std::mutex> guard(snapshots_mut_);
+    auto it = snapshots_.find(position);
+    CHECK(it != snapshots_.end()) << "No snapshot at position " << position;
+    snapshots_.erase(it);
+    advanced = UpdateGcHorizon();
+  }
+  if (advanced) {
+    Sweep();
+  }
+}
+
+void MultiVersionStorage::MultiReadAt(const std::vector<const Key*>& keys, LogPosition position,
+                                      std::vector<std::optional<Record>>& records) const {
+  records.clear();
+  records.resize(keys.size());
+  versions_.MultiVisit(keys, [&records, position](size_t i, const VersionChain& chain) {
+    auto version = FindVersion(chain, position);
+    records[i] = version != nullptr ? version->record : std::nullopt;
+  });
+}
+
+const MultiVersionStorage::Version* MultiVersionStorage::FindVersion(const VersionChain& chain,
+                                                                     LogPosition position) {
+  for (const auto& version : chain) {
+    if (version.position <= position) {
+      return &version;
+    }
+  }
+  return nullptr;
+}
+
+void MultiVersionStorage::AddVersion(VersionChain& chain, LogPosition position, std::optional<Record>&& record,
+                                     LogPosition gc_horizon) {
+  DCHECK(chain.empty() || chain.front().position <= position) << "Versions must be added in log order";
+  chain.insert(chain.begin(), Version{position, std::move(record)});
+  chain.erase(FindGarbage(chain, gc_horizon), chain.end());
+}
+
+MultiVersionStorage::VersionChain::const_iterator MultiVersionStorage::FindGarbage(const VersionChain& chain,
+                                                                                   LogPosition gc_horizon) {
+  // Only the newest version at or before the horizon can be read by the oldest possible snapshot
+  auto it = std::find_if(chain.begin(), chain.end(),
+                         [gc_horizon](const Version& version) { return version.position <= gc_horizon; });
+  if (it == chain.end()) {
+    return it;
+  }
+  // A deleted key reads the same as a key without any version
+  return it->record.has_value() ? it + 1 : it;
+}
+
+bool MultiVersionStorage::UpdateGcHorizon() {
+  auto stable_position = stable_position_.load(std::memory_order_relaxed);
+  auto gc_horizon = stable_position > snapshot_retention_ ? stable_position - snapshot_retention_ : 0;
+  if (!snapshots_.empty()) {
+    gc_horizon = std::min(gc_horizon, *snapshots_.begin());
+  }
+  if (gc_horizon > gc_horizon_.load(std::memory_order_relaxed)) {
+    gc_horizon_.store(gc_horizon, std::memory_order_release);
+    return true;
+  }
+  return false;
+}
+
+void MultiVersionStorage::Sweep() {
+  std::unique_lock<std::mutex> lock(sweep_mut_, std::try_to_lock);
+  if (!lock.owns_lock()) {
+    return;
+  }
+
+  auto gc_horizon = gc_horizon_.load(std::memory_order_acquire);
+  std::vector<Key> keys;
+  for (uint64_t i = 0; i < versions_.num_segments() / kSweepsPerPass; i++) {
+    versions_.ForEachInSegment(next_sweep_segment_, [&](const Key& key, const VersionChain& chain) {
+      if (FindGarbage(chain, gc_horizon) != chain.end()) {
+        keys.push_back(key);
+      }
+    });
+    next_sweep_segment_ = (next_sweep_segment_ + 1) % versions_.num_segments();
+  }
+
+  // The chains may have changed since they were visited so their garbage is looked for again
+  std::vector<const Key*> key_ptrs;
+  key_ptrs.reserve(keys.size());
+  for (const auto& key : keys) {
+    key_ptrs.push_back(&key);
+  }
+  versions_.UpdateOrErase(key_ptrs, [gc_horizon](size_t, VersionChain& chain) {
+    chain.erase(FindGarbage(chain, gc_horizon), chain.end());
+    return !chain.empty();
+  });
+}
+
+}  // namespace slog
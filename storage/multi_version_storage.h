@@ -0,0 +1,133 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "common/types.h"
+#include "data_structure/concurrent_hash_map.h"
+#include "storage/lookup_master_index.h"
+#include "storage/storage.h"
+
+namespace slog {
+
+/**
+ * An in-memory storage that keeps a short chain of versions for each key. Each version
+ * is tagged with the log position of the transaction that wrote it so that the storage
+ * can be read as of any stable position, i.e. a position up to which all transactions
+ * have been applied and their writes are durable.
+ *
+ * Reading at a position requires holding a snapshot at that position. The versions of a
+ * key that no snapshot can read anymore are dropped the next time the key is written, or
+ * by the sweep that runs over a few segments of keys each time the gc horizon advances,
+ * which also erases the keys that are deleted as of the horizon. A version can still be
+ * read while there is a snapshot at or after its position or while it is within the
+ * retention window behind the stable position.
+ *
+ * Writes without a log position, such as those loading the initial data, are treated as
+ * coming before all transactions and replace all versions of their key.
+ */
+class MultiVersionStorage : public Storage<Key, Record>, public LookupMasterIndex<Key, Metadata> {
+ public:
+  /**
+   * A snapshot can be acquired at up to snapshot_retention positions behind the stable position
+   */
+  MultiVersionStorage(LogPosition snapshot_retention = 0);
+
+  bool Read(const Key& key, Record& result) const final;
+
+  void Write(const Key& key, const Record& record) final;
+
+  bool Delete(const Key& key) final;
+
+  void WriteBatch(const std::vector<std::pair<Key, Record>>& records) final;
+
+  void MultiRead(const std::vector<const Key*>& keys, std::vector<std::optional<Record>>& records) const final;
+
+  void ReadModifyWrite(const std::vector<const Key*>& keys, const ModifyFn& modify_fn) final;
+
+  void ReadModifyWriteAt(const std::vector<const Key*>& keys, const ModifyFn& modify_fn, LogPosition position) final;
+
+  bool DeleteAt(const Key& key, LogPosition position) final;
+
+  void SetStablePosition(LogPosition position) final;
+
+  void Reserve(size_t num_keys) final;
+
+  bool GetMasterMetadata(const Key& key, Metadata& metadata) const final;
+
+  // The value bytes include all versions of the records
+  bool GetStats(StorageStats& stats, bool per_segment) const final;
+
+  /**
+   * Acquires a snapshot at the given position or at the stable position if none is given.
+   * Returns the position of the snapshot or nothing if the position is not stable yet or
+   * its versions might have been garbage collected. Must be paired with ReleaseSnapshot.
+   */
+  std::optional<LogPosition> AcquireSnapshot(std::optional<LogPosition> position = std::nullopt);
+
+  void ReleaseSnapshot(LogPosition position);
+
+  /**
+   * Reads many records as of a snapshot held at the given position. records[i] is the
+   * record of keys[i] or empty if it did not exist at that position.
+   */
+  void MultiReadAt(const std::vector<const Key*>& keys, LogPosition position,
+                   std::vector<std::optional<Record>>& records) const;
+
+  LogPosition stable_position() const { return stable_position_.load(std::memory_order_acquire); }
+
+ private:
+  struct Version {
+    LogPosition position;
+    // Empty if the key was deleted at this position
+    std::optional<Record> record;
+
+    // Found by argument-dependent lookup when the version chains are counted in the stats
+    friend size_t ValueBytes(const std::vector<Version>& chain) {
+      size_t bytes = 0;
+      for (const auto& version : chain) {
+        bytes += version.record.has_value() ? version.record->size() : 0;
+      }
+      return bytes;
+    }
+  };
+  // Newest version first. An empty chain is the same as a non-existent key
+  using VersionChain = std::vector<Version>;
+
+  // Returns the newest version of the chain at or before the given position or nullptr if there is none
+  static const Version* FindVersion(const VersionChain& chain, LogPosition position);
+
+  // Adds a new version to the chain and drops the versions that cannot be read at or after gc_horizon
+  static void AddVersion(VersionChain& chain, LogPosition position, std::optional<Record>&& record,
+                         LogPosition gc_horizon);
+
+  // Returns the first version of the chain that cannot be read at or after gc_horizon or the end of the chain
+  static VersionChain::const_iterator FindGarbage(const VersionChain& chain, LogPosition gc_horizon);
+
+  // Must hold snapshots_mut_. Returns true if the gc horizon advanced
+  bool UpdateGcHorizon();
+
+  // Drops the garbage of the keys in the next few segments of versions_. Skipped if another sweep is running
+  void Sweep();
+
+  const LogPosition snapshot_retention_;
+
+  ConcurrentHashMap<Key, VersionChain> versions_;
+
+  std::atomic<LogPosition> stable_position_;
+  // Versions needed to read at this position or later are never dropped. This never decreases
+  std::atomic<LogPosition> gc_horizon_;
+
+  std::mutex snapshots_mut_;
+  std::multiset<LogPosition> snapshots_;
+
+  std::mutex sweep_mut_;
+  // Segment of versions_ where the next sweep starts
+  uint64_t next_sweep_segment_;
+};
+
+}  // namespace slog
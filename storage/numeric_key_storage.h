@@ -0,0 +1,111 @@
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "common/string_utils.h"
+#include "common/types.h"
+#include "storage/lookup_master_index.h"
+#include "storage/mem_only_storage.h"
+#include "storage/storage.h"
+
+namespace slog {
+
+/**
+ * With simple partitioning, all keys are decimal integers and the keys of a partition
+ * are congruent modulo the number of partitions. The low bits of the key are mixed into
+ * the rest so that such keys are still spread across all segments of the hash map.
+ */
+struct NumericKeyHash {
+  size_t operator()(uint64_t key) const {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    return key;
+  }
+};
+
+/**
+ * An in-memory storage for deployments using simple partitioning. Keys are parsed
+ * into integers at the interface so that internally they are hashed and compared as
+ * integers and stored without any string allocation.
+ */
+template <typename R, typename M>
+class NumericKeyStorage : public Storage<Key, R>, public LookupMasterIndex<Key, M> {
+ public:
+  /**
+   * If ordered is true, the keys can be scanned by range in numeric order
+   */
+  explicit NumericKeyStorage(bool ordered = false) : storage_(ordered) {}
+
+  bool Read(const Key& key, R& result) const final { return storage_.Read(ParseNumericKey(key), result); }
+
+  void Write(const Key& key, const R& record) final { storage_.Write(ParseNumericKey(key), record); }
+
+  bool Delete(const Key& key) final { return storage_.Delete(ParseNumericKey(key)); }
+
+  void WriteBatch(const std::vector<std::pair<Key, R>>& records) final {
+    std::vector<std::pair<uint64_t, R>> numeric_records;
+    numeric_records.reserve(records.size());
+    for (const auto& [key, record] : records) {
+      numeric_records.emplace_back(ParseNumericKey(key), record);
+    }
+    storage_.WriteBatch(numeric_records);
+  }
+
+  void MultiRead(const std::vector<const Key*>& keys, std::vector<std::optional<R>>& records) const final {
+    std::vector<uint64_t> numeric_keys;
+    std::vector<const uint64_t*> numeric_key_ptrs;
+    ParseKeys(keys, numeric_keys, numeric_key_ptrs);
+    storage_.MultiRead(numeric_key_ptrs, records);
+  }
+
+  void ReadModifyWrite(const std::vector<const Key*>& keys, const typename Storage<Key, R>::ModifyFn& modify_fn) final {
+    std::vector<uint64_t> numeric_keys;
+    std::vector<const uint64_t*> numeric_key_ptrs;
+    ParseKeys(keys, numeric_keys, numeric_key_ptrs);
+    storage_.ReadModifyWrite(numeric_key_ptrs, modify_fn);
+  }
+
+  bool Scan(const Key& start, const Key& end, std::vector<std::pair<Key, R>>& records) const final {
+    std::vector<std::pair<uint64_t, R>> numeric_records;
+    if (!storage_.Scan(ParseNumericKey(start), ParseNumericKey(end), numeric_records)) {
+      return false;
+    }
+    records.clear();
+    records.reserve(numeric_records.size());
+    for (auto& [key, record] : numeric_records) {
+      records.emplace_back(std::to_string(key), std::move(record));
+    }
+    return true;
+  }
+
+  void Reserve(size_t num_keys) final { storage_.Reserve(num_keys); }
+
+  bool GetStats(StorageStats& stats, bool per_segment) const final { return storage_.GetStats(stats, per_segment); }
+
+  bool GetMasterMetadata(const Key& key, M& metadata) const final {
+    return storage_.GetMasterMetadata(ParseNumericKey(key), metadata);
+  }
+
+  template <typename Fn>
+  void ForEach(Fn&& fn) const {
+    storage_.ForEach([&fn](uint64_t key, const R& record) { fn(std::to_string(key), record); });
+  }
+
+ private:
+  static void ParseKeys(const std::vector<const Key*>& keys, std::vector<uint64_t>& numeric_keys,
+                        std::vector<const uint64_t*>& numeric_key_ptrs) {
+    numeric_keys.reserve(keys.size());
+    numeric_key_ptrs.reserve(keys.size());
+    for (auto key : keys) {
+      numeric_keys.push_back(ParseNumericKey(*key));
+      numeric_key_ptrs.push_back(&numeric_keys.back());
+    }
+  }
+
+  MemOnlyStorage<uint64_t, R, M, NumericKeyHash> storage_;
+};
+
+}  // namespace slog
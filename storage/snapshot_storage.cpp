@@ -0,0 +1,247 @@
+#include "storage/snapshot_storage.h"
+
+#include <fcntl.h>
+#include <glog/logging.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+
+namespace slog {
+
+using snapshot::EntryHeader;
+using snapshot::Header;
+using snapshot::Slot;
+
+namespace {
+
+const char kMagic[8] = {'S', 'L', 'O', 'G', 'S', 'N', 'A', 'P'};
+const uint32_t kVersion = 3;
+const uint32_t kCompressed = 1;
+const size_t kWriteBufferSize = 4 * 1024 * 1024;
+
+// The hash is stored in the file so it must be stable across builds, unlike std::hash
+uint64_t HashKey(const Key& key) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (unsigned char c : key) {
+    hash ^= c;
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+size_t Align(size_t size) { return (size + 7) & ~static_cast<size_t>(7); }
+
+void WriteFully(int fd, const char* data, size_t size, uint64_t offset, const std::string& path) {
+  while (size > 0) {
+    auto n = pwrite(fd, data, size, offset);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0) {
+      LOG(FATAL) << "Error while writing snapshot \"" << path << "\": " << strerror(errno);
+    }
+    data += n;
+    size -= n;
+    offset += n;
+  }
+}
+
+}  // namespace
+
+/**
+ * SnapshotWriter
+ */
+
+SnapshotWriter::SnapshotWriter(const std::string& path, uint64_t lsn)
+    : path_(path), tmp_path_(path + ".tmp"), lsn_(lsn), offset_(sizeof(Header)) {
+  fd_ = open(tmp_path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd_ < 0) {
+    LOG(FATAL) << "Cannot create snapshot \"" << tmp_path_ << "\": " << strerror(errno);
+  }
+}
+
+SnapshotWriter::~SnapshotWriter() {
+  if (fd_ >= 0) {
+    close(fd_);
+    unlink(tmp_path_.c_str());
+  }
+}
+
+void SnapshotWriter::Add(const Key& key, const Record& record) {
+  auto value = record.to_string();
+  EntryHeader entry{.key_size = static_cast<uint32_t>(key.size()),
+                    .value_size = static_cast<uint32_t>(value.size()),
+                    .master = record.metadata.master,
+                    .counter = record.metadata.counter,
+                    .flags = record.compressed() ? kCompressed : 0};
+  auto entry_size = Align(sizeof(EntryHeader) + key.size() + value.size());
+
+  entries_.push_back({.hash = HashKey(key), .offset = offset_ + buffer_.size()});
+
+  auto pos = buffer_.size();
+  buffer_.resize(pos + entry_size, '\0');
+  memcpy(buffer_.data() + pos, &entry, sizeof(EntryHeader));
+  memcpy(buffer_.data() + pos + sizeof(EntryHeader), key.data(), key.size());
+  memcpy(buffer_.data() + pos + sizeof(EntryHeader) + key.size(), value.data(), value.size());
+
+  if (buffer_.size() >= kWriteBufferSize) {
+    FlushBuffer();
+  }
+}
+
+void SnapshotWriter::FlushBuffer() {
+  WriteFully(fd_, buffer_.data(), buffer_.size(), offset_, tmp_path_);
+  offset_ += buffer_.size();
+  buffer_.clear();
+}
+
+void SnapshotWriter::Finish() {
+  FlushBuffer();
+
+  // Keep the load factor at most 0.5 so that probe sequences stay short
+  uint64_t num_slots = 2;
+  while (num_slots < 2 * entries_.size()) {
+    num_slots <<= 1;
+  }
+  std::vector<Slot> slots(num_slots, Slot{.hash = 0, .offset = 0});
+  for (const auto& entry : entries_) {
+    auto i = entry.hash & (num_slots - 1);
+    while (slots[i].offset != 0) {
+      i = (i + 1) & (num_slots - 1);
+    }
+    slots[i] = entry;
+  }
+  WriteFully(fd_, reinterpret_cast<const char*>(slots.data()), slots.size() * sizeof(Slot), offset_, tmp_path_);
+
+  Header header;
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.reserved = 0;
+  header.num_records = entries_.size();
+  header.num_slots = num_slots;
+  header.slots_offset = offset_;
+  header.lsn = lsn_;
+  WriteFully(fd_, reinterpret_cast<const char*>(&header), sizeof(Header), 0, tmp_path_);
+
+  if (fsync(fd_) < 0) {
+    LOG(FATAL) << "Error while syncing snapshot \"" << tmp_path_ << "\": " << strerror(errno);
+  }
+  close(fd_);
+  fd_ = -1;
+  if (rename(tmp_path_.c_str(), path_.c_str()) < 0) {
+    LOG(FATAL) << "Cannot rename snapshot \"" << tmp_path_ << "\" to \"" << path_ << "\": " << strerror(errno);
+  }
+
+  LOG(INFO) << "Wrote snapshot of " << entries_.size() << " records up to LSN " << lsn_ << " to \"" << path_ << "\"";
+}
+
+/**
+ * SnapshotStorage
+ */
+
+SnapshotStorage::SnapshotStorage(const std::string& path) : path_(path) {
+  fd_ = open(path_.c_str(), O_RDONLY);
+  if (fd_ < 0) {
+    LOG(FATAL) << "Cannot open snapshot \"" << path_ << "\": " << strerror(errno);
+  }
+  struct stat st;
+  if (fstat(fd_, &st) < 0) {
+    LOG(FATAL) << "Cannot stat snapshot \"" << path_ << "\": " << strerror(errno);
+  }
+  size_ = st.st_size;
+  CHECK_GE(size_, sizeof(Header)) << "Snapshot \"" << path_ << "\" is too small";
+
+  auto data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+  if (data == MAP_FAILED) {
+    LOG(FATAL) << "Cannot map snapshot \"" << path_ << "\": " << strerror(errno);
+  }
+  // Lookups are scattered over the whole file so reading ahead would mostly fetch unused pages
+  madvise(data, size_, MADV_RANDOM);
+  data_ = static_cast<const char*>(data);
+
+  header_ = reinterpret_cast<const Header*>(data_);
+  CHECK(memcmp(header_->magic, kMagic, sizeof(kMagic)) == 0) << "\"" << path_ << "\" is not a snapshot";
+  CHECK_EQ(header_->version, kVersion) << "Unsupported snapshot version";
+  CHECK_EQ(header_->slots_offset + header_->num_slots * sizeof(Slot), size_)
+      << "Snapshot \"" << path_ << "\" is corrupted";
+  slots_ = reinterpret_cast<const Slot*>(data_ + header_->slots_offset);
+
+  LOG(INFO) << "Mapped snapshot of " << header_->num_records << " records up to LSN " << header_->lsn << " from \""
+            << path_ << "\"";
+}
+
+SnapshotStorage::~SnapshotStorage() {
+  munmap(const_cast<char*>(data_), size_);
+  close(fd_);
+}
+
+const EntryHeader* SnapshotStorage::Find(const Key& key) const {
+  auto hash = HashKey(key);
+  auto mask = header_->num_slots - 1;
+  for (auto i = hash & mask;; i = (i + 1) & mask) {
+    const auto& slot = slots_[i];
+    if (slot.offset == 0) {
+      return nullptr;
+    }
+    if (slot.hash != hash) {
+      continue;
+    }
+    auto entry = reinterpret_cast<const EntryHeader*>(data_ + slot.offset);
+    if (entry->key_size == key.size() && memcmp(entry + 1, key.data(), key.size()) == 0) {
+      return entry;
+    }
+  }
+}
+
+bool SnapshotStorage::Read(const Key& key, Record& result) const {
+  std::optional<Record> overlaid;
+  if (overlay_.Get(overlaid, key)) {
+    if (!overlaid.has_value()) {
+      return false;
+    }
+    result = *overlaid;
+    return true;
+  }
+
+  auto entry = Find(key);
+  if (entry == nullptr) {
+    return false;
+  }
+  result.SetValue(reinterpret_cast<const char*>(entry + 1) + entry->key_size, entry->value_size,
+                  entry->flags & kCompressed);
+  result.metadata = Metadata(entry->master, entry->counter);
+  return true;
+}
+
+void SnapshotStorage::Write(const Key& key, const Record& record) { overlay_.InsertOrUpdate(key, record); }
+
+bool SnapshotStorage::Delete(const Key& key) {
+  std::optional<Record> overlaid;
+  bool exists = overlay_.Get(overlaid, key) ? overlaid.has_value() : Find(key) != nullptr;
+  if (exists) {
+    overlay_.InsertOrUpdate(key, std::nullopt);
+  }
+  return exists;
+}
+
+bool SnapshotStorage::GetMasterMetadata(const Key& key, Metadata& metadata) const {
+  std::optional<Record> overlaid;
+  if (overlay_.Get(overlaid, key)) {
+    if (!overlaid.has_value()) {
+      return false;
+    }
+    metadata = overlaid->metadata;
+    return true;
+  }
+
+  auto entry = Find(key);
+  if (entry == nullptr) {
+    return false;
+  }
+  metadata = Metadata(entry->master, entry->counter);
+  return true;
+}
+
+}  // namespace slog
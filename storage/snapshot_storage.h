@@ -0,0 +1,123 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "common/types.h"
+#include "data_structure/concurrent_hash_map.h"
+#include "storage/lookup_master_index.h"
+#include "storage/storage.h"
+
+namespace slog {
+
+namespace snapshot {
+
+/**
+ * A snapshot file is laid out as
+ *
+ *    <Header> <entry 1> <entry 2> ... <entry n> <Slot 1> <Slot 2> ... <Slot m>
+ *
+ * Each entry is an EntryHeader followed by the key and the value, padded to
+ * 8 bytes. The slots form an open-addressing hash table with linear probing
+ * whose size is a power of 2. A slot refers to an entry by its offset from
+ * the beginning of the file, so the file can be used in place wherever it
+ * is mapped.
+ */
+struct Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved;
+  uint64_t num_records;
+  uint64_t num_slots;
+  uint64_t slots_offset;
+  // LSN of the last write-ahead log record whose writes are in the snapshot
+  uint64_t lsn;
+};
+
+struct EntryHeader {
+  uint32_t key_size;
+  uint32_t value_size;
+  uint32_t master;
+  uint32_t counter;
+  uint32_t flags;
+};
+
+struct Slot {
+  uint64_t hash;
+  // 0 if the slot is empty
+  uint64_t offset;
+};
+
+}  // namespace snapshot
+
+/**
+ * Writes records into a new snapshot file. The file is only moved to the
+ * given path after Finish() so an interrupted dump never leaves a partial
+ * snapshot behind. This class is not thread-safe.
+ *
+ * The given LSN is that of the last write-ahead log record whose writes are
+ * in the snapshot, or 0 if the snapshot only has the initial data.
+ */
+class SnapshotWriter {
+ public:
+  SnapshotWriter(const std::string& path, uint64_t lsn = 0);
+  ~SnapshotWriter();
+
+  void Add(const Key& key, const Record& record);
+
+  void Finish();
+
+ private:
+  void FlushBuffer();
+
+  const std::string path_;
+  const std::string tmp_path_;
+  const uint64_t lsn_;
+  int fd_;
+  std::string buffer_;
+  uint64_t offset_;
+  std::vector<snapshot::Slot> entries_;
+};
+
+/**
+ * A storage backed by a memory-mapped snapshot file. Opening a snapshot only
+ * maps the file, so startup time does not depend on the number of records.
+ * Pages of the file are faulted in lazily as keys are looked up.
+ *
+ * The mapped file is never modified. Writes and deletes after the snapshot is
+ * opened are kept in memory and take precedence over the snapshot.
+ */
+class SnapshotStorage : public Storage<Key, Record>, public LookupMasterIndex<Key, Metadata> {
+ public:
+  SnapshotStorage(const std::string& path);
+  ~SnapshotStorage();
+
+  bool Read(const Key& key, Record& result) const final;
+
+  void Write(const Key& key, const Record& record) final;
+
+  bool Delete(const Key& key) final;
+
+  bool GetMasterMetadata(const Key& key, Metadata& metadata) const final;
+
+  size_t num_snapshot_records() const { return header_->num_records; }
+  // The write-ahead log records up to this LSN must not be replayed on top of the snapshot
+  uint64_t lsn() const { return header_->lsn; }
+
+ private:
+  // Returns nullptr if the key is not in the snapshot
+  const snapshot::EntryHeader* Find(const Key& key) const;
+
+  const std::string path_;
+  int fd_;
+  size_t size_;
+  const char* data_;
+  const snapshot::Header* header_;
+  const snapshot::Slot* slots_;
+
+  // Records written after the snapshot was opened. A deleted key maps to an empty value
+  ConcurrentHashMap<Key, std::optional<Record>> overlay_;
+};
+
+}  // namespace slog
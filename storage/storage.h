@@ -1,7 +1,30 @@
 #pragma once
 
+#include <functional>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "common/types.h"
+#include "data_structure/concurrent_hash_map.h"
+
 namespace slog {
 
+/**
+ * Memory used by a storage
+ */
+struct StorageStats {
+  size_t num_keys = 0;
+  // Bytes of the values of all records
+  size_t value_bytes = 0;
+  // Memory used to find the records, such as hash tables and their nodes
+  size_t index_bytes = 0;
+  // Totals over the segments of the hash table holding the records
+  concurrent_hash_map::SegmentStats table;
+  // Stats of each segment of the hash table holding the records. Only filled if requested
+  std::vector<concurrent_hash_map::SegmentStats> segments;
+};
+
 template <typename K, typename R>
 class Storage {
 public:
@@ -10,6 +33,94 @@ public:
   virtual void Write(const K& key, const R& record) = 0;
 
   virtual bool Delete(const K& key) = 0;
+
+  /**
+   * Reads many records at once. records[i] is the record of keys[i] or empty if it
+   * does not exist. Implementations may override this to amortize the cost of
+   * looking up the keys.
+   */
+  virtual void MultiRead(const std::vector<const K*>& keys, std::vector<std::optional<R>>& records) const {
+    records.clear();
+    records.resize(keys.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+      R record;
+      if (Read(*keys[i], record)) {
+        records[i] = std::move(record);
+      }
+    }
+  }
+
+  /**
+   * Called with the index of a key, its record and whether the key exists. If it does not,
+   * the record is default-constructed.
+   */
+  using ModifyFn = std::function<void(size_t i, R& record, bool exists)>;
+
+  /**
+   * Reads the records of many keys, lets modify_fn change them and writes them back.
+   * Implementations may override this to do all of it with one lookup per key.
+   */
+  virtual void ReadModifyWrite(const std::vector<const K*>& keys, const ModifyFn& modify_fn) {
+    for (size_t i = 0; i < keys.size(); i++) {
+      R record;
+      bool exists = Read(*keys[i], record);
+      modify_fn(i, record, exists);
+      Write(*keys[i], record);
+    }
+  }
+
+  /**
+   * Same as above but for the writes of the transaction at the given log position. Storages
+   * that only keep the latest version of a record ignore the position.
+   */
+  virtual void ReadModifyWriteAt(const std::vector<const K*>& keys, const ModifyFn& modify_fn,
+                                 LogPosition /* position */) {
+    ReadModifyWrite(keys, modify_fn);
+  }
+
+  virtual bool DeleteAt(const K& key, LogPosition /* position */) { return Delete(key); }
+
+  /**
+   * Tells the storage that all transactions up to the given log position have been applied and,
+   * if there is a write-ahead log, that their writes are durable. Does nothing by default.
+   */
+  virtual void SetStablePosition(LogPosition /* position */) {}
+
+  /**
+   * Writes many records at once. Implementations may override this
+   * to amortize their synchronization cost over the whole batch.
+   */
+  virtual void WriteBatch(const std::vector<std::pair<K, R>>& records) {
+    for (const auto& [key, record] : records) {
+      Write(key, record);
+    }
+  }
+
+  /**
+   * Reads the records of all keys in [start, end) in the order of the keys. Returns false
+   * if the storage does not keep its keys ordered.
+   */
+  virtual bool Scan(const K& /* start */, const K& /* end */, std::vector<std::pair<K, R>>& /* records */) const {
+    return false;
+  }
+
+  /**
+   * Hints that the given keys are about to be read. Storages that keep some of their
+   * records on disk may load them into memory in the background. Does nothing by default.
+   */
+  virtual void Prefetch(const std::vector<const K*>& /* keys */) const {}
+
+  /**
+   * Fills in the memory usage of the storage, including the stats of each segment of its hash
+   * table if per_segment is true. Returns false if the storage does not keep such stats.
+   */
+  virtual bool GetStats(StorageStats& /* stats */, bool /* per_segment */) const { return false; }
+
+  /**
+   * Hints that the storage is about to receive the given number of keys,
+   * so that it can presize its structures. Does nothing by default.
+   */
+  virtual void Reserve(size_t /* num_keys */) {}
 };
 
 } // namespace slog
\ No newline at end of file
@@ -0,0 +1,274 @@
+#include "storage/write_ahead_log.h"
+
+#include <fcntl.h>
+#include <glog/logging.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+
+namespace slog {
+
+namespace {
+
+const char kSegmentExtension[] = ".wal";
+// The buffer is flushed before the group commit interval ends if it reaches this size
+const size_t kMaxBatchSize = 16 * 1024 * 1024;
+
+std::string SegmentPath(const std::string& directory, uint64_t first_lsn) {
+  return directory + "/" + std::to_string(first_lsn) + kSegmentExtension;
+}
+
+void SyncDirectory(const std::string& directory) {
+  auto fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+  if (fd < 0 || fsync(fd) < 0) {
+    LOG(FATAL) << "Cannot sync directory \"" << directory << "\": " << strerror(errno);
+  }
+  close(fd);
+}
+
+}  // namespace
+
+WriteAheadLog::WriteAheadLog(const std::string& directory, std::chrono::microseconds group_commit_interval,
+                             size_t segment_size_bytes, CheckpointFn checkpoint)
+    : directory_(directory),
+      group_commit_interval_(group_commit_interval),
+      segment_size_bytes_(segment_size_bytes),
+      checkpoint_(std::move(checkpoint)),
+      fd_(-1),
+      segment_size_(0),
+      stopping_(false),
+      last_lsn_(0),
+      durable_lsn_(0) {
+  std::filesystem::create_directories(directory_);
+  for (const auto& entry : std::filesystem::directory_iterator(directory_)) {
+    const auto& path = entry.path();
+    if (path.extension() == kSegmentExtension) {
+      segments_.push_back(std::stoull(path.stem().string()));
+    }
+  }
+  std::sort(segments_.begin(), segments_.end());
+  // An existing log is opened for appending when it is replayed
+  if (segments_.empty()) {
+    std::lock_guard<std::mutex> guard(segments_mut_);
+    StartSegment(1);
+  }
+  flush_thread_ = std::thread(&WriteAheadLog::FlushLoop, this);
+}
+
+WriteAheadLog::~WriteAheadLog() {
+  {
+    std::lock_guard<std::mutex> guard(mut_);
+    stopping_ = true;
+  }
+  cv_.notify_one();
+  flush_thread_.join();
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+}
+
+uint64_t WriteAheadLog::Replay(Storage<Key, Record>& storage, uint64_t storage_lsn) {
+  CHECK_EQ(last_lsn_, 0U) << "Write-ahead log must be replayed before any append";
+
+  std::lock_guard<std::mutex> guard(segments_mut_);
+  if (fd_ >= 0) {
+    CHECK_EQ(storage_lsn, 0U) << "The storage has the writes up to LSN " << storage_lsn
+                              << " but the write-ahead log in \"" << directory_ << "\" is new";
+    return 0;
+  }
+  CHECK_LE(segments_.front(), storage_lsn + 1)
+      << "The storage only has the writes up to LSN " << storage_lsn << " but the write-ahead log in \"" << directory_
+      << "\" starts at LSN " << segments_.front();
+
+  uint64_t num_records = 0;
+  uint64_t lsn = segments_.front() - 1;
+  WriteAheadLogRecord record;
+  for (size_t i = 0; i < segments_.size(); i++) {
+    auto path = SegmentPath(directory_, segments_[i]);
+    bool is_last = i == segments_.size() - 1;
+    CHECK_EQ(segments_[i], lsn + 1) << "Segment \"" << path << "\" does not follow the previous one";
+
+    auto fd = open(path.c_str(), O_RDWR);
+    if (fd < 0) {
+      LOG(FATAL) << "Cannot open write-ahead log segment \"" << path << "\": " << strerror(errno);
+    }
+    std::string data(lseek(fd, 0, SEEK_END), '\0');
+    if (pread(fd, data.data(), data.size(), 0) != static_cast<ssize_t>(data.size())) {
+      LOG(FATAL) << "Cannot read write-ahead log segment \"" << path << "\": " << strerror(errno);
+    }
+
+    size_t pos = 0;
+    while (pos < data.size()) {
+      uint32_t size;
+      bool valid = pos + sizeof(size) <= data.size();
+      if (valid) {
+        memcpy(&size, data.data() + pos, sizeof(size));
+        valid = pos + sizeof(size) + size <= data.size() &&
+                record.ParseFromArray(data.data() + pos + sizeof(size), size);
+      }
+      if (!valid) {
+        // A crash in the middle of a flush may leave an incomplete record at the end. Older
+        // segments are synced before the next one is started so they are always complete
+        CHECK(is_last) << "Write-ahead log segment \"" << path << "\" is corrupted at offset " << pos;
+        LOG(WARNING) << "Truncating incomplete record at the end of \"" << path << "\"";
+        if (ftruncate(fd, pos) < 0) {
+          LOG(FATAL) << "Cannot truncate write-ahead log segment \"" << path << "\": " << strerror(errno);
+        }
+        break;
+      }
+
+      pos += sizeof(size) + size;
+      lsn++;
+      if (lsn <= storage_lsn) {
+        continue;
+      }
+
+      Record replayed;
+      for (const auto& datum : record.writes()) {
+        replayed.SetValue(datum.record(), datum.compressed());
+        replayed.metadata = Metadata(datum.master(), datum.counter());
+        storage.Write(datum.key(), replayed);
+      }
+      for (const auto& key : record.deleted_keys()) {
+        storage.Delete(key);
+      }
+      num_records++;
+    }
+
+    if (is_last) {
+      lseek(fd, pos, SEEK_SET);
+      fd_ = fd;
+      segment_size_ = pos;
+    } else {
+      close(fd);
+    }
+  }
+
+  CHECK_GE(lsn, storage_lsn) << "The storage has the writes up to LSN " << storage_lsn
+                             << " but the write-ahead log in \"" << directory_ << "\" ends at LSN " << lsn;
+  last_lsn_ = lsn;
+  durable_lsn_ = lsn;
+
+  LOG(INFO) << "Replayed " << num_records << " records from " << segments_.size()
+            << " segments of the write-ahead log in \"" << directory_ << "\"";
+
+  return num_records;
+}
+
+void WriteAheadLog::Truncate(uint64_t lsn) {
+  std::lock_guard<std::mutex> guard(segments_mut_);
+  // A segment only contains the records before the first record of the next segment
+  while (segments_.size() > 1 && segments_[1] <= lsn + 1) {
+    auto path = SegmentPath(directory_, segments_.front());
+    if (unlink(path.c_str()) < 0) {
+      LOG(FATAL) << "Cannot delete write-ahead log segment \"" << path << "\": " << strerror(errno);
+    }
+    segments_.pop_front();
+  }
+}
+
+uint64_t WriteAheadLog::first_lsn() const {
+  std::lock_guard<std::mutex> guard(segments_mut_);
+  return segments_.front();
+}
+
+size_t WriteAheadLog::num_segments() const {
+  std::lock_guard<std::mutex> guard(segments_mut_);
+  return segments_.size();
+}
+
+void WriteAheadLog::StartSegment(uint64_t first_lsn) {
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+  auto path = SegmentPath(directory_, first_lsn);
+  fd_ = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd_ < 0) {
+    LOG(FATAL) << "Cannot create write-ahead log segment \"" << path << "\": " << strerror(errno);
+  }
+  // The records in the new segment are not durable unless the segment itself is
+  SyncDirectory(directory_);
+  segment_size_ = 0;
+  segments_.push_back(first_lsn);
+}
+
+uint64_t WriteAheadLog::Append(const WriteAheadLogRecord& record) {
+  uint32_t size = record.ByteSizeLong();
+
+  std::lock_guard<std::mutex> guard(mut_);
+  bool was_empty = buffer_.empty();
+  if (was_empty) {
+    batch_start_time_ = std::chrono::steady_clock::now();
+  }
+  auto offset = buffer_.size();
+  buffer_.resize(offset + sizeof(size) + size);
+  memcpy(buffer_.data() + offset, &size, sizeof(size));
+  record.SerializeToArray(buffer_.data() + offset + sizeof(size), size);
+  auto lsn = ++last_lsn_;
+
+  if (was_empty || buffer_.size() >= kMaxBatchSize) {
+    cv_.notify_one();
+  }
+
+  return lsn;
+}
+
+void WriteAheadLog::FlushLoop() {
+  std::unique_lock<std::mutex> lock(mut_);
+  for (;;) {
+    cv_.wait(lock, [this] { return stopping_ || !buffer_.empty(); });
+    // Wait for more records to join this group until the oldest record has waited
+    // for the whole group commit interval or the buffer is full
+    cv_.wait_until(lock, batch_start_time_ + group_commit_interval_,
+                   [this] { return stopping_ || buffer_.size() >= kMaxBatchSize; });
+    if (buffer_.empty()) {
+      // Only reachable when stopping
+      break;
+    }
+
+    std::string batch;
+    batch.swap(buffer_);
+    uint64_t lsn = last_lsn_;
+    lock.unlock();
+
+    CHECK_GE(fd_, 0) << "Write-ahead log was appended to before it was replayed";
+
+    const char* data = batch.data();
+    size_t remaining = batch.size();
+    while (remaining > 0) {
+      auto n = write(fd_, data, remaining);
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      if (n < 0) {
+        LOG(FATAL) << "Error while writing to write-ahead log in \"" << directory_ << "\": " << strerror(errno);
+      }
+      data += n;
+      remaining -= n;
+    }
+    if (fdatasync(fd_) < 0) {
+      LOG(FATAL) << "Error while syncing write-ahead log in \"" << directory_ << "\": " << strerror(errno);
+    }
+    durable_lsn_ = lsn;
+    segment_size_ += batch.size();
+
+    if (segment_size_ >= segment_size_bytes_) {
+      {
+        std::lock_guard<std::mutex> guard(segments_mut_);
+        StartSegment(lsn + 1);
+      }
+      // The writes of a record are applied to the storage before the record is appended, so
+      // once the storage is checkpointed, none of the older segments is needed anymore
+      if (checkpoint_ != nullptr) {
+        checkpoint_();
+        Truncate(lsn);
+      }
+    }
+
+    lock.lock();
+  }
+}
+
+}  // namespace slog
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "common/types.h"
+#include "proto/offline_data.pb.h"
+#include "storage/storage.h"
+
+namespace slog {
+
+/**
+ * A write-ahead log shared by all workers of a partition.
+ *
+ * Workers append the writes of their committed transactions to an in-memory buffer.
+ * A background thread writes the buffer to the log file and fsyncs it, at the latest
+ * one group commit interval after the oldest record in the buffer was appended, so
+ * all records appended by all workers within an interval cost a single fsync.
+ *
+ * Each record is identified by a log sequence number (LSN), starting from 1. A record
+ * is durable once its LSN is not larger than durable_lsn().
+ *
+ * The log is split into segment files named after the LSN of their first record. A new segment
+ * is started once the current one exceeds the segment size. If a checkpoint function is given,
+ * it is called after each new segment is started and the older segments are deleted once it
+ * returns. Without a checkpoint function, no segment is ever deleted so the log grows without
+ * bound and a restart replays all of it.
+ *
+ * On disk, each record is laid out as <size of the record (4 bytes)> <WriteAheadLogRecord>
+ */
+class WriteAheadLog {
+ public:
+  /**
+   * Must make all writes that have been applied to the storage so far durable. It is called from
+   * the flush thread, so the records that are appended in the meantime wait for it
+   */
+  using CheckpointFn = std::function<void()>;
+
+  WriteAheadLog(const std::string& directory, std::chrono::microseconds group_commit_interval,
+                size_t segment_size_bytes = 64 * 1024 * 1024, CheckpointFn checkpoint = nullptr);
+  ~WriteAheadLog();
+
+  /**
+   * Applies the records in the log to the given storage. This must be called before
+   * the first append if the directory already contains a log.
+   *
+   * The storage already has the writes of the records up to storage_lsn, so these are
+   * skipped. The log must still have all records after storage_lsn and must not end
+   * before it, otherwise either the storage or the log is stale.
+   *
+   * @return Number of replayed records
+   */
+  uint64_t Replay(Storage<Key, Record>& storage, uint64_t storage_lsn = 0);
+
+  /**
+   * Appends a record to the log. This is thread-safe.
+   *
+   * @return LSN of the appended record
+   */
+  uint64_t Append(const WriteAheadLogRecord& record);
+
+  /**
+   * Deletes the segments whose records all have an LSN not larger than the given one. The
+   * segment that is being appended to is never deleted. This is thread-safe.
+   */
+  void Truncate(uint64_t lsn);
+
+  // LSN of the oldest record that is still in the log. It is last_lsn() + 1 if the log is empty
+  uint64_t first_lsn() const;
+  size_t num_segments() const;
+  uint64_t last_lsn() const { return last_lsn_; }
+  uint64_t durable_lsn() const { return durable_lsn_; }
+  std::chrono::microseconds group_commit_interval() const { return group_commit_interval_; }
+
+ private:
+  // Must hold segments_mut_
+  void StartSegment(uint64_t first_lsn);
+  void FlushLoop();
+
+  const std::string directory_;
+  const std::chrono::microseconds group_commit_interval_;
+  const size_t segment_size_bytes_;
+  const CheckpointFn checkpoint_;
+
+  // LSNs of the first records of the segments, from the oldest to the one being appended to
+  mutable std::mutex segments_mut_;
+  std::deque<uint64_t> segments_;
+  // Only used by the flush thread once the log is opened
+  int fd_;
+  size_t segment_size_;
+
+  std::mutex mut_;
+  std::condition_variable cv_;
+  std::string buffer_;
+  std::chrono::steady_clock::time_point batch_start_time_;
+  bool stopping_;
+  std::atomic<uint64_t> last_lsn_;
+  std::atomic<uint64_t> durable_lsn_;
+
+  std::thread flush_thread_;
+};
+
+}  // namespace slog
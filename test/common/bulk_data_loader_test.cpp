@@ -0,0 +1,79 @@
+#include "common/bulk_data_loader.h"
+
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <fstream>
+#include <mutex>
+
+#include "test/test_utils.h"
+
+using namespace std;
+using namespace slog;
+
+class BulkDataLoaderTest : public ::testing::Test {
+ protected:
+  void WriteDataFile(int num_datums) {
+    ofstream out(path_, ios::binary);
+    google::protobuf::io::OstreamOutputStream raw_output(&out);
+    google::protobuf::io::CodedOutputStream output(&raw_output);
+    output.WriteVarint32(num_datums);
+    for (int i = 0; i < num_datums; i++) {
+      Datum datum;
+      datum.set_key(to_string(i));
+      datum.set_record(string(i % 50, 'a'));
+      datum.set_master(i % 3);
+      output.WriteVarint32(datum.ByteSizeLong());
+      datum.SerializeToCodedStream(&output);
+    }
+  }
+
+  TempDirectory temp_directory_{"slog_loader_test"};
+  string directory_ = temp_directory_.path();
+  string path_ = directory_ + "/0.dat";
+};
+
+TEST_F(BulkDataLoaderTest, LoadInFileOrder) {
+  const int kNumDatums = 10000;
+  WriteDataFile(kNumDatums);
+
+  BulkDataLoader loader(4);
+  mutex mut;
+  vector<vector<Datum>> datums_per_chunk(4);
+  ASSERT_TRUE(loader.Load(path_, [&](uint32_t chunk, vector<Datum>& batch) {
+    lock_guard<mutex> guard(mut);
+    ASSERT_LT(chunk, 4U);
+    for (auto& datum : batch) {
+      datums_per_chunk[chunk].push_back(move(datum));
+    }
+  }));
+  ASSERT_EQ(loader.num_datums(), static_cast<uint64_t>(kNumDatums));
+  ASSERT_EQ(loader.num_chunks(), 4U);
+
+  int i = 0;
+  for (const auto& datums : datums_per_chunk) {
+    for (const auto& datum : datums) {
+      ASSERT_EQ(datum.key(), to_string(i));
+      ASSERT_EQ(datum.record(), string(i % 50, 'a'));
+      ASSERT_EQ(datum.master(), static_cast<uint32_t>(i % 3));
+      i++;
+    }
+  }
+  ASSERT_EQ(i, kNumDatums);
+}
+
+TEST_F(BulkDataLoaderTest, FewerDatumsThanThreads) {
+  WriteDataFile(2);
+  BulkDataLoader loader(8);
+  atomic<int> count = 0;
+  ASSERT_TRUE(loader.Load(path_, [&](uint32_t, vector<Datum>& batch) { count += batch.size(); }));
+  ASSERT_EQ(count, 2);
+  ASSERT_LE(loader.num_chunks(), 2U);
+}
+
+TEST_F(BulkDataLoaderTest, MissingFile) {
+  BulkDataLoader loader(2);
+  ASSERT_FALSE(loader.Load(directory_ + "/missing.dat", [](uint32_t, vector<Datum>&) {}));
+}
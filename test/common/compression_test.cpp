@@ -0,0 +1,106 @@
+#include "common/compression.h"
+
+#include <gtest/gtest.h>
+
+#include <random>
+
+using namespace std;
+using namespace slog;
+
+namespace {
+
+string RandomBytes(size_t size) {
+  mt19937 rg(size);
+  string bytes(size, '\0');
+  for (auto& c : bytes) {
+    c = static_cast<char>(rg());
+  }
+  return bytes;
+}
+
+string JsonLikeValue(size_t size) {
+  mt19937 rg(size);
+  string value = "{";
+  for (int i = 0; value.size() < size; i++) {
+    value += "\"field" + to_string(i) + "\": {\"id\": " + to_string(rg() % 1000) + ", \"name\": \"item" +
+             to_string(rg() % 100) + "\", \"active\": true},";
+  }
+  value.resize(size);
+  return value;
+}
+
+void AssertRoundTrip(const string& value) {
+  string compressed, decompressed;
+  CompressValue(value, compressed);
+  ASSERT_TRUE(DecompressValue(compressed, decompressed));
+  ASSERT_EQ(decompressed, value);
+}
+
+}  // namespace
+
+TEST(CompressionTest, RoundTrip) {
+  AssertRoundTrip("");
+  AssertRoundTrip("a");
+  AssertRoundTrip("abcd");
+  AssertRoundTrip("abcabcabcabcabcabcabc");
+  // Long literal runs and long matches need extra length bytes
+  AssertRoundTrip(string(100000, 'a'));
+  AssertRoundTrip(RandomBytes(1000));
+  AssertRoundTrip(RandomBytes(100000));
+  AssertRoundTrip(RandomBytes(300) + string(300, 'x') + RandomBytes(300));
+  AssertRoundTrip(JsonLikeValue(10000));
+  // Matches are only searched in the last 64KB
+  auto block = RandomBytes(70000);
+  AssertRoundTrip(block + block);
+}
+
+TEST(CompressionTest, CompressesRedundantData) {
+  string compressed;
+  CompressValue(string(10000, 'a'), compressed);
+  ASSERT_LT(compressed.size(), 100U);
+
+  auto json = JsonLikeValue(10000);
+  CompressValue(json, compressed);
+  ASSERT_LT(compressed.size(), json.size() / 2);
+}
+
+TEST(CompressionTest, RejectsCorruptedInput) {
+  string compressed, decompressed;
+  CompressValue(JsonLikeValue(1000), compressed);
+  ASSERT_FALSE(DecompressValue(compressed.substr(0, compressed.size() / 2), decompressed));
+  ASSERT_FALSE(DecompressValue("", decompressed));
+  // A huge size in the header
+  ASSERT_FALSE(DecompressValue("\xff\xff\xff\xff\x0f", decompressed));
+
+  // Random garbage must never crash the decoder
+  for (size_t size = 1; size < 200; size++) {
+    DecompressValue(RandomBytes(size), decompressed);
+  }
+}
+
+TEST(CompressionTest, MaybeCompressValue) {
+  string compressed;
+  auto value = string(1000, 'a');
+  ASSERT_FALSE(MaybeCompressValue(value, 0 /* min_size */, compressed));
+  ASSERT_FALSE(MaybeCompressValue(value, 1001 /* min_size */, compressed));
+  ASSERT_TRUE(MaybeCompressValue(value, 1000 /* min_size */, compressed));
+  // Incompressible values are stored as is
+  ASSERT_FALSE(MaybeCompressValue(RandomBytes(1000), 1 /* min_size */, compressed));
+}
+
+TEST(CompressionTest, DecompressValueEntry) {
+  auto value = JsonLikeValue(1000);
+  string compressed;
+  CompressValue(value, compressed);
+
+  ValueEntry entry;
+  entry.set_value(compressed);
+  entry.set_compressed(true);
+  DecompressValueEntry(entry);
+  ASSERT_EQ(entry.value(), value);
+  ASSERT_FALSE(entry.compressed());
+
+  // Uncompressed values are left alone
+  DecompressValueEntry(entry);
+  ASSERT_EQ(entry.value(), value);
+}
@@ -0,0 +1,123 @@
+#include "common/flat_txn.h"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+
+#include "common/proto_utils.h"
+
+using namespace std;
+using namespace slog;
+
+TEST(FlatTxnTest, KeysAreSorted) {
+  unique_ptr<Transaction> txn(MakeTransaction(
+      {{"C", KeyType::WRITE, {{1, 2}}}, {"A", KeyType::READ, {{0, 0}}}, {"B", KeyType::WRITE, {{1, 5}}}}));
+  txn->mutable_internal()->set_id(7);
+  txn->mutable_internal()->set_home(1);
+
+  FlatTxn flat_txn(*txn);
+  ASSERT_EQ(flat_txn.id(), 7U);
+  ASSERT_EQ(flat_txn.home(), 1);
+  ASSERT_FALSE(flat_txn.is_remaster());
+  ASSERT_EQ(flat_txn.num_keys(), 3U);
+  ASSERT_EQ(flat_txn.key(0), "A");
+  ASSERT_EQ(flat_txn.key(1), "B");
+  ASSERT_EQ(flat_txn.key(2), "C");
+  ASSERT_EQ(flat_txn.slot(0).type, KeyType::READ);
+  ASSERT_EQ(flat_txn.slot(1).type, KeyType::WRITE);
+  ASSERT_EQ(flat_txn.slot(1).metadata.master, 1U);
+  ASSERT_EQ(flat_txn.slot(1).metadata.counter, 5U);
+  ASSERT_EQ(flat_txn.key_ptrs().size(), 3U);
+  for (size_t i = 0; i < flat_txn.num_keys(); i++) {
+    ASSERT_EQ(flat_txn.key_ptrs()[i], &flat_txn.key(i));
+    ASSERT_EQ(flat_txn.Find(flat_txn.key(i)), i);
+  }
+  ASSERT_EQ(flat_txn.Find("D"), FlatTxn::kNotFound);
+  ASSERT_EQ(flat_txn.Find(""), FlatTxn::kNotFound);
+}
+
+TEST(FlatTxnTest, AddRemoteReads) {
+  unique_ptr<Transaction> txn(MakeTransaction({{"B", KeyType::WRITE}, {"D"}}));
+  FlatTxn flat_txn(*txn);
+  flat_txn.slot(flat_txn.Find("B")).value = "local";
+
+  google::protobuf::Map<string, ValueEntry> reads;
+  reads["A"].set_value("remote A");
+  reads["B"].set_value("remote B");
+  reads["C"].set_value("remote C");
+  reads["C"].set_compressed(true);
+  flat_txn.AddRemoteReads(reads);
+
+  ASSERT_EQ(flat_txn.num_keys(), 4U);
+  ASSERT_EQ(flat_txn.key(0), "A");
+  ASSERT_EQ(flat_txn.key(1), "B");
+  ASSERT_EQ(flat_txn.key(2), "C");
+  ASSERT_EQ(flat_txn.key(3), "D");
+  ASSERT_EQ(flat_txn.slot(0).value, "remote A");
+  // Local keys are not overwritten
+  ASSERT_EQ(flat_txn.slot(1).value, "local");
+  ASSERT_EQ(flat_txn.slot(1).type, KeyType::WRITE);
+  ASSERT_EQ(flat_txn.slot(2).value, "remote C");
+  ASSERT_TRUE(flat_txn.slot(2).compressed);
+  for (size_t i = 0; i < flat_txn.num_keys(); i++) {
+    ASSERT_EQ(flat_txn.key_ptrs()[i], &flat_txn.key(i));
+  }
+}
+
+TEST(FlatTxnTest, MoveTo) {
+  unique_ptr<Transaction> txn(MakeTransaction({{"A"}, {"B", KeyType::WRITE}, {"C", KeyType::WRITE}}));
+  FlatTxn flat_txn(*txn);
+  flat_txn.slot(flat_txn.Find("A")).value = "value A";
+  flat_txn.slot(flat_txn.Find("B")).new_value = "new value B";
+  flat_txn.Delete(flat_txn.Find("C"));
+
+  google::protobuf::Map<string, ValueEntry> reads;
+  reads["R"].set_value("remote R");
+  reads["R"].set_type(KeyType::READ);
+  flat_txn.AddRemoteReads(reads);
+
+  // The flat txn is not affected by changes to the proto after it is created
+  txn->mutable_keys()->at("A").set_value("stale");
+
+  flat_txn.MoveTo(*txn);
+  ASSERT_EQ(txn->keys_size(), 4);
+  ASSERT_EQ(txn->keys().at("A").value(), "value A");
+  ASSERT_EQ(txn->keys().at("A").type(), KeyType::READ);
+  ASSERT_EQ(txn->keys().at("B").new_value(), "new value B");
+  ASSERT_EQ(txn->keys().at("B").type(), KeyType::WRITE);
+  ASSERT_EQ(txn->keys().at("R").value(), "remote R");
+  ASSERT_EQ(txn->deleted_keys_size(), 1);
+  ASSERT_EQ(txn->deleted_keys(0), "C");
+}
+
+TEST(FlatTxnTest, MoveKeepsKeyPointers) {
+  unique_ptr<Transaction> txn(MakeTransaction({{"A"}, {"B"}}));
+  FlatTxn flat_txn(*txn);
+  auto key_ptrs = flat_txn.key_ptrs();
+
+  FlatTxn moved(std::move(flat_txn));
+  ASSERT_EQ(moved.key_ptrs(), key_ptrs);
+  ASSERT_EQ(*moved.key_ptrs()[0], "A");
+  ASSERT_EQ(*moved.key_ptrs()[1], "B");
+}
+
+TEST(FlatTxnTest, NumericKeys) {
+  unique_ptr<Transaction> txn(MakeTransaction({{"20", KeyType::WRITE}, {"3"}}));
+  FlatTxn flat_txn(*txn);
+  ASSERT_FALSE(flat_txn.has_numeric_keys());
+  flat_txn.ParseNumericKeys();
+  ASSERT_TRUE(flat_txn.has_numeric_keys());
+  // Keys stay sorted as strings and the numbers follow their order
+  ASSERT_EQ(flat_txn.key(0), "20");
+  ASSERT_EQ(flat_txn.numeric_key(0), 20U);
+  ASSERT_EQ(flat_txn.key_as<uint64_t>(1), 3U);
+  ASSERT_EQ(flat_txn.key_as<Key>(1), "3");
+
+  google::protobuf::Map<string, ValueEntry> reads;
+  reads["100"].set_value("remote");
+  flat_txn.AddRemoteReads(reads);
+  ASSERT_EQ(flat_txn.num_keys(), 3U);
+  for (size_t i = 0; i < flat_txn.num_keys(); i++) {
+    ASSERT_EQ(std::to_string(flat_txn.numeric_key(i)), flat_txn.key(i));
+  }
+}
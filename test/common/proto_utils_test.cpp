@@ -0,0 +1,74 @@
+#include "common/proto_utils.h"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <vector>
+
+using namespace std;
+using namespace slog;
+using internal::Envelope;
+
+namespace {
+
+EnvelopePtr MakeBatchEnvelope(google::protobuf::Arena* arena, int num_txns) {
+  EnvelopePtr env(google::protobuf::Arena::CreateMessage<Envelope>(arena));
+  auto batch = env->mutable_request()->mutable_forward_batch()->mutable_batch_data();
+  batch->set_id(100);
+  for (int i = 0; i < num_txns; i++) {
+    unique_ptr<Transaction> txn(MakeTransaction({{"A"}, {"B", KeyType::WRITE}}));
+    txn->mutable_internal()->set_id(i);
+    batch->add_transactions()->CopyFrom(*txn);
+  }
+  return env;
+}
+
+}  // namespace
+
+TEST(ProtoUtilsTest, UnbatchFromArena) {
+  auto arena = NewArena(1000);
+  auto batch = ReleaseBatchData(MakeBatchEnvelope(arena, 3));
+  ASSERT_EQ(batch->GetArena(), arena);
+  ASSERT_EQ(batch->id(), 100U);
+
+  auto transactions = Unbatch(batch.get());
+  ASSERT_EQ(transactions.size(), 3U);
+  ASSERT_EQ(batch->transactions_size(), 0);
+  for (size_t i = 0; i < transactions.size(); i++) {
+    ASSERT_EQ(transactions[i]->GetArena(), arena);
+    ASSERT_EQ(transactions[i]->internal().id(), i);
+  }
+
+  // The txns outlive the batch as long as someone shares the arena
+  ArenaPtr shared_arena(batch.release()->GetArena());
+  unique_ptr<Transaction, ArenaSharerDeleter<Transaction>> txn(transactions[0]);
+  txn.reset();
+  ASSERT_EQ(transactions[1]->keys().size(), 2U);
+}
+
+TEST(ProtoUtilsTest, UnbatchFromHeap) {
+  auto batch = ReleaseBatchData(MakeBatchEnvelope(nullptr, 2));
+  ASSERT_EQ(batch->GetArena(), nullptr);
+
+  auto transactions = Unbatch(batch.get());
+  ASSERT_EQ(transactions.size(), 2U);
+  for (auto txn : transactions) {
+    ASSERT_EQ(txn->GetArena(), nullptr);
+    unique_ptr<Transaction, ArenaSharerDeleter<Transaction>> deleter(txn);
+  }
+}
+
+TEST(ProtoUtilsTest, EnvelopeOwnsItsArena) {
+  Envelope serialized_env;
+  serialized_env.mutable_request()->mutable_forward_batch()->mutable_batch_data()->set_id(5);
+  auto data = serialized_env.SerializeAsString();
+
+  EnvelopePtr env(google::protobuf::Arena::CreateMessage<Envelope>(NewArena(data.size())));
+  ASSERT_TRUE(env->ParseFromString(data));
+  ASSERT_EQ(env->request().forward_batch().batch_data().id(), 5U);
+  // Deleting the envelope frees the arena, which is checked by the leak sanitizer
+
+  // Pointers with the default deleter are accepted
+  EnvelopePtr heap_env = make_unique<Envelope>();
+  ASSERT_EQ(heap_env->GetArena(), nullptr);
+}
@@ -0,0 +1,120 @@
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+#include "common/slab_allocator.h"
+#include "common/types.h"
+
+using namespace std;
+using namespace slog;
+
+TEST(RecordTest, InlineAndSlabValues) {
+  string small(Record::kInlineSize, 'a');
+  string large(100, 'b');
+  string huge(SlabAllocator::kMaxBlockSize + 1, 'c');
+
+  Record record(small, 1, 2);
+  ASSERT_EQ(record.to_string(), small);
+  ASSERT_EQ(record.metadata.master, 1U);
+  ASSERT_EQ(record.metadata.counter, 2U);
+
+  record.SetValue(large);
+  ASSERT_EQ(record.to_string(), large);
+  record.SetValue(small);
+  ASSERT_EQ(record.to_string(), small);
+  record.SetValue(huge);
+  ASSERT_EQ(record.to_string(), huge);
+  record.SetValue("");
+  ASSERT_EQ(record.to_string(), "");
+
+  ASSERT_EQ(Record().to_string(), "");
+}
+
+TEST(RecordTest, CopyAndMove) {
+  for (auto value : {string("short"), string(100, 'x')}) {
+    Record record(value, 1);
+
+    Record copy(record);
+    ASSERT_EQ(copy.to_string(), value);
+    Record assigned("foo", 0);
+    assigned = record;
+    ASSERT_EQ(assigned.to_string(), value);
+    ASSERT_EQ(assigned.metadata.master, 1U);
+    assigned = assigned;
+    ASSERT_EQ(assigned.to_string(), value);
+
+    Record moved(std::move(copy));
+    ASSERT_EQ(moved.to_string(), value);
+    Record move_assigned(string(200, 'y'), 0);
+    move_assigned = std::move(moved);
+    ASSERT_EQ(move_assigned.to_string(), value);
+
+    ASSERT_EQ(record.to_string(), value);
+  }
+}
+
+TEST(RecordTest, SameSizeUpdatesReuseBuffer) {
+  Record record(string(100, 'a'), 0);
+  for (char c = 'b'; c <= 'z'; c++) {
+    record.SetValue(string(100, c));
+    ASSERT_EQ(record.to_string(), string(100, c));
+  }
+  // A smaller value still fits in the same block
+  record.SetValue(string(40, 'a'));
+  ASSERT_EQ(record.to_string(), string(40, 'a'));
+}
+
+TEST(RecordTest, CompressedFlag) {
+  string large(100, 'b');
+  Record record(large, 1);
+  ASSERT_FALSE(record.compressed());
+
+  record.SetValue(large, true /* compressed */);
+  ASSERT_TRUE(record.compressed());
+  ASSERT_EQ(record.size(), large.size());
+  ASSERT_EQ(record.to_string(), large);
+
+  Record copied(record);
+  ASSERT_TRUE(copied.compressed());
+  ASSERT_EQ(copied.to_string(), large);
+  Record moved(std::move(copied));
+  ASSERT_TRUE(moved.compressed());
+  ASSERT_EQ(moved.to_string(), large);
+
+  record.SetValue("small");
+  ASSERT_FALSE(record.compressed());
+  ASSERT_EQ(record.to_string(), "small");
+  record = moved;
+  ASSERT_TRUE(record.compressed());
+}
+
+TEST(SlabAllocatorTest, BlocksAreReusedAcrossThreads) {
+  const size_t kNumBlocks = 10000;
+  auto block_size = SlabAllocator::BlockSize(100);
+  ASSERT_EQ(block_size, 128U);
+
+  // Blocks allocated on one thread and freed on another
+  vector<char*> blocks;
+  for (size_t i = 0; i < kNumBlocks; i++) {
+    blocks.push_back(SlabAllocator::Allocate(block_size));
+    memset(blocks.back(), i % 256, block_size);
+  }
+  for (size_t i = 0; i < kNumBlocks; i++) {
+    ASSERT_EQ(blocks[i][block_size - 1], static_cast<char>(i % 256));
+  }
+  thread t([&] {
+    for (auto block : blocks) {
+      SlabAllocator::Free(block, block_size);
+    }
+  });
+  t.join();
+
+  for (size_t i = 0; i < kNumBlocks; i++) {
+    blocks[i] = SlabAllocator::Allocate(block_size);
+    memset(blocks[i], 0, block_size);
+  }
+  for (auto block : blocks) {
+    SlabAllocator::Free(block, block_size);
+  }
+}
@@ -84,4 +84,17 @@ TEST(StringUtilsTest, NextNTokensTest) {
 TEST(StringUtilsTest, TrimTest) {
   ASSERT_EQ(Trim("       trim this plz    "), "trim this plz");
   ASSERT_EQ(Trim(" \t\t trim this plz \t\t    "), "trim this plz");
+}
+
+TEST(StringUtilsTest, ParseNumericKey) {
+  ASSERT_EQ(ParseNumericKey("0"), 0U);
+  ASSERT_EQ(ParseNumericKey("12345"), 12345U);
+  ASSERT_EQ(ParseNumericKey("18446744073709551615"), 18446744073709551615ULL);
+  ASSERT_THROW(ParseNumericKey(""), std::invalid_argument);
+  ASSERT_THROW(ParseNumericKey("abc"), std::invalid_argument);
+  ASSERT_THROW(ParseNumericKey("12a"), std::invalid_argument);
+  ASSERT_THROW(ParseNumericKey("-1"), std::invalid_argument);
+  ASSERT_THROW(ParseNumericKey(" 1"), std::invalid_argument);
+  ASSERT_THROW(ParseNumericKey("007"), std::invalid_argument);
+  ASSERT_THROW(ParseNumericKey("18446744073709551616"), std::invalid_argument);
 }
\ No newline at end of file
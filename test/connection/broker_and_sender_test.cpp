@@ -8,6 +8,7 @@
 #include "common/proto_utils.h"
 #include "connection/broker.h"
 #include "connection/sender.h"
+#include "connection/shm_ring.h"
 #include "connection/zmq_utils.h"
 #include "proto/internal.pb.h"
 #include "test/test_utils.h"
@@ -148,6 +149,9 @@ TEST(BrokerTest, MultiSend) {
       dests.push_back(configs[0]->MakeMachineId(0, i + 1));
     }
     sender.Send(*ping_req, dests, PONG);
+    // Serialized once and shared with all destinations but one
+    ASSERT_EQ(sender.stats().serialized_bytes, wire::kHeaderSize + ping_req->ByteSizeLong());
+    ASSERT_EQ(sender.stats().num_shared_sends, NUM_PONGS - 1U);
 
     // Wait for pongs
     for (int i = 0; i < NUM_PONGS; i++) {
@@ -189,6 +193,340 @@ TEST(BrokerTest, MultiSend) {
   }
 }
 
+TEST(BrokerTest, MultiSendIncludingLocal) {
+  const Channel PING = 1;
+  const Channel PONG = 2;
+  const int NUM_PONGS = 3;
+  ConfigVec configs = MakeTestConfigurations("pingpong", 1, NUM_PONGS);
+  // Large enough to not be inlined in a zmq message so that the buffer is shared between destinations
+  const string data(100000, 'x');
+
+  auto ping = thread([&]() {
+    auto broker = Broker::New(configs[0], kTestModuleTimeout);
+    broker->AddChannel(PING);
+    broker->AddChannel(PONG);
+    broker->StartInNewThreads();
+
+    auto ping_socket = MakePullSocket(*broker->context(), PING);
+    auto pong_socket = MakePullSocket(*broker->context(), PONG);
+
+    Sender sender(broker->config(), broker->context());
+    vector<MachineId> dests;
+    for (int i = 0; i < NUM_PONGS; i++) {
+      dests.push_back(configs[0]->MakeMachineId(0, i));
+    }
+    sender.Send(MakeEchoRequest(data), dests, PONG);
+
+    // The local machine receives the envelope without going through the broker
+    auto req = RecvEnvelope(pong_socket);
+    ASSERT_TRUE(req != nullptr);
+    ASSERT_EQ(data, req->request().echo().data());
+
+    // Wait for pongs from the remote machines
+    for (int i = 1; i < NUM_PONGS; i++) {
+      auto res = RecvEnvelope(ping_socket);
+      ASSERT_TRUE(res != nullptr);
+      ASSERT_EQ("pong", res->response().echo().data());
+    }
+  });
+
+  thread pongs[NUM_PONGS - 1];
+  for (int i = 1; i < NUM_PONGS; i++) {
+    pongs[i - 1] = thread([&configs, &data, i]() {
+      auto broker = Broker::New(configs[i], kTestModuleTimeout);
+      broker->AddChannel(PONG);
+      broker->StartInNewThreads();
+
+      auto socket = MakePullSocket(*broker->context(), PONG);
+
+      Sender sender(broker->config(), broker->context());
+
+      // Wait for ping
+      auto req = RecvEnvelope(socket);
+      ASSERT_TRUE(req != nullptr);
+      ASSERT_EQ(data, req->request().echo().data());
+
+      // Send pong
+      auto pong_res = MakeEchoResponse("pong");
+      sender.Send(*pong_res, configs[i]->MakeMachineId(0, 0), PING);
+
+      this_thread::sleep_for(200ms);
+    });
+  }
+
+  ping.join();
+  for (auto& pong : pongs) {
+    pong.join();
+  }
+}
+
+TEST(BrokerTest, CoalescedSend) {
+  const Channel PING = 1;
+  const Channel PONG = 2;
+  internal::Configuration common_config;
+  // Long enough for the frame to only be sent on flush
+  common_config.mutable_message_coalescing()->set_max_delay(10000000);
+  common_config.mutable_message_coalescing()->set_max_frame_bytes(1000);
+  ConfigVec configs = MakeTestConfigurations("coalesced_send", 1, 2, common_config);
+
+  auto sender_broker = Broker::New(configs[0], kTestModuleTimeout);
+  sender_broker->StartInNewThreads();
+  Sender sender(sender_broker->config(), sender_broker->context());
+
+  auto receiver_broker = Broker::New(configs[1], kTestModuleTimeout);
+  auto ping_socket = MakePullSocket(*receiver_broker->context(), PING);
+  auto pong_socket = MakePullSocket(*receiver_broker->context(), PONG);
+  receiver_broker->AddChannel(PING);
+  receiver_broker->AddChannel(PONG);
+  receiver_broker->StartInNewThreads();
+
+  auto receiver = configs[0]->MakeMachineId(0, 1);
+  sender.Send(*MakeEchoRequest("a"), receiver, PING);
+  sender.Send(*MakeEchoRequest("b"), receiver, PONG);
+  sender.Send(*MakeEchoRequest("c"), receiver, PING);
+  sender.Send(*MakeEchoRequest("d"), vector<MachineId>{receiver}, PONG);
+
+  this_thread::sleep_for(5ms);
+  sender.FlushExpired();
+  this_thread::sleep_for(5ms);
+  ASSERT_EQ(RecvEnvelope(ping_socket, true), nullptr);
+  ASSERT_EQ(RecvEnvelope(pong_socket, true), nullptr);
+
+  // A message that does not fit in a frame is sent on its own, after the frame
+  const string large(2000, 'x');
+  sender.Send(*MakeEchoRequest(large), receiver, PING);
+  sender.Send(*MakeEchoRequest("e"), receiver, PONG);
+  sender.Flush();
+
+  for (auto data : {"a", "c", large.c_str()}) {
+    auto env = RecvEnvelope(ping_socket);
+    ASSERT_TRUE(env != nullptr);
+    ASSERT_EQ(env->from(), configs[0]->local_machine_id());
+    ASSERT_EQ(env->request().echo().data(), data);
+  }
+  for (auto data : {"b", "d", "e"}) {
+    auto env = RecvEnvelope(pong_socket);
+    ASSERT_TRUE(env != nullptr);
+    ASSERT_EQ(env->from(), configs[0]->local_machine_id());
+    ASSERT_EQ(env->request().echo().data(), data);
+  }
+}
+
+TEST(BrokerTest, SharedMemoryTransport) {
+  const Channel PING = 1;
+  const Channel PONG = 2;
+  internal::Configuration common_config;
+  common_config.mutable_shared_memory_transport()->set_ring_size_bytes(4096);
+  // The test machines communicate through ipc so they are on the same host
+  ConfigVec configs = MakeTestConfigurations("shared_memory_transport", 1, 2, common_config);
+
+  auto sender_broker = Broker::New(configs[0], kTestModuleTimeout);
+  sender_broker->StartInNewThreads();
+  Sender sender(sender_broker->config(), sender_broker->context());
+
+  auto receiver_broker = Broker::New(configs[1], kTestModuleTimeout);
+  auto ping_socket = MakePullSocket(*receiver_broker->context(), PING);
+  auto pong_socket = MakePullSocket(*receiver_broker->context(), PONG);
+  receiver_broker->AddChannel(PING);
+  receiver_broker->AddChannel(PONG);
+  receiver_broker->StartInNewThreads();
+
+  auto receiver = configs[0]->MakeMachineId(0, 1);
+  // Larger than the ring
+  const string large(10000, 'x');
+  sender.Send(*MakeEchoRequest("a"), receiver, PING);
+  sender.Send(*MakeEchoRequest("b"), receiver, PONG);
+  sender.Send(*MakeEchoRequest(large), receiver, PING);
+  sender.Send(*MakeEchoRequest("c"), vector<MachineId>{receiver}, PONG);
+
+  for (auto data : {"a", large.c_str()}) {
+    auto env = RecvEnvelope(ping_socket);
+    ASSERT_TRUE(env != nullptr);
+    ASSERT_EQ(env->from(), configs[0]->local_machine_id());
+    ASSERT_EQ(env->request().echo().data(), data);
+  }
+  for (auto data : {"b", "c"}) {
+    auto env = RecvEnvelope(pong_socket);
+    ASSERT_TRUE(env != nullptr);
+    ASSERT_EQ(env->from(), configs[0]->local_machine_id());
+    ASSERT_EQ(env->request().echo().data(), data);
+  }
+
+  // Wait for the receiver broker to go to sleep then wake it up
+  this_thread::sleep_for(50ms);
+  sender.Send(*MakeEchoRequest("d"), receiver, PING);
+  auto env = RecvEnvelope(ping_socket);
+  ASSERT_TRUE(env != nullptr);
+  ASSERT_EQ(env->request().echo().data(), "d");
+}
+
+TEST(BrokerTest, SenderDetachesRings) {
+  const Channel PING = 1;
+  internal::Configuration common_config;
+  common_config.mutable_shared_memory_transport()->set_ring_size_bytes(4096);
+  ConfigVec configs = MakeTestConfigurations("detach_rings", 1, 2, common_config);
+
+  auto sender_broker = Broker::New(configs[0], kTestModuleTimeout);
+  sender_broker->StartInNewThreads();
+
+  auto receiver_broker = Broker::New(configs[1], kTestModuleTimeout);
+  auto ping_socket = MakePullSocket(*receiver_broker->context(), PING);
+  receiver_broker->AddChannel(PING);
+  receiver_broker->StartInNewThreads();
+
+  auto receiver = configs[0]->MakeMachineId(0, 1);
+  // Each sender attaches a ring then detaches it once it is destroyed, possibly before the broker
+  // has attached it. The messages left in a ring are still received
+  for (auto data : {"a", "b", "c"}) {
+    Sender sender(sender_broker->config(), sender_broker->context());
+    sender.Send(*MakeEchoRequest(data), receiver, PING);
+  }
+  // Messages from different senders may arrive in any order
+  vector<string> received;
+  for (int i = 0; i < 3; i++) {
+    auto env = RecvEnvelope(ping_socket);
+    ASSERT_TRUE(env != nullptr);
+    received.push_back(env->request().echo().data());
+  }
+  sort(received.begin(), received.end());
+  ASSERT_EQ(received, (vector<string>{"a", "b", "c"}));
+}
+
+TEST(BrokerTest, FallBackToSocketWhenRingIsNotRead) {
+  const Channel PING = 1;
+  internal::Configuration common_config;
+  common_config.mutable_shared_memory_transport()->set_ring_size_bytes(4096);
+  ConfigVec configs = MakeTestConfigurations("ring_fallback", 1, 2, common_config);
+  // The receiver does not enable the shared memory transport so it never reads the ring
+  ConfigVec receiver_configs = MakeTestConfigurations("ring_fallback", 1, 2);
+
+  auto sender_broker = Broker::New(configs[0], kTestModuleTimeout);
+  sender_broker->StartInNewThreads();
+  Sender sender(sender_broker->config(), sender_broker->context());
+
+  auto receiver_broker = Broker::New(receiver_configs[1], kTestModuleTimeout);
+  auto ping_socket = MakePullSocket(*receiver_broker->context(), PING);
+  receiver_broker->AddChannel(PING);
+  receiver_broker->StartInNewThreads();
+
+  auto receiver = configs[0]->MakeMachineId(0, 1);
+  // The ring fills up after a few of these then the sender waits for the broker to read it, gives up
+  // and sends through the socket
+  for (int i = 0; i < 5; i++) {
+    sender.Send(*MakeEchoRequest(string(1000, 'a' + i)), receiver, PING);
+  }
+  sender.Send(*MakeEchoRequest("b"), receiver, PING);
+  // What was written to the ring is lost but the following messages arrive in order
+  vector<string> received;
+  while (received.empty() || received.back() != "b") {
+    auto env = RecvEnvelope(ping_socket);
+    ASSERT_TRUE(env != nullptr);
+    received.push_back(env->request().echo().data());
+  }
+  ASSERT_GE(received.size(), 2U);
+  ASSERT_EQ(received[received.size() - 2], string(1000, 'a' + 4));
+}
+
+TEST(BrokerTest, RingAttachRequiresSharedMemoryTransport) {
+  const Channel PING = 1;
+  ConfigVec configs = MakeTestConfigurations("ring_attach", 1, 1);
+
+  auto broker = Broker::New(configs[0], kTestModuleTimeout);
+  auto ping_socket = MakePullSocket(*broker->context(), PING);
+  broker->AddChannel(PING);
+  broker->StartInNewThreads();
+
+  auto ring = ShmRing::Create(4096);
+  ASSERT_NE(ring, nullptr);
+  const auto& name = ring->name();
+  zmq::socket_t socket(*broker->context(), ZMQ_PUSH);
+  socket.connect(MakeRemoteAddress(configs[0]->protocol(), configs[0]->local_address(), configs[0]->broker_ports(0)));
+  zmq::message_t attach(wire::kHeaderSize + name.size());
+  wire::WriteHeader(attach.data<char>(), wire::Type::RING_ATTACH, name.size());
+  memcpy(attach.data<char>() + wire::kHeaderSize, name.data(), name.size());
+  SendAddressedBuffer(socket, std::move(attach), 0, 0);
+  // Messages from the socket are handled in order so the attach message is handled once this arrives
+  SendSerializedProto(socket, *MakeEchoRequest("a"), 0, PING);
+  auto env = RecvEnvelope(ping_socket);
+  ASSERT_TRUE(env != nullptr);
+  ASSERT_EQ(env->request().echo().data(), "a");
+
+  // The broker has not opened the ring, which would have removed its name
+  ASSERT_NE(ShmRing::Open(name), nullptr);
+}
+
+TEST(BrokerTest, ShardedRouting) {
+  const Channel PING = 1;
+  const Channel PONG = 2;
+  internal::Configuration common_config;
+  common_config.mutable_broker_routing()->set_shard(true);
+  ConfigVec configs = MakeTestConfigurations("sharded_routing", 1, 2, common_config);
+
+  auto sender_broker = Broker::New(configs[0], kTestModuleTimeout);
+  sender_broker->StartInNewThreads();
+  Sender sender(sender_broker->config(), sender_broker->context());
+
+  auto receiver_broker = Broker::New(configs[1], kTestModuleTimeout);
+  auto ping_socket = MakePullSocket(*receiver_broker->context(), PING);
+  auto pong_socket = MakePullSocket(*receiver_broker->context(), PONG);
+  receiver_broker->AddChannel(PING);
+  receiver_broker->AddChannel(PONG);
+  receiver_broker->StartInNewThreads();
+
+  auto receiver = configs[0]->MakeMachineId(0, 1);
+  for (auto data : {"a", "b", "c"}) {
+    sender.Send(*MakeEchoRequest(data), receiver, PING);
+    sender.Send(*MakeEchoRequest(data), vector<MachineId>{receiver}, PONG);
+  }
+  for (auto socket : {&ping_socket, &pong_socket}) {
+    for (auto data : {"a", "b", "c"}) {
+      auto env = RecvEnvelope(*socket);
+      ASSERT_TRUE(env != nullptr);
+      ASSERT_EQ(env->request().echo().data(), data);
+    }
+  }
+
+  // The two channels are routed through different brokers. The stats are updated right after the
+  // messages are forwarded so they may lag behind a little
+  for (int i = 0; i < 100; i++) {
+    if (receiver_broker->thread_stats(0).num_messages == 3 && receiver_broker->thread_stats(1).num_messages == 3) {
+      break;
+    }
+    this_thread::sleep_for(1ms);
+  }
+  ASSERT_EQ(receiver_broker->thread_stats(0).num_messages, 3U);
+  ASSERT_EQ(receiver_broker->thread_stats(1).num_messages, 3U);
+  ASSERT_GT(receiver_broker->thread_stats(0).work_ns, 0U);
+  ASSERT_GT(receiver_broker->thread_stats(1).work_ns, 0U);
+}
+
+TEST(BrokerTest, LazyDeserialization) {
+  const Channel PING = 1;
+  internal::Configuration common_config;
+  common_config.mutable_broker_routing()->set_lazy_deserialization(true);
+  ConfigVec configs = MakeTestConfigurations("lazy_deserialization", 1, 2, common_config);
+
+  auto sender_broker = Broker::New(configs[0], kTestModuleTimeout);
+  sender_broker->StartInNewThreads();
+  Sender sender(sender_broker->config(), sender_broker->context());
+
+  auto receiver_broker = Broker::New(configs[1], kTestModuleTimeout);
+  auto ping_socket = MakePullSocket(*receiver_broker->context(), PING);
+  receiver_broker->AddChannel(PING, false /* send_raw */);
+  receiver_broker->StartInNewThreads();
+
+  sender.Send(*MakeEchoRequest("a"), configs[0]->MakeMachineId(0, 1), PING);
+
+  // The message is not parsed by the broker even though the channel asks for it
+  auto env = RecvEnvelope(ping_socket);
+  ASSERT_TRUE(env != nullptr);
+  ASSERT_EQ(env->type_case(), Envelope::TypeCase::kRaw);
+  ASSERT_EQ(env->from(), configs[0]->local_machine_id());
+  Envelope parsed;
+  ASSERT_TRUE(DeserializeProto(parsed, env->raw().data(), env->raw().size()));
+  ASSERT_EQ(parsed.request().echo().data(), "a");
+}
+
 TEST(BrokerTest, CreateRedirection) {
   const Channel PING = 1;
   const Channel PONG = 2;
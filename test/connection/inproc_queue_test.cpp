@@ -0,0 +1,117 @@
+#include "connection/inproc_queue.h"
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+#include "connection/poller.h"
+
+using namespace std;
+using namespace slog;
+
+TEST(InProcQueueTest, PushAndPop) {
+  InProcQueue<int> queue(4);
+  int value;
+  ASSERT_FALSE(queue.Pop(value));
+  queue.Push(1);
+  queue.Push(2);
+  ASSERT_TRUE(queue.Pop(value));
+  ASSERT_EQ(value, 1);
+  queue.Push(3);
+  ASSERT_TRUE(queue.Pop(value));
+  ASSERT_EQ(value, 2);
+  ASSERT_TRUE(queue.Pop(value));
+  ASSERT_EQ(value, 3);
+  ASSERT_FALSE(queue.Pop(value));
+}
+
+TEST(InProcQueueTest, CapacityIsRoundedUp) { ASSERT_EQ(InProcQueue<int>(5).capacity(), 8U); }
+
+TEST(InProcQueueTest, Overflow) {
+  InProcQueue<int> queue(4);
+  for (int i = 0; i < 10; i++) {
+    queue.Push(i);
+  }
+  int value;
+  for (int i = 0; i < 5; i++) {
+    ASSERT_TRUE(queue.Pop(value));
+    ASSERT_EQ(value, i);
+  }
+  // Values pushed while overflowing stay behind the overflowing values
+  queue.Push(10);
+  for (int i = 5; i <= 10; i++) {
+    ASSERT_TRUE(queue.Pop(value));
+    ASSERT_EQ(value, i);
+  }
+  ASSERT_FALSE(queue.Pop(value));
+  // The ring is used again after the overflowing values are popped
+  queue.Push(11);
+  ASSERT_TRUE(queue.Pop(value));
+  ASSERT_EQ(value, 11);
+}
+
+TEST(InProcQueueTest, MultipleProducers) {
+  const int kNumProducers = 4;
+  const int kNumValues = 20000;
+  // Small enough to overflow
+  InProcQueue<uint64_t> queue(64);
+  vector<thread> producers;
+  for (int p = 0; p < kNumProducers; p++) {
+    producers.emplace_back([&queue, p] {
+      for (uint64_t i = 0; i < kNumValues; i++) {
+        queue.Push((uint64_t(p) << 32) | i);
+      }
+    });
+  }
+  // The values of each producer are received in order
+  vector<uint64_t> next(kNumProducers, 0);
+  for (int received = 0; received < kNumProducers * kNumValues;) {
+    uint64_t value;
+    if (!queue.Pop(value)) {
+      this_thread::yield();
+      continue;
+    }
+    auto p = value >> 32;
+    ASSERT_EQ(value & 0xFFFFFFFF, next[p]);
+    next[p]++;
+    received++;
+  }
+  for (auto& producer : producers) {
+    producer.join();
+  }
+}
+
+TEST(InProcQueueTest, SleepAndWake) {
+  InProcQueue<int> queue(4);
+  queue.Push(1);
+  // The consumer cannot sleep with a value in the queue
+  ASSERT_FALSE(queue.Sleep());
+  int value;
+  ASSERT_TRUE(queue.Pop(value));
+  ASSERT_TRUE(queue.Sleep());
+  queue.Wake();
+}
+
+TEST(InProcQueueTest, PollerWakesUpOnPush) {
+  InProcQueue<int> queue(4);
+  Poller poller(std::nullopt);
+  poller.PushQueue(queue);
+
+  thread producer([&queue] {
+    this_thread::sleep_for(50ms);
+    queue.Push(42);
+  });
+  // Blocks until the producer pushes since there is no timeout
+  ASSERT_TRUE(poller.NextEvent());
+  int value;
+  ASSERT_TRUE(queue.Pop(value));
+  ASSERT_EQ(value, 42);
+  producer.join();
+
+  // The poller does not block if the queue is not empty
+  queue.Push(43);
+  ASSERT_TRUE(poller.NextEvent());
+  ASSERT_TRUE(queue.Pop(value));
+  ASSERT_EQ(value, 43);
+}
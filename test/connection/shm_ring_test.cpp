@@ -0,0 +1,236 @@
+#include "connection/shm_ring.h"
+
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace slog;
+
+namespace {
+const auto kTimeout = 1s;
+const auto kNoWakeUp = [] {};
+
+vector<string> ReadAll(ShmRing& ring) {
+  vector<string> msgs;
+  ring.Read([&msgs](const char* data, size_t size) { msgs.emplace_back(data, size); }, 1000000);
+  return msgs;
+}
+}  // namespace
+
+TEST(ShmRingTest, WriteAndRead) {
+  auto producer = ShmRing::Create(4096);
+  ASSERT_NE(producer, nullptr);
+  auto consumer = ShmRing::Open(producer->name());
+  ASSERT_NE(consumer, nullptr);
+  ASSERT_EQ(consumer->capacity(), 4096U);
+
+  producer->Write("abc", 3, kTimeout, kNoWakeUp);
+  producer->Write("", 0, kTimeout, kNoWakeUp);
+  producer->Write("defgh", 5, kTimeout, kNoWakeUp);
+  auto msgs = ReadAll(*consumer);
+  ASSERT_EQ(msgs, (vector<string>{"abc", "", "defgh"}));
+  ASSERT_TRUE(ReadAll(*consumer).empty());
+}
+
+TEST(ShmRingTest, ReadAtMostMaxMessages) {
+  auto producer = ShmRing::Create(4096);
+  auto consumer = ShmRing::Open(producer->name());
+  for (int i = 0; i < 5; i++) {
+    producer->Write("x", 1, kTimeout, kNoWakeUp);
+  }
+  ASSERT_EQ(consumer->Read([](const char*, size_t) {}, 3), 3U);
+  ASSERT_EQ(consumer->Read([](const char*, size_t) {}, 3), 2U);
+}
+
+TEST(ShmRingTest, OpenNonExistentRing) { ASSERT_EQ(ShmRing::Open("/slog_ring_does_not_exist"), nullptr); }
+
+TEST(ShmRingTest, OpenOnlyRingNames) {
+  auto producer = ShmRing::Create(4096);
+  ASSERT_EQ(ShmRing::Open(producer->name().substr(1)), nullptr);
+  ASSERT_EQ(ShmRing::Open("/other" + producer->name()), nullptr);
+  ASSERT_EQ(ShmRing::Open(producer->name() + "/.."), nullptr);
+  // The name is still there after the rejected attempts
+  ASSERT_NE(ShmRing::Open(producer->name()), nullptr);
+}
+
+TEST(ShmRingTest, WrapAround) {
+  auto producer = ShmRing::Create(4096);
+  auto consumer = ShmRing::Open(producer->name());
+  // 1000 is not a divisor of the capacity so records end up being wrapped
+  for (int i = 0; i < 20; i++) {
+    string msg(1000, 'a' + i);
+    producer->Write(msg.data(), msg.size(), kTimeout, kNoWakeUp);
+    auto msgs = ReadAll(*consumer);
+    ASSERT_EQ(msgs.size(), 1U);
+    ASSERT_EQ(msgs[0], msg);
+  }
+}
+
+TEST(ShmRingTest, MessageLargerThanRing) {
+  auto producer = ShmRing::Create(4096);
+  auto consumer = ShmRing::Open(producer->name());
+  string large(100000, 0);
+  for (size_t i = 0; i < large.size(); i++) {
+    large[i] = i % 251;
+  }
+  thread producer_thread([&] {
+    producer->Write(large.data(), large.size(), kTimeout, kNoWakeUp);
+    producer->Write("small", 5, kTimeout, kNoWakeUp);
+  });
+  vector<string> msgs;
+  while (msgs.size() < 2) {
+    if (consumer->Read([&msgs](const char* data, size_t size) { msgs.emplace_back(data, size); }, 10) == 0) {
+      this_thread::yield();
+    }
+  }
+  producer_thread.join();
+  ASSERT_EQ(msgs[0], large);
+  ASSERT_EQ(msgs[1], "small");
+}
+
+TEST(ShmRingTest, ConcurrentProducerAndConsumer) {
+  const int kNumMessages = 20000;
+  auto producer = ShmRing::Create(8192);
+  auto consumer = ShmRing::Open(producer->name());
+  thread producer_thread([&] {
+    for (int i = 0; i < kNumMessages; i++) {
+      string msg(i % 300, static_cast<char>(i));
+      msg.append(to_string(i));
+      producer->Write(msg.data(), msg.size(), kTimeout, kNoWakeUp);
+    }
+  });
+  int next = 0;
+  while (next < kNumMessages) {
+    auto num_read = consumer->Read(
+        [&next](const char* data, size_t size) {
+          string expected(next % 300, static_cast<char>(next));
+          expected.append(to_string(next));
+          ASSERT_EQ(string(data, size), expected);
+          next++;
+        },
+        100);
+    if (num_read == 0) {
+      this_thread::yield();
+    }
+  }
+  producer_thread.join();
+}
+
+TEST(ShmRingTest, WriteTimesOutOnFullRing) {
+  auto producer = ShmRing::Create(4096);
+  auto consumer = ShmRing::Open(producer->name());
+  string msg(1000, 'a');
+  for (int i = 0; i < 4; i++) {
+    ASSERT_TRUE(producer->Write(msg.data(), msg.size(), kTimeout, kNoWakeUp));
+  }
+  ASSERT_FALSE(producer->Write(msg.data(), msg.size(), 10ms, kNoWakeUp));
+  // The messages written before are still there
+  ASSERT_EQ(ReadAll(*consumer).size(), 4U);
+}
+
+TEST(ShmRingTest, SleepAndWake) {
+  auto producer = ShmRing::Create(4096);
+  auto consumer = ShmRing::Open(producer->name());
+  int num_wake_ups = 0;
+  auto wake_up = [&num_wake_ups] { num_wake_ups++; };
+
+  // The producer does not need to wake up an awake consumer
+  ASSERT_TRUE(producer->Write("a", 1, kTimeout, wake_up));
+  ASSERT_EQ(num_wake_ups, 0);
+  // The consumer cannot sleep with a message in the ring
+  ASSERT_FALSE(consumer->Sleep());
+  ASSERT_EQ(ReadAll(*consumer).size(), 1U);
+
+  ASSERT_TRUE(consumer->Sleep());
+  ASSERT_TRUE(producer->Write("b", 1, kTimeout, wake_up));
+  ASSERT_EQ(num_wake_ups, 1);
+  // Only the first message after the consumer goes to sleep needs to wake it up
+  ASSERT_TRUE(producer->Write("c", 1, kTimeout, wake_up));
+  ASSERT_EQ(num_wake_ups, 1);
+  consumer->Wake();
+  ASSERT_EQ(ReadAll(*consumer).size(), 2U);
+}
+
+TEST(ShmRingTest, WakeUpWhileWaitingForRoom) {
+  auto producer = ShmRing::Create(4096);
+  auto consumer = ShmRing::Open(producer->name());
+  ASSERT_TRUE(consumer->Sleep());
+
+  // The consumer only reads once it is woken up, which has to happen before the message is fully
+  // written since it does not fit in the ring
+  atomic<bool> woken_up = false;
+  thread consumer_thread([&] {
+    while (!woken_up) {
+      this_thread::yield();
+    }
+    consumer->Wake();
+    vector<string> msgs;
+    while (msgs.empty()) {
+      consumer->Read([&msgs](const char* data, size_t size) { msgs.emplace_back(data, size); }, 1);
+    }
+    ASSERT_EQ(msgs[0].size(), 10000U);
+  });
+  string large(10000, 'a');
+  ASSERT_TRUE(producer->Write(large.data(), large.size(), kTimeout, [&woken_up] { woken_up = true; }));
+  consumer_thread.join();
+}
+
+TEST(ShmRingTest, CorruptedRecordSize) {
+  auto producer = ShmRing::Create(4096);
+  ASSERT_TRUE(producer->Write("abc", 3, kTimeout, kNoWakeUp));
+  ASSERT_TRUE(producer->Write("def", 3, kTimeout, kNoWakeUp));
+
+  // Overwrites the size of the second record, which starts 8 bytes into the ring, with a size larger
+  // than the ring
+  int fd = shm_open(producer->name().c_str(), O_RDWR, 0);
+  ASSERT_GE(fd, 0);
+  struct stat st;
+  ASSERT_EQ(fstat(fd, &st), 0);
+  auto mem = static_cast<char*>(mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+  close(fd);
+  ASSERT_NE(mem, MAP_FAILED);
+  uint32_t size = 100000;
+  memcpy(mem + st.st_size - producer->capacity() + 8, &size, sizeof(size));
+  munmap(mem, st.st_size);
+
+  auto consumer = ShmRing::Open(producer->name());
+  ASSERT_NE(consumer, nullptr);
+  ASSERT_EQ(ReadAll(*consumer), vector<string>{"abc"});
+  ASSERT_TRUE(consumer->corrupted());
+  ASSERT_TRUE(ReadAll(*consumer).empty());
+}
+
+TEST(ShmRingTest, ProducerExited) {
+  int fds[2];
+  ASSERT_EQ(pipe(fds), 0);
+  auto pid = fork();
+  ASSERT_GE(pid, 0);
+  if (pid == 0) {
+    auto producer = ShmRing::Create(4096);
+    auto name = producer->name();
+    producer.release();
+    // Exits without destroying the ring so that its name is left for the parent to open
+    _exit(write(fds[1], name.data(), name.size()) == static_cast<ssize_t>(name.size()) ? 0 : 1);
+  }
+  close(fds[1]);
+  char name[256];
+  auto size = read(fds[0], name, sizeof(name));
+  close(fds[0]);
+  ASSERT_GT(size, 0);
+  auto consumer = ShmRing::Open(string(name, size));
+  ASSERT_NE(consumer, nullptr);
+  int status;
+  ASSERT_EQ(waitpid(pid, &status, 0), pid);
+  ASSERT_TRUE(consumer->ProducerExited());
+
+  auto producer = ShmRing::Create(4096);
+  ASSERT_FALSE(ShmRing::Open(producer->name())->ProducerExited());
+}
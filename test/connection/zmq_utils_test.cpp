@@ -116,4 +116,106 @@ TEST(ZmqUtilsTest, FailedParsing) {
   ASSERT_FALSE(ParseChannel(chan, msg));
   Request req;
   ASSERT_FALSE(DeserializeProto(req, msg));
-}
\ No newline at end of file
+}
+TEST(ZmqUtilsTest, SerializeProto) {
+  Request req;
+  req.mutable_echo()->set_data("test");
+  auto msg = SerializeProto(req);
+  SetAddress(msg, 2, 5);
+  ASSERT_EQ(msg.size(), wire::kHeaderSize + req.ByteSizeLong());
+
+  MachineId machine_id;
+  ASSERT_TRUE(ParseMachineId(machine_id, msg));
+  ASSERT_EQ(machine_id, 2);
+  Channel channel;
+  ASSERT_TRUE(ParseChannel(channel, msg));
+  ASSERT_EQ(channel, 5U);
+
+  Request req2;
+  uint8_t version = 255;
+  ASSERT_TRUE(DeserializeProto(req2, msg, &version));
+  ASSERT_EQ(version, wire::kVersion);
+  ASSERT_EQ(req2.echo().data(), "test");
+}
+
+TEST(ZmqUtilsTest, SerializeProtoLegacyVersion) {
+  Request req;
+  req.mutable_echo()->set_data("test");
+  auto msg = SerializeProto(req, wire::kLegacyVersion);
+  SetAddress(msg, 2, 5);
+
+  MachineId machine_id;
+  ASSERT_TRUE(ParseMachineId(machine_id, msg));
+  ASSERT_EQ(machine_id, 2);
+  Channel channel;
+  ASSERT_TRUE(ParseChannel(channel, msg));
+  ASSERT_EQ(channel, 5U);
+
+  Request req2;
+  uint8_t version = 255;
+  ASSERT_TRUE(DeserializeProto(req2, msg, &version));
+  ASSERT_EQ(version, wire::kLegacyVersion);
+  ASSERT_EQ(req2.echo().data(), "test");
+
+  Response res;
+  ASSERT_FALSE(DeserializeProto(res, msg));
+}
+
+TEST(ZmqUtilsTest, DeserializeMalformedProto) {
+  Request req;
+  req.mutable_echo()->set_data("test");
+  auto msg = SerializeProto(req);
+
+  // Truncated
+  Request req2;
+  ASSERT_FALSE(DeserializeProto(req2, msg.data<char>(), msg.size() - 1));
+  ASSERT_FALSE(DeserializeProto(req2, msg.data<char>(), wire::kHeaderSize - 1));
+
+  // Wrong type
+  Response res;
+  ASSERT_FALSE(DeserializeProto(res, msg));
+
+  // Unknown version
+  wire::Write<uint8_t>(msg.data<char>(), wire::kVersionOffset, wire::kVersion + 1);
+  ASSERT_FALSE(wire::ReadVersion(msg.data<char>(), msg.size()).has_value());
+  ASSERT_FALSE(DeserializeProto(req2, msg));
+}
+
+TEST(ZmqUtilsTest, ForEachCoalesced) {
+  Request req;
+  req.mutable_echo()->set_data("test");
+  Response res;
+  res.mutable_echo()->set_data("test2");
+  auto msg1 = SerializeProto(req);
+  SetAddress(msg1, 1, 2);
+  auto msg2 = SerializeProto(res);
+  SetAddress(msg2, 1, 3);
+
+  string frame(wire::kHeaderSize, 0);
+  frame.append(msg1.data<char>(), msg1.size());
+  frame.append(msg2.data<char>(), msg2.size());
+  wire::WriteHeader(frame.data(), wire::Type::COALESCED, frame.size() - wire::kHeaderSize);
+  ASSERT_TRUE(wire::IsCoalesced(frame.data(), frame.size()));
+  ASSERT_FALSE(wire::IsCoalesced(msg1.data<char>(), msg1.size()));
+
+  vector<string> msgs;
+  auto collect = [&msgs](const char* data, size_t size) { msgs.emplace_back(data, size); };
+  ASSERT_TRUE(wire::ForEachCoalesced(frame.data(), frame.size(), collect));
+  ASSERT_EQ(msgs.size(), 2U);
+
+  Request req2;
+  ASSERT_TRUE(DeserializeProto(req2, msgs[0].data(), msgs[0].size()));
+  ASSERT_EQ(req2.echo().data(), "test");
+  Response res2;
+  ASSERT_TRUE(DeserializeProto(res2, msgs[1].data(), msgs[1].size()));
+  ASSERT_EQ(res2.echo().data(), "test2");
+  Channel channel = wire::Read<Channel>(msgs[1].data(), wire::kChannelOffset);
+  ASSERT_EQ(channel, 3U);
+
+  // Truncated frame
+  msgs.clear();
+  frame.pop_back();
+  wire::WriteHeader(frame.data(), wire::Type::COALESCED, frame.size() - wire::kHeaderSize);
+  ASSERT_FALSE(wire::ForEachCoalesced(frame.data(), frame.size(), collect));
+  ASSERT_EQ(msgs.size(), 1U);
+}
@@ -1,12 +1,28 @@
 #include "data_structure/concurrent_hash_map.h"
+#include "data_structure/open_addressing_segment.h"
+#include "data_structure/rwlatch.h"
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <atomic>
+#include <optional>
 #include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "common/types.h"
 
 using namespace std;
 using namespace slog;
 
+template <typename K, typename V>
+using OpenAddressingHashMap = ConcurrentHashMap<K, V, std::hash<K>, 8, concurrent_hash_map::OpenAddressingSegmentT>;
+
+template <typename K, typename V, typename Latch>
+using LatchedOpenAddressingHashMap =
+    ConcurrentHashMap<K, V, std::hash<K>, 8, concurrent_hash_map::WithLatch<Latch>::template OpenAddressingSegmentT>;
+
 TEST(ConcurrentHashMapTest, SerialBasicOperations) {
   ConcurrentHashMap<string, string> map;
   string result;
@@ -58,6 +74,143 @@ TEST(ConcurrentHashMapTest, TriggerRehash) {
   }
 }
 
+TEST(ConcurrentHashMapTest, UpdateAndEraseDuringMigration) {
+  ConcurrentHashMap<string, string> map;
+  string result;
+
+  // Every operation only migrates a few buckets so most of these
+  // operations happen while some keys are still in the old buckets
+  for (size_t i = 0; i < 10000; i++) {
+    ASSERT_FALSE(map.InsertOrUpdate("k" + to_string(i), "foo"));
+    ASSERT_TRUE(map.InsertOrUpdate("k" + to_string(i / 2), "bar"));
+    ASSERT_FALSE(map.InsertOrUpdate("e" + to_string(i), "foo"));
+    if (i % 2 == 1) {
+      ASSERT_TRUE(map.Erase("e" + to_string(i / 2)));
+    }
+  }
+
+  size_t count = 0;
+  map.ForEach([&count](const string&, const string&) { count++; });
+  ASSERT_EQ(count, 15000U);
+  for (size_t i = 0; i < 10000; i++) {
+    ASSERT_TRUE(map.Get(result, "k" + to_string(i)));
+    ASSERT_EQ(result, i < 5000 ? "bar" : "foo");
+    ASSERT_EQ(map.Get(result, "e" + to_string(i)), i >= 5000);
+  }
+}
+
+TEST(ConcurrentHashMapTest, Reserve) {
+  ConcurrentHashMap<string, string> map;
+  string result;
+  map.InsertOrUpdate("foo", "bar");
+
+  map.Reserve(100000);
+  for (size_t i = 0; i < 100000; i++) {
+    ASSERT_FALSE(map.InsertOrUpdate(to_string(i), to_string(i)));
+  }
+  ASSERT_TRUE(map.Get(result, "foo"));
+  ASSERT_EQ(result, "bar");
+  for (size_t i = 0; i < 100000; i++) {
+    ASSERT_TRUE(map.Get(result, to_string(i)));
+    ASSERT_EQ(result, to_string(i));
+  }
+
+  OpenAddressingHashMap<uint64_t, uint64_t> oa_map;
+  uint64_t oa_result;
+  oa_map.Reserve(100000);
+  for (uint64_t i = 0; i < 100000; i++) {
+    ASSERT_FALSE(oa_map.InsertOrUpdate(i, i));
+  }
+  for (uint64_t i = 0; i < 100000; i++) {
+    ASSERT_TRUE(oa_map.Get(oa_result, i));
+    ASSERT_EQ(oa_result, i);
+  }
+}
+
+TEST(ConcurrentHashMapTest, MultiGetAndReadModifyWrite) {
+  ConcurrentHashMap<string, string> map;
+  vector<string> keys;
+  vector<const string*> key_ptrs;
+  for (size_t i = 0; i < 100; i++) {
+    keys.push_back(to_string(i));
+    if (i % 2 == 0) {
+      map.InsertOrUpdate(keys.back(), "foo" + keys.back());
+    }
+  }
+  for (auto& key : keys) {
+    key_ptrs.push_back(&key);
+  }
+
+  vector<optional<string>> results;
+  map.MultiGet(key_ptrs, results);
+  ASSERT_EQ(results.size(), 100U);
+  for (size_t i = 0; i < 100; i++) {
+    ASSERT_EQ(results[i].has_value(), i % 2 == 0);
+    if (i % 2 == 0) {
+      ASSERT_EQ(*results[i], "foo" + to_string(i));
+    }
+  }
+
+  map.ReadModifyWrite(key_ptrs, [](size_t i, string& value, bool exists) {
+    ASSERT_EQ(exists, i % 2 == 0);
+    value += "bar";
+  });
+  map.MultiGet(key_ptrs, results);
+  for (size_t i = 0; i < 100; i++) {
+    ASSERT_EQ(*results[i], (i % 2 == 0 ? "foo" + to_string(i) : "") + "bar");
+  }
+
+  OpenAddressingHashMap<uint64_t, uint64_t> oa_map;
+  vector<uint64_t> oa_keys{1, 2, 3};
+  vector<const uint64_t*> oa_key_ptrs{&oa_keys[0], &oa_keys[1], &oa_keys[2]};
+  oa_map.InsertOrUpdate(2, 20);
+  oa_map.ReadModifyWrite(oa_key_ptrs, [](size_t, uint64_t& value, bool) { value++; });
+  vector<optional<uint64_t>> oa_results;
+  oa_map.MultiGet(oa_key_ptrs, oa_results);
+  ASSERT_EQ(oa_results, (vector<optional<uint64_t>>{1, 21, 1}));
+}
+
+TEST(ConcurrentHashMapTest, UpdateOrErase) {
+  ConcurrentHashMap<string, string> map;
+  vector<string> keys;
+  vector<const string*> key_ptrs;
+  for (size_t i = 0; i < 100; i++) {
+    keys.push_back(to_string(i));
+    if (i % 2 == 0) {
+      map.InsertOrUpdate(keys.back(), "foo");
+    }
+  }
+  for (auto& key : keys) {
+    key_ptrs.push_back(&key);
+  }
+
+  // Even keys exist. Every fourth key is erased, the other even keys are updated
+  map.UpdateOrErase(key_ptrs, [](size_t i, string& value) {
+    EXPECT_EQ(i % 2, 0U);
+    value += "bar";
+    return i % 4 != 0;
+  });
+  vector<optional<string>> results;
+  map.MultiGet(key_ptrs, results);
+  for (size_t i = 0; i < 100; i++) {
+    ASSERT_EQ(results[i], i % 4 == 2 ? optional<string>("foobar") : nullopt);
+  }
+  ASSERT_EQ(map.Stats().num_keys, 25U);
+
+  OpenAddressingHashMap<uint64_t, uint64_t> oa_map;
+  vector<uint64_t> oa_keys{1, 2, 3};
+  vector<const uint64_t*> oa_key_ptrs{&oa_keys[0], &oa_keys[1], &oa_keys[2]};
+  oa_map.InsertOrUpdate(2, 20);
+  oa_map.InsertOrUpdate(3, 30);
+  oa_map.UpdateOrErase(oa_key_ptrs, [](size_t i, uint64_t& value) {
+    value++;
+    return i != 2;
+  });
+  vector<optional<uint64_t>> oa_results;
+  oa_map.MultiGet(oa_key_ptrs, oa_results);
+  ASSERT_EQ(oa_results, (vector<optional<uint64_t>>{nullopt, 21, nullopt}));
+}
+
 TEST(ConcurrentHashMapTest, TwoReadersOneWriter) {
   uint32_t N = 500000;
   string key = "foo";
@@ -159,4 +312,269 @@ TEST(ConcurrentHashMapTest, OneWriterOneEraser) {
       ASSERT_EQ(result, to_string(i));
     }
   }
-}
\ No newline at end of file
+}
+
+TEST(ConcurrentHashMapTest, ForEach) {
+  ConcurrentHashMap<string, string> map;
+  for (size_t i = 0; i < 1000; i++) {
+    map.InsertOrUpdate(to_string(i), "foo" + to_string(i));
+  }
+  for (size_t i = 0; i < 1000; i += 2) {
+    map.Erase(to_string(i));
+  }
+
+  unordered_map<string, string> visited;
+  map.ForEach([&visited](const string& key, const string& value) { visited.emplace(key, value); });
+  ASSERT_EQ(visited.size(), 500U);
+  for (size_t i = 1; i < 1000; i += 2) {
+    ASSERT_EQ(visited[to_string(i)], "foo" + to_string(i));
+  }
+}
+
+TEST(ConcurrentHashMapTest, Visit) {
+  ConcurrentHashMap<string, Record> map;
+  OpenAddressingHashMap<string, Record> oa_map;
+  for (size_t i = 0; i < 100; i++) {
+    map.InsertOrUpdate(to_string(i), Record("value" + to_string(i), i % 3, i));
+    oa_map.InsertOrUpdate(to_string(i), Record("value" + to_string(i), i % 3, i));
+  }
+
+  Metadata metadata;
+  auto get_metadata = [&metadata](const Record& record) { metadata = record.metadata; };
+  for (size_t i = 0; i < 100; i++) {
+    ASSERT_TRUE(map.Visit(to_string(i), get_metadata));
+    ASSERT_EQ(metadata.master, i % 3);
+    ASSERT_EQ(metadata.counter, i);
+    ASSERT_TRUE(oa_map.Visit(to_string(i), get_metadata));
+    ASSERT_EQ(metadata.master, i % 3);
+    ASSERT_EQ(metadata.counter, i);
+  }
+  ASSERT_FALSE(map.Visit("missing", get_metadata));
+  ASSERT_FALSE(oa_map.Visit("missing", get_metadata));
+}
+
+TEST(ConcurrentHashMapTest, Stats) {
+  ConcurrentHashMap<string, Record> map;
+  for (size_t i = 0; i < 1000; i++) {
+    map.InsertOrUpdate(to_string(i), Record(string(10, 'a'), 0));
+  }
+  // Overwrite and erase some keys so that the value bytes have to be adjusted
+  for (size_t i = 0; i < 100; i++) {
+    map.InsertOrUpdate(to_string(i), Record(string(20, 'b'), 0));
+  }
+  for (size_t i = 900; i < 1000; i++) {
+    map.Erase(to_string(i));
+  }
+
+  vector<concurrent_hash_map::SegmentStats> segments;
+  auto stats = map.Stats(&segments);
+  ASSERT_EQ(stats.num_keys, 900U);
+  ASSERT_EQ(stats.value_bytes, 100U * 20 + 800U * 10);
+  ASSERT_GT(stats.index_bytes, 900 * sizeof(Record));
+  ASSERT_GE(stats.max_chain_length, 1U);
+
+  size_t num_keys = 0, num_buckets = 0, max_chain_length = 0;
+  for (const auto& segment : segments) {
+    num_keys += segment.num_keys;
+    num_buckets += segment.num_buckets;
+    max_chain_length = std::max(max_chain_length, segment.max_chain_length);
+    ASSERT_LE(segment.num_empty_buckets, segment.num_buckets);
+  }
+  ASSERT_EQ(num_keys, stats.num_keys);
+  ASSERT_EQ(num_buckets, stats.num_buckets);
+  ASSERT_EQ(max_chain_length, stats.max_chain_length);
+}
+
+TEST(ConcurrentHashMapTest, ReadersNeverMissKeysDuringRehash) {
+  const int kNumKeys = 1000;
+  const int kNumNewKeys = 200000;
+  ConcurrentHashMap<string, string> map;
+  for (int i = 0; i < kNumKeys; i++) {
+    map.InsertOrUpdate(to_string(i), to_string(i));
+  }
+
+  atomic<bool> done = false;
+  auto Writes = [&]() {
+    // New keys keep growing the segments while existing keys are overwritten
+    for (int i = 0; i < kNumNewKeys; i++) {
+      map.InsertOrUpdate("new" + to_string(i), "");
+      map.InsertOrUpdate(to_string(i % kNumKeys), to_string(i % kNumKeys));
+    }
+    done = true;
+  };
+
+  auto Gets = [&]() {
+    string result;
+    for (int i = 0; !done; i = (i + 1) % kNumKeys) {
+      ASSERT_TRUE(map.Get(result, to_string(i)));
+      ASSERT_EQ(result, to_string(i));
+    }
+  };
+
+  thread w(Writes);
+  thread r1(Gets);
+  thread r2(Gets);
+  w.join();
+  r1.join();
+  r2.join();
+}
+
+TEST(ConcurrentHashMapTest, OpenAddressingSerialBasicOperations) {
+  OpenAddressingHashMap<string, string> map;
+  string result;
+  ASSERT_FALSE(map.Get(result, "test"));
+  ASSERT_FALSE(map.Erase("test"));
+
+  for (size_t i = 0; i < 10; i++) {
+    ASSERT_FALSE(map.InsertOrUpdate(to_string(i), "foo"));
+  }
+  ASSERT_TRUE(map.InsertOrUpdate("0", "bar"));
+  ASSERT_TRUE(map.Get(result, "0"));
+  ASSERT_EQ(result, "bar");
+
+  for (size_t i = 0; i < 5; i++) {
+    ASSERT_TRUE(map.Erase(to_string(i)));
+  }
+  for (size_t i = 0; i < 5; i++) {
+    ASSERT_FALSE(map.Get(result, to_string(i)));
+  }
+  for (size_t i = 5; i < 10; i++) {
+    ASSERT_TRUE(map.Get(result, to_string(i)));
+    ASSERT_EQ(result, "foo");
+  }
+}
+
+TEST(ConcurrentHashMapTest, OpenAddressingReuseDeletedSlots) {
+  OpenAddressingHashMap<uint64_t, uint64_t> map;
+  uint64_t result;
+
+  // Repeatedly filling and emptying the map leaves many deleted slots behind
+  for (uint64_t round = 0; round < 10; round++) {
+    for (uint64_t i = 0; i < 10000; i++) {
+      ASSERT_FALSE(map.InsertOrUpdate(round * 10000 + i, i));
+    }
+    for (uint64_t i = 0; i < 10000; i++) {
+      ASSERT_TRUE(map.Get(result, round * 10000 + i));
+      ASSERT_EQ(result, i);
+    }
+    for (uint64_t i = 0; i < 10000; i++) {
+      ASSERT_TRUE(map.Erase(round * 10000 + i));
+    }
+  }
+  for (uint64_t i = 0; i < 100000; i++) {
+    ASSERT_FALSE(map.Get(result, i));
+  }
+
+  map.InsertOrUpdateBatch({{1, 10}, {2, 20}, {1, 11}});
+  ASSERT_TRUE(map.Get(result, 1));
+  ASSERT_EQ(result, 11U);
+  ASSERT_TRUE(map.Get(result, 2));
+  ASSERT_EQ(result, 20U);
+
+  size_t count = 0;
+  map.ForEach([&count](uint64_t, uint64_t) { count++; });
+  ASSERT_EQ(count, 2U);
+}
+
+TEST(ConcurrentHashMapTest, OpenAddressingTwoReadersOneWriter) {
+  uint32_t N = 200000;
+  string key = "foo";
+  OpenAddressingHashMap<string, string> map;
+
+  auto Updates = [&]() {
+    for (size_t i = 0; i < N; i++) {
+      map.InsertOrUpdate(key, to_string(i));
+    }
+  };
+
+  auto Gets = [&]() {
+    int prev = 0;
+    string result;
+    for (size_t i = 0; i < N; i++) {
+      if (map.Get(result, key)) {
+        auto x = stoi(result);
+        ASSERT_GE(x, prev);
+        prev = x;
+      }
+    }
+  };
+
+  thread w(Updates);
+  thread r1(Gets);
+  thread r2(Gets);
+  w.join();
+  r1.join();
+  r2.join();
+}
+
+TEST(ConcurrentHashMapTest, OpenAddressingReadersNeverMissKeysDuringRehash) {
+  const uint64_t kNumKeys = 1000;
+  const uint64_t kNumNewKeys = 200000;
+  OpenAddressingHashMap<uint64_t, uint64_t> map;
+  for (uint64_t i = 0; i < kNumKeys; i++) {
+    map.InsertOrUpdate(i, i);
+  }
+
+  atomic<bool> done = false;
+  auto Writes = [&]() {
+    for (uint64_t i = 0; i < kNumNewKeys; i++) {
+      map.InsertOrUpdate(kNumKeys + i, 0);
+      map.InsertOrUpdate(i % kNumKeys, i % kNumKeys);
+      if (i % 3 == 0) {
+        map.Erase(kNumKeys + i);
+      }
+    }
+    done = true;
+  };
+
+  auto Gets = [&]() {
+    uint64_t result;
+    for (uint64_t i = 0; !done; i = (i + 1) % kNumKeys) {
+      ASSERT_TRUE(map.Get(result, i));
+      ASSERT_EQ(result, i);
+    }
+  };
+
+  thread w(Writes);
+  thread r1(Gets);
+  thread r2(Gets);
+  w.join();
+  r1.join();
+  r2.join();
+}
+
+TEST(ConcurrentHashMapTest, OpenAddressingWithOtherLatches) {
+  LatchedOpenAddressingHashMap<string, string, SpinRWLatch> spin_map;
+  LatchedOpenAddressingHashMap<string, string, DistributedRWLatch<>> distributed_map;
+
+  auto Run = [](auto& map) {
+    uint32_t N = 50000;
+    auto Updates = [&]() {
+      for (size_t i = 0; i < N; i++) {
+        map.InsertOrUpdate(to_string(i % 100), to_string(i));
+      }
+    };
+    auto Reads = [&]() {
+      string result;
+      for (size_t i = 0; i < N; i++) {
+        if (map.Get(result, to_string(i % 100))) {
+          ASSERT_EQ(stoul(result) % 100, i % 100);
+        }
+      }
+    };
+    thread writer(Updates);
+    thread reader1(Reads);
+    thread reader2(Reads);
+    writer.join();
+    reader1.join();
+    reader2.join();
+
+    string result;
+    for (size_t i = 0; i < 100; i++) {
+      ASSERT_TRUE(map.Get(result, to_string(i)));
+      ASSERT_EQ(result, to_string(N - 100 + i));
+    }
+  };
+  Run(spin_map);
+  Run(distributed_map);
+}
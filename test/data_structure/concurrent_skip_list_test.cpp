@@ -0,0 +1,107 @@
+#include "data_structure/concurrent_skip_list.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace slog;
+
+namespace {
+
+template <typename K>
+vector<K> ScanAll(const ConcurrentSkipList<K>& list, const K& start, const K& end) {
+  vector<K> keys;
+  list.Scan(start, end, [&keys](const K& key) {
+    keys.push_back(key);
+    return true;
+  });
+  return keys;
+}
+
+}  // namespace
+
+TEST(ConcurrentSkipListTest, InsertEraseAndScan) {
+  ConcurrentSkipList<uint64_t> list;
+  for (uint64_t key = 100; key > 0; key--) {
+    ASSERT_TRUE(list.Insert(key * 2));
+  }
+  ASSERT_FALSE(list.Insert(10));
+  ASSERT_EQ(list.size(), 100U);
+  ASSERT_TRUE(list.Contains(10));
+  ASSERT_FALSE(list.Contains(11));
+
+  ASSERT_EQ(ScanAll<uint64_t>(list, 9, 17), (vector<uint64_t>{10, 12, 14, 16}));
+  ASSERT_EQ(ScanAll<uint64_t>(list, 0, 5), (vector<uint64_t>{2, 4}));
+  ASSERT_EQ(ScanAll<uint64_t>(list, 199, 1000), (vector<uint64_t>{200}));
+  ASSERT_TRUE(ScanAll<uint64_t>(list, 201, 1000).empty());
+  ASSERT_TRUE(ScanAll<uint64_t>(list, 10, 10).empty());
+
+  ASSERT_TRUE(list.Erase(12));
+  ASSERT_FALSE(list.Erase(12));
+  ASSERT_FALSE(list.Erase(13));
+  ASSERT_FALSE(list.Contains(12));
+  ASSERT_EQ(ScanAll<uint64_t>(list, 9, 17), (vector<uint64_t>{10, 14, 16}));
+
+  // Inserting an erased key again
+  ASSERT_TRUE(list.Insert(12));
+  ASSERT_EQ(ScanAll<uint64_t>(list, 9, 17), (vector<uint64_t>{10, 12, 14, 16}));
+  ASSERT_EQ(list.size(), 100U);
+
+  // Stop early
+  size_t count = 0;
+  list.Scan(0, 1000, [&count](uint64_t) { return ++count < 3; });
+  ASSERT_EQ(count, 3U);
+}
+
+TEST(ConcurrentSkipListTest, StringKeysAreOrderedLexicographically) {
+  ConcurrentSkipList<string> list;
+  for (auto key : {"b", "a", "ab", "c", "10", "9"}) {
+    list.Insert(key);
+  }
+  ASSERT_EQ(ScanAll<string>(list, "", "z"), (vector<string>{"10", "9", "a", "ab", "b", "c"}));
+  ASSERT_EQ(ScanAll<string>(list, "a", "b"), (vector<string>{"a", "ab"}));
+}
+
+TEST(ConcurrentSkipListTest, ConcurrentInsertsAndScans) {
+  const uint64_t kNumKeys = 20000;
+  const int kNumWriters = 4;
+  ConcurrentSkipList<uint64_t> list;
+  atomic<bool> done = false;
+
+  // Scans must always see keys in increasing order
+  thread reader([&]() {
+    while (!done) {
+      uint64_t prev = 0;
+      list.Scan(0, kNumKeys, [&prev](uint64_t key) {
+        EXPECT_GE(key, prev);
+        prev = key + 1;
+        return true;
+      });
+    }
+  });
+
+  vector<thread> writers;
+  for (int i = 0; i < kNumWriters; i++) {
+    writers.emplace_back([&list, i]() {
+      for (uint64_t key = i; key < kNumKeys; key += kNumWriters) {
+        list.Insert(key);
+      }
+    });
+  }
+  for (auto& t : writers) {
+    t.join();
+  }
+  done = true;
+  reader.join();
+
+  ASSERT_EQ(list.size(), kNumKeys);
+  auto keys = ScanAll<uint64_t>(list, 0, kNumKeys);
+  ASSERT_EQ(keys.size(), kNumKeys);
+  for (uint64_t key = 0; key < kNumKeys; key++) {
+    ASSERT_EQ(keys[key], key);
+  }
+}
@@ -0,0 +1,61 @@
+#include "data_structure/rwlatch.h"
+
+#include <gtest/gtest.h>
+
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace slog;
+
+template <typename Latch>
+class RWLatchTest : public ::testing::Test {};
+
+using Latches = ::testing::Types<SharedMutexLatch, SpinRWLatch, DistributedRWLatch<>, DistributedRWLatch<2>>;
+TYPED_TEST_SUITE(RWLatchTest, Latches);
+
+TYPED_TEST(RWLatchTest, TryLock) {
+  TypeParam latch;
+  ASSERT_TRUE(latch.try_lock_shared());
+  ASSERT_TRUE(latch.try_lock_shared());
+  ASSERT_FALSE(latch.try_lock());
+  latch.unlock_shared();
+  latch.unlock_shared();
+
+  ASSERT_TRUE(latch.try_lock());
+  ASSERT_FALSE(latch.try_lock_shared());
+  ASSERT_FALSE(latch.try_lock());
+  latch.unlock();
+  ASSERT_TRUE(latch.try_lock_shared());
+  latch.unlock_shared();
+}
+
+TYPED_TEST(RWLatchTest, ReadersNeverSeePartialWrites) {
+  const int kThreads = 4;
+  const int kOps = 20000;
+  TypeParam latch;
+  // Writers keep both counters equal
+  uint64_t a = 0, b = 0;
+
+  vector<thread> threads;
+  for (int t = 0; t < kThreads; t++) {
+    threads.emplace_back([&, t] {
+      for (int i = 0; i < kOps; i++) {
+        if ((i + t) % 4 == 0) {
+          unique_lock<TypeParam> lock(latch);
+          a++;
+          b++;
+        } else {
+          shared_lock<TypeParam> lock(latch);
+          ASSERT_EQ(a, b);
+        }
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  ASSERT_EQ(a, static_cast<uint64_t>(kThreads * kOps / 4));
+  ASSERT_EQ(b, a);
+}
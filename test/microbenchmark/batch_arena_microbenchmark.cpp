@@ -0,0 +1,94 @@
+#include <atomic>
+#include <new>
+#include <string>
+
+#include "common/proto_utils.h"
+#include "proto/internal.pb.h"
+#include "service/service_utils.h"
+
+DEFINE_uint64(batches, 10000, "Number of batches");
+DEFINE_uint32(txns_per_batch, 100, "Number of transactions in each batch");
+DEFINE_uint32(keys_per_txn, 10, "Number of keys of each transaction");
+DEFINE_uint32(value_size, 100, "Size of the values in bytes");
+
+using namespace slog;
+using std::string;
+
+namespace {
+
+std::atomic<uint64_t> num_allocations = 0;
+
+string MakeSerializedBatch() {
+  internal::Batch batch;
+  batch.set_id(1);
+  string value(FLAGS_value_size, 'a');
+  for (uint32_t i = 0; i < FLAGS_txns_per_batch; i++) {
+    auto txn = batch.add_transactions();
+    txn->mutable_internal()->set_id(i);
+    txn->mutable_internal()->add_involved_partitions(0);
+    for (uint32_t k = 0; k < FLAGS_keys_per_txn; k++) {
+      auto& entry = (*txn->mutable_keys())["key" + std::to_string(i * FLAGS_keys_per_txn + k)];
+      entry.set_type(k % 2 ? KeyType::WRITE : KeyType::READ);
+      entry.set_value(value);
+    }
+    txn->mutable_code()->append("SET key0 value");
+  }
+  return batch.SerializeAsString();
+}
+
+/**
+ * Goes through the lifecycle of the txns of a batch on the scheduler side: the batch is
+ * received, its txns are unbatched, read, then freed one by one as they complete
+ */
+void RunBenchmark(const string& name, bool use_arena) {
+  auto serialized = MakeSerializedBatch();
+
+  uint64_t num_keys = 0;
+  auto allocations_before = num_allocations.load();
+  auto start = steady_clock::now();
+  for (uint64_t i = 0; i < FLAGS_batches; i++) {
+    auto arena = use_arena ? NewArena(serialized.size()) : nullptr;
+    BatchPtr batch(google::protobuf::Arena::CreateMessage<internal::Batch>(arena));
+    CHECK(batch->ParseFromString(serialized));
+
+    auto transactions = Unbatch(batch.get());
+    ArenaPtr shared_arena(batch->GetArena() != nullptr ? batch.release()->GetArena() : nullptr);
+    for (auto txn : transactions) {
+      std::unique_ptr<Transaction, ArenaSharerDeleter<Transaction>> holder(txn);
+      num_keys += holder->keys_size();
+    }
+  }
+  auto elapsed = duration_cast<duration<double>>(steady_clock::now() - start).count();
+  auto allocations = num_allocations.load() - allocations_before;
+  auto num_txns = FLAGS_batches * FLAGS_txns_per_batch;
+  CHECK_EQ(num_keys, num_txns * FLAGS_keys_per_txn);
+
+  LOG(INFO) << name << ": " << static_cast<double>(allocations) / num_txns << " allocations/txn, "
+            << num_txns / elapsed << " txns/s";
+}
+
+}  // namespace
+
+void* operator new(size_t size) {
+  num_allocations.fetch_add(1, std::memory_order_relaxed);
+  if (auto ptr = malloc(size)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept { free(ptr); }
+
+void operator delete(void* ptr, size_t) noexcept { free(ptr); }
+
+int main(int argc, char* argv[]) {
+  InitializeService(&argc, &argv);
+
+  LOG(INFO) << "Txns per batch = " << FLAGS_txns_per_batch << ". Keys per txn = " << FLAGS_keys_per_txn
+            << ". Value size = " << FLAGS_value_size << " bytes";
+
+  RunBenchmark("Heap", false);
+  RunBenchmark("Arena", true);
+
+  return 0;
+}
@@ -0,0 +1,225 @@
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/configuration.h"
+#include "common/proto_utils.h"
+#include "connection/broker.h"
+#include "connection/sender.h"
+#include "connection/zmq_utils.h"
+#include "proto/internal.pb.h"
+#include "service/service_utils.h"
+
+DEFINE_uint64(messages, 20000, "Number of messages sent in each run");
+DEFINE_uint32(brokers, 4, "Number of broker threads of the receiving machine");
+DEFINE_uint32(channels, 4, "Number of channels that the messages are spread over");
+DEFINE_uint32(txns_per_batch, 10, "Number of transactions in each batch");
+DEFINE_uint32(keys_per_txn, 10, "Number of keys of each transaction");
+DEFINE_uint32(destinations, 4, "Number of machines that each batch is multicast to");
+
+using namespace slog;
+using internal::Envelope;
+using std::string;
+
+namespace {
+
+struct Routing {
+  string name;
+  bool shard;
+  bool lazy_deserialization;
+};
+
+Envelope MakeBatch() {
+  Envelope env;
+  auto batch = env.mutable_request()->mutable_forward_batch()->mutable_batch_data();
+  batch->set_id(1);
+  for (uint32_t i = 0; i < FLAGS_txns_per_batch; i++) {
+    auto txn = batch->add_transactions();
+    txn->mutable_internal()->set_id(i);
+    txn->mutable_internal()->add_involved_partitions(0);
+    for (uint32_t k = 0; k < FLAGS_keys_per_txn; k++) {
+      auto& entry = (*txn->mutable_keys())["key" + std::to_string(i * FLAGS_keys_per_txn + k)];
+      entry.set_type(k % 2 ? KeyType::WRITE : KeyType::READ);
+    }
+    txn->mutable_code()->append("SET key0 value");
+  }
+  return env;
+}
+
+int64_t Now() { return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count(); }
+
+/**
+ * One machine sends batches round-robin to the channels of another machine. A thread per channel
+ * plays the module, which parses the messages that the broker hands over unparsed
+ */
+void RunBenchmark(const Routing& routing, uint32_t run) {
+  internal::Configuration config;
+  config.set_protocol("ipc");
+  for (uint32_t i = 0; i < FLAGS_brokers; i++) {
+    config.add_broker_ports(i);
+  }
+  config.set_num_partitions(2);
+  auto replica = config.add_replicas();
+  string prefix = "/tmp/slog_broker_routing_" + std::to_string(run) + "_";
+  replica->add_addresses(prefix + "0");
+  replica->add_addresses(prefix + "1");
+  config.mutable_broker_routing()->set_shard(routing.shard);
+  config.mutable_broker_routing()->set_lazy_deserialization(routing.lazy_deserialization);
+  auto sender_config = std::make_shared<Configuration>(config, prefix + "0");
+  auto receiver_config = std::make_shared<Configuration>(config, prefix + "1");
+
+  auto broker = Broker::New(receiver_config);
+  std::vector<zmq::socket_t> sockets;
+  for (Channel chan = 1; chan <= FLAGS_channels; chan++) {
+    auto& socket = sockets.emplace_back(*broker->context(), ZMQ_PULL);
+    socket.set(zmq::sockopt::rcvhwm, 0);
+    socket.bind(MakeInProcChannelAddress(chan));
+    broker->AddChannel(chan);
+  }
+  broker->StartInNewThreads();
+
+  std::vector<std::thread> modules;
+  for (uint32_t c = 0; c < FLAGS_channels; c++) {
+    auto num_messages = FLAGS_messages / FLAGS_channels + (c < FLAGS_messages % FLAGS_channels ? 1 : 0);
+    modules.emplace_back([&socket = sockets[c], num_messages] {
+      for (uint64_t i = 0; i < num_messages; i++) {
+        auto env = RecvEnvelope(socket);
+        CHECK(env != nullptr);
+        if (env->type_case() == Envelope::TypeCase::kRaw) {
+          Envelope parsed;
+          CHECK(DeserializeProto(parsed, env->raw().data(), env->raw().size()));
+        }
+      }
+    });
+  }
+
+  Sender sender(sender_config, std::make_shared<zmq::context_t>(1));
+  auto receiver_id = sender_config->MakeMachineId(0, 1);
+  auto batch = MakeBatch();
+  auto start = Now();
+  for (uint64_t i = 0; i < FLAGS_messages; i++) {
+    sender.Send(batch, receiver_id, 1 + i % FLAGS_channels);
+  }
+  for (auto& module : modules) {
+    module.join();
+  }
+  auto elapsed = Now() - start;
+
+  std::ostringstream saturation;
+  for (uint32_t i = 0; i < FLAGS_brokers; i++) {
+    const auto& stats = broker->thread_stats(i);
+    saturation << " " << static_cast<double>(stats.work_ns) / elapsed << " (" << stats.num_messages << " msgs)";
+  }
+  LOG(INFO) << routing.name << ": " << FLAGS_messages / (elapsed / 1e9) << " msgs/s. Broker saturation:"
+            << saturation.str();
+
+  broker->Stop();
+}
+
+struct Multicast {
+  string name;
+  // Whether each destination is sent to on its own instead of with one multicast
+  bool one_send_per_destination;
+  bool coalescing;
+};
+
+/**
+ * One machine multicasts batches to one channel of FLAGS_destinations other machines on the same host,
+ * like a sequencer sending its batches to the other regions. The sender stats tell how many bytes are
+ * serialized and copied for each multicast
+ */
+void RunMulticastBenchmark(const Multicast& multicast, uint32_t run) {
+  const Channel kChannel = 1;
+  internal::Configuration config;
+  config.set_protocol("ipc");
+  config.add_broker_ports(0);
+  config.set_num_partitions(1);
+  string prefix = "/tmp/slog_broker_multicast_" + std::to_string(run) + "_";
+  for (uint32_t i = 0; i <= FLAGS_destinations; i++) {
+    config.add_replicas()->add_addresses(prefix + std::to_string(i));
+  }
+  if (multicast.coalescing) {
+    config.mutable_message_coalescing();
+  }
+
+  std::vector<std::shared_ptr<Broker>> brokers;
+  std::vector<zmq::socket_t> sockets;
+  std::vector<MachineId> destinations;
+  // The module threads keep references to the sockets
+  sockets.reserve(FLAGS_destinations);
+  for (uint32_t i = 1; i <= FLAGS_destinations; i++) {
+    auto receiver_config = std::make_shared<Configuration>(config, prefix + std::to_string(i));
+    auto& broker = brokers.emplace_back(Broker::New(receiver_config));
+    auto& socket = sockets.emplace_back(*broker->context(), ZMQ_PULL);
+    socket.set(zmq::sockopt::rcvhwm, 0);
+    socket.bind(MakeInProcChannelAddress(kChannel));
+    broker->AddChannel(kChannel);
+    broker->StartInNewThreads();
+    destinations.push_back(receiver_config->MakeMachineId(i, 0));
+  }
+
+  std::vector<std::thread> modules;
+  for (auto& socket : sockets) {
+    modules.emplace_back([&socket] {
+      for (uint64_t i = 0; i < FLAGS_messages; i++) {
+        CHECK(RecvEnvelope(socket) != nullptr);
+      }
+    });
+  }
+
+  auto sender_config = std::make_shared<Configuration>(config, prefix + "0");
+  Sender sender(sender_config, std::make_shared<zmq::context_t>(1));
+  auto batch = MakeBatch();
+  auto start = Now();
+  for (uint64_t i = 0; i < FLAGS_messages; i++) {
+    if (multicast.one_send_per_destination) {
+      for (auto dest : destinations) {
+        sender.Send(batch, dest, kChannel);
+      }
+    } else {
+      sender.Send(batch, destinations, kChannel);
+    }
+    sender.FlushExpired();
+  }
+  sender.Flush();
+  for (auto& module : modules) {
+    module.join();
+  }
+  auto elapsed = Now() - start;
+
+  const auto& stats = sender.stats();
+  LOG(INFO) << multicast.name << ": " << FLAGS_messages / (elapsed / 1e9) << " multicasts/s. Per multicast: "
+            << static_cast<double>(stats.serialized_bytes) / FLAGS_messages << " bytes serialized, "
+            << static_cast<double>(stats.copied_bytes) / FLAGS_messages << " bytes copied, "
+            << static_cast<double>(stats.num_shared_sends) / FLAGS_messages << " shared sends";
+
+  for (auto& broker : brokers) {
+    broker->Stop();
+  }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  InitializeService(&argc, &argv);
+
+  LOG(INFO) << "Batch size = " << MakeBatch().ByteSizeLong() << " bytes";
+
+  std::vector<Routing> routings{{"First broker", false, false},
+                                {"Sharded", true, false},
+                                {"Sharded and lazy", true, true}};
+  for (size_t i = 0; i < routings.size(); i++) {
+    RunBenchmark(routings[i], i);
+  }
+
+  LOG(INFO) << "Destinations of each multicast = " << FLAGS_destinations;
+  std::vector<Multicast> multicasts{{"One send per destination", true, false},
+                                    {"Multicast", false, false},
+                                    {"Multicast, coalesced", false, true}};
+  for (size_t i = 0; i < multicasts.size(); i++) {
+    RunMulticastBenchmark(multicasts[i], i);
+  }
+
+  return 0;
+}
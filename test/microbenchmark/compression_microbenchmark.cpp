@@ -0,0 +1,140 @@
+#include <random>
+#include <string>
+#include <vector>
+
+#include "common/compression.h"
+#include "common/string_utils.h"
+#include "common/types.h"
+#include "service/service_utils.h"
+#include "storage/mem_only_storage.h"
+
+DEFINE_uint64(keys, 100000, "Number of keys");
+DEFINE_string(value_sizes, "1024,4096,10240", "Comma-separated sizes of the values in bytes");
+DEFINE_uint32(distinct_values, 256, "Number of distinct values of each kind that the keys share");
+DEFINE_uint64(reads, 1000000, "Number of reads");
+
+using namespace slog;
+using std::string;
+using std::vector;
+
+namespace {
+
+template <typename Fn>
+double Measure(Fn&& fn) {
+  auto start = steady_clock::now();
+  fn();
+  return duration_cast<duration<double>>(steady_clock::now() - start).count();
+}
+
+// Records with a few fields whose names repeat and whose values vary, like typical JSON documents
+string JsonLikeValue(std::mt19937& rg, size_t size) {
+  string value = "{";
+  for (int i = 0; value.size() < size; i++) {
+    value += "\"field" + std::to_string(i) + "\": {\"id\": " + std::to_string(rg()) + ", \"name\": \"item" +
+             std::to_string(rg() % 1000) + "\", \"active\": " + (rg() % 2 ? "true" : "false") + "},";
+  }
+  value.resize(size);
+  return value;
+}
+
+string RandomValue(std::mt19937& rg, size_t size) {
+  string value(size, '\0');
+  for (auto& c : value) {
+    c = static_cast<char>(rg());
+  }
+  return value;
+}
+
+/**
+ * Loads the values into a storage, with and without compression, then reads them back
+ * the way a worker does when a command reads every value. Compression is applied to all
+ * values so that its cost on incompressible data is visible too
+ */
+void RunBenchmark(const string& kind, const vector<string>& values) {
+  auto value_size = values[0].size();
+
+  vector<string> compressed(values.size());
+  auto compress_elapsed = Measure([&]() {
+    for (size_t i = 0; i < values.size(); i++) {
+      CompressValue(values[i], compressed[i]);
+    }
+  });
+  string decompressed;
+  auto decompress_elapsed = Measure([&]() {
+    for (const auto& c : compressed) {
+      CHECK(DecompressValue(c, decompressed));
+    }
+  });
+  size_t compressed_bytes = 0;
+  for (const auto& c : compressed) {
+    compressed_bytes += c.size();
+  }
+  auto raw_bytes = values.size() * value_size;
+  auto mb = raw_bytes / 1024.0 / 1024.0;
+  auto ratio = static_cast<double>(raw_bytes) / compressed_bytes;
+  LOG(INFO) << kind << ", value size = " << value_size << ": ratio = " << ratio
+            << ", compress = " << mb / compress_elapsed << " MB/s, decompress = " << mb / decompress_elapsed << " MB/s";
+
+  for (bool compress : {false, true}) {
+    MemOnlyStorage<Key, Record, Metadata> storage;
+    storage.Reserve(FLAGS_keys);
+    string buffer;
+    auto write_elapsed = Measure([&]() {
+      for (uint64_t key = 0; key < FLAGS_keys; key++) {
+        const auto& value = values[key % values.size()];
+        Record record;
+        if (compress && MaybeCompressValue(value, 1, buffer)) {
+          record.SetValue(buffer, true /* compressed */);
+        } else {
+          record.SetValue(value);
+        }
+        storage.Write(std::to_string(key), record);
+      }
+    });
+
+    size_t stored_bytes = 0;
+    storage.ForEach([&stored_bytes](const Key&, const Record& record) { stored_bytes += record.size(); });
+
+    std::mt19937 rg(value_size);
+    std::uniform_int_distribution<uint64_t> key_dis(0, FLAGS_keys - 1);
+    Record record;
+    string value;
+    auto read_elapsed = Measure([&]() {
+      for (uint64_t i = 0; i < FLAGS_reads; i++) {
+        CHECK(storage.Read(std::to_string(key_dis(rg)), record));
+        value = record.to_string();
+        if (record.compressed()) {
+          CHECK(DecompressValue(record.to_string(), value));
+        }
+      }
+    });
+
+    LOG(INFO) << "  " << (compress ? "compressed" : "raw") << ": stored = " << stored_bytes / 1024.0 / 1024.0
+              << " MB, writes = " << FLAGS_keys / write_elapsed << " ops/s, reads = " << FLAGS_reads / read_elapsed
+              << " ops/s";
+  }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  InitializeService(&argc, &argv);
+
+  LOG(INFO) << "Keys = " << FLAGS_keys << ". Distinct values = " << FLAGS_distinct_values;
+
+  string value_size;
+  for (size_t pos = NextToken(value_size, FLAGS_value_sizes, ","); pos != string::npos;
+       pos = NextToken(value_size, FLAGS_value_sizes, ",", pos)) {
+    auto size = std::stoull(value_size);
+    std::mt19937 rg(size);
+    vector<string> json_values, random_values;
+    for (uint32_t i = 0; i < FLAGS_distinct_values; i++) {
+      json_values.push_back(JsonLikeValue(rg, size));
+      random_values.push_back(RandomValue(rg, size));
+    }
+    RunBenchmark("JSON-like", json_values);
+    RunBenchmark("Random", random_values);
+  }
+
+  return 0;
+}
@@ -0,0 +1,109 @@
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "common/types.h"
+#include "data_structure/concurrent_hash_map.h"
+#include "data_structure/rwlatch.h"
+#include "service/service_utils.h"
+
+DEFINE_uint64(keys, 1000000, "Number of keys");
+DEFINE_uint64(ops, 1000000, "Number of operations per thread");
+DEFINE_uint32(write_pct, 5, "Percentage of operations that are writes");
+DEFINE_uint32(max_threads, 32, "The benchmark is run with 1, 2, 4, ... threads up to this number");
+
+using namespace slog;
+using std::string;
+using std::vector;
+
+namespace {
+
+/**
+ * The design ConcurrentHashMap had before its reads became lock-free: each
+ * shard is guarded by a reader-writer latch, including for reads. See
+ * rwlatch_microbenchmark.cpp for a comparison of the latches.
+ */
+class LatchedHashMap {
+ public:
+  bool Get(string& res, const string& key) const {
+    auto& shard = shards_[std::hash<string>{}(key) % kNumShards];
+    std::shared_lock<SharedMutexLatch> lock(shard.latch);
+    auto it = shard.map.find(key);
+    if (it == shard.map.end()) {
+      return false;
+    }
+    res = it->second;
+    return true;
+  }
+
+  void InsertOrUpdate(const string& key, const string& value) {
+    auto& shard = shards_[std::hash<string>{}(key) % kNumShards];
+    std::unique_lock<SharedMutexLatch> lock(shard.latch);
+    shard.map[key] = value;
+  }
+
+ private:
+  static constexpr size_t kNumShards = 256;
+  struct Shard {
+    mutable SharedMutexLatch latch;
+    std::unordered_map<string, string> map;
+  };
+  Shard shards_[kNumShards];
+};
+
+template <typename Map>
+void RunBenchmark(const string& name) {
+  Map map;
+  for (uint64_t key = 0; key < FLAGS_keys; key++) {
+    map.InsertOrUpdate(std::to_string(key), "value");
+  }
+
+  // Pre-generate the keys so that the measurement is not dominated by string conversions
+  vector<string> keys;
+  for (uint64_t key = 0; key < FLAGS_keys; key++) {
+    keys.push_back(std::to_string(key));
+  }
+
+  for (uint32_t num_threads = 1; num_threads <= FLAGS_max_threads; num_threads *= 2) {
+    vector<std::thread> threads;
+    auto start = steady_clock::now();
+    for (uint32_t t = 0; t < num_threads; t++) {
+      threads.emplace_back([&map, &keys, t] {
+        std::mt19937 rg(t);
+        std::uniform_int_distribution<uint64_t> key_dis(0, keys.size() - 1);
+        std::uniform_int_distribution<uint32_t> pct_dis(0, 99);
+        string value;
+        for (uint64_t i = 0; i < FLAGS_ops; i++) {
+          const auto& key = keys[key_dis(rg)];
+          if (pct_dis(rg) < FLAGS_write_pct) {
+            map.InsertOrUpdate(key, "value");
+          } else {
+            CHECK(map.Get(value, key));
+          }
+        }
+      });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+    auto elapsed = duration_cast<duration<double>>(steady_clock::now() - start).count();
+    LOG(INFO) << name << ": threads = " << num_threads << ", throughput = " << num_threads * FLAGS_ops / elapsed
+              << " ops/s";
+  }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  InitializeService(&argc, &argv);
+
+  LOG(INFO) << "Keys = " << FLAGS_keys << ". Writes = " << FLAGS_write_pct << "%";
+
+  RunBenchmark<ConcurrentHashMap<string, string>>("ConcurrentHashMap");
+  RunBenchmark<LatchedHashMap>("LatchedHashMap");
+
+  return 0;
+}
@@ -0,0 +1,79 @@
+#include <malloc.h>
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "common/string_utils.h"
+#include "common/types.h"
+#include "data_structure/concurrent_hash_map.h"
+#include "data_structure/open_addressing_segment.h"
+#include "service/service_utils.h"
+
+DEFINE_string(key_counts, "10000000,100000000,1000000000", "Comma-separated numbers of keys to run the benchmark with");
+DEFINE_uint64(samples, 1000000, "Number of timed Get operations");
+
+using namespace slog;
+using std::string;
+using std::vector;
+
+namespace {
+
+size_t AllocatedBytes() {
+#if __GLIBC_PREREQ(2, 33)
+  auto info = mallinfo2();
+  return info.uordblks + info.hblkhd;
+#else
+  // The fields are ints before glibc 2.33 so the counts wrap around every 4GB
+  auto info = mallinfo();
+  return static_cast<unsigned int>(info.uordblks) + static_cast<size_t>(static_cast<unsigned int>(info.hblkhd));
+#endif
+}
+
+template <typename Map>
+void RunBenchmark(const string& name, uint64_t num_keys) {
+  auto allocated_before = AllocatedBytes();
+  {
+    Map map;
+    for (uint64_t key = 0; key < num_keys; key++) {
+      map.InsertOrUpdate(key, key);
+    }
+    auto allocated = AllocatedBytes() - allocated_before;
+    auto payload = sizeof(uint64_t) * 2;
+    auto overhead = static_cast<double>(allocated) / num_keys - payload;
+
+    std::mt19937_64 rg(0);
+    std::uniform_int_distribution<uint64_t> key_dis(0, num_keys - 1);
+    vector<uint64_t> latencies(FLAGS_samples);
+    uint64_t value;
+    for (auto& latency : latencies) {
+      auto key = key_dis(rg);
+      auto start = steady_clock::now();
+      CHECK(map.Get(value, key));
+      latency = duration_cast<nanoseconds>(steady_clock::now() - start).count();
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    LOG(INFO) << name << ": keys = " << num_keys << ", overhead = " << overhead << " bytes/key"
+              << ", p50 = " << latencies[latencies.size() / 2] << " ns"
+              << ", p99 = " << latencies[latencies.size() * 99 / 100] << " ns";
+  }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  InitializeService(&argc, &argv);
+
+  string key_count;
+  for (size_t pos = NextToken(key_count, FLAGS_key_counts, ","); pos != string::npos;
+       pos = NextToken(key_count, FLAGS_key_counts, ",", pos)) {
+    auto num_keys = std::stoull(key_count);
+    RunBenchmark<ConcurrentHashMap<uint64_t, uint64_t>>("Chained", num_keys);
+    RunBenchmark<ConcurrentHashMap<uint64_t, uint64_t, std::hash<uint64_t>, 8,
+                                   concurrent_hash_map::OpenAddressingSegmentT>>("OpenAddressing", num_keys);
+  }
+
+  return 0;
+}
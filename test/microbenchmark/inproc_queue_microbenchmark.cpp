@@ -0,0 +1,168 @@
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/constants.h"
+#include "connection/inproc_queue.h"
+#include "connection/poller.h"
+#include "service/service_utils.h"
+
+DEFINE_uint64(hops, 1000000, "Number of messages sent from one thread to another to measure throughput");
+DEFINE_uint64(round_trips, 100000, "Number of messages sent back and forth between two threads to measure latency");
+DEFINE_uint64(capacity, 4096, "Capacity of the queues");
+DEFINE_bool(yield, true, "Yield while waiting for a message. Useful when there are fewer cores than threads");
+
+using namespace slog;
+using std::string;
+
+namespace {
+
+int64_t Now() { return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count(); }
+
+/**
+ * How modules talked before: a pointer in a zmq message through an inproc PUSH/PULL pair
+ */
+class ZmqChannel {
+ public:
+  explicit ZmqChannel(zmq::context_t& context) : push_(context, ZMQ_PUSH), pull_(context, ZMQ_PULL) {
+    auto address = "inproc://inproc_queue_microbenchmark_" + std::to_string(num_channels_++);
+    push_.set(zmq::sockopt::sndhwm, 0);
+    pull_.set(zmq::sockopt::rcvhwm, 0);
+    pull_.bind(address);
+    push_.connect(address);
+  }
+
+  void Push(void* ptr) {
+    zmq::message_t msg(sizeof(ptr));
+    *msg.data<void*>() = ptr;
+    push_.send(msg, zmq::send_flags::dontwait);
+  }
+
+  bool Pop(void*& ptr) {
+    zmq::message_t msg;
+    if (!pull_.recv(msg, zmq::recv_flags::dontwait)) {
+      return false;
+    }
+    ptr = *msg.data<void*>();
+    return true;
+  }
+
+  void PushTo(Poller& poller) { poller.PushSocket(pull_); }
+
+ private:
+  static inline int num_channels_ = 0;
+  zmq::socket_t push_;
+  zmq::socket_t pull_;
+};
+
+class QueueChannel {
+ public:
+  explicit QueueChannel(zmq::context_t&) : queue_(FLAGS_capacity) {}
+
+  void Push(void* ptr) { queue_.Push(ptr); }
+  bool Pop(void*& ptr) { return queue_.Pop(ptr); }
+  void PushTo(Poller& poller) { poller.PushQueue(queue_); }
+
+ private:
+  InProcQueue<void*> queue_;
+};
+
+/**
+ * Receives like a NetworkedModule: keeps trying for some time before blocking in the poller
+ */
+template <typename Channel>
+class Receiver {
+ public:
+  explicit Receiver(Channel& channel) : channel_(channel), poller_(kModuleTimeout), recv_retries_(0) {
+    channel_.PushTo(poller_);
+  }
+
+  void* Recv() {
+    for (;;) {
+      void* ptr;
+      if (channel_.Pop(ptr)) {
+        recv_retries_ = kRecvRetries;
+        return ptr;
+      }
+      if (recv_retries_ > 0) {
+        recv_retries_--;
+        if (FLAGS_yield) {
+          std::this_thread::yield();
+        }
+      } else {
+        poller_.NextEvent();
+      }
+    }
+  }
+
+ private:
+  Channel& channel_;
+  Poller poller_;
+  int recv_retries_;
+};
+
+template <typename Channel>
+void RunThroughput(const string& name) {
+  zmq::context_t context;
+  Channel channel(context);
+
+  auto start = Now();
+  std::thread consumer([&channel] {
+    Receiver<Channel> receiver(channel);
+    for (uint64_t i = 0; i < FLAGS_hops; i++) {
+      receiver.Recv();
+    }
+  });
+  for (uint64_t i = 0; i < FLAGS_hops; i++) {
+    channel.Push(reinterpret_cast<void*>(i));
+  }
+  consumer.join();
+  auto elapsed = (Now() - start) / 1e9;
+
+  LOG(INFO) << name << ": " << FLAGS_hops / elapsed << " hops/s";
+}
+
+template <typename Channel>
+void RunLatency(const string& name) {
+  zmq::context_t context;
+  Channel ping(context);
+  Channel pong(context);
+
+  std::thread echo([&ping, &pong] {
+    Receiver<Channel> receiver(ping);
+    for (uint64_t i = 0; i < FLAGS_round_trips; i++) {
+      pong.Push(receiver.Recv());
+    }
+  });
+
+  Receiver<Channel> receiver(pong);
+  std::vector<int64_t> hop_latencies;
+  hop_latencies.reserve(FLAGS_round_trips);
+  for (uint64_t i = 0; i < FLAGS_round_trips; i++) {
+    auto start = Now();
+    ping.Push(nullptr);
+    receiver.Recv();
+    hop_latencies.push_back((Now() - start) / 2);
+  }
+  echo.join();
+
+  std::sort(hop_latencies.begin(), hop_latencies.end());
+  auto percentile = [&hop_latencies](double p) {
+    return hop_latencies[static_cast<size_t>(p * (hop_latencies.size() - 1))] / 1e3;
+  };
+  LOG(INFO) << name << ": latency per hop p50 = " << percentile(0.5) << " us, p99 = " << percentile(0.99) << " us";
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  InitializeService(&argc, &argv);
+
+  RunThroughput<ZmqChannel>("zmq inproc");
+  RunThroughput<QueueChannel>("InProcQueue");
+  RunLatency<ZmqChannel>("zmq inproc");
+  RunLatency<QueueChannel>("InProcQueue");
+
+  return 0;
+}
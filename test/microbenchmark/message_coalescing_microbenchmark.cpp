@@ -0,0 +1,124 @@
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/configuration.h"
+#include "common/constants.h"
+#include "connection/sender.h"
+#include "connection/zmq_utils.h"
+#include "proto/internal.pb.h"
+#include "service/service_utils.h"
+
+DEFINE_uint64(messages, 500000, "Number of messages sent in each run");
+DEFINE_uint64(rate, 100000, "Number of messages sent per second");
+DEFINE_uint32(message_size, 64, "Size of the data of each message in bytes");
+DEFINE_uint32(max_frame_bytes, 16384, "Maximum size of a frame of coalesced messages");
+DEFINE_uint64(max_delay, 100, "Maximum time in microseconds a message waits in a frame");
+DEFINE_uint32(port, 2030, "First port used by the receiver");
+
+using namespace slog;
+using internal::Envelope;
+using std::string;
+
+namespace {
+
+const string kSenderAddress = "127.0.0.1";
+const string kReceiverAddress = "127.0.0.2";
+
+ConfigurationPtr MakeConfig(uint32_t port, bool coalescing) {
+  internal::Configuration config;
+  config.set_protocol("tcp");
+  config.add_broker_ports(port);
+  config.set_num_partitions(2);
+  auto replica = config.add_replicas();
+  replica->add_addresses(kSenderAddress);
+  replica->add_addresses(kReceiverAddress);
+  if (coalescing) {
+    config.mutable_message_coalescing()->set_max_frame_bytes(FLAGS_max_frame_bytes);
+    config.mutable_message_coalescing()->set_max_delay(FLAGS_max_delay);
+  }
+  return std::make_shared<Configuration>(config, kSenderAddress);
+}
+
+int64_t Now() { return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count(); }
+
+/**
+ * Sends messages at a fixed rate from a Sender to a socket that receives and parses them the way a broker
+ * thread does. Between messages, the sender only flushes the frames whose deadline has passed, which is
+ * the worst case for latency since a module that runs out of work flushes all frames right away
+ */
+void RunBenchmark(const string& name, uint32_t port, bool coalescing) {
+  auto config = MakeConfig(port, coalescing);
+  auto context = std::make_shared<zmq::context_t>(1);
+
+  zmq::socket_t receiver_socket(*context, ZMQ_PULL);
+  receiver_socket.set(zmq::sockopt::rcvhwm, 0);
+  receiver_socket.bind(MakeRemoteAddress("tcp", kReceiverAddress, port));
+
+  std::thread sender_thread([&] {
+    Sender sender(config, context);
+    Envelope env;
+    auto data = env.mutable_request()->mutable_echo()->mutable_data();
+    data->resize(std::max<size_t>(FLAGS_message_size, sizeof(int64_t)));
+    auto receiver_id = config->MakeMachineId(0, 1);
+    auto start = Now();
+    for (uint64_t i = 0; i < FLAGS_messages; i++) {
+      auto send_time = start + static_cast<int64_t>(i * 1e9 / FLAGS_rate);
+      while (Now() < send_time) {
+        sender.FlushExpired();
+      }
+      auto now = Now();
+      memcpy(data->data(), &now, sizeof(now));
+      sender.Send(env, receiver_id, kServerChannel);
+    }
+    sender.Flush();
+  });
+
+  std::vector<int64_t> latencies;
+  latencies.reserve(FLAGS_messages);
+  uint64_t packets = 0;
+  auto on_message = [&latencies](const char* data, size_t size) {
+    Envelope env;
+    CHECK(DeserializeProto(env, data, size));
+    int64_t send_time;
+    memcpy(&send_time, env.request().echo().data().data(), sizeof(send_time));
+    latencies.push_back(Now() - send_time);
+  };
+  int64_t first_recv_time = 0;
+  while (latencies.size() < FLAGS_messages) {
+    zmq::message_t msg;
+    CHECK(receiver_socket.recv(msg));
+    if (packets++ == 0) {
+      first_recv_time = Now();
+    }
+    if (wire::IsCoalesced(msg.data<char>(), msg.size())) {
+      CHECK(wire::ForEachCoalesced(msg.data<char>(), msg.size(), on_message));
+    } else {
+      on_message(msg.data<char>(), msg.size());
+    }
+  }
+  auto elapsed = (Now() - first_recv_time) / 1e9;
+  sender_thread.join();
+
+  std::sort(latencies.begin(), latencies.end());
+  auto percentile = [&latencies](double p) { return latencies[static_cast<size_t>(p * (latencies.size() - 1))] / 1e3; };
+  LOG(INFO) << name << ": " << packets / elapsed << " packets/s, " << latencies.size() / elapsed << " msgs/s, "
+            << static_cast<double>(latencies.size()) / packets << " msgs/packet. Latency p50 = " << percentile(0.5)
+            << " us, p99 = " << percentile(0.99) << " us";
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  InitializeService(&argc, &argv);
+
+  LOG(INFO) << "Messages = " << FLAGS_messages << ". Rate = " << FLAGS_rate << " msgs/s. Message size = "
+            << FLAGS_message_size << " bytes. Max frame size = " << FLAGS_max_frame_bytes
+            << " bytes. Max delay = " << FLAGS_max_delay << " us";
+
+  RunBenchmark("One by one", FLAGS_port, false);
+  RunBenchmark("Coalesced", FLAGS_port + 1, true);
+
+  return 0;
+}
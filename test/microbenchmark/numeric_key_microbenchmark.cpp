@@ -0,0 +1,73 @@
+#include <random>
+#include <string>
+#include <vector>
+
+#include "common/string_utils.h"
+#include "common/types.h"
+#include "service/service_utils.h"
+#include "storage/mem_only_storage.h"
+#include "storage/numeric_key_storage.h"
+
+DEFINE_uint64(keys, 1000000, "Number of keys");
+DEFINE_uint64(txns, 1000000, "Number of transactions");
+DEFINE_uint32(keys_per_txn, 10, "Number of keys in each transaction");
+DEFINE_uint32(value_size, 100, "Size of the values in bytes");
+DEFINE_uint32(partitions, 4, "Number of partitions");
+
+using namespace slog;
+using std::string;
+using std::vector;
+
+namespace {
+
+/**
+ * Runs the per-key work that a transaction goes through with simple partitioning: finding the
+ * partition of each key, reading all keys in the worker then writing all keys on commit
+ */
+template <typename StorageType, typename PartitionFn>
+void RunBenchmark(const string& name, PartitionFn&& partition_of_key) {
+  StorageType storage;
+  string value(FLAGS_value_size, 'a');
+
+  // Only keys of partition 0 are stored, like on a real partition
+  vector<Key> keys;
+  for (uint64_t key = 0; key < FLAGS_keys * FLAGS_partitions; key += FLAGS_partitions) {
+    keys.push_back(std::to_string(key));
+    storage.Write(keys.back(), Record(value, 0));
+  }
+
+  std::mt19937 rg(0);
+  std::uniform_int_distribution<uint64_t> key_dis(0, keys.size() - 1);
+  vector<const Key*> txn_keys(FLAGS_keys_per_txn);
+  vector<std::optional<Record>> records;
+
+  auto start = steady_clock::now();
+  for (uint64_t i = 0; i < FLAGS_txns; i++) {
+    for (auto& key : txn_keys) {
+      key = &keys[key_dis(rg)];
+      CHECK_EQ(partition_of_key(*key), 0U);
+    }
+    storage.MultiRead(txn_keys, records);
+    storage.ReadModifyWrite(txn_keys, [&value](size_t, Record& record, bool) { record.SetValue(value); });
+  }
+  auto elapsed = duration_cast<duration<double>>(steady_clock::now() - start).count();
+
+  LOG(INFO) << name << ": " << FLAGS_txns / elapsed << " txns/s";
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  InitializeService(&argc, &argv);
+
+  LOG(INFO) << "Keys = " << FLAGS_keys << ". Keys per txn = " << FLAGS_keys_per_txn
+            << ". Value size = " << FLAGS_value_size << " bytes";
+
+  // How partition_of_key parsed keys before ParseNumericKey
+  RunBenchmark<MemOnlyStorage<Key, Record, Metadata>>(
+      "String keys", [](const Key& key) -> uint32_t { return std::stoll(key) % FLAGS_partitions; });
+  RunBenchmark<NumericKeyStorage<Record, Metadata>>(
+      "Numeric keys", [](const Key& key) -> uint32_t { return ParseNumericKey(key) % FLAGS_partitions; });
+
+  return 0;
+}
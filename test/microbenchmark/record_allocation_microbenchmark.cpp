@@ -0,0 +1,125 @@
+#include <atomic>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "common/types.h"
+#include "service/service_utils.h"
+#include "storage/mem_only_storage.h"
+
+DEFINE_uint64(keys, 1000000, "Number of keys");
+DEFINE_uint64(txns, 1000000, "Number of committed transactions");
+DEFINE_uint32(writes_per_txn, 10, "Number of keys written by each transaction");
+DEFINE_uint32(value_size, 100, "Size of the values in bytes");
+
+using namespace slog;
+using std::string;
+using std::vector;
+
+namespace {
+
+std::atomic<uint64_t> num_allocations = 0;
+
+/**
+ * The representation Record had before values were stored inline or in slab blocks
+ */
+struct HeapRecord {
+  HeapRecord(const string& v, uint32_t m) : metadata(m) { SetValue(v.data(), v.size()); }
+
+  HeapRecord(const HeapRecord& other) {
+    SetValue(other.data_.get(), other.size_);
+    metadata = other.metadata;
+  }
+
+  HeapRecord& operator=(const HeapRecord& other) {
+    HeapRecord tmp(other);
+    data_.swap(tmp.data_);
+    std::swap(size_, tmp.size_);
+    std::swap(metadata, tmp.metadata);
+    return *this;
+  }
+
+  void SetValue(const char* data, size_t size) {
+    size_ = size;
+    data_.reset(new char[size_]);
+    memcpy(data_.get(), data, size_);
+  }
+
+  HeapRecord() = default;
+
+  Metadata metadata;
+
+ private:
+  std::unique_ptr<char[]> data_;
+  size_t size_ = 0;
+};
+
+/**
+ * Applies the writes of committed transactions to the storage the same way Worker::Commit does
+ */
+template <typename RecordType>
+void RunBenchmark(const string& name) {
+  MemOnlyStorage<Key, RecordType, Metadata> storage;
+  string value(FLAGS_value_size, 'a');
+  vector<Key> keys;
+  for (uint64_t key = 0; key < FLAGS_keys; key++) {
+    keys.push_back(std::to_string(key));
+    storage.Write(keys.back(), RecordType(value, 0));
+  }
+
+  std::mt19937 rg(0);
+  std::uniform_int_distribution<uint64_t> key_dis(0, keys.size() - 1);
+  vector<const Key*> txn_keys(FLAGS_writes_per_txn);
+
+  auto allocations_before = num_allocations.load();
+  auto start = steady_clock::now();
+  for (uint64_t i = 0; i < FLAGS_txns; i++) {
+    for (auto& key : txn_keys) {
+      key = &keys[key_dis(rg)];
+    }
+    value[i % value.size()]++;
+
+    for (auto key : txn_keys) {
+      RecordType record;
+      if (!storage.Read(*key, record)) {
+        record.metadata = Metadata(0);
+      }
+      record.SetValue(value.data(), value.size());
+      storage.Write(*key, record);
+    }
+  }
+  auto elapsed = duration_cast<duration<double>>(steady_clock::now() - start).count();
+  auto allocations = num_allocations.load() - allocations_before;
+  auto num_writes = FLAGS_txns * FLAGS_writes_per_txn;
+
+  LOG(INFO) << name << ": " << static_cast<double>(allocations) / num_writes << " allocations/write, "
+            << num_writes / elapsed << " writes/s";
+}
+
+}  // namespace
+
+void* operator new(size_t size) {
+  num_allocations.fetch_add(1, std::memory_order_relaxed);
+  if (auto ptr = malloc(size)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept { free(ptr); }
+
+void operator delete(void* ptr, size_t) noexcept { free(ptr); }
+
+int main(int argc, char* argv[]) {
+  InitializeService(&argc, &argv);
+
+  LOG(INFO) << "Keys = " << FLAGS_keys << ". Writes per txn = " << FLAGS_writes_per_txn
+            << ". Value size = " << FLAGS_value_size << " bytes";
+
+  RunBenchmark<HeapRecord>("HeapRecord");
+  RunBenchmark<Record>("Record");
+
+  return 0;
+}
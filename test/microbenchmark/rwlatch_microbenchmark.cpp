@@ -0,0 +1,115 @@
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/string_utils.h"
+#include "common/types.h"
+#include "data_structure/concurrent_hash_map.h"
+#include "data_structure/open_addressing_segment.h"
+#include "data_structure/rwlatch.h"
+#include "service/service_utils.h"
+
+DEFINE_uint64(keys, 100000, "Number of keys");
+DEFINE_uint64(ops, 1000000, "Number of operations per thread");
+DEFINE_string(write_pcts, "0,1,5,20,50", "Comma-separated percentages of operations that are writes");
+DEFINE_uint32(max_threads, 32, "The benchmark is run with 1, 2, 4, ... threads up to this number");
+
+using namespace slog;
+using std::string;
+using std::vector;
+
+namespace {
+
+// String values are not trivially copyable so every read of these maps takes the latch of its segment
+template <typename Latch>
+using LatchedMap = ConcurrentHashMap<string, string, std::hash<string>, 8,
+                                     concurrent_hash_map::WithLatch<Latch>::template OpenAddressingSegmentT>;
+
+template <typename Map>
+double RunWorkload(const vector<string>& keys, uint32_t write_pct, uint32_t num_threads) {
+  Map map;
+  for (const auto& key : keys) {
+    map.InsertOrUpdate(key, "value");
+  }
+
+  vector<std::thread> threads;
+  auto start = steady_clock::now();
+  for (uint32_t t = 0; t < num_threads; t++) {
+    threads.emplace_back([&map, &keys, write_pct, t] {
+      std::mt19937 rg(t);
+      std::uniform_int_distribution<uint64_t> key_dis(0, keys.size() - 1);
+      std::uniform_int_distribution<uint32_t> pct_dis(0, 99);
+      string value;
+      for (uint64_t i = 0; i < FLAGS_ops; i++) {
+        const auto& key = keys[key_dis(rg)];
+        if (pct_dis(rg) < write_pct) {
+          map.InsertOrUpdate(key, "value");
+        } else {
+          CHECK(map.Get(value, key));
+        }
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  auto elapsed = duration_cast<duration<double>>(steady_clock::now() - start).count();
+  return num_threads * FLAGS_ops / elapsed;
+}
+
+}  // namespace
+
+/**
+ * Runs a mix of reads and writes on a ConcurrentHashMap whose segments are guarded by each
+ * latch, then reports the latch with the highest throughput for each workload. The lock-free
+ * chained segment is measured as a reference but is not a candidate.
+ */
+int main(int argc, char* argv[]) {
+  InitializeService(&argc, &argv);
+
+  LOG(INFO) << "Keys = " << FLAGS_keys << ". Hardware threads = " << std::thread::hardware_concurrency();
+
+  vector<string> keys;
+  for (uint64_t key = 0; key < FLAGS_keys; key++) {
+    keys.push_back(std::to_string(key));
+  }
+
+  const std::map<string, double (*)(const vector<string>&, uint32_t, uint32_t)> latches = {
+      {"SharedMutexLatch", RunWorkload<LatchedMap<SharedMutexLatch>>},
+      {"SpinRWLatch", RunWorkload<LatchedMap<SpinRWLatch>>},
+      {"DistributedRWLatch", RunWorkload<LatchedMap<DistributedRWLatch<>>>}};
+
+  vector<string> summary;
+  string write_pct_str;
+  for (size_t pos = NextToken(write_pct_str, FLAGS_write_pcts, ","); pos != string::npos;
+       pos = NextToken(write_pct_str, FLAGS_write_pcts, ",", pos)) {
+    auto write_pct = static_cast<uint32_t>(std::stoul(write_pct_str));
+    for (uint32_t num_threads = 1; num_threads <= FLAGS_max_threads; num_threads *= 2) {
+      auto lock_free = RunWorkload<ConcurrentHashMap<string, string>>(keys, write_pct, num_threads);
+      LOG(INFO) << "Writes = " << write_pct << "%, threads = " << num_threads << ": lock-free = " << lock_free
+                << " ops/s";
+
+      string best;
+      double best_throughput = 0;
+      for (const auto& [name, run] : latches) {
+        auto throughput = run(keys, write_pct, num_threads);
+        LOG(INFO) << "  " << name << " = " << throughput << " ops/s";
+        if (throughput > best_throughput) {
+          best = name;
+          best_throughput = throughput;
+        }
+      }
+      summary.push_back("Writes = " + std::to_string(write_pct) + "%, threads = " + std::to_string(num_threads) +
+                        ": " + best);
+    }
+  }
+
+  LOG(INFO) << "Best latch per workload:";
+  for (const auto& line : summary) {
+    LOG(INFO) << "  " << line;
+  }
+
+  return 0;
+}
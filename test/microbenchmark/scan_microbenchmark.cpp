@@ -0,0 +1,106 @@
+#include <random>
+#include <string>
+#include <vector>
+
+#include "common/string_utils.h"
+#include "common/types.h"
+#include "service/service_utils.h"
+#include "storage/numeric_key_storage.h"
+
+DEFINE_uint64(keys, 1000000, "Size of the key space");
+DEFINE_uint32(key_stride, 1, "Only every key_stride-th key of the key space exists, so that ranges are sparse");
+DEFINE_uint32(value_size, 100, "Size of the values in bytes");
+DEFINE_string(range_sizes, "10,100,1000,10000", "Comma-separated numbers of keys in a scanned range");
+DEFINE_uint64(scanned_keys, 10000000, "Total number of keys scanned for each range size");
+
+using namespace slog;
+using std::string;
+using std::vector;
+
+namespace {
+
+template <typename Fn>
+double Measure(Fn&& fn) {
+  auto start = steady_clock::now();
+  fn();
+  return duration_cast<duration<double>>(steady_clock::now() - start).count();
+}
+
+double Load(NumericKeyStorage<Record, Metadata>& storage) {
+  Record record(string(FLAGS_value_size, 'a'), 0);
+  auto elapsed = Measure([&]() {
+    for (uint64_t key = 0; key < FLAGS_keys; key += FLAGS_key_stride) {
+      storage.Write(std::to_string(key), record);
+    }
+  });
+  return (FLAGS_keys + FLAGS_key_stride - 1) / FLAGS_key_stride / elapsed;
+}
+
+/**
+ * Reads random ranges with a range scan, which is how a worker reads the keys of a SCAN command
+ * from an ordered storage, and, for comparison, with point reads of every key in the range, which
+ * is how they are read from a storage without an ordered index
+ */
+void RunBenchmark(const NumericKeyStorage<Record, Metadata>& storage, uint64_t range_size) {
+  CHECK_LE(range_size, FLAGS_keys);
+  auto num_scans = std::max<uint64_t>(FLAGS_scanned_keys / range_size, 1);
+  std::mt19937 rg(range_size);
+  std::uniform_int_distribution<uint64_t> start_dis(0, FLAGS_keys - range_size);
+  vector<uint64_t> starts(num_scans);
+  for (auto& start : starts) {
+    start = start_dis(rg);
+  }
+
+  vector<std::pair<Key, Record>> records;
+  auto scan_elapsed = Measure([&]() {
+    for (auto start : starts) {
+      CHECK(storage.Scan(std::to_string(start), std::to_string(start + range_size), records));
+      CHECK_LE(records.size(), range_size);
+    }
+  });
+
+  vector<Key> keys(range_size);
+  vector<const Key*> key_ptrs;
+  for (auto& key : keys) {
+    key_ptrs.push_back(&key);
+  }
+  vector<std::optional<Record>> point_records;
+  auto multi_read_elapsed = Measure([&]() {
+    for (auto start : starts) {
+      for (uint64_t i = 0; i < range_size; i++) {
+        keys[i] = std::to_string(start + i);
+      }
+      storage.MultiRead(key_ptrs, point_records);
+    }
+  });
+
+  LOG(INFO) << "Range size = " << range_size << ": scan = " << num_scans / scan_elapsed << " scans/s ("
+            << num_scans * range_size / scan_elapsed << " keys/s), point reads = " << num_scans / multi_read_elapsed
+            << " scans/s (" << num_scans * range_size / multi_read_elapsed << " keys/s)";
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  InitializeService(&argc, &argv);
+
+  LOG(INFO) << "Key space = " << FLAGS_keys << ". Key stride = " << FLAGS_key_stride
+            << ". Value size = " << FLAGS_value_size << " bytes";
+
+  {
+    // Cost of maintaining the ordered index when inserting keys
+    NumericKeyStorage<Record, Metadata> storage;
+    LOG(INFO) << "Unordered load = " << Load(storage) << " writes/s";
+  }
+
+  NumericKeyStorage<Record, Metadata> storage(true /* ordered */);
+  LOG(INFO) << "Ordered load = " << Load(storage) << " writes/s";
+
+  string range_size;
+  for (size_t pos = NextToken(range_size, FLAGS_range_sizes, ","); pos != string::npos;
+       pos = NextToken(range_size, FLAGS_range_sizes, ",", pos)) {
+    RunBenchmark(storage, std::stoull(range_size));
+  }
+
+  return 0;
+}
@@ -0,0 +1,163 @@
+#include <deque>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "common/configuration.h"
+#include "common/proto_utils.h"
+#include "common/txn_holder.h"
+#include "common/types.h"
+#include "module/scheduler_components/commands.h"
+#include "module/scheduler_components/rma_lock_manager.h"
+#include "service/service_utils.h"
+#include "storage/mem_only_storage.h"
+#include "storage/numeric_key_storage.h"
+
+DEFINE_uint64(keys, 1000000, "Number of keys of the local partition");
+DEFINE_uint64(txns, 300000, "Number of transactions");
+DEFINE_uint32(keys_per_txn, 10, "Number of keys in each transaction");
+DEFINE_uint32(writes_per_txn, 2, "Number of keys written by each transaction");
+DEFINE_uint32(value_size, 100, "Size of the values in bytes");
+DEFINE_uint32(partitions, 4, "Number of partitions");
+DEFINE_uint32(window, 100, "Number of transactions holding or waiting for locks at a time");
+
+using namespace slog;
+using std::string;
+using std::vector;
+
+namespace {
+
+ConfigurationPtr MakeConfiguration(bool simple_partitioning) {
+  internal::Configuration internal_config;
+  internal_config.set_num_partitions(FLAGS_partitions);
+  if (simple_partitioning) {
+    internal_config.mutable_simple_partitioning();
+  } else {
+    internal_config.mutable_hash_partitioning()->set_partition_key_num_bytes(20);
+  }
+  auto replica = internal_config.add_replicas();
+  for (uint32_t p = 0; p < FLAGS_partitions; p++) {
+    replica->add_addresses("/tmp/scheduler_worker_microbenchmark" + std::to_string(p));
+  }
+  return std::make_shared<Configuration>(internal_config, replica->addresses(0));
+}
+
+/**
+ * Runs the txns of the local partition through what the scheduler and a worker do to them on a
+ * single thread: the txn is held and flattened, its locks are acquired, then, once it is ready,
+ * its keys are read, its code is executed, its writes are applied and its locks are released.
+ * Up to FLAGS_window txns hold or wait for locks at a time so that some of them conflict.
+ */
+template <typename K, typename StorageType>
+void RunBenchmark(const string& name, bool simple_partitioning) {
+  auto config = MakeConfiguration(simple_partitioning);
+  StorageType storage;
+  string value(FLAGS_value_size, 'a');
+
+  // Only keys of the local partition are used, like the keys of the lock-only txns of a partition
+  vector<Key> keys;
+  for (uint64_t key = 0; keys.size() < FLAGS_keys; key++) {
+    auto key_str = std::to_string(key);
+    if (config->key_is_in_local_partition(key_str)) {
+      keys.push_back(key_str);
+      storage.Write(key_str, Record(value, 0));
+    }
+  }
+
+  std::mt19937 rg(0);
+  std::uniform_int_distribution<uint64_t> key_dis(0, keys.size() - 1);
+  vector<Transaction*> txns;
+  txns.reserve(FLAGS_txns);
+  for (uint64_t id = 0; id < FLAGS_txns; id++) {
+    vector<KeyEntry> entries;
+    string code;
+    for (uint32_t k = 0; k < FLAGS_keys_per_txn; k++) {
+      const auto& key = keys[key_dis(rg)];
+      auto type = k < FLAGS_writes_per_txn ? KeyType::WRITE : KeyType::READ;
+      entries.emplace_back(key, type, 0);
+      code += (type == KeyType::WRITE ? "SET " + key + " " + value : "GET " + key) + " ";
+    }
+    auto txn = MakeTransaction(entries, code);
+    txn->mutable_internal()->set_id(id);
+    txns.push_back(txn);
+  }
+
+  RMALockManager<K> lock_manager;
+  KeyValueCommands commands;
+  std::unordered_map<TxnId, TxnHolder> active_txns;
+  std::deque<TxnId> ready_txns;
+  vector<std::optional<Record>> records;
+  uint64_t num_committed = 0;
+
+  auto execute_one = [&]() {
+    auto txn_id = ready_txns.front();
+    ready_txns.pop_front();
+    auto& holder = active_txns.at(txn_id);
+    auto& flat_txn = holder.flat_txn();
+
+    storage.MultiRead(flat_txn.key_ptrs(), records);
+    for (size_t i = 0; i < flat_txn.num_keys(); i++) {
+      flat_txn.slot(i).value.assign(records[i]->view());
+    }
+
+    commands.Execute(holder.txn(), flat_txn);
+
+    vector<const Key*> write_keys;
+    vector<const string*> new_values;
+    for (size_t i = 0; i < flat_txn.num_keys(); i++) {
+      const auto& slot = flat_txn.slot(i);
+      bool is_local = flat_txn.has_numeric_keys()
+                          ? config->partition_of_key(flat_txn.numeric_key(i)) == config->local_partition()
+                          : config->key_is_in_local_partition(flat_txn.key(i));
+      if (slot.type != KeyType::READ && is_local) {
+        write_keys.push_back(&flat_txn.key(i));
+        new_values.push_back(&slot.new_value);
+      }
+    }
+    storage.ReadModifyWrite(write_keys,
+                            [&new_values](size_t i, Record& record, bool) { record.SetValue(*new_values[i]); });
+    num_committed += holder.txn().status() == TransactionStatus::COMMITTED;
+
+    for (auto unblocked_txn : lock_manager.ReleaseLocks(txn_id)) {
+      ready_txns.push_back(unblocked_txn);
+    }
+    active_txns.erase(txn_id);
+  };
+
+  auto start = steady_clock::now();
+  for (auto txn : txns) {
+    auto txn_id = txn->internal().id();
+    auto& holder = active_txns.try_emplace(txn_id, config, txn).first->second;
+    if (lock_manager.AcquireLocks(holder.flat_txn()) == AcquireLocksResult::ACQUIRED) {
+      ready_txns.push_back(txn_id);
+    }
+    while (active_txns.size() >= FLAGS_window) {
+      execute_one();
+    }
+  }
+  while (!active_txns.empty()) {
+    execute_one();
+  }
+  auto elapsed = duration_cast<duration<double>>(steady_clock::now() - start).count();
+
+  CHECK_EQ(num_committed, FLAGS_txns);
+  LOG(INFO) << name << ": " << FLAGS_txns / elapsed << " txns/s";
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  InitializeService(&argc, &argv);
+
+  LOG(INFO) << "Keys = " << FLAGS_keys << ". Keys per txn = " << FLAGS_keys_per_txn
+            << " (writes = " << FLAGS_writes_per_txn << "). Value size = " << FLAGS_value_size
+            << " bytes. Window = " << FLAGS_window << " txns";
+
+  // Keys are strings everywhere, as with hash partitioning or before integer keys reached the lock manager
+  RunBenchmark<Key, MemOnlyStorage<Key, Record, Metadata>>("String keys", false /* simple_partitioning */);
+  RunBenchmark<uint64_t, NumericKeyStorage<Record, Metadata>>("Numeric keys", true /* simple_partitioning */);
+
+  return 0;
+}
@@ -0,0 +1,134 @@
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/configuration.h"
+#include "connection/broker.h"
+#include "connection/sender.h"
+#include "connection/zmq_utils.h"
+#include "proto/internal.pb.h"
+#include "service/service_utils.h"
+
+DEFINE_uint64(messages, 200000, "Number of messages sent to measure throughput");
+DEFINE_uint64(round_trips, 10000, "Number of messages sent one at a time to measure latency");
+DEFINE_uint32(message_size, 100, "Size of the data of each message in bytes");
+DEFINE_uint32(port, 2040, "First broker port");
+
+using namespace slog;
+using internal::Envelope;
+using std::string;
+
+namespace {
+
+const Channel kReceiverChannel = 1;
+
+struct Transport {
+  string name;
+  string protocol;
+  std::vector<string> addresses;
+  bool shared_memory;
+};
+
+std::vector<ConfigurationPtr> MakeConfigs(const Transport& transport, uint32_t port) {
+  internal::Configuration config;
+  config.set_protocol(transport.protocol);
+  config.add_broker_ports(port);
+  config.set_num_partitions(2);
+  auto replica = config.add_replicas();
+  for (const auto& address : transport.addresses) {
+    replica->add_addresses(address);
+  }
+  if (transport.shared_memory) {
+    config.mutable_shared_memory_transport();
+  }
+  return {std::make_shared<Configuration>(config, transport.addresses[0]),
+          std::make_shared<Configuration>(config, transport.addresses[1])};
+}
+
+int64_t Now() { return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count(); }
+
+/**
+ * A sender on one machine sends messages to a module on another machine through the broker of that machine.
+ * The messages are first sent as fast as possible, then one at a time, waiting for each message to be received
+ */
+void RunBenchmark(const Transport& transport, uint32_t port) {
+  auto configs = MakeConfigs(transport, port);
+  auto receiver_broker = Broker::New(configs[1]);
+  zmq::socket_t receiver_socket(*receiver_broker->context(), ZMQ_PULL);
+  receiver_socket.set(zmq::sockopt::rcvhwm, 0);
+  receiver_socket.bind(MakeInProcChannelAddress(kReceiverChannel));
+  receiver_broker->AddChannel(kReceiverChannel);
+  receiver_broker->StartInNewThreads();
+
+  auto num_messages = FLAGS_messages + FLAGS_round_trips;
+  std::atomic<uint64_t> num_received = 0;
+  std::vector<int64_t> latencies;
+  latencies.reserve(FLAGS_round_trips);
+  int64_t throughput_end_time = 0;
+
+  std::thread receiver_thread([&] {
+    for (uint64_t i = 0; i < num_messages; i++) {
+      auto env = RecvEnvelope(receiver_socket);
+      CHECK(env != nullptr);
+      if (i >= FLAGS_messages) {
+        int64_t send_time;
+        memcpy(&send_time, env->request().echo().data().data(), sizeof(send_time));
+        latencies.push_back(Now() - send_time);
+      } else if (i == FLAGS_messages - 1) {
+        throughput_end_time = Now();
+      }
+      num_received.store(i + 1, std::memory_order_release);
+    }
+  });
+
+  Sender sender(configs[0], std::make_shared<zmq::context_t>(1));
+  auto receiver_id = configs[0]->MakeMachineId(0, 1);
+  Envelope env;
+  auto data = env.mutable_request()->mutable_echo()->mutable_data();
+  data->resize(std::max<size_t>(FLAGS_message_size, sizeof(int64_t)));
+
+  auto throughput_start_time = Now();
+  for (uint64_t i = 0; i < FLAGS_messages; i++) {
+    sender.Send(env, receiver_id, kReceiverChannel);
+  }
+  while (num_received.load(std::memory_order_acquire) < FLAGS_messages) {
+    std::this_thread::yield();
+  }
+
+  for (uint64_t i = 0; i < FLAGS_round_trips; i++) {
+    auto now = Now();
+    memcpy(data->data(), &now, sizeof(now));
+    sender.Send(env, receiver_id, kReceiverChannel);
+    while (num_received.load(std::memory_order_acquire) < FLAGS_messages + i + 1) {
+      std::this_thread::yield();
+    }
+  }
+  receiver_thread.join();
+
+  std::sort(latencies.begin(), latencies.end());
+  auto percentile = [&latencies](double p) { return latencies[static_cast<size_t>(p * (latencies.size() - 1))] / 1e3; };
+  auto elapsed = (throughput_end_time - throughput_start_time) / 1e9;
+  LOG(INFO) << transport.name << ": " << FLAGS_messages / elapsed << " msgs/s. Latency p50 = " << percentile(0.5)
+            << " us, p99 = " << percentile(0.99) << " us";
+
+  receiver_broker->Stop();
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  InitializeService(&argc, &argv);
+
+  LOG(INFO) << "Message size = " << FLAGS_message_size << " bytes";
+
+  std::vector<Transport> transports{{"tcp", "tcp", {"127.0.0.1", "127.0.0.2"}, false},
+                                    {"ipc", "ipc", {"/tmp/slog_bench_ipc0", "/tmp/slog_bench_ipc1"}, false},
+                                    {"Shared memory", "ipc", {"/tmp/slog_bench_shm0", "/tmp/slog_bench_shm1"}, true}};
+  for (size_t i = 0; i < transports.size(); i++) {
+    RunBenchmark(transports[i], FLAGS_port + i);
+  }
+
+  return 0;
+}
@@ -0,0 +1,106 @@
+#include <filesystem>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "common/types.h"
+#include "service/service_utils.h"
+#include "storage/log_structured_storage.h"
+#include "storage/mem_only_storage.h"
+
+DEFINE_uint64(keys, 1000000, "Number of keys");
+DEFINE_uint32(value_size, 1000, "Size of a value in bytes");
+DEFINE_uint32(threads, 4, "Number of threads");
+DEFINE_uint64(ops, 1000000, "Number of reads and number of writes per thread");
+DEFINE_string(dir, "/tmp/slog_storage_microbenchmark", "Directory for the log-structured storage");
+DEFINE_uint64(memory_budget, 64 * 1024 * 1024,
+              "Memory budget of the log-structured storage in bytes. By default, this is much smaller than "
+              "the size of the data so that most reads miss the cache");
+
+using namespace slog;
+using std::vector;
+
+namespace {
+
+template <typename Fn>
+double RunInThreads(Fn&& fn) {
+  vector<std::thread> threads;
+  auto start = steady_clock::now();
+  for (uint32_t i = 0; i < FLAGS_threads; i++) {
+    threads.emplace_back(fn, i);
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  auto elapsed = duration_cast<duration<double>>(steady_clock::now() - start).count();
+  return FLAGS_threads * FLAGS_ops / elapsed;
+}
+
+template <typename StorageType>
+void RunBenchmark(const std::string& name, StorageType& storage) {
+  std::string value(FLAGS_value_size, 'a');
+
+  // Populate the storage
+  auto start = steady_clock::now();
+  for (uint64_t key = 0; key < FLAGS_keys; key++) {
+    storage.Write(std::to_string(key), Record(value, 0));
+  }
+  auto load_elapsed = duration_cast<duration<double>>(steady_clock::now() - start).count();
+
+  auto writes_per_sec = RunInThreads([&](uint32_t thread) {
+    std::mt19937 rg(thread);
+    std::uniform_int_distribution<uint64_t> dis(0, FLAGS_keys - 1);
+    Record record(value, 0);
+    for (uint64_t i = 0; i < FLAGS_ops; i++) {
+      storage.Write(std::to_string(dis(rg)), record);
+    }
+  });
+
+  auto reads_per_sec = RunInThreads([&](uint32_t thread) {
+    std::mt19937 rg(thread + FLAGS_threads);
+    std::uniform_int_distribution<uint64_t> dis(0, FLAGS_keys - 1);
+    Record record;
+    for (uint64_t i = 0; i < FLAGS_ops; i++) {
+      CHECK(storage.Read(std::to_string(dis(rg)), record));
+    }
+  });
+
+  // The forwarder looks up the master of every key of every transaction
+  auto lookups_per_sec = RunInThreads([&](uint32_t thread) {
+    std::mt19937 rg(thread + 2 * FLAGS_threads);
+    std::uniform_int_distribution<uint64_t> dis(0, FLAGS_keys - 1);
+    Metadata metadata;
+    for (uint64_t i = 0; i < FLAGS_ops; i++) {
+      CHECK(storage.GetMasterMetadata(std::to_string(dis(rg)), metadata));
+    }
+  });
+
+  LOG(INFO) << name << ": load = " << FLAGS_keys / load_elapsed << " writes/s, random writes = " << writes_per_sec
+            << " writes/s, random reads = " << reads_per_sec << " reads/s, master lookups = " << lookups_per_sec
+            << " lookups/s";
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  InitializeService(&argc, &argv);
+
+  LOG(INFO) << "Data size = " << FLAGS_keys * FLAGS_value_size << " bytes. Threads = " << FLAGS_threads;
+
+  {
+    MemOnlyStorage<Key, Record, Metadata> storage;
+    RunBenchmark("MemOnlyStorage", storage);
+  }
+
+  std::filesystem::remove_all(FLAGS_dir);
+  {
+    LogStructuredStorage::Options options;
+    options.directory = FLAGS_dir;
+    options.memory_budget_bytes = FLAGS_memory_budget;
+    LogStructuredStorage storage(options);
+    RunBenchmark("LogStructuredStorage", storage);
+  }
+  std::filesystem::remove_all(FLAGS_dir);
+
+  return 0;
+}
@@ -0,0 +1,97 @@
+#include <string>
+#include <vector>
+
+#include "common/constants.h"
+#include "common/proto_utils.h"
+#include "connection/zmq_utils.h"
+#include "proto/internal.pb.h"
+#include "service/service_utils.h"
+
+DEFINE_uint64(messages, 1000000, "Number of messages of each kind");
+DEFINE_uint32(txns_per_batch, 10, "Number of transactions in each batch");
+DEFINE_uint32(keys_per_txn, 10, "Number of keys of each transaction");
+DEFINE_uint32(value_size, 100, "Size of the values in bytes");
+
+using namespace slog;
+using internal::Envelope;
+using std::string;
+
+namespace {
+
+Envelope MakeBatch() {
+  Envelope env;
+  auto batch = env.mutable_request()->mutable_forward_batch()->mutable_batch_data();
+  batch->set_id(1);
+  string value(FLAGS_value_size, 'a');
+  for (uint32_t i = 0; i < FLAGS_txns_per_batch; i++) {
+    auto txn = batch->add_transactions();
+    txn->mutable_internal()->set_id(i);
+    txn->mutable_internal()->add_involved_partitions(0);
+    for (uint32_t k = 0; k < FLAGS_keys_per_txn; k++) {
+      auto& entry = (*txn->mutable_keys())["key" + std::to_string(i * FLAGS_keys_per_txn + k)];
+      entry.set_type(k % 2 ? KeyType::WRITE : KeyType::READ);
+    }
+    txn->mutable_code()->append("SET key0 value");
+  }
+  return env;
+}
+
+Envelope MakeRemoteRead() {
+  Envelope env;
+  auto remote_read = env.mutable_request()->mutable_remote_read_result();
+  remote_read->set_txn_id(1000);
+  remote_read->set_partition(1);
+  string value(FLAGS_value_size, 'a');
+  for (uint32_t k = 0; k < FLAGS_keys_per_txn / 2; k++) {
+    (*remote_read->mutable_reads())["key" + std::to_string(k)].set_value(value);
+  }
+  return env;
+}
+
+Envelope MakeEcho() {
+  Envelope env;
+  env.mutable_request()->mutable_echo()->set_data("ping");
+  return env;
+}
+
+/**
+ * Serializes and deserializes the same message repeatedly. Deserializing is the work that a broker thread
+ * does for every message it forwards so its time is reported separately
+ */
+void RunBenchmark(const string& name, const Envelope& env, uint8_t version) {
+  size_t bytes = 0;
+  duration<double> serialize_time{0}, deserialize_time{0};
+  for (uint64_t i = 0; i < FLAGS_messages; i++) {
+    auto start = steady_clock::now();
+    auto msg = SerializeProto(env, version);
+    SetAddress(msg, 1, kServerChannel);
+    auto serialized = steady_clock::now();
+    Envelope out;
+    CHECK(DeserializeProto(out, msg));
+    deserialize_time += steady_clock::now() - serialized;
+    serialize_time += serialized - start;
+    bytes = msg.size();
+  }
+  auto per_million = 1000000.0 / FLAGS_messages;
+  LOG(INFO) << name << " v" << static_cast<int>(version) << ": " << bytes << " bytes/msg, "
+            << serialize_time.count() * per_million << " s serializing and " << deserialize_time.count() * per_million
+            << " s deserializing per million msgs";
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  InitializeService(&argc, &argv);
+
+  LOG(INFO) << "Txns per batch = " << FLAGS_txns_per_batch << ". Keys per txn = " << FLAGS_keys_per_txn
+            << ". Value size = " << FLAGS_value_size << " bytes";
+
+  std::vector<std::pair<string, Envelope>> messages{
+      {"Batch", MakeBatch()}, {"Remote read", MakeRemoteRead()}, {"Echo", MakeEcho()}};
+  for (const auto& [name, env] : messages) {
+    RunBenchmark(name, env, wire::kLegacyVersion);
+    RunBenchmark(name, env, wire::kVersion);
+  }
+
+  return 0;
+}
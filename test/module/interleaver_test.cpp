@@ -2,6 +2,7 @@
 
 #include <gtest/gtest.h>
 
+#include <deque>
 #include <vector>
 
 #include "common/proto_utils.h"
@@ -139,18 +140,31 @@ class InterleaverTest : public ::testing::Test {
 
   void SendToInterleaver(int from, int to, const Envelope& req) { senders_[from]->Send(req, to, kInterleaverChannel); }
 
+  // The interleaver sends whole batches to the scheduler. Their txns are returned one at a time
   Transaction* ReceiveTxn(int i) {
-    auto req_env = slogs_[i]->ReceiveFromOutputChannel(kSchedulerChannel);
-    if (req_env == nullptr) {
-      return nullptr;
+    if (pending_txns_[i].empty()) {
+      auto req_env = slogs_[i]->ReceiveFromOutputChannel(kSchedulerChannel);
+      if (req_env == nullptr) {
+        return nullptr;
+      }
+      if (req_env->request().type_case() != internal::Request::kForwardBatch) {
+        return nullptr;
+      }
+      for (auto txn : Unbatch(req_env->mutable_request()->mutable_forward_batch()->mutable_batch_data())) {
+        // Txns in an arena are freed with the envelope
+        pending_txns_[i].push_back(txn->GetArena() != nullptr ? new Transaction(*txn) : txn);
+      }
     }
-    if (req_env->request().type_case() != internal::Request::kForwardTxn) {
+    if (pending_txns_[i].empty()) {
       return nullptr;
     }
-    return req_env->mutable_request()->mutable_forward_txn()->release_txn();
+    auto txn = pending_txns_[i].front();
+    pending_txns_[i].pop_front();
+    return txn;
   }
 
   unique_ptr<Sender> senders_[4];
+  deque<Transaction*> pending_txns_[4];
   unique_ptr<TestSlog> slogs_[4];
 };
 
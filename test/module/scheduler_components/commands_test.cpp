@@ -2,7 +2,9 @@
 
 #include <gtest/gtest.h>
 
+#include "common/compression.h"
 #include "common/proto_utils.h"
+#include "storage/numeric_key_storage.h"
 
 using namespace std;
 using namespace slog;
@@ -60,4 +62,101 @@ TEST(CommandsTest, KeyValueOnlyWritesKeysInWriteSet) {
   ASSERT_EQ(txn->keys().at("key2").new_value(), "value2");
   ASSERT_EQ(txn->deleted_keys_size(), 1);
   ASSERT_EQ(txn->deleted_keys(0), "key3");
+}
+
+TEST(CommandsTest, KeyValueReadsCompressedValues) {
+  auto txn = MakeTransaction({{"key1", KeyType::READ}, {"key2", KeyType::READ}, {"key3", KeyType::WRITE}},
+                             "EQ   key1 value1\n"
+                             "COPY key2 key3\n");
+  string compressed;
+  CompressValue("value1", compressed);
+  txn->mutable_keys()->at("key1").set_value(compressed);
+  txn->mutable_keys()->at("key1").set_compressed(true);
+  CompressValue("value2", compressed);
+  txn->mutable_keys()->at("key2").set_value(compressed);
+  txn->mutable_keys()->at("key2").set_compressed(true);
+
+  KeyValueCommands proc;
+  proc.Execute(*txn);
+  ASSERT_EQ(txn->status(), TransactionStatus::COMMITTED);
+  ASSERT_EQ(txn->keys().at("key1").value(), "value1");
+  ASSERT_FALSE(txn->keys().at("key1").compressed());
+  ASSERT_EQ(txn->keys().at("key3").new_value(), "value2");
+}
+
+TEST(CommandsTest, DeclareScannedKeys) {
+  auto txn = MakeTransaction({{"2", KeyType::WRITE}},
+                             "SCAN 0 5\n"
+                             "SET 2 value2\n"
+                             "SCAN 10 12");
+
+  KeyValueCommands proc;
+  ASSERT_TRUE(proc.DeclareScannedKeys(*txn, true /* integer_keys */));
+  ASSERT_EQ(txn->keys_size(), 7);
+  for (auto key : {"0", "1", "3", "4", "10", "11"}) {
+    ASSERT_EQ(txn->keys().at(key).type(), KeyType::READ);
+  }
+  ASSERT_EQ(txn->keys().at("2").type(), KeyType::WRITE);
+
+  proc.Execute(*txn);
+  ASSERT_EQ(txn->status(), TransactionStatus::COMMITTED);
+  ASSERT_EQ(txn->keys().at("2").new_value(), "value2");
+}
+
+TEST(CommandsTest, DeclareScannedKeysInvalidRange) {
+  // The last one is within the limit per range but not per txn
+  for (auto code : {"SCAN 5 0", "SCAN a b", "SCAN 0 1000000000", "SCAN 0 60000 SCAN 60000 120000"}) {
+    auto txn = MakeTransaction({}, code);
+    KeyValueCommands proc;
+    ASSERT_FALSE(proc.DeclareScannedKeys(*txn, true /* integer_keys */));
+    ASSERT_EQ(txn->status(), TransactionStatus::ABORTED);
+  }
+}
+
+TEST(CommandsTest, DeclareScannedKeysRejectsWhatCannotBeDeclared) {
+  KeyValueCommands proc;
+  // The keys of the range cannot be enumerated
+  auto txn = MakeTransaction({{"A", KeyType::READ}}, "GET A SCAN 0 5");
+  ASSERT_FALSE(proc.DeclareScannedKeys(*txn, false /* integer_keys */));
+  ASSERT_EQ(txn->status(), TransactionStatus::ABORTED);
+
+  txn = MakeTransaction({{"A", KeyType::READ}}, "GET A SCAN");
+  ASSERT_FALSE(proc.DeclareScannedKeys(*txn, true /* integer_keys */));
+  ASSERT_EQ(txn->status(), TransactionStatus::ABORTED);
+
+  // Nothing to declare without a scan
+  txn = MakeTransaction({{"A", KeyType::READ}}, "GET A");
+  ASSERT_TRUE(proc.DeclareScannedKeys(*txn, false /* integer_keys */));
+  ASSERT_EQ(txn->keys_size(), 1);
+}
+
+TEST(CommandsTest, ReadRanges) {
+  NumericKeyStorage<Record, Metadata> storage(true /* ordered */);
+  for (int key = 0; key < 20; key += 3) {
+    storage.Write(to_string(key), Record("value" + to_string(key), 0));
+  }
+  auto txn = MakeTransaction({{"4", KeyType::WRITE}, {"18", KeyType::READ}}, "SCAN 2 7 SET 4 value4 GET 18");
+  KeyValueCommands proc;
+  ASSERT_TRUE(proc.DeclareScannedKeys(*txn, true /* integer_keys */));
+
+  FlatTxn flat_txn(*txn);
+  flat_txn.ParseNumericKeys();
+  vector<optional<Record>> records;
+  vector<bool> scanned;
+  ASSERT_TRUE(proc.ReadRanges(*txn, flat_txn, storage, records, scanned));
+  ASSERT_EQ(records.size(), flat_txn.num_keys());
+  for (size_t i = 0; i < flat_txn.num_keys(); i++) {
+    auto key = stoi(flat_txn.key(i));
+    // 18 is read by GET so it is left to be looked up with the other keys
+    ASSERT_EQ(scanned[i], key != 18) << key;
+    ASSERT_EQ(records[i].has_value(), key == 3 || key == 6) << key;
+  }
+  ASSERT_EQ(records[flat_txn.Find("6")]->to_string(), "value6");
+
+  // Nothing is read by range from a storage without an ordered index or for a txn without a scan
+  ASSERT_FALSE(proc.ReadRanges(*txn, flat_txn, NumericKeyStorage<Record, Metadata>(), records, scanned));
+  auto no_scan_txn = MakeTransaction({{"3", KeyType::READ}}, "GET 3");
+  FlatTxn no_scan_flat_txn(*no_scan_txn);
+  no_scan_flat_txn.ParseNumericKeys();
+  ASSERT_FALSE(proc.ReadRanges(*no_scan_txn, no_scan_flat_txn, storage, records, scanned));
 }
\ No newline at end of file
@@ -16,7 +16,7 @@ TEST(OldLockManagerTest, GetAllLocksOnFirstTry) {
   OldLockManager lock_manager;
   auto holder = MakeTestTxnHolder(
       configs[0], 1000, {{"readA", KeyType::READ, 0}, {"readB", KeyType::READ, 0}, {"writeC", KeyType::WRITE, 0}});
-  ASSERT_EQ(lock_manager.AcquireLocks(holder.lock_only_txn(0)), AcquireLocksResult::ACQUIRED);
+  ASSERT_EQ(lock_manager.AcquireLocks(holder.flat_lock_only_txn(0)), AcquireLocksResult::ACQUIRED);
   auto result = lock_manager.ReleaseLocks(holder.txn_id());
   ASSERT_TRUE(result.empty());
 }
@@ -28,8 +28,8 @@ TEST(OldLockManager, ReadLocks) {
 
   auto holder2 = MakeTestTxnHolder(configs[0], 200, {{"readB", KeyType::READ, 0}, {"readC", KeyType::READ, 0}});
 
-  ASSERT_EQ(lock_manager.AcquireLocks(holder1.lock_only_txn(0)), AcquireLocksResult::ACQUIRED);
-  ASSERT_EQ(lock_manager.AcquireLocks(holder2.lock_only_txn(0)), AcquireLocksResult::ACQUIRED);
+  ASSERT_EQ(lock_manager.AcquireLocks(holder1.flat_lock_only_txn(0)), AcquireLocksResult::ACQUIRED);
+  ASSERT_EQ(lock_manager.AcquireLocks(holder2.flat_lock_only_txn(0)), AcquireLocksResult::ACQUIRED);
   ASSERT_TRUE(lock_manager.ReleaseLocks(holder1.txn_id()).empty());
   ASSERT_TRUE(lock_manager.ReleaseLocks(holder2.txn_id()).empty());
 }
@@ -40,12 +40,12 @@ TEST(OldLockManager, WriteLocks) {
   auto holder1 = MakeTestTxnHolder(configs[0], 100, {{"writeA", KeyType::WRITE, 0}, {"writeB", KeyType::WRITE, 0}});
   auto holder2 = MakeTestTxnHolder(configs[0], 200, {{"readA", KeyType::READ, 0}, {"writeA", KeyType::WRITE, 0}});
 
-  ASSERT_EQ(lock_manager.AcquireLocks(holder1.lock_only_txn(0)), AcquireLocksResult::ACQUIRED);
-  ASSERT_EQ(lock_manager.AcquireLocks(holder2.lock_only_txn(0)), AcquireLocksResult::WAITING);
+  ASSERT_EQ(lock_manager.AcquireLocks(holder1.flat_lock_only_txn(0)), AcquireLocksResult::ACQUIRED);
+  ASSERT_EQ(lock_manager.AcquireLocks(holder2.flat_lock_only_txn(0)), AcquireLocksResult::WAITING);
   // The blocked txn becomes ready
   ASSERT_EQ(lock_manager.ReleaseLocks(holder1.txn_id()).size(), 1U);
   // Make sure the lock is already held by holder2
-  ASSERT_EQ(lock_manager.AcquireLocks(holder1.lock_only_txn(0)), AcquireLocksResult::WAITING);
+  ASSERT_EQ(lock_manager.AcquireLocks(holder1.flat_lock_only_txn(0)), AcquireLocksResult::WAITING);
 }
 
 TEST(OldLockManager, ReleaseLocksAndGetManyNewHolders) {
@@ -57,10 +57,10 @@ TEST(OldLockManager, ReleaseLocksAndGetManyNewHolders) {
   auto holder3 = MakeTestTxnHolder(configs[0], 300, {{"B", KeyType::READ, 0}});
   auto holder4 = MakeTestTxnHolder(configs[0], 400, {{"C", KeyType::READ, 0}});
 
-  ASSERT_EQ(lock_manager.AcquireLocks(holder1.lock_only_txn(0)), AcquireLocksResult::ACQUIRED);
-  ASSERT_EQ(lock_manager.AcquireLocks(holder2.lock_only_txn(0)), AcquireLocksResult::WAITING);
-  ASSERT_EQ(lock_manager.AcquireLocks(holder3.lock_only_txn(0)), AcquireLocksResult::WAITING);
-  ASSERT_EQ(lock_manager.AcquireLocks(holder4.lock_only_txn(0)), AcquireLocksResult::WAITING);
+  ASSERT_EQ(lock_manager.AcquireLocks(holder1.flat_lock_only_txn(0)), AcquireLocksResult::ACQUIRED);
+  ASSERT_EQ(lock_manager.AcquireLocks(holder2.flat_lock_only_txn(0)), AcquireLocksResult::WAITING);
+  ASSERT_EQ(lock_manager.AcquireLocks(holder3.flat_lock_only_txn(0)), AcquireLocksResult::WAITING);
+  ASSERT_EQ(lock_manager.AcquireLocks(holder4.flat_lock_only_txn(0)), AcquireLocksResult::WAITING);
 
   ASSERT_TRUE(lock_manager.ReleaseLocks(holder3.txn_id()).empty());
 
@@ -79,9 +79,9 @@ TEST(OldLockManager, PartiallyAcquiredLocks) {
   auto holder2 = MakeTestTxnHolder(configs[0], 200, {{"A", KeyType::READ, 0}, {"B", KeyType::WRITE, 0}});
   auto holder3 = MakeTestTxnHolder(configs[0], 300, {{"A", KeyType::WRITE, 0}, {"C", KeyType::WRITE, 0}});
 
-  ASSERT_EQ(lock_manager.AcquireLocks(holder1.lock_only_txn(0)), AcquireLocksResult::ACQUIRED);
-  ASSERT_EQ(lock_manager.AcquireLocks(holder2.lock_only_txn(0)), AcquireLocksResult::WAITING);
-  ASSERT_EQ(lock_manager.AcquireLocks(holder3.lock_only_txn(0)), AcquireLocksResult::WAITING);
+  ASSERT_EQ(lock_manager.AcquireLocks(holder1.flat_lock_only_txn(0)), AcquireLocksResult::ACQUIRED);
+  ASSERT_EQ(lock_manager.AcquireLocks(holder2.flat_lock_only_txn(0)), AcquireLocksResult::WAITING);
+  ASSERT_EQ(lock_manager.AcquireLocks(holder3.flat_lock_only_txn(0)), AcquireLocksResult::WAITING);
 
   auto ready_txns = lock_manager.ReleaseLocks(holder1.txn_id());
   ASSERT_THAT(ready_txns, ElementsAre(200));
@@ -97,9 +97,9 @@ TEST(OldLockManager, AcquireLocksWithLockOnlyholder1) {
       MakeTestTxnHolder(configs[0], 100, {{"A", KeyType::READ, 0}, {"B", KeyType::WRITE, 0}, {"C", KeyType::WRITE, 0}});
   auto holder2 = MakeTestTxnHolder(configs[0], 200, {{"A", KeyType::READ, 2}, {"B", KeyType::WRITE, 1}});
 
-  ASSERT_EQ(lock_manager.AcquireLocks(holder2.lock_only_txn(1)), AcquireLocksResult::WAITING);
-  ASSERT_EQ(lock_manager.AcquireLocks(holder1.lock_only_txn(0)), AcquireLocksResult::WAITING);
-  ASSERT_EQ(lock_manager.AcquireLocks(holder2.lock_only_txn(2)), AcquireLocksResult::ACQUIRED);
+  ASSERT_EQ(lock_manager.AcquireLocks(holder2.flat_lock_only_txn(1)), AcquireLocksResult::WAITING);
+  ASSERT_EQ(lock_manager.AcquireLocks(holder1.flat_lock_only_txn(0)), AcquireLocksResult::WAITING);
+  ASSERT_EQ(lock_manager.AcquireLocks(holder2.flat_lock_only_txn(2)), AcquireLocksResult::ACQUIRED);
 
   auto ready_txns = lock_manager.ReleaseLocks(holder2.txn_id());
   ASSERT_THAT(ready_txns, ElementsAre(100));
@@ -112,9 +112,9 @@ TEST(OldLockManager, AcquireLocksWithLockOnlyholder2) {
       MakeTestTxnHolder(configs[0], 100, {{"A", KeyType::READ, 0}, {"B", KeyType::WRITE, 0}, {"C", KeyType::WRITE, 0}});
   auto holder2 = MakeTestTxnHolder(configs[0], 200, {{"A", KeyType::READ, 2}, {"B", KeyType::WRITE, 1}});
 
-  ASSERT_EQ(lock_manager.AcquireLocks(holder1.lock_only_txn(0)), AcquireLocksResult::ACQUIRED);
-  ASSERT_EQ(lock_manager.AcquireLocks(holder2.lock_only_txn(1)), AcquireLocksResult::WAITING);
-  ASSERT_EQ(lock_manager.AcquireLocks(holder2.lock_only_txn(2)), AcquireLocksResult::WAITING);
+  ASSERT_EQ(lock_manager.AcquireLocks(holder1.flat_lock_only_txn(0)), AcquireLocksResult::ACQUIRED);
+  ASSERT_EQ(lock_manager.AcquireLocks(holder2.flat_lock_only_txn(1)), AcquireLocksResult::WAITING);
+  ASSERT_EQ(lock_manager.AcquireLocks(holder2.flat_lock_only_txn(2)), AcquireLocksResult::WAITING);
 
   auto ready_txns = lock_manager.ReleaseLocks(holder1.txn_id());
   ASSERT_THAT(ready_txns, ElementsAre(200));
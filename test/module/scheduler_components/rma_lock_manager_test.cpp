@@ -16,7 +16,7 @@ TEST(RMALockManagerTest, GetAllLocksOnFirstTry) {
   auto configs = MakeTestConfigurations("locking", 1, 1);
   auto holder = MakeTestTxnHolder(
       configs[0], 100, {{"readA", KeyType::READ, 0}, {"readB", KeyType::READ, 0}, {"writeC", KeyType::WRITE, 0}});
-  ASSERT_EQ(lock_manager.AcquireLocks(holder.lock_only_txn(0)), AcquireLocksResult::ACQUIRED);
+  ASSERT_EQ(lock_manager.AcquireLocks(holder.flat_lock_only_txn(0)), AcquireLocksResult::ACQUIRED);
   auto result = lock_manager.ReleaseLocks(holder.txn_id());
   ASSERT_TRUE(result.empty());
 }
@@ -26,8 +26,8 @@ TEST(RMALockManagerTest, ReadLocks) {
   auto configs = MakeTestConfigurations("locking", 1, 1);
   auto holder1 = MakeTestTxnHolder(configs[0], 100, {{"readA", KeyType::READ, 0}, {"readB", KeyType::READ, 0}});
   auto holder2 = MakeTestTxnHolder(configs[0], 200, {{"readB", KeyType::READ, 0}, {"readC", KeyType::READ, 0}});
-  ASSERT_EQ(lock_manager.AcquireLocks(holder1.lock_only_txn(0)), AcquireLocksResult::ACQUIRED);
-  ASSERT_EQ(lock_manager.AcquireLocks(holder2.lock_only_txn(0)), AcquireLocksResult::ACQUIRED);
+  ASSERT_EQ(lock_manager.AcquireLocks(holder1.flat_lock_only_txn(0)), AcquireLocksResult::ACQUIRED);
+  ASSERT_EQ(lock_manager.AcquireLocks(holder2.flat_lock_only_txn(0)), AcquireLocksResult::ACQUIRED);
   ASSERT_TRUE(lock_manager.ReleaseLocks(holder1.txn_id()).empty());
   ASSERT_TRUE(lock_manager.ReleaseLocks(holder2.txn_id()).empty());
 }
@@ -38,12 +38,12 @@ TEST(RMALockManagerTest, WriteLocks) {
   auto holder1 = MakeTestTxnHolder(configs[0], 100, {{"writeA", KeyType::WRITE, 0}, {"writeB", KeyType::WRITE, 0}});
   auto holder2 = MakeTestTxnHolder(configs[0], 200, {{"readA", KeyType::READ, 0}, {"writeA", KeyType::WRITE, 0}});
 
-  ASSERT_EQ(lock_manager.AcquireLocks(holder1.lock_only_txn(0)), AcquireLocksResult::ACQUIRED);
-  ASSERT_EQ(lock_manager.AcquireLocks(holder2.lock_only_txn(0)), AcquireLocksResult::WAITING);
+  ASSERT_EQ(lock_manager.AcquireLocks(holder1.flat_lock_only_txn(0)), AcquireLocksResult::ACQUIRED);
+  ASSERT_EQ(lock_manager.AcquireLocks(holder2.flat_lock_only_txn(0)), AcquireLocksResult::WAITING);
   // The blocked txn becomes ready
   ASSERT_EQ(lock_manager.ReleaseLocks(holder1.txn_id()).size(), 1U);
   // Make sure the lock is already held by holder2
-  ASSERT_EQ(lock_manager.AcquireLocks(holder1.lock_only_txn(0)), AcquireLocksResult::WAITING);
+  ASSERT_EQ(lock_manager.AcquireLocks(holder1.flat_lock_only_txn(0)), AcquireLocksResult::WAITING);
 }
 
 TEST(RMALockManagerTest, ReleaseLocksAndGetMultipleNewLockHolders) {
@@ -55,10 +55,10 @@ TEST(RMALockManagerTest, ReleaseLocksAndGetMultipleNewLockHolders) {
   auto holder3 = MakeTestTxnHolder(configs[0], 300, {{"B", KeyType::READ, 0}});
   auto holder4 = MakeTestTxnHolder(configs[0], 400, {{"C", KeyType::READ, 0}});
 
-  ASSERT_EQ(lock_manager.AcquireLocks(holder1.lock_only_txn(0)), AcquireLocksResult::ACQUIRED);
-  ASSERT_EQ(lock_manager.AcquireLocks(holder2.lock_only_txn(0)), AcquireLocksResult::WAITING);
-  ASSERT_EQ(lock_manager.AcquireLocks(holder3.lock_only_txn(0)), AcquireLocksResult::WAITING);
-  ASSERT_EQ(lock_manager.AcquireLocks(holder4.lock_only_txn(0)), AcquireLocksResult::WAITING);
+  ASSERT_EQ(lock_manager.AcquireLocks(holder1.flat_lock_only_txn(0)), AcquireLocksResult::ACQUIRED);
+  ASSERT_EQ(lock_manager.AcquireLocks(holder2.flat_lock_only_txn(0)), AcquireLocksResult::WAITING);
+  ASSERT_EQ(lock_manager.AcquireLocks(holder3.flat_lock_only_txn(0)), AcquireLocksResult::WAITING);
+  ASSERT_EQ(lock_manager.AcquireLocks(holder4.flat_lock_only_txn(0)), AcquireLocksResult::WAITING);
 
   ASSERT_TRUE(lock_manager.ReleaseLocks(holder3.txn_id()).empty());
 
@@ -76,9 +76,9 @@ TEST(RMALockManagerTest, PartiallyAcquiredLocks) {
   auto holder2 = MakeTestTxnHolder(configs[0], 200, {{"A", KeyType::READ, 0}, {"B", KeyType::WRITE, 0}});
   auto holder3 = MakeTestTxnHolder(configs[0], 300, {{"A", KeyType::WRITE, 0}, {"C", KeyType::WRITE, 0}});
 
-  ASSERT_EQ(lock_manager.AcquireLocks(holder1.lock_only_txn(0)), AcquireLocksResult::ACQUIRED);
-  ASSERT_EQ(lock_manager.AcquireLocks(holder2.lock_only_txn(0)), AcquireLocksResult::WAITING);
-  ASSERT_EQ(lock_manager.AcquireLocks(holder3.lock_only_txn(0)), AcquireLocksResult::WAITING);
+  ASSERT_EQ(lock_manager.AcquireLocks(holder1.flat_lock_only_txn(0)), AcquireLocksResult::ACQUIRED);
+  ASSERT_EQ(lock_manager.AcquireLocks(holder2.flat_lock_only_txn(0)), AcquireLocksResult::WAITING);
+  ASSERT_EQ(lock_manager.AcquireLocks(holder3.flat_lock_only_txn(0)), AcquireLocksResult::WAITING);
 
   auto result = lock_manager.ReleaseLocks(holder1.txn_id());
   ASSERT_THAT(result, ElementsAre(200));
@@ -94,9 +94,9 @@ TEST(RMALockManagerTest, AcquireLocksWithLockOnly1) {
       MakeTestTxnHolder(configs[0], 100, {{"A", KeyType::READ, 0}, {"B", KeyType::WRITE, 0}, {"C", KeyType::WRITE, 0}});
   auto holder2 = MakeTestTxnHolder(configs[0], 200, {{"A", KeyType::READ, 1}, {"B", KeyType::WRITE, 0}});
 
-  ASSERT_EQ(lock_manager.AcquireLocks(holder2.lock_only_txn(0)), AcquireLocksResult::WAITING);
-  ASSERT_EQ(lock_manager.AcquireLocks(holder1.lock_only_txn(0)), AcquireLocksResult::WAITING);
-  ASSERT_EQ(lock_manager.AcquireLocks(holder2.lock_only_txn(1)), AcquireLocksResult::ACQUIRED);
+  ASSERT_EQ(lock_manager.AcquireLocks(holder2.flat_lock_only_txn(0)), AcquireLocksResult::WAITING);
+  ASSERT_EQ(lock_manager.AcquireLocks(holder1.flat_lock_only_txn(0)), AcquireLocksResult::WAITING);
+  ASSERT_EQ(lock_manager.AcquireLocks(holder2.flat_lock_only_txn(1)), AcquireLocksResult::ACQUIRED);
 
   auto result = lock_manager.ReleaseLocks(holder2.txn_id());
   ASSERT_THAT(result, ElementsAre(100));
@@ -109,9 +109,9 @@ TEST(RMALockManagerTest, AcquireLocksWithLockOnly2) {
       MakeTestTxnHolder(configs[0], 100, {{"A", KeyType::READ, 0}, {"B", KeyType::WRITE, 0}, {"C", KeyType::WRITE, 0}});
   auto holder2 = MakeTestTxnHolder(configs[0], 200, {{"A", KeyType::READ, 1}, {"B", KeyType::WRITE, 0}});
 
-  ASSERT_EQ(lock_manager.AcquireLocks(holder2.lock_only_txn(1)), AcquireLocksResult::WAITING);
-  ASSERT_EQ(lock_manager.AcquireLocks(holder1.lock_only_txn(0)), AcquireLocksResult::ACQUIRED);
-  ASSERT_EQ(lock_manager.AcquireLocks(holder2.lock_only_txn(0)), AcquireLocksResult::WAITING);
+  ASSERT_EQ(lock_manager.AcquireLocks(holder2.flat_lock_only_txn(1)), AcquireLocksResult::WAITING);
+  ASSERT_EQ(lock_manager.AcquireLocks(holder1.flat_lock_only_txn(0)), AcquireLocksResult::ACQUIRED);
+  ASSERT_EQ(lock_manager.AcquireLocks(holder2.flat_lock_only_txn(0)), AcquireLocksResult::WAITING);
 
   auto result = lock_manager.ReleaseLocks(holder1.txn_id());
   ASSERT_THAT(result, ElementsAre(200));
@@ -123,8 +123,27 @@ TEST(RMALockManagerTest, KeyReplicaLocks) {
   auto holder1 = MakeTestTxnHolder(configs[0], 100, {{"writeA", KeyType::WRITE, 2}, {"writeB", KeyType::WRITE, 2}});
   auto holder2 = MakeTestTxnHolder(configs[0], 200, {{"readA", KeyType::READ, 1}, {"writeA", KeyType::WRITE, 1}});
 
-  ASSERT_EQ(lock_manager.AcquireLocks(holder1.lock_only_txn(2)), AcquireLocksResult::ACQUIRED);
-  ASSERT_EQ(lock_manager.AcquireLocks(holder2.lock_only_txn(1)), AcquireLocksResult::ACQUIRED);
+  ASSERT_EQ(lock_manager.AcquireLocks(holder1.flat_lock_only_txn(2)), AcquireLocksResult::ACQUIRED);
+  ASSERT_EQ(lock_manager.AcquireLocks(holder2.flat_lock_only_txn(1)), AcquireLocksResult::ACQUIRED);
+}
+
+TEST(RMALockManagerTest, NumericKeys) {
+  RMALockManager<uint64_t> lock_manager;
+  internal::Configuration internal_config;
+  internal_config.set_num_partitions(1);
+  internal_config.mutable_simple_partitioning();
+  internal_config.add_replicas()->add_addresses("/tmp/test_locking0");
+  auto config = make_shared<Configuration>(internal_config, "/tmp/test_locking0");
+  auto holder1 = MakeTestTxnHolder(config, 100, {{"1", KeyType::WRITE, 0}, {"20", KeyType::READ, 0}});
+  auto holder2 = MakeTestTxnHolder(config, 200, {{"20", KeyType::READ, 0}, {"300", KeyType::WRITE, 0}});
+  auto holder3 = MakeTestTxnHolder(config, 300, {{"1", KeyType::READ, 0}});
+  ASSERT_TRUE(holder1.flat_lock_only_txn(0).has_numeric_keys());
+
+  ASSERT_EQ(lock_manager.AcquireLocks(holder1.flat_lock_only_txn(0)), AcquireLocksResult::ACQUIRED);
+  ASSERT_EQ(lock_manager.AcquireLocks(holder2.flat_lock_only_txn(0)), AcquireLocksResult::ACQUIRED);
+  ASSERT_EQ(lock_manager.AcquireLocks(holder3.flat_lock_only_txn(0)), AcquireLocksResult::WAITING);
+  ASSERT_TRUE(lock_manager.ReleaseLocks(holder2.txn_id()).empty());
+  ASSERT_THAT(lock_manager.ReleaseLocks(holder1.txn_id()), ElementsAre(300));
 }
 
 #ifdef REMASTER_PROTOCOL_COUNTERLESS
@@ -133,12 +152,12 @@ TEST(RMALockManagerTest, RemasterTxn) {
   auto configs = MakeTestConfigurations("locking", 3, 1);
   auto holder = MakeTestTxnHolder(configs[0], 100, {{"A", KeyType::WRITE, 2}}, 1 /* new_master */);
 
-  ASSERT_EQ(lock_manager.AcquireLocks(holder.lock_only_txn(1)), AcquireLocksResult::WAITING);
-  ASSERT_EQ(lock_manager.AcquireLocks(holder.lock_only_txn(2)), AcquireLocksResult::ACQUIRED);
+  ASSERT_EQ(lock_manager.AcquireLocks(holder.flat_lock_only_txn(1)), AcquireLocksResult::WAITING);
+  ASSERT_EQ(lock_manager.AcquireLocks(holder.flat_lock_only_txn(2)), AcquireLocksResult::ACQUIRED);
   lock_manager.ReleaseLocks(holder.txn_id());
 
-  ASSERT_EQ(lock_manager.AcquireLocks(holder.lock_only_txn(2)), AcquireLocksResult::WAITING);
-  ASSERT_EQ(lock_manager.AcquireLocks(holder.lock_only_txn(1)), AcquireLocksResult::ACQUIRED);
+  ASSERT_EQ(lock_manager.AcquireLocks(holder.flat_lock_only_txn(2)), AcquireLocksResult::WAITING);
+  ASSERT_EQ(lock_manager.AcquireLocks(holder.flat_lock_only_txn(1)), AcquireLocksResult::ACQUIRED);
   lock_manager.ReleaseLocks(holder.txn_id());
 }
 #endif
\ No newline at end of file
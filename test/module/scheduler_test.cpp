@@ -1,5 +1,7 @@
 #include <gtest/gtest.h>
 
+#include <optional>
+#include <thread>
 #include <vector>
 
 #include "common/proto_utils.h"
@@ -421,8 +423,76 @@ TEST_F(SchedulerTest, AbortMultiHomeMultiPartition2Active) {
   ASSERT_EQ(output_txn.status(), TransactionStatus::ABORTED);
 }
 
+class SchedulerStablePositionTest : public ::testing::Test {
+ protected:
+  void SetUp() {
+    internal::Configuration common_config;
+    common_config.mutable_multi_version_storage();
+    auto configs = MakeTestConfigurations("scheduler_stable", 1 /* num_replicas */, 1 /* num_partitions */,
+                                          common_config);
+    // Long enough for the txns to be done well before their writes are durable
+    wal = make_shared<WriteAheadLog>(directory.path(), 500ms);
+
+    test_slog = make_unique<TestSlog>(configs[0]);
+    test_slog->AddScheduler(wal);
+    sender = test_slog->NewSender();
+    test_slog->AddOutputChannel(kServerChannel);
+    test_slog->Data("A", {"valueA", 0, 1});
+    test_slog->StartInNewThreads();
+  }
+
+  void SendTransaction(Transaction* txn) {
+    internal::Envelope env;
+    env.mutable_request()->mutable_forward_txn()->set_allocated_txn(txn);
+    sender->Send(env, 0, kSchedulerChannel);
+  }
+
+  TempDirectory directory{"slog_scheduler_test"};
+  shared_ptr<WriteAheadLog> wal;
+  unique_ptr<TestSlog> test_slog;
+  unique_ptr<Sender> sender;
+};
+
+TEST_F(SchedulerStablePositionTest, PublishedOnlyAfterWritesAreDurable) {
+  auto storage = test_slog->multi_version_storage();
+  SendTransaction(
+      MakeTestTransaction(test_slog->config(), 1000, {{"A", KeyType::WRITE, {{0, 1}}}}, "SET A newA", 0));
+
+  for (int i = 0; i < 1000 && wal->last_lsn() < 1; i++) {
+    this_thread::sleep_for(1ms);
+  }
+  ASSERT_EQ(wal->last_lsn(), 1U);
+
+  // The write has been applied to the storage but a snapshot must not see it before it is durable.
+  // The stable position is read first so that it is checked only if the write was not durable then
+  auto stable_position = storage->stable_position();
+  if (wal->durable_lsn() < 1) {
+    ASSERT_EQ(stable_position, 0U);
+  }
+
+  // The result is held back until the write is durable
+  auto env = test_slog->ReceiveFromOutputChannel(kServerChannel);
+  ASSERT_NE(env, nullptr);
+  ASSERT_EQ(env->request().completed_subtxn().txn().status(), TransactionStatus::COMMITTED);
+  ASSERT_GE(wal->durable_lsn(), 1U);
+
+  for (int i = 0; i < 1000 && storage->stable_position() < 1; i++) {
+    this_thread::sleep_for(1ms);
+  }
+  ASSERT_EQ(storage->stable_position(), 1U);
+
+  auto position = storage->AcquireSnapshot();
+  ASSERT_EQ(position, 1U);
+  vector<optional<Record>> records;
+  Key key = "A";
+  storage->MultiReadAt({&key}, *position, records);
+  storage->ReleaseSnapshot(*position);
+  ASSERT_TRUE(records[0].has_value());
+  ASSERT_EQ(records[0]->to_string(), "newA");
+}
+
 int main(int argc, char* argv[]) {
   ::testing::InitGoogleTest(&argc, argv);
   google::InstallFailureSignalHandler();
   return RUN_ALL_TESTS();
-}
\ No newline at end of file
+}
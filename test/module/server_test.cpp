@@ -0,0 +1,119 @@
+#include "module/server.h"
+
+#include <gtest/gtest.h>
+
+#include "common/configuration.h"
+#include "common/constants.h"
+#include "common/proto_utils.h"
+#include "test/test_utils.h"
+
+using namespace std;
+using namespace slog;
+
+TEST(ValidateTransactionTest, NoKey) {
+  auto config = MakeTestConfigurations("validate", 1, 1)[0];
+  auto txn = MakeTransaction({}, "");
+  ValidateTransaction(config, txn);
+  ASSERT_EQ(txn->status(), TransactionStatus::ABORTED);
+  ASSERT_EQ(txn->abort_reason(), "Txn accesses no key");
+  delete txn;
+}
+
+TEST(ValidateTransactionTest, ReadOnlyTxnWritesKey) {
+  auto config = MakeTestConfigurations("validate", 1, 1)[0];
+  auto txn = MakeTransaction({{"A", KeyType::READ}, {"B", KeyType::WRITE}}, "SET B b");
+  ValidateTransaction(config, txn);
+  ASSERT_EQ(txn->status(), TransactionStatus::NOT_STARTED);
+
+  txn->set_read_only(true);
+  ValidateTransaction(config, txn);
+  ASSERT_EQ(txn->status(), TransactionStatus::ABORTED);
+  ASSERT_EQ(txn->abort_reason(), "Read-only txn writes key B");
+  delete txn;
+}
+
+TEST(ValidateTransactionTest, NonNumericKeyWithSimplePartitioning) {
+  internal::Configuration internal_config;
+  internal_config.set_num_partitions(1);
+  internal_config.mutable_simple_partitioning();
+  internal_config.add_replicas()->add_addresses("/tmp/test_validate0");
+  auto config = make_shared<Configuration>(internal_config, "/tmp/test_validate0");
+
+  for (auto key : {"5", "0", "123456789"}) {
+    auto txn = MakeTransaction({{key, KeyType::WRITE}}, "");
+    ValidateTransaction(config, txn);
+    ASSERT_EQ(txn->status(), TransactionStatus::NOT_STARTED) << key;
+    delete txn;
+  }
+  for (auto key : {"-5", " 5", "12abc", "007", ""}) {
+    auto txn = MakeTransaction({{key, KeyType::WRITE}}, "");
+    ValidateTransaction(config, txn);
+    ASSERT_EQ(txn->status(), TransactionStatus::ABORTED) << key;
+    ASSERT_EQ(txn->abort_reason(), "Key " + string(key) + " is not a decimal integer without leading zeros");
+    delete txn;
+  }
+}
+
+class ServerReadOnlyTest : public ::testing::Test {
+ protected:
+  void SetUp() {
+    internal::Configuration common_config;
+    common_config.mutable_multi_version_storage();
+    // "A" is in partition 0 and "B" is in partition 1
+    auto configs = MakeTestConfigurations("server", 1 /* num_replicas */, 2 /* num_partitions */, common_config);
+    test_slog = make_unique<TestSlog>(configs[0]);
+    test_slog->AddServerAndClient();
+    test_slog->AddOutputChannel(kForwarderChannel);
+    test_slog->Data("A", {"valueA", 0, 1});
+    test_slog->StartInNewThreads();
+  }
+
+  Transaction SendReadOnlyTxn(const Key& key, optional<LogPosition> position = {}) {
+    auto txn = MakeTransaction({{key, KeyType::READ}}, "GET " + key);
+    txn->set_read_only(true);
+    if (position.has_value()) {
+      txn->set_snapshot_position(*position);
+    }
+    test_slog->SendTxn(txn);
+    return test_slog->RecvTxnResult();
+  }
+
+  unique_ptr<TestSlog> test_slog;
+};
+
+TEST_F(ServerReadOnlyTest, ReadsAtStablePosition) {
+  auto result = SendReadOnlyTxn("A");
+  ASSERT_EQ(result.status(), TransactionStatus::COMMITTED);
+  ASSERT_EQ(result.keys().at("A").value(), "valueA");
+  ASSERT_EQ(result.snapshot_position(), 0U);
+
+  // A write at a position that is not stable yet is not visible
+  auto storage = test_slog->multi_version_storage();
+  Key key = "A";
+  storage->ReadModifyWriteAt({&key}, [](size_t, Record& record, bool) { record.SetValue("newA"); }, 1);
+  result = SendReadOnlyTxn("A");
+  ASSERT_EQ(result.keys().at("A").value(), "valueA");
+  ASSERT_EQ(result.snapshot_position(), 0U);
+
+  storage->SetStablePosition(1);
+  result = SendReadOnlyTxn("A");
+  ASSERT_EQ(result.keys().at("A").value(), "newA");
+  ASSERT_EQ(result.snapshot_position(), 1U);
+}
+
+TEST_F(ServerReadOnlyTest, SnapshotNotAvailable) {
+  auto result = SendReadOnlyTxn("A", 5);
+  ASSERT_EQ(result.status(), TransactionStatus::ABORTED);
+  ASSERT_EQ(result.abort_reason(), "Snapshot at log position 5 is not available");
+}
+
+TEST_F(ServerReadOnlyTest, RemoteKeyIsForwarded) {
+  auto txn = MakeTransaction({{"B", KeyType::READ}}, "GET B");
+  txn->set_read_only(true);
+  test_slog->SendTxn(txn);
+
+  auto env = test_slog->ReceiveFromOutputChannel(kForwarderChannel);
+  ASSERT_NE(env, nullptr);
+  ASSERT_EQ(env->request().type_case(), internal::Request::kForwardTxn);
+  ASSERT_TRUE(env->request().forward_txn().txn().read_only());
+}
@@ -0,0 +1,236 @@
+#include "storage/log_structured_storage.h"
+
+#include <gtest/gtest.h>
+
+#include "common/types.h"
+#include "test/test_utils.h"
+
+using namespace std;
+using namespace slog;
+
+class LogStructuredStorageTest : public ::testing::Test {
+ protected:
+  void SetUp() {
+    options_.directory = directory_.path();
+    options_.segment_size_bytes = 4096;
+    // Effectively disable background compaction so that it can be triggered manually
+    options_.compaction_interval = 1h;
+  }
+
+  TempDirectory directory_{"slog_lss_test"};
+  LogStructuredStorage::Options options_;
+};
+
+TEST_F(LogStructuredStorageTest, ReadWriteDelete) {
+  LogStructuredStorage storage(options_);
+  Record record;
+  ASSERT_FALSE(storage.Read("key1", record));
+
+  storage.Write("key1", Record("value1", 1, 2));
+  ASSERT_TRUE(storage.Read("key1", record));
+  ASSERT_EQ(record.to_string(), "value1");
+  ASSERT_EQ(record.metadata.master, 1U);
+  ASSERT_EQ(record.metadata.counter, 2U);
+
+  Metadata metadata;
+  ASSERT_TRUE(storage.GetMasterMetadata("key1", metadata));
+  ASSERT_EQ(metadata.master, 1U);
+  ASSERT_EQ(metadata.counter, 2U);
+
+  storage.Write("key1", Record("value2", 0));
+  ASSERT_TRUE(storage.Read("key1", record));
+  ASSERT_EQ(record.to_string(), "value2");
+  ASSERT_EQ(storage.num_keys(), 1U);
+
+  ASSERT_TRUE(storage.Delete("key1"));
+  ASSERT_FALSE(storage.Read("key1", record));
+  ASSERT_FALSE(storage.GetMasterMetadata("key1", metadata));
+  ASSERT_FALSE(storage.Delete("key1"));
+  ASSERT_EQ(storage.num_keys(), 0U);
+}
+
+TEST_F(LogStructuredStorageTest, ReadWithoutCache) {
+  options_.memory_budget_bytes = 0;
+  LogStructuredStorage storage(options_);
+  for (int i = 0; i < 1000; i++) {
+    storage.Write(to_string(i), Record("value" + to_string(i), i % 3));
+  }
+  // Some values are still in the write buffer and some are already in the segment files
+  for (int i = 0; i < 1000; i++) {
+    Record record;
+    ASSERT_TRUE(storage.Read(to_string(i), record));
+    ASSERT_EQ(record.to_string(), "value" + to_string(i));
+    ASSERT_EQ(record.metadata.master, static_cast<uint32_t>(i % 3));
+  }
+}
+
+TEST_F(LogStructuredStorageTest, Recover) {
+  {
+    LogStructuredStorage storage(options_);
+    for (int i = 0; i < 1000; i++) {
+      storage.Write(to_string(i), Record("foo", 0));
+    }
+    for (int i = 0; i < 1000; i += 2) {
+      storage.Write(to_string(i), Record("bar" + to_string(i), 1, 1));
+    }
+    for (int i = 0; i < 1000; i += 3) {
+      storage.Delete(to_string(i));
+    }
+  }
+
+  LogStructuredStorage storage(options_);
+  for (int i = 0; i < 1000; i++) {
+    Record record;
+    if (i % 3 == 0) {
+      ASSERT_FALSE(storage.Read(to_string(i), record));
+    } else if (i % 2 == 0) {
+      ASSERT_TRUE(storage.Read(to_string(i), record));
+      ASSERT_EQ(record.to_string(), "bar" + to_string(i));
+      ASSERT_EQ(record.metadata.master, 1U);
+      ASSERT_EQ(record.metadata.counter, 1U);
+    } else {
+      ASSERT_TRUE(storage.Read(to_string(i), record));
+      ASSERT_EQ(record.to_string(), "foo");
+    }
+  }
+}
+
+TEST_F(LogStructuredStorageTest, Compact) {
+  {
+    LogStructuredStorage storage(options_);
+    for (int round = 0; round < 10; round++) {
+      for (int i = 0; i < 100; i++) {
+        storage.Write(to_string(i), Record(to_string(round), 0));
+      }
+    }
+    for (int i = 0; i < 100; i += 10) {
+      storage.Delete(to_string(i));
+    }
+    auto num_segments_before = storage.num_segments();
+    storage.Flush();
+    storage.Compact();
+    ASSERT_LT(storage.num_segments(), num_segments_before);
+
+    for (int i = 0; i < 100; i++) {
+      Record record;
+      if (i % 10 == 0) {
+        ASSERT_FALSE(storage.Read(to_string(i), record));
+      } else {
+        ASSERT_TRUE(storage.Read(to_string(i), record));
+        ASSERT_EQ(record.to_string(), "9");
+      }
+    }
+  }
+
+  // Deleted keys must not be resurrected by the recovery after compaction
+  LogStructuredStorage storage(options_);
+  ASSERT_EQ(storage.num_keys(), 90U);
+  for (int i = 0; i < 100; i++) {
+    Record record;
+    if (i % 10 == 0) {
+      ASSERT_FALSE(storage.Read(to_string(i), record));
+    } else {
+      ASSERT_TRUE(storage.Read(to_string(i), record));
+      ASSERT_EQ(record.to_string(), "9");
+    }
+  }
+}
+
+TEST_F(LogStructuredStorageTest, CompactDropsTombstones) {
+  // Each value fills a segment on its own
+  string large_value(4000, 'a');
+  {
+    LogStructuredStorage storage(options_);
+    // These segments are never compacted since their entries stay live
+    for (int i = 0; i < 5; i++) {
+      storage.Write("live" + to_string(i), Record(large_value, 0));
+    }
+    for (int i = 0; i < 5; i++) {
+      storage.Write("deleted" + to_string(i), Record(large_value, 0));
+    }
+    // The tombstones share one segment, which is sealed by the following writes
+    for (int i = 0; i < 5; i++) {
+      storage.Delete("deleted" + to_string(i));
+    }
+    for (int i = 0; i < 2; i++) {
+      storage.Write("more" + to_string(i), Record(large_value, 0));
+    }
+    ASSERT_EQ(storage.num_segments(), 13U);
+
+    // The segments of the deleted values are compacted first, after which no older
+    // segment holds the deleted keys so the tombstones are not moved forward
+    storage.Flush();
+    storage.Compact();
+    ASSERT_EQ(storage.num_segments(), 7U);
+  }
+
+  LogStructuredStorage storage(options_);
+  ASSERT_EQ(storage.num_keys(), 7U);
+  for (int i = 0; i < 5; i++) {
+    Record record;
+    ASSERT_FALSE(storage.Read("deleted" + to_string(i), record));
+  }
+}
+
+TEST_F(LogStructuredStorageTest, CompressedValues) {
+  {
+    LogStructuredStorage storage(options_);
+    Record compressed;
+    for (int round = 0; round < 10; round++) {
+      for (int i = 0; i < 100; i++) {
+        compressed.SetValue(to_string(round), i % 2 == 0 /* compressed */);
+        storage.Write(to_string(i), compressed);
+      }
+    }
+    storage.Flush();
+    storage.Compact();
+  }
+
+  // The flag survives both compaction and recovery
+  options_.memory_budget_bytes = 0;
+  LogStructuredStorage storage(options_);
+  for (int i = 0; i < 100; i++) {
+    Record record;
+    ASSERT_TRUE(storage.Read(to_string(i), record));
+    ASSERT_EQ(record.to_string(), "9");
+    ASSERT_EQ(record.compressed(), i % 2 == 0);
+  }
+}
+
+TEST_F(LogStructuredStorageTest, Prefetch) {
+  {
+    LogStructuredStorage storage(options_);
+    for (int i = 0; i < 100; i++) {
+      storage.Write(to_string(i), Record("value" + to_string(i), 0));
+    }
+  }
+
+  // The cache starts empty after recovery so every value has to be read from disk
+  LogStructuredStorage storage(options_);
+  vector<Key> keys;
+  for (int i = 0; i < 50; i++) {
+    keys.push_back(to_string(i));
+  }
+  keys.push_back("missing");
+  vector<const Key*> key_ptrs;
+  for (const auto& key : keys) {
+    key_ptrs.push_back(&key);
+  }
+
+  storage.Prefetch(key_ptrs);
+  for (int i = 0; i < 1000 && storage.num_prefetched() < 50; i++) {
+    this_thread::sleep_for(10ms);
+  }
+  ASSERT_EQ(storage.num_prefetched(), 50U);
+
+  // Values that are already cached are not read again
+  storage.Prefetch(key_ptrs);
+  this_thread::sleep_for(100ms);
+  ASSERT_EQ(storage.num_prefetched(), 50U);
+
+  Record record;
+  for (int i = 0; i < 100; i++) {
+    ASSERT_TRUE(storage.Read(to_string(i), record));
+    ASSERT_EQ(record.to_string(), "value" + to_string(i));
+  }
+}
@@ -17,4 +17,120 @@ TEST(MemOnlyStorageTest, ReadWriteTest) {
   bool ok = storage.Read(key, ret);
   ASSERT_TRUE(ok);
   ASSERT_EQ(value, ret.to_string());
-}
\ No newline at end of file
+}
+
+TEST(MemOnlyStorageTest, WriteBatchTest) {
+  MemOnlyStorage<Key, Record, Metadata> storage;
+  std::vector<std::pair<Key, Record>> records;
+  for (int i = 0; i < 1000; i++) {
+    records.emplace_back(std::to_string(i), Record("value" + std::to_string(i), i % 2));
+  }
+  storage.WriteBatch(records);
+
+  for (int i = 0; i < 1000; i++) {
+    Record ret;
+    ASSERT_TRUE(storage.Read(std::to_string(i), ret));
+    ASSERT_EQ(ret.to_string(), "value" + std::to_string(i));
+    ASSERT_EQ(ret.metadata.master, static_cast<uint32_t>(i % 2));
+  }
+}
+
+TEST(MemOnlyStorageTest, MasterMetadataFollowsWrites) {
+  MemOnlyStorage<Key, Record, Metadata> storage;
+  Metadata metadata;
+  ASSERT_FALSE(storage.GetMasterMetadata("key1", metadata));
+
+  storage.Write("key1", Record("value1", 1, 0));
+  ASSERT_TRUE(storage.GetMasterMetadata("key1", metadata));
+  ASSERT_EQ(metadata.master, 1U);
+  ASSERT_EQ(metadata.counter, 0U);
+
+  // Remaster
+  storage.Write("key1", Record("value1", 2, 1));
+  ASSERT_TRUE(storage.GetMasterMetadata("key1", metadata));
+  ASSERT_EQ(metadata.master, 2U);
+  ASSERT_EQ(metadata.counter, 1U);
+
+  storage.WriteBatch({{"key2", Record("value2", 3, 4)}});
+  ASSERT_TRUE(storage.GetMasterMetadata("key2", metadata));
+  ASSERT_EQ(metadata.master, 3U);
+  ASSERT_EQ(metadata.counter, 4U);
+
+  ASSERT_TRUE(storage.Delete("key1"));
+  ASSERT_FALSE(storage.GetMasterMetadata("key1", metadata));
+}
+
+TEST(MemOnlyStorageTest, MultiReadAndReadModifyWrite) {
+  MemOnlyStorage<Key, Record, Metadata> storage;
+  storage.Write("key1", Record("value1", 1));
+
+  std::vector<Key> keys{"key1", "key2"};
+  std::vector<const Key*> key_ptrs{&keys[0], &keys[1]};
+  storage.ReadModifyWrite(key_ptrs, [](size_t i, Record& record, bool exists) {
+    ASSERT_EQ(exists, i == 0);
+    if (!exists) {
+      record.metadata = Metadata(2);
+    }
+    record.SetValue("new" + std::to_string(i));
+  });
+
+  std::vector<std::optional<Record>> records;
+  storage.MultiRead(key_ptrs, records);
+  ASSERT_EQ(records.size(), 2U);
+  ASSERT_EQ(records[0]->to_string(), "new0");
+  ASSERT_EQ(records[0]->metadata.master, 1U);
+  ASSERT_EQ(records[1]->to_string(), "new1");
+  ASSERT_EQ(records[1]->metadata.master, 2U);
+
+  Metadata metadata;
+  ASSERT_TRUE(storage.GetMasterMetadata("key2", metadata));
+  ASSERT_EQ(metadata.master, 2U);
+}
+
+TEST(MemOnlyStorageTest, ScanTest) {
+  MemOnlyStorage<Key, Record, Metadata> unordered_storage;
+  std::vector<std::pair<Key, Record>> records;
+  ASSERT_FALSE(unordered_storage.Scan("a", "z", records));
+
+  MemOnlyStorage<Key, Record, Metadata> storage(true /* ordered */);
+  storage.WriteBatch({{"b", Record("vb", 0)}, {"d", Record("vd", 0)}});
+  storage.Write("a", Record("va", 0));
+  Key c = "c", e = "e";
+  storage.ReadModifyWrite({&c, &e}, [](size_t, Record& record, bool) { record.SetValue("new"); });
+  ASSERT_TRUE(storage.Delete("d"));
+
+  ASSERT_TRUE(storage.Scan("b", "e", records));
+  ASSERT_EQ(records.size(), 2U);
+  ASSERT_EQ(records[0].first, "b");
+  ASSERT_EQ(records[0].second.to_string(), "vb");
+  ASSERT_EQ(records[1].first, "c");
+  ASSERT_EQ(records[1].second.to_string(), "new");
+
+  ASSERT_TRUE(storage.Scan("", "f", records));
+  ASSERT_EQ(records.size(), 4U);
+  ASSERT_EQ(records[3].first, "e");
+}
+TEST(MemOnlyStorageTest, StatsTest) {
+  MemOnlyStorage<Key, Record, Metadata> storage(true /* ordered */);
+  for (int i = 0; i < 100; i++) {
+    storage.Write(std::to_string(i), Record("value", 0));
+  }
+  Key key = "0";
+  storage.ReadModifyWrite({&key}, [](size_t, Record& record, bool) { record.SetValue(std::string("longer value")); });
+  ASSERT_TRUE(storage.Delete("1"));
+
+  StorageStats stats;
+  ASSERT_TRUE(storage.GetStats(stats, false));
+  ASSERT_EQ(stats.num_keys, 99U);
+  ASSERT_EQ(stats.value_bytes, 98U * 5 + 12);
+  ASSERT_GT(stats.index_bytes, 0U);
+  ASSERT_TRUE(stats.segments.empty());
+
+  ASSERT_TRUE(storage.GetStats(stats, true));
+  ASSERT_FALSE(stats.segments.empty());
+  size_t num_keys = 0;
+  for (const auto& segment : stats.segments) {
+    num_keys += segment.num_keys;
+  }
+  ASSERT_EQ(num_keys, 99U);
+}
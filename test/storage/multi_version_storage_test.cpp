@@ -0,0 +1,164 @@
+#include "storage/multi_version_storage.h"
+
+#include <gtest/gtest.h>
+
+#include "common/types.h"
+
+using namespace std;
+using namespace slog;
+
+namespace {
+
+void SetValueAt(MultiVersionStorage& storage, const Key& key, const string& value, LogPosition position) {
+  storage.ReadModifyWriteAt(
+      {&key}, [&value](size_t, Record& record, bool) { record.SetValue(value); }, position);
+}
+
+optional<Record> ReadAt(const MultiVersionStorage& storage, const Key& key, LogPosition position) {
+  vector<optional<Record>> records;
+  storage.MultiReadAt({&key}, position, records);
+  return records[0];
+}
+
+}  // namespace
+
+TEST(MultiVersionStorageTest, ReadAtSnapshots) {
+  MultiVersionStorage storage(10 /* snapshot_retention */);
+  storage.Write("A", Record("a0", 1));
+
+  SetValueAt(storage, "A", "a1", 1);
+  SetValueAt(storage, "B", "b2", 2);
+  ASSERT_TRUE(storage.DeleteAt("A", 3));
+  ASSERT_FALSE(storage.DeleteAt("C", 3));
+  // Deleting a key that does not exist does not insert it
+  StorageStats stats;
+  storage.GetStats(stats, false);
+  ASSERT_EQ(stats.num_keys, 2U);
+
+  // The latest versions are visible to normal reads even before they are stable
+  Record record;
+  ASSERT_FALSE(storage.Read("A", record));
+  ASSERT_TRUE(storage.Read("B", record));
+  ASSERT_EQ(record.to_string(), "b2");
+
+  // Nothing is stable yet
+  ASSERT_FALSE(storage.AcquireSnapshot(1).has_value());
+  storage.SetStablePosition(3);
+
+  for (LogPosition position = 0; position <= 3; position++) {
+    ASSERT_EQ(storage.AcquireSnapshot(position), position);
+  }
+  ASSERT_EQ(ReadAt(storage, "A", 0)->to_string(), "a0");
+  ASSERT_EQ(ReadAt(storage, "A", 1)->to_string(), "a1");
+  ASSERT_EQ(ReadAt(storage, "A", 1)->metadata.master, 1U);
+  ASSERT_EQ(ReadAt(storage, "A", 2)->to_string(), "a1");
+  ASSERT_FALSE(ReadAt(storage, "A", 3).has_value());
+  ASSERT_FALSE(ReadAt(storage, "B", 1).has_value());
+  ASSERT_EQ(ReadAt(storage, "B", 2)->to_string(), "b2");
+  ASSERT_FALSE(ReadAt(storage, "C", 3).has_value());
+  for (LogPosition position = 0; position <= 3; position++) {
+    storage.ReleaseSnapshot(position);
+  }
+
+  auto latest = storage.AcquireSnapshot();
+  ASSERT_EQ(latest, 3U);
+  storage.ReleaseSnapshot(*latest);
+}
+
+TEST(MultiVersionStorageTest, OldVersionsAreGarbageCollected) {
+  MultiVersionStorage storage;
+  storage.Write("A", Record("a0", 0));
+
+  // A snapshot keeps the version it reads alive while newer versions are written
+  auto snapshot = storage.AcquireSnapshot();
+  ASSERT_EQ(snapshot, 0U);
+  for (LogPosition position = 1; position <= 10; position++) {
+    SetValueAt(storage, "A", "a" + to_string(position), position);
+    storage.SetStablePosition(position);
+  }
+  ASSERT_EQ(ReadAt(storage, "A", *snapshot)->to_string(), "a0");
+  ASSERT_EQ(ReadAt(storage, "A", 10)->to_string(), "a10");
+
+  // The versions after the oldest snapshot are kept too
+  ASSERT_EQ(storage.AcquireSnapshot(5), 5U);
+  ASSERT_EQ(ReadAt(storage, "A", 5)->to_string(), "a5");
+  storage.ReleaseSnapshot(5);
+
+  // Without retention, only the stable position is readable once the snapshots are released
+  storage.ReleaseSnapshot(*snapshot);
+  ASSERT_FALSE(storage.AcquireSnapshot(0).has_value());
+  ASSERT_FALSE(storage.AcquireSnapshot(9).has_value());
+
+  // Once there is no snapshot left, the next write drops the versions that cannot be read anymore
+  SetValueAt(storage, "A", "a11", 11);
+  ASSERT_FALSE(ReadAt(storage, "A", 0).has_value());
+  ASSERT_FALSE(ReadAt(storage, "A", 9).has_value());
+  ASSERT_EQ(ReadAt(storage, "A", 10)->to_string(), "a10");
+  ASSERT_EQ(ReadAt(storage, "A", 11)->to_string(), "a11");
+}
+
+TEST(MultiVersionStorageTest, SweepCollectsKeysThatAreNotWrittenAgain) {
+  MultiVersionStorage storage;
+  for (int i = 0; i < 100; i++) {
+    storage.Write("K" + to_string(i), Record("v0", 0));
+  }
+  auto snapshot = storage.AcquireSnapshot();
+  for (int i = 0; i < 100; i++) {
+    auto key = "K" + to_string(i);
+    if (i % 2 == 0) {
+      SetValueAt(storage, key, "v1", 1);
+    } else {
+      ASSERT_TRUE(storage.DeleteAt(key, 1));
+    }
+  }
+  storage.SetStablePosition(1);
+
+  // The snapshot still reads the old versions
+  StorageStats stats;
+  storage.GetStats(stats, false);
+  ASSERT_EQ(stats.num_keys, 100U);
+  ASSERT_EQ(stats.value_bytes, 150 * 2U);
+
+  // Once it is released, the keys are swept as the horizon advances without being written again
+  storage.ReleaseSnapshot(*snapshot);
+  for (LogPosition position = 2; position <= 16; position++) {
+    storage.SetStablePosition(position);
+  }
+  storage.GetStats(stats, false);
+  ASSERT_EQ(stats.num_keys, 50U);
+  ASSERT_EQ(stats.value_bytes, 50 * 2U);
+  ASSERT_EQ(ReadAt(storage, "K0", 1)->to_string(), "v1");
+  ASSERT_FALSE(ReadAt(storage, "K1", 1).has_value());
+}
+
+TEST(MultiVersionStorageTest, SnapshotRetention) {
+  MultiVersionStorage storage(5 /* snapshot_retention */);
+  for (LogPosition position = 1; position <= 20; position++) {
+    SetValueAt(storage, "A", "a" + to_string(position), position);
+    storage.SetStablePosition(position);
+  }
+  ASSERT_FALSE(storage.AcquireSnapshot(14).has_value());
+  for (LogPosition position = 15; position <= 20; position++) {
+    auto snapshot = storage.AcquireSnapshot(position);
+    ASSERT_EQ(snapshot, position);
+    ASSERT_EQ(ReadAt(storage, "A", position)->to_string(), "a" + to_string(position));
+    storage.ReleaseSnapshot(*snapshot);
+  }
+}
+
+TEST(MultiVersionStorageTest, WritesWithoutPositionReplaceAllVersions) {
+  MultiVersionStorage storage(10 /* snapshot_retention */);
+  SetValueAt(storage, "A", "a1", 1);
+  storage.SetStablePosition(1);
+  storage.Write("A", Record("a0", 2));
+
+  Metadata metadata;
+  ASSERT_TRUE(storage.GetMasterMetadata("A", metadata));
+  ASSERT_EQ(metadata.master, 2U);
+  ASSERT_EQ(ReadAt(storage, "A", 0)->to_string(), "a0");
+  ASSERT_EQ(ReadAt(storage, "A", 1)->to_string(), "a0");
+
+  ASSERT_TRUE(storage.Delete("A"));
+  ASSERT_FALSE(ReadAt(storage, "A", 1).has_value());
+  ASSERT_FALSE(storage.GetMasterMetadata("A", metadata));
+}
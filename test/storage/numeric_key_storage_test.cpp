@@ -0,0 +1,76 @@
+#include "storage/numeric_key_storage.h"
+
+#include <gtest/gtest.h>
+
+#include <map>
+
+#include "common/types.h"
+
+using namespace slog;
+
+TEST(NumericKeyStorageTest, ReadWriteDelete) {
+  NumericKeyStorage<Record, Metadata> storage;
+  Record record;
+  ASSERT_FALSE(storage.Read("1", record));
+
+  storage.Write("1", Record("value1", 1, 2));
+  ASSERT_TRUE(storage.Read("1", record));
+  ASSERT_EQ(record.to_string(), "value1");
+
+  Metadata metadata;
+  ASSERT_TRUE(storage.GetMasterMetadata("1", metadata));
+  ASSERT_EQ(metadata.master, 1U);
+  ASSERT_EQ(metadata.counter, 2U);
+
+  ASSERT_TRUE(storage.Delete("1"));
+  ASSERT_FALSE(storage.Read("1", record));
+  ASSERT_THROW(storage.Read("key1", record), std::invalid_argument);
+}
+
+TEST(NumericKeyStorageTest, BatchOperations) {
+  NumericKeyStorage<Record, Metadata> storage;
+  std::vector<std::pair<Key, Record>> records;
+  for (int i = 0; i < 1000; i += 2) {
+    records.emplace_back(std::to_string(i), Record("value" + std::to_string(i), 0));
+  }
+  storage.WriteBatch(records);
+
+  std::vector<Key> keys;
+  for (int i = 0; i < 1000; i++) {
+    keys.push_back(std::to_string(i));
+  }
+  std::vector<const Key*> key_ptrs;
+  for (auto& key : keys) {
+    key_ptrs.push_back(&key);
+  }
+  storage.ReadModifyWrite(key_ptrs, [](size_t i, Record& record, bool exists) {
+    ASSERT_EQ(exists, i % 2 == 0);
+    record.SetValue(record.to_string() + "!");
+  });
+
+  std::vector<std::optional<Record>> results;
+  storage.MultiRead(key_ptrs, results);
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_EQ(results[i]->to_string(), (i % 2 == 0 ? "value" + std::to_string(i) : "") + "!");
+  }
+
+  std::map<Key, std::string> visited;
+  storage.ForEach([&visited](const Key& key, const Record& record) { visited[key] = record.to_string(); });
+  ASSERT_EQ(visited.size(), 1000U);
+  ASSERT_EQ(visited["10"], "value10!");
+}
+
+TEST(NumericKeyStorageTest, ScanInNumericOrder) {
+  NumericKeyStorage<Record, Metadata> storage(true /* ordered */);
+  for (int i = 0; i < 200; i += 4) {
+    storage.Write(std::to_string(i), Record("value" + std::to_string(i), 0));
+  }
+
+  std::vector<std::pair<Key, Record>> records;
+  ASSERT_TRUE(storage.Scan("8", "100", records));
+  ASSERT_EQ(records.size(), 23U);
+  for (size_t i = 0; i < records.size(); i++) {
+    ASSERT_EQ(records[i].first, std::to_string(8 + 4 * i));
+    ASSERT_EQ(records[i].second.to_string(), "value" + records[i].first);
+  }
+}
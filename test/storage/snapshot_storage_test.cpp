@@ -0,0 +1,103 @@
+#include "storage/snapshot_storage.h"
+
+#include <gtest/gtest.h>
+
+#include "storage/mem_only_storage.h"
+#include "test/test_utils.h"
+
+using namespace std;
+using namespace slog;
+
+class SnapshotStorageTest : public ::testing::Test {
+ protected:
+  TempDirectory directory_{"slog_snapshot_test"};
+  string path_ = directory_.path() + "/snapshot";
+};
+
+TEST_F(SnapshotStorageTest, ReadFromSnapshot) {
+  MemOnlyStorage<Key, Record, Metadata> mem_storage;
+  for (int i = 0; i < 1000; i++) {
+    mem_storage.Write(to_string(i), Record("value" + to_string(i), i % 3, i % 5));
+  }
+  // Empty values must be preserved too
+  mem_storage.Write("empty", Record("", 0));
+  Record compressed;
+  compressed.SetValue(string("compressed"), true /* compressed */);
+  mem_storage.Write("compressed", compressed);
+
+  SnapshotWriter writer(path_);
+  mem_storage.ForEach([&writer](const Key& key, const Record& record) { writer.Add(key, record); });
+  writer.Finish();
+
+  SnapshotStorage storage(path_);
+  ASSERT_EQ(storage.num_snapshot_records(), 1002U);
+  for (int i = 0; i < 1000; i++) {
+    Record record;
+    ASSERT_TRUE(storage.Read(to_string(i), record));
+    ASSERT_EQ(record.to_string(), "value" + to_string(i));
+    ASSERT_FALSE(record.compressed());
+    ASSERT_EQ(record.metadata.master, static_cast<uint32_t>(i % 3));
+    ASSERT_EQ(record.metadata.counter, static_cast<uint32_t>(i % 5));
+
+    Metadata metadata;
+    ASSERT_TRUE(storage.GetMasterMetadata(to_string(i), metadata));
+    ASSERT_EQ(metadata.master, static_cast<uint32_t>(i % 3));
+  }
+  Record record;
+  ASSERT_TRUE(storage.Read("empty", record));
+  ASSERT_EQ(record.to_string(), "");
+  ASSERT_TRUE(storage.Read("compressed", record));
+  ASSERT_EQ(record.to_string(), "compressed");
+  ASSERT_TRUE(record.compressed());
+  ASSERT_FALSE(storage.Read("1000", record));
+}
+
+TEST_F(SnapshotStorageTest, WriteAndDeleteOverSnapshot) {
+  {
+    SnapshotWriter writer(path_);
+    writer.Add("A", Record("a", 0));
+    writer.Add("B", Record("b", 0));
+    writer.Finish();
+  }
+
+  SnapshotStorage storage(path_);
+  storage.Write("A", Record("aa", 1, 1));
+  storage.Write("C", Record("c", 1));
+  ASSERT_TRUE(storage.Delete("B"));
+  ASSERT_FALSE(storage.Delete("B"));
+  ASSERT_FALSE(storage.Delete("D"));
+
+  Record record;
+  ASSERT_TRUE(storage.Read("A", record));
+  ASSERT_EQ(record.to_string(), "aa");
+  ASSERT_EQ(record.metadata.master, 1U);
+  ASSERT_FALSE(storage.Read("B", record));
+  Metadata metadata;
+  ASSERT_FALSE(storage.GetMasterMetadata("B", metadata));
+  ASSERT_TRUE(storage.Read("C", record));
+  ASSERT_EQ(record.to_string(), "c");
+
+  // A deleted key can be written again
+  storage.Write("B", Record("bb", 0));
+  ASSERT_TRUE(storage.Read("B", record));
+  ASSERT_EQ(record.to_string(), "bb");
+}
+
+TEST_F(SnapshotStorageTest, EmptySnapshot) {
+  SnapshotWriter(path_).Finish();
+  SnapshotStorage storage(path_);
+  ASSERT_EQ(storage.num_snapshot_records(), 0U);
+  ASSERT_EQ(storage.lsn(), 0U);
+  Record record;
+  ASSERT_FALSE(storage.Read("A", record));
+}
+
+TEST_F(SnapshotStorageTest, RecordsLsn) {
+  {
+    SnapshotWriter writer(path_, 42);
+    writer.Add("A", Record("a", 0));
+    writer.Finish();
+  }
+  SnapshotStorage storage(path_);
+  ASSERT_EQ(storage.lsn(), 42U);
+}
@@ -0,0 +1,199 @@
+#include "storage/write_ahead_log.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <filesystem>
+#include <thread>
+
+#include "storage/mem_only_storage.h"
+#include "test/test_utils.h"
+
+using namespace std;
+using namespace slog;
+
+class WriteAheadLogTest : public ::testing::Test {
+ protected:
+  WriteAheadLogRecord MakeRecord(const vector<pair<string, string>>& writes, const vector<string>& deleted_keys = {}) {
+    WriteAheadLogRecord record;
+    for (const auto& [key, value] : writes) {
+      auto datum = record.add_writes();
+      datum->set_key(key);
+      datum->set_record(value);
+      datum->set_master(1);
+      datum->set_counter(2);
+    }
+    for (const auto& key : deleted_keys) {
+      record.add_deleted_keys(key);
+    }
+    return record;
+  }
+
+  void WaitForDurable(const WriteAheadLog& wal, uint64_t lsn) {
+    while (wal.durable_lsn() < lsn) {
+      this_thread::sleep_for(100us);
+    }
+  }
+
+  TempDirectory temp_directory_{"slog_wal_test"};
+  string directory_ = temp_directory_.path();
+};
+
+TEST_F(WriteAheadLogTest, AppendBecomesDurable) {
+  WriteAheadLog wal(directory_, 1000us);
+  ASSERT_EQ(wal.Append(MakeRecord({{"A", "a"}})), 1U);
+  ASSERT_EQ(wal.Append(MakeRecord({{"B", "b"}})), 2U);
+  ASSERT_EQ(wal.last_lsn(), 2U);
+  WaitForDurable(wal, 2);
+  ASSERT_EQ(wal.durable_lsn(), 2U);
+}
+
+TEST_F(WriteAheadLogTest, Replay) {
+  {
+    WriteAheadLog wal(directory_, 1000us);
+    vector<thread> threads;
+    for (int t = 0; t < 4; t++) {
+      threads.emplace_back([&wal, t] {
+        for (int i = 0; i < 100; i++) {
+          WriteAheadLogRecord record;
+          auto datum = record.add_writes();
+          datum->set_key(to_string(t) + "_" + to_string(i));
+          datum->set_record("value" + to_string(i));
+          wal.Append(record);
+        }
+      });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+    wal.Append(MakeRecord({{"0_0", "overwritten"}}, {"1_0"}));
+  }
+
+  MemOnlyStorage<Key, Record, Metadata> storage;
+  WriteAheadLog wal(directory_, 1000us);
+  ASSERT_EQ(wal.Replay(storage), 401U);
+  ASSERT_EQ(wal.last_lsn(), 401U);
+  ASSERT_EQ(wal.durable_lsn(), 401U);
+
+  Record record;
+  ASSERT_TRUE(storage.Read("0_0", record));
+  ASSERT_EQ(record.to_string(), "overwritten");
+  ASSERT_EQ(record.metadata.master, 1U);
+  ASSERT_EQ(record.metadata.counter, 2U);
+  ASSERT_FALSE(storage.Read("1_0", record));
+  ASSERT_TRUE(storage.Read("3_99", record));
+  ASSERT_EQ(record.to_string(), "value99");
+
+  // New records continue after the replayed ones
+  ASSERT_EQ(wal.Append(MakeRecord({{"C", "c"}})), 402U);
+}
+
+TEST_F(WriteAheadLogTest, ReplayTruncatesIncompleteRecord) {
+  {
+    WriteAheadLog wal(directory_, 1000us);
+    wal.Append(MakeRecord({{"A", "a"}}));
+    wal.Append(MakeRecord({{"B", "b"}}));
+  }
+  auto path = directory_ + "/1.wal";
+  std::filesystem::resize_file(path, std::filesystem::file_size(path) - 1);
+
+  {
+    MemOnlyStorage<Key, Record, Metadata> storage;
+    WriteAheadLog wal(directory_, 1000us);
+    ASSERT_EQ(wal.Replay(storage), 1U);
+    Record record;
+    ASSERT_TRUE(storage.Read("A", record));
+    ASSERT_FALSE(storage.Read("B", record));
+    WaitForDurable(wal, wal.Append(MakeRecord({{"C", "c"}})));
+  }
+
+  MemOnlyStorage<Key, Record, Metadata> storage;
+  WriteAheadLog wal(directory_, 1000us);
+  ASSERT_EQ(wal.Replay(storage), 2U);
+  Record record;
+  ASSERT_TRUE(storage.Read("C", record));
+}
+
+TEST_F(WriteAheadLogTest, Segments) {
+  {
+    // Every flush fills a segment
+    WriteAheadLog wal(directory_, 1000us, 1);
+    for (int i = 0; i < 5; i++) {
+      WaitForDurable(wal, wal.Append(MakeRecord({{"A", to_string(i)}})));
+    }
+    // A new segment is started right after a flush becomes durable
+    for (int i = 0; i < 1000 && wal.num_segments() < 6; i++) {
+      this_thread::sleep_for(1ms);
+    }
+    ASSERT_EQ(wal.first_lsn(), 1U);
+    ASSERT_EQ(wal.num_segments(), 6U);
+
+    wal.Truncate(3);
+    ASSERT_EQ(wal.first_lsn(), 4U);
+    ASSERT_EQ(wal.num_segments(), 3U);
+  }
+
+  // The storage must already have the writes of the deleted segments
+  MemOnlyStorage<Key, Record, Metadata> storage;
+  WriteAheadLog wal(directory_, 1000us, 1);
+  ASSERT_EQ(wal.Replay(storage, 3), 2U);
+  ASSERT_EQ(wal.last_lsn(), 5U);
+  Record record;
+  ASSERT_TRUE(storage.Read("A", record));
+  ASSERT_EQ(record.to_string(), "4");
+
+  // The segment that is being appended to is never deleted
+  wal.Truncate(100);
+  ASSERT_EQ(wal.num_segments(), 1U);
+  ASSERT_EQ(wal.first_lsn(), 6U);
+  ASSERT_EQ(wal.Append(MakeRecord({{"B", "b"}})), 6U);
+}
+
+TEST_F(WriteAheadLogTest, TruncateAfterCheckpoint) {
+  atomic<int> num_checkpoints = 0;
+  WriteAheadLog wal(directory_, 1000us, 1, [&num_checkpoints] { num_checkpoints++; });
+  for (int i = 0; i < 5; i++) {
+    WaitForDurable(wal, wal.Append(MakeRecord({{"A", to_string(i)}})));
+  }
+  // The older segments are deleted after the checkpoint that follows the last flush
+  for (int i = 0; i < 1000 && (num_checkpoints < 5 || wal.num_segments() > 1); i++) {
+    this_thread::sleep_for(1ms);
+  }
+  ASSERT_EQ(num_checkpoints, 5);
+  ASSERT_EQ(wal.num_segments(), 1U);
+  ASSERT_EQ(wal.first_lsn(), 6U);
+}
+
+TEST_F(WriteAheadLogTest, ReplayAfterStorageLsn) {
+  {
+    WriteAheadLog wal(directory_, 1000us, 1);
+    for (int i = 1; i <= 4; i++) {
+      WaitForDurable(wal, wal.Append(MakeRecord({{to_string(i), "v"}})));
+    }
+    wal.Truncate(2);
+  }
+
+  {
+    // The storage already has the writes up to LSN 3
+    MemOnlyStorage<Key, Record, Metadata> storage;
+    WriteAheadLog wal(directory_, 1000us, 1);
+    ASSERT_EQ(wal.Replay(storage, 3), 1U);
+    ASSERT_EQ(wal.last_lsn(), 4U);
+    Record record;
+    ASSERT_FALSE(storage.Read("3", record));
+    ASSERT_TRUE(storage.Read("4", record));
+  }
+
+  // Records 1 and 2 are gone so a storage without them is stale
+  {
+    MemOnlyStorage<Key, Record, Metadata> storage;
+    WriteAheadLog wal(directory_, 1000us, 1);
+    ASSERT_DEATH(wal.Replay(storage, 1), "starts at LSN 3");
+  }
+  // The log ends before the writes that the storage has
+  {
+    MemOnlyStorage<Key, Record, Metadata> storage;
+    WriteAheadLog wal(directory_, 1000us, 1);
+    ASSERT_DEATH(wal.Replay(storage, 5), "ends at LSN 4");
+  }
+}
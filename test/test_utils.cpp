@@ -2,6 +2,8 @@
 
 #include <glog/logging.h>
 
+#include <cstring>
+#include <filesystem>
 #include <random>
 
 #include "common/proto_utils.h"
@@ -93,11 +95,26 @@ TxnHolder MakeTestTxnHolder(const ConfigurationPtr& config, TxnId id, const std:
   return holder;
 }
 
+TempDirectory::TempDirectory(const string& prefix) {
+  string path_template = "/tmp/" + prefix + "_XXXXXX";
+  auto path = mkdtemp(path_template.data());
+  CHECK(path != nullptr) << "Cannot create temporary directory \"" << path_template << "\": " << strerror(errno);
+  path_ = path;
+}
+
+TempDirectory::~TempDirectory() { std::filesystem::remove_all(path_); }
+
 TestSlog::TestSlog(const ConfigurationPtr& config)
-    : config_(config),
-      storage_(new MemOnlyStorage<Key, Record, Metadata>()),
-      broker_(Broker::New(config, kTestModuleTimeout)),
-      client_context_(1) {
+    : config_(config), broker_(Broker::New(config, kTestModuleTimeout)), client_context_(1) {
+  if (auto mvs_config = config->multi_version_storage(); mvs_config != nullptr) {
+    multi_version_storage_ = make_shared<MultiVersionStorage>(mvs_config->snapshot_retention());
+    storage_ = multi_version_storage_;
+    lookup_master_index_ = multi_version_storage_;
+  } else {
+    auto storage = make_shared<MemOnlyStorage<Key, Record, Metadata>>();
+    storage_ = storage;
+    lookup_master_index_ = storage;
+  }
   client_context_.set(zmq::ctxopt::blocky, false);
   client_socket_ = zmq::socket_t(client_context_, ZMQ_DEALER);
 }
@@ -108,15 +125,21 @@ void TestSlog::Data(Key&& key, Record&& record) {
   storage_->Write(key, record);
 }
 
-void TestSlog::AddServerAndClient() { server_ = MakeRunnerFor<Server>(config_, broker_, kTestModuleTimeout); }
+void TestSlog::AddServerAndClient() {
+  server_ = MakeRunnerFor<Server>(config_, broker_, multi_version_storage_, kTestModuleTimeout);
+}
 
-void TestSlog::AddForwarder() { forwarder_ = MakeRunnerFor<Forwarder>(config_, broker_, storage_, kTestModuleTimeout); }
+void TestSlog::AddForwarder() {
+  forwarder_ = MakeRunnerFor<Forwarder>(config_, broker_, lookup_master_index_, kTestModuleTimeout);
+}
 
 void TestSlog::AddSequencer() { sequencer_ = MakeRunnerFor<Sequencer>(config_, broker_, kTestModuleTimeout); }
 
 void TestSlog::AddInterleaver() { interleaver_ = MakeRunnerFor<Interleaver>(config_, broker_, kTestModuleTimeout); }
 
-void TestSlog::AddScheduler() { scheduler_ = MakeRunnerFor<Scheduler>(config_, broker_, storage_, kTestModuleTimeout); }
+void TestSlog::AddScheduler(const shared_ptr<WriteAheadLog>& wal) {
+  scheduler_ = MakeRunnerFor<Scheduler>(config_, broker_, storage_, wal, kTestModuleTimeout);
+}
 
 void TestSlog::AddLocalPaxos() { local_paxos_ = MakeRunnerFor<LocalPaxos>(config_, broker_, kTestModuleTimeout); }
 
@@ -14,6 +14,8 @@
 #include "module/base/module.h"
 #include "proto/internal.pb.h"
 #include "storage/mem_only_storage.h"
+#include "storage/multi_version_storage.h"
+#include "storage/write_ahead_log.h"
 
 using std::pair;
 using std::shared_ptr;
@@ -34,11 +36,28 @@ Transaction* MakeTestTransaction(const ConfigurationPtr& config, TxnId id, const
 TxnHolder MakeTestTxnHolder(const ConfigurationPtr& config, TxnId id, const std::vector<KeyEntry>& keys,
                             const std::variant<string, int>& proc = "");
 
+/**
+ * A new directory under /tmp, which is removed with all of its content on destruction
+ */
+class TempDirectory {
+ public:
+  TempDirectory(const string& prefix);
+  ~TempDirectory();
+  TempDirectory(const TempDirectory&) = delete;
+  TempDirectory& operator=(const TempDirectory&) = delete;
+
+  const string& path() const { return path_; }
+
+ private:
+  string path_;
+};
+
 using ModuleRunnerPtr = unique_ptr<ModuleRunner>;
 
 /**
  * This is a fake SLOG system where we can only add a subset
- * of modules to test them in isolation.
+ * of modules to test them in isolation. It uses the multi-version
+ * storage if the configuration has one and an in-memory storage otherwise.
  */
 class TestSlog {
  public:
@@ -48,7 +67,7 @@ class TestSlog {
   void AddForwarder();
   void AddSequencer();
   void AddInterleaver();
-  void AddScheduler();
+  void AddScheduler(const shared_ptr<WriteAheadLog>& wal = nullptr);
   void AddLocalPaxos();
   void AddGlobalPaxos();
   void AddMultiHomeOrderer();
@@ -68,10 +87,14 @@ class TestSlog {
   Transaction RecvTxnResult();
 
   const ConfigurationPtr& config() const { return config_; }
+  // Null if the configuration does not have a multi-version storage
+  const shared_ptr<MultiVersionStorage>& multi_version_storage() const { return multi_version_storage_; }
 
  private:
   ConfigurationPtr config_;
-  shared_ptr<MemOnlyStorage<Key, Record, Metadata>> storage_;
+  shared_ptr<Storage<Key, Record>> storage_;
+  shared_ptr<LookupMasterIndex<Key, Metadata>> lookup_master_index_;
+  shared_ptr<MultiVersionStorage> multi_version_storage_;
   shared_ptr<Broker> broker_;
   ModuleRunnerPtr server_;
   ModuleRunnerPtr forwarder_;
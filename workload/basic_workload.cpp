@@ -1,15 +1,15 @@
 #include "workload/basic_workload.h"
 
-#include <fcntl.h>
 #include <glog/logging.h>
 
 #include <algorithm>
 #include <iomanip>
 #include <random>
 #include <sstream>
+#include <thread>
 #include <unordered_set>
 
-#include "common/offline_data_reader.h"
+#include "common/bulk_data_loader.h"
 #include "common/proto_utils.h"
 #include "proto/offline_data.pb.h"
 
@@ -83,22 +83,30 @@ BasicWorkload::BasicWorkload(const ConfigurationPtr config, uint32_t region, con
 
   if (!simple_partitioning) {
     // Load and index the initial data from file if simple partitioning is not used
+    auto num_threads = std::max(1U, std::thread::hardware_concurrency());
+    BulkDataLoader loader(num_threads);
     for (uint32_t partition = 0; partition < num_partitions; partition++) {
       auto data_file = data_dir + "/" + std::to_string(partition) + ".dat";
-      auto fd = open(data_file.c_str(), O_RDONLY);
-      if (fd < 0) {
+
+      // Chunks are decoded concurrently but the keys must be added in file order
+      // because the first keys of each list are the hot keys
+      vector<vector<std::pair<Key, uint32_t>>> keys_per_chunk(num_threads);
+      bool ok = loader.Load(data_file, [&](uint32_t chunk, vector<Datum>& batch) {
+        auto& keys = keys_per_chunk[chunk];
+        for (auto& datum : batch) {
+          CHECK_LT(datum.master(), num_replicas) << "Master number exceeds number of replicas";
+          keys.emplace_back(std::move(*datum.mutable_key()), datum.master());
+        }
+      });
+      if (!ok) {
         LOG(FATAL) << "Error while loading \"" << data_file << "\": " << strerror(errno);
       }
 
-      OfflineDataReader reader(fd);
-      LOG(INFO) << "Loading " << reader.GetNumDatums() << " datums from " << data_file;
-      while (reader.HasNextDatum()) {
-        auto datum = reader.GetNextDatum();
-        CHECK_LT(datum.master(), num_replicas) << "Master number exceeds number of replicas";
-
-        partition_to_key_lists_[partition][datum.master()].AddKey(datum.key());
+      for (auto& keys : keys_per_chunk) {
+        for (auto& [key, master] : keys) {
+          partition_to_key_lists_[partition][master].AddKey(std::move(key));
+        }
       }
-      close(fd);
     }
   }
 }